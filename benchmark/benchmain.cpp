@@ -0,0 +1,171 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include <QApplication>
+#include <QDebug>
+
+#include "benchmark/benchmark.h"
+#include "global/config.h"
+#include "global/global.h"
+#include "panels/panels.h"
+#include "panels/effectcontrols.h"
+#include "ui/mediaiconservice.h"
+#include "ui/mainwindow.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavfilter/avfilter.h>
+}
+
+/**
+ * @brief Read the integer value following an option
+ *
+ * @return **FALSE** if there is no valid value, in which case an error has already been printed.
+ */
+static bool ReadIntArgument(int argc, char* argv[], int& i, int& value) {
+  if (i + 1 < argc) {
+    bool ok;
+    int v = QString(argv[i + 1]).toInt(&ok);
+    if (ok && v > 0) {
+      value = v;
+      i++;
+      return true;
+    }
+  }
+
+  printf("[ERROR] '%s' requires a positive number\n", argv[i]);
+  return false;
+}
+
+int main(int argc, char *argv[]) {
+  olive::Global = std::unique_ptr<OliveGlobal>(new OliveGlobal);
+
+  BenchmarkParams params;
+  params.output_file = "olive-bench.json";
+
+  for (int i=1;i<argc;i++) {
+    if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
+      printf("Usage: %s [options]\n\n"
+             "Generates synthetic media, runs Olive's decode, compose, audio mix and export paths on it and writes\n"
+             "the timings to a JSON file.\n\n"
+             "Options:\n"
+             "\t-h, --help\t\tShow this help\n"
+             "\t-o, --output <file>\tFile to write the results to (default: olive-bench.json)\n"
+             "\t--only <groups>\t\tComma-separated benchmark groups to run (decode, compose, mix, export)\n"
+             "\t--width <px>\t\tWidth of the generated media and sequences (default: 1920)\n"
+             "\t--height <px>\t\tHeight of the generated media and sequences (default: 1080)\n"
+             "\t--frames <n>\t\tLength of each generated media file and clip (default: 150)\n"
+             "\t--tracks <n>\t\tVideo and audio tracks in the layered sequence (default: 4)\n"
+             "\t--clips <n>\t\tClips per track (default: 2)\n"
+             "\t--effects <n>\t\tShader effects per clip in the effects sequence (default: 4)\n"
+             "\t--seeks <n>\t\tRandom seeks per decode benchmark (default: 50)\n"
+             "\t--software\t\tRender with Mesa's llvmpipe (sets LIBGL_ALWAYS_SOFTWARE, implies --core-profile)\n"
+             "\t--core-profile\t\tRequest an OpenGL 3.2 core profile context\n"
+             "\n"
+             "No window is shown, but an OpenGL capable display is still needed (e.g. run under xvfb-run).\n"
+             "\n", argv[0]);
+      return 0;
+    } else if (!strcmp(argv[i], "--output") || !strcmp(argv[i], "-o")) {
+      if (i + 1 < argc) {
+        params.output_file = argv[i + 1];
+        i++;
+      } else {
+        printf("[ERROR] No output file specified\n");
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--only")) {
+      if (i + 1 < argc) {
+        params.groups = QString(argv[i + 1]).split(',', QString::SkipEmptyParts);
+        i++;
+      } else {
+        printf("[ERROR] No benchmark groups specified\n");
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--width")) {
+      if (!ReadIntArgument(argc, argv, i, params.width)) return 1;
+    } else if (!strcmp(argv[i], "--height")) {
+      if (!ReadIntArgument(argc, argv, i, params.height)) return 1;
+    } else if (!strcmp(argv[i], "--frames")) {
+      if (!ReadIntArgument(argc, argv, i, params.frames)) return 1;
+    } else if (!strcmp(argv[i], "--tracks")) {
+      if (!ReadIntArgument(argc, argv, i, params.tracks)) return 1;
+    } else if (!strcmp(argv[i], "--clips")) {
+      if (!ReadIntArgument(argc, argv, i, params.clips_per_track)) return 1;
+    } else if (!strcmp(argv[i], "--effects")) {
+      if (!ReadIntArgument(argc, argv, i, params.effects_per_clip)) return 1;
+    } else if (!strcmp(argv[i], "--seeks")) {
+      if (!ReadIntArgument(argc, argv, i, params.seeks)) return 1;
+    } else if (!strcmp(argv[i], "--software")) {
+      qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+      olive::CurrentRuntimeConfig.core_profile = true;
+    } else if (!strcmp(argv[i], "--core-profile")) {
+      olive::CurrentRuntimeConfig.core_profile = true;
+    } else {
+      printf("[ERROR] Unknown argument '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+#ifdef OLIVE_BENCH_EFFECTS_PATH
+  // use the shader effects from the source tree unless told otherwise, the benchmark isn't installed next to them
+  if (qgetenv("OLIVE_EFFECTS_PATH").isEmpty()) {
+    qputenv("OLIVE_EFFECTS_PATH", OLIVE_BENCH_EFFECTS_PATH);
+  }
+#endif
+
+  // Initialize ffmpeg subsystem
+  // (these have been deprecated in FFmpeg 4, but are still necessary for FFmpeg 3)
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+  av_register_all();
+#endif
+
+#if LIBAVFILTER_VERSION_INT < AV_VERSION_INT(7, 14, 100)
+  avfilter_register_all();
+#endif
+
+  QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+
+  QSurfaceFormat format;
+  format.setDepthBufferSize(24);
+  if (olive::CurrentRuntimeConfig.core_profile) {
+    format.setVersion(3, 2);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+  }
+  QSurfaceFormat::setDefaultFormat(format);
+
+  QApplication a(argc, argv);
+
+  olive::media_icon_service = std::unique_ptr<MediaIconService>(new MediaIconService());
+
+  QCoreApplication::setOrganizationName("olivevideoeditor.org");
+  QCoreApplication::setOrganizationDomain("olivevideoeditor.org");
+  QCoreApplication::setApplicationName("Olive");
+
+  // the main window is never shown, but creating it sets up the panels and starts loading effects
+  MainWindow w(nullptr);
+
+  // wait for the effects to finish loading before building sequences that use them
+  panel_effect_controls->effects_loaded.lock();
+  panel_effect_controls->effects_loaded.unlock();
+
+  Benchmark benchmark(params);
+
+  return benchmark.Run() ? 0 : 1;
+}
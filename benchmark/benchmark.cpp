@@ -0,0 +1,737 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "benchmark.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QSysInfo>
+
+#include <algorithm>
+
+#include "benchmark/mediagenerator.h"
+#include "effects/effect.h"
+#include "global/global.h"
+#include "rendering/exportthread.h"
+#include "rendering/offlinerenderer.h"
+#include "timeline/clip.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+}
+
+// shader effects stacked onto clips in the effect-heavy compose benchmark, in order
+const char* kShaderEffects[] = {
+  "Gaussian Blur",
+  "Color Correction",
+  "Chromatic Aberration",
+  "Vignette",
+  "Hue/Saturation/Brightness",
+  "Noise",
+  "Box Blur",
+  "Emboss"
+};
+const int kShaderEffectCount = sizeof(kShaderEffects) / sizeof(kShaderEffects[0]);
+
+// how long a compose frame can keep being retried before the benchmark gives up on it (e.g. because the media uses a
+// decoder this FFmpeg build doesn't have, so its clips never become ready)
+const qint64 kComposeFrameTimeoutMs = 30000;
+
+/**
+ * @brief Summarize a list of per-frame times (in milliseconds)
+ */
+static QJsonObject FrameTimeStats(QVector<double> times) {
+  QJsonObject stats;
+
+  if (times.isEmpty()) {
+    return stats;
+  }
+
+  std::sort(times.begin(), times.end());
+
+  double total = 0;
+  for (int i=0;i<times.size();i++) {
+    total += times.at(i);
+  }
+  double mean = total / times.size();
+
+  stats["frames"] = times.size();
+  stats["mean_ms"] = mean;
+  stats["median_ms"] = times.at(times.size() / 2);
+  stats["p95_ms"] = times.at(qMin(times.size() - 1, int(times.size() * 0.95)));
+  stats["max_ms"] = times.last();
+  stats["fps"] = (mean > 0) ? 1000.0 / mean : 0.0;
+
+  return stats;
+}
+
+/**
+ * @brief Decodes a single clip through its Cacher, first sequentially and then at random positions
+ *
+ * Clip::Retrieve() uploads each frame to a texture, so the thread gets its own OpenGL context the same way the
+ * renderers do.
+ */
+class DecodeWorker : public QThread {
+public:
+  DecodeWorker(Clip* clip, QOffscreenSurface* surface, long frame_count, int seeks) :
+    failed_(false),
+    clip_(clip),
+    surface_(surface),
+    frame_count_(frame_count),
+    seeks_(seeks)
+  {}
+
+  virtual void run() override {
+    QOpenGLContext ctx;
+    ctx.setShareContext(QOpenGLContext::globalShareContext());
+    ctx.setFormat(surface_->format());
+    if (!ctx.create() || !ctx.makeCurrent(surface_)) {
+      qCritical() << "Failed to create OpenGL context for decode benchmark";
+      failed_ = true;
+      return;
+    }
+
+    QVector<Clip*> nests;
+    QElapsedTimer timer;
+
+    clip_->Open();
+
+    // the cacher unlocks this once the decoder has been opened
+    clip_->state_change_lock.lock();
+    clip_->state_change_lock.unlock();
+
+    // sequential playback, as the viewer requests frames at normal speed
+    for (long i=0;i<frame_count_;i++) {
+      ClipLatency latency;
+
+      timer.start();
+      clip_->Cache(i, false, nests, 1);
+      clip_->Retrieve(&latency);
+
+      sequential_.append(timer.nsecsElapsed() / 1000000.0);
+      wait_.append(latency.wait / 1000.0);
+    }
+
+    // scrubbing to random frames, seeded so every run requests the same frames
+    quint32 seed = 12345;
+    for (int i=0;i<seeks_;i++) {
+      seed = seed * 1664525u + 1013904223u;
+      long frame = long(seed % quint32(frame_count_));
+
+      timer.start();
+      clip_->Cache(frame, true, nests, 0);
+      clip_->Retrieve();
+
+      seek_.append(timer.nsecsElapsed() / 1000000.0);
+    }
+
+    clip_->Close(true);
+
+    ctx.doneCurrent();
+  }
+
+  bool failed_;
+  QVector<double> sequential_;
+  QVector<double> wait_;
+  QVector<double> seek_;
+
+private:
+  Clip* clip_;
+  QOffscreenSurface* surface_;
+  long frame_count_;
+  int seeks_;
+};
+
+/**
+ * @brief Renders a range of frames with an OfflineRenderer and times each one
+ */
+class ComposeWorker : public QThread {
+public:
+  ComposeWorker(OfflineRenderer* renderer, QOffscreenSurface* surface, long frame_count) :
+    failed_(false),
+    first_frame_ms_(0),
+    retries_(0),
+    renderer_(renderer),
+    surface_(surface),
+    frame_count_(frame_count)
+  {}
+
+  virtual void run() override {
+    if (!renderer_->Start(surface_)) {
+      failed_ = true;
+      return;
+    }
+
+    Sequence* seq = renderer_->sequence();
+    QByteArray pixels(seq->width * seq->height * 4, 0);
+
+    QElapsedTimer timer;
+
+    for (long i=0;i<frame_count_;i++) {
+      timer.start();
+
+      // the renderer returns false if a clip's frame wasn't ready yet, in which case the export thread renders the
+      // same frame again, so count those retries as part of the frame's time
+      while (!renderer_->RenderFrame(i, pixels.data())) {
+        retries_++;
+
+        if (timer.elapsed() > kComposeFrameTimeoutMs) {
+          qWarning() << "Frame" << i << "still wasn't ready after" << kComposeFrameTimeoutMs << "ms, giving up";
+          failed_ = true;
+          break;
+        }
+      }
+
+      if (failed_) {
+        break;
+      }
+
+      double ms = timer.nsecsElapsed() / 1000000.0;
+
+      // the first frame includes opening every clip and compiling shaders, so it's reported separately
+      if (i == 0) {
+        first_frame_ms_ = ms;
+      } else {
+        frames_.append(ms);
+      }
+    }
+
+    renderer_->Stop();
+  }
+
+  bool failed_;
+  double first_frame_ms_;
+  int retries_;
+  QVector<double> frames_;
+
+private:
+  OfflineRenderer* renderer_;
+  QOffscreenSurface* surface_;
+  long frame_count_;
+};
+
+/**
+ * @brief Mixes a sequence's audio with an OfflineRenderer as fast as possible
+ */
+class AudioMixWorker : public QThread {
+public:
+  AudioMixWorker(OfflineRenderer* renderer, QOffscreenSurface* surface, long frame_count) :
+    failed_(false),
+    elapsed_ms_(0),
+    renderer_(renderer),
+    surface_(surface),
+    frame_count_(frame_count)
+  {}
+
+  virtual void run() override {
+    if (!renderer_->Start(surface_)) {
+      failed_ = true;
+      return;
+    }
+
+    Sequence* seq = renderer_->sequence();
+    AudioMixBuffer* buffer = renderer_->audio_buffer();
+
+    buffer->SetSampleRate(seq->audio_frequency);
+    buffer->Reset(0, seq->frame_rate);
+
+    long block_length = renderer_->AudioBlockLength();
+    QVector<qint8> scratch;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (long i=0;i<frame_count_;i+=block_length) {
+      long block_end = qMin(i + block_length, frame_count_) - 1;
+
+      renderer_->MixAudio(i, block_end);
+
+      // drain what was mixed, just like the export thread would, so the next block has room
+      int len = int(buffer->OffsetFromFrame(seq->frame_rate, block_end + 1) - buffer->read);
+      if (len > 0) {
+        scratch.resize(len);
+        buffer->Pull(scratch.data(), len);
+      }
+    }
+
+    elapsed_ms_ = timer.nsecsElapsed() / 1000000.0;
+
+    renderer_->Stop();
+  }
+
+  bool failed_;
+  double elapsed_ms_;
+
+private:
+  OfflineRenderer* renderer_;
+  QOffscreenSurface* surface_;
+  long frame_count_;
+};
+
+Benchmark::Benchmark(const BenchmarkParams &params) :
+  params_(params)
+{
+  // QOffscreenSurface has to be created in the main thread, the worker threads all render to this one
+  surface_.create();
+}
+
+bool Benchmark::Run()
+{
+  if (!media_dir_.isValid()) {
+    qCritical() << "Failed to create temporary directory for benchmark media";
+    return false;
+  }
+
+  if (!GenerateMedia()) {
+    return false;
+  }
+
+  long clip_length = params_.frames;
+  long sequence_length = clip_length * params_.clips_per_track;
+
+  if (ShouldRun("decode")) {
+    RunDecode("h264", h264_media_.get());
+    RunDecode("prores", prores_media_.get());
+    RunDecode("png_sequence", image_sequence_media_.get());
+  }
+
+  // N tracks of M clips each, every track covering the same time range so all of them are composited on every frame
+  SequencePtr layers = CreateSequence("Layers");
+  Media* layer_media = (h264_media_ != nullptr) ? h264_media_.get() : prores_media_.get();
+  for (int i=0;i<params_.tracks;i++) {
+    for (int j=0;j<params_.clips_per_track;j++) {
+      AddClip(layers.get(), layer_media, true, -1 - i, j * clip_length, clip_length);
+      AddClip(layers.get(), audio_media_.get(), false, i, j * clip_length, clip_length);
+    }
+  }
+
+  // a single track of clips with a stack of shader effects on each
+  SequencePtr effects = CreateSequence("Effects");
+  for (int j=0;j<params_.clips_per_track;j++) {
+    Clip* c = AddClip(effects.get(), layer_media, true, -1, j * clip_length, clip_length);
+    AddShaderEffects(c, params_.effects_per_clip);
+  }
+
+  // the layered sequence nested twice on top of each other
+  MediaPtr nested_media = std::make_shared<Media>();
+  nested_media->set_sequence(layers);
+
+  SequencePtr nested = CreateSequence("Nested");
+  AddClip(nested.get(), nested_media.get(), true, -1, 0, sequence_length);
+  AddClip(nested.get(), nested_media.get(), true, -2, 0, sequence_length);
+
+  if (ShouldRun("compose")) {
+    RunCompose("layers", layers.get(), sequence_length);
+    RunCompose("effects", effects.get(), sequence_length);
+    RunCompose("nested", nested.get(), sequence_length);
+  }
+
+  if (ShouldRun("mix")) {
+    RunAudioMix("layers", layers.get(), sequence_length);
+  }
+
+  if (ShouldRun("export")) {
+    RunExport("layers", layers.get(), sequence_length);
+  }
+
+  return Save();
+}
+
+bool Benchmark::GenerateMedia()
+{
+  QDir dir(media_dir_.path());
+
+  qInfo() << "Generating benchmark media in" << dir.path();
+
+  // H.264 through libx264 if FFmpeg was built with it, the native MPEG-4 encoder is always available as a fallback
+  // for a long-GOP codec
+  QString h264_path = dir.filePath("h264.mp4");
+  if (olive::benchmark::GenerateVideo(h264_path,
+                                      "libx264",
+                                      params_.width,
+                                      params_.height,
+                                      params_.frame_rate,
+                                      params_.frames)) {
+    h264_media_ = ImportFootage(h264_path, "H.264", params_.frames);
+  } else if (olive::benchmark::GenerateVideo(h264_path,
+                                             "mpeg4",
+                                             params_.width,
+                                             params_.height,
+                                             params_.frame_rate,
+                                             params_.frames)) {
+    qWarning() << "Falling back to MPEG-4 Part 2 for the long-GOP benchmarks";
+    h264_media_ = ImportFootage(h264_path, "MPEG-4", params_.frames);
+  }
+
+  QString prores_path = dir.filePath("prores.mov");
+  if (olive::benchmark::GenerateVideo(prores_path,
+                                      "prores_ks",
+                                      params_.width,
+                                      params_.height,
+                                      params_.frame_rate,
+                                      params_.frames)) {
+    prores_media_ = ImportFootage(prores_path, "ProRes", params_.frames);
+  }
+
+  QString image_sequence_path = dir.filePath("frame_%04d.png");
+  if (olive::benchmark::GenerateImageSequence(image_sequence_path,
+                                              params_.width,
+                                              params_.height,
+                                              params_.frames)) {
+    image_sequence_media_ = ImportFootage(image_sequence_path, "PNG Sequence", params_.frames);
+  }
+
+  // 5.1 at 48 kHz so every clip has to be downmixed and resampled to the sequence's stereo layout
+  QString audio_path = dir.filePath("audio.wav");
+  if (olive::benchmark::GenerateAudio(audio_path,
+                                      AV_CH_LAYOUT_5POINT1,
+                                      48000,
+                                      double(params_.frames) / params_.frame_rate)) {
+    audio_media_ = ImportFootage(audio_path, "Audio", params_.frames);
+  }
+
+  if ((h264_media_ == nullptr && prores_media_ == nullptr) || audio_media_ == nullptr) {
+    qCritical() << "Failed to generate benchmark media";
+    return false;
+  }
+
+  return true;
+}
+
+MediaPtr Benchmark::ImportFootage(const QString &url, const QString &name, long frame_count)
+{
+  AVFormatContext* fmt_ctx = nullptr;
+
+  if (avformat_open_input(&fmt_ctx, url.toUtf8().constData(), nullptr, nullptr) < 0) {
+    qCritical() << "Failed to open generated media" << url;
+    return nullptr;
+  }
+
+  avformat_find_stream_info(fmt_ctx, nullptr);
+
+  FootagePtr footage = std::make_shared<Footage>();
+  footage->url = url;
+  footage->name = name;
+  footage->using_inout = false;
+
+  for (int i=0;i<int(fmt_ctx->nb_streams);i++) {
+    AVStream* stream = fmt_ctx->streams[i];
+
+    FootageStream ms;
+    ms.file_index = i;
+    ms.enabled = true;
+    ms.infinite_length = false;
+    ms.preview_done = true;
+
+    if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+      ms.video_width = stream->codecpar->width;
+      ms.video_height = stream->codecpar->height;
+      ms.video_frame_rate = (stream->avg_frame_rate.den == 0) ?
+            params_.frame_rate : av_q2d(av_guess_frame_rate(fmt_ctx, stream, nullptr));
+      ms.video_interlacing = VIDEO_PROGRESSIVE;
+      ms.video_auto_interlacing = VIDEO_PROGRESSIVE;
+
+      footage->video_tracks.append(ms);
+    } else if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+      ms.audio_channels = stream->codecpar->channels;
+      ms.audio_layout = int(stream->codecpar->channel_layout);
+      ms.audio_frequency = stream->codecpar->sample_rate;
+
+      footage->audio_tracks.append(ms);
+    }
+  }
+
+  // image sequences don't always report a duration, but we know exactly how long everything we generated is
+  footage->length = (fmt_ctx->duration > 0) ?
+        fmt_ctx->duration : qRound64(double(frame_count) / params_.frame_rate * AV_TIME_BASE);
+
+  avformat_close_input(&fmt_ctx);
+
+  footage->ready = true;
+  footage->ready_lock.unlock();
+
+  MediaPtr media = std::make_shared<Media>();
+  media->set_footage(footage);
+  media->set_name(name);
+
+  return media;
+}
+
+SequencePtr Benchmark::CreateSequence(const QString &name)
+{
+  SequencePtr seq = std::make_shared<Sequence>();
+
+  seq->name = name;
+  seq->width = params_.width;
+  seq->height = params_.height;
+  seq->frame_rate = params_.frame_rate;
+  seq->audio_frequency = 48000;
+  seq->audio_layout = AV_CH_LAYOUT_STEREO;
+
+  return seq;
+}
+
+Clip* Benchmark::AddClip(Sequence *seq, Media *media, bool video, int track, long timeline_in, long length)
+{
+  int stream_index = 0;
+  if (media->get_type() == MEDIA_TYPE_FOOTAGE) {
+    Footage* footage = media->to_footage();
+    stream_index = video ? footage->video_tracks.first().file_index : footage->audio_tracks.first().file_index;
+  }
+
+  ClipPtr c = std::make_shared<Clip>(seq);
+  c->set_media(media, stream_index);
+  c->set_timeline_in(timeline_in);
+  c->set_timeline_out(timeline_in + length);
+  c->set_track(track);
+  c->set_clip_in(0);
+  c->set_name(media->get_name());
+  c->refresh();
+
+  if (video) {
+    c->effects.append(Effect::Create(c.get(), Effect::GetInternalMeta(EFFECT_INTERNAL_TRANSFORM, EFFECT_TYPE_EFFECT)));
+  } else {
+    c->effects.append(Effect::Create(c.get(), Effect::GetInternalMeta(EFFECT_INTERNAL_VOLUME, EFFECT_TYPE_EFFECT)));
+    c->effects.append(Effect::Create(c.get(), Effect::GetInternalMeta(EFFECT_INTERNAL_PAN, EFFECT_TYPE_EFFECT)));
+  }
+
+  seq->clips.append(c);
+
+  return c.get();
+}
+
+void Benchmark::AddShaderEffects(Clip *c, int count)
+{
+  int added = 0;
+
+  for (int i=0;i<kShaderEffectCount && added<count;i++) {
+    const EffectMeta* meta = get_meta_from_name(kShaderEffects[i]);
+    if (meta == nullptr) {
+      qWarning() << "Shader effect" << kShaderEffects[i] << "wasn't found, check OLIVE_EFFECTS_PATH";
+      continue;
+    }
+
+    c->effects.append(Effect::Create(c, meta));
+    added++;
+  }
+}
+
+bool Benchmark::ShouldRun(const QString &group)
+{
+  return params_.groups.isEmpty() || params_.groups.contains(group);
+}
+
+void Benchmark::RunDecode(const QString &name, Media *media)
+{
+  if (media == nullptr) {
+    QJsonObject values;
+    values["skipped"] = true;
+    AddResult("decode", name, values);
+    return;
+  }
+
+  qInfo() << "Running decode benchmark" << name;
+
+  SequencePtr seq = CreateSequence(name);
+  Clip* c = AddClip(seq.get(), media, true, -1, 0, params_.frames);
+
+  DecodeWorker worker(c, &surface_, params_.frames, params_.seeks);
+  RunThread(&worker);
+
+  QJsonObject values;
+  if (worker.failed_) {
+    values["failed"] = true;
+  } else {
+    values["sequential"] = FrameTimeStats(worker.sequential_);
+    values["decode_wait"] = FrameTimeStats(worker.wait_);
+    values["seek"] = FrameTimeStats(worker.seek_);
+  }
+  AddResult("decode", name, values);
+}
+
+void Benchmark::RunCompose(const QString &name, Sequence *seq, long frame_count)
+{
+  qInfo() << "Running compose benchmark" << name;
+
+  OfflineRenderer renderer(seq);
+
+  ComposeWorker worker(&renderer, &surface_, frame_count);
+  RunThread(&worker);
+
+  QJsonObject values;
+  if (worker.failed_) {
+    values["failed"] = true;
+  } else {
+    values["frame_time"] = FrameTimeStats(worker.frames_);
+    values["first_frame_ms"] = worker.first_frame_ms_;
+    values["retries"] = worker.retries_;
+  }
+  AddResult("compose", name, values);
+}
+
+void Benchmark::RunAudioMix(const QString &name, Sequence *seq, long frame_count)
+{
+  qInfo() << "Running audio mix benchmark" << name;
+
+  OfflineRenderer renderer(seq);
+
+  AudioMixWorker worker(&renderer, &surface_, frame_count);
+  RunThread(&worker);
+
+  QJsonObject values;
+  if (worker.failed_) {
+    values["failed"] = true;
+  } else {
+    double audio_seconds = double(frame_count) / seq->frame_rate;
+    int audio_clips = 0;
+    for (int i=0;i<seq->clips.size();i++) {
+      if (seq->clips.at(i) != nullptr && seq->clips.at(i)->track() >= 0) {
+        audio_clips++;
+      }
+    }
+
+    values["clips"] = audio_clips;
+    values["elapsed_ms"] = worker.elapsed_ms_;
+    values["realtime_factor"] = (worker.elapsed_ms_ > 0) ? audio_seconds * 1000.0 / worker.elapsed_ms_ : 0.0;
+  }
+  AddResult("mix", name, values);
+}
+
+void Benchmark::RunExport(const QString &name, Sequence *seq, long frame_count)
+{
+  qInfo() << "Running export benchmark" << name;
+
+  ExportParams params;
+  params.sequence = seq;
+  params.filename = QDir(media_dir_.path()).filePath(QString("export_%1.mp4").arg(name));
+  params.video_enabled = true;
+  params.video_codec = AV_CODEC_ID_MPEG4;
+  params.video_width = seq->width;
+  params.video_height = seq->height;
+  params.video_frame_rate = seq->frame_rate;
+  params.video_compression_type = COMPRESSION_TYPE_CBR;
+  params.video_bitrate = 20;
+  params.audio_enabled = true;
+  params.audio_codec = AV_CODEC_ID_AAC;
+  params.audio_sampling_rate = seq->audio_frequency;
+  params.audio_bitrate = 320;
+  params.start_frame = 0;
+  params.end_frame = frame_count;
+
+  VideoCodecParams vparams;
+  vparams.pix_fmt = AV_PIX_FMT_YUV420P;
+  vparams.threads = 0;
+  vparams.segments = 0;
+
+  ExportThread thread(params, vparams);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  RunThread(&thread);
+
+  double elapsed_ms = timer.nsecsElapsed() / 1000000.0;
+
+  QJsonObject values;
+  if (!thread.GetError().isEmpty()) {
+    values["failed"] = true;
+    values["error"] = thread.GetError();
+  } else {
+    values["frames"] = int(frame_count);
+    values["elapsed_ms"] = elapsed_ms;
+    values["fps"] = (elapsed_ms > 0) ? frame_count * 1000.0 / elapsed_ms : 0.0;
+  }
+  AddResult("export", name, values);
+}
+
+void Benchmark::RunThread(QThread *thread)
+{
+  thread->start();
+
+  while (!thread->wait(10)) {
+    QCoreApplication::processEvents();
+  }
+
+  // handle anything the thread queued right before finishing
+  QCoreApplication::processEvents();
+}
+
+void Benchmark::AddResult(const QString &group, const QString &name, QJsonObject values)
+{
+  values["group"] = group;
+  values["name"] = name;
+  results_.append(values);
+}
+
+bool Benchmark::Save()
+{
+  QJsonObject params;
+  params["width"] = params_.width;
+  params["height"] = params_.height;
+  params["frame_rate"] = params_.frame_rate;
+  params["frames"] = params_.frames;
+  params["tracks"] = params_.tracks;
+  params["clips_per_track"] = params_.clips_per_track;
+  params["effects_per_clip"] = params_.effects_per_clip;
+  params["seeks"] = params_.seeks;
+
+  QJsonObject system;
+  system["cpu"] = QSysInfo::currentCpuArchitecture();
+  system["os"] = QSysInfo::prettyProductName();
+  system["threads"] = QThread::idealThreadCount();
+  system["ffmpeg"] = QString(av_version_info());
+
+  // ask a throwaway context which OpenGL implementation all the rendering actually went through
+  QOpenGLContext ctx;
+  ctx.setShareContext(QOpenGLContext::globalShareContext());
+  if (ctx.create() && ctx.makeCurrent(&surface_)) {
+    system["gl_renderer"] = QString(reinterpret_cast<const char*>(ctx.functions()->glGetString(GL_RENDERER)));
+    system["gl_version"] = QString(reinterpret_cast<const char*>(ctx.functions()->glGetString(GL_VERSION)));
+    ctx.doneCurrent();
+  }
+
+  QJsonObject root;
+  root["version"] = olive::AppName;
+  root["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+  root["system"] = system;
+  root["parameters"] = params;
+  root["results"] = results_;
+
+  QFile file(params_.output_file);
+  if (!file.open(QFile::WriteOnly)) {
+    qCritical() << "Failed to open" << params_.output_file << "for writing";
+    return false;
+  }
+
+  file.write(QJsonDocument(root).toJson());
+  file.close();
+
+  qInfo() << "Benchmark results written to" << params_.output_file;
+
+  return true;
+}
@@ -0,0 +1,149 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QOffscreenSurface>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QVector>
+
+#include "project/media.h"
+#include "timeline/sequence.h"
+
+class Clip;
+
+/**
+ * @brief Settings for one olive-bench run
+ */
+struct BenchmarkParams {
+  // file the JSON results are written to
+  QString output_file;
+
+  // resolution and frame rate of the generated media and sequences
+  int width = 1920;
+  int height = 1080;
+  int frame_rate = 30;
+
+  // length of each generated media file and of each clip in the generated sequences, in frames
+  int frames = 150;
+
+  // shape of the generated multi-layer sequences
+  int tracks = 4;
+  int clips_per_track = 2;
+  int effects_per_clip = 4;
+
+  // number of random seeks in the decode benchmarks
+  int seeks = 50;
+
+  // benchmark groups to run ("decode", "compose", "mix", "export"), all of them if empty
+  QStringList groups;
+};
+
+/**
+ * @brief Headless performance benchmarks of the main playback and export paths
+ *
+ * Generates its own media into a temporary directory (see mediagenerator.h), builds sequences in code and measures:
+ *
+ * * **decode** - sequential playback and random seek speed of a single clip's Cacher for each media type
+ * * **compose** - frame times of rendering multi-layer, effect-heavy and nested sequences with an OfflineRenderer
+ * * **mix** - audio mixing throughput of many multichannel clips through their Volume and Pan effects
+ * * **export** - end-to-end frames per second of an ExportThread
+ *
+ * Every benchmark runs on the same code paths the editor uses, so the numbers move with changes to the real pipeline.
+ * Results are collected into a JSON document so runs can be compared between builds and machines.
+ *
+ * Must be created and run in the main thread after the effects have been loaded.
+ */
+class Benchmark {
+public:
+  Benchmark(const BenchmarkParams& params);
+
+  /**
+   * @brief Generate the media, run every requested benchmark and write the results
+   *
+   * @return **FALSE** if the media couldn't be generated or the results couldn't be written. A single benchmark
+   * failing is recorded in the results but doesn't fail the run.
+   */
+  bool Run();
+
+private:
+  bool GenerateMedia();
+
+  /**
+   * @brief Probe a generated file and wrap it in a ready Media object
+   *
+   * Equivalent to what PreviewGenerator fills in on import, but synchronous and without generating thumbnails or
+   * waveforms.
+   */
+  MediaPtr ImportFootage(const QString& url, const QString& name, long frame_count);
+
+  SequencePtr CreateSequence(const QString& name);
+
+  /**
+   * @brief Add a clip of `media` to `seq`
+   *
+   * Video clips (`track` < 0) get a Transform effect and audio clips get Volume and Pan, the same default effects the
+   * timeline adds to new clips.
+   */
+  Clip* AddClip(Sequence* seq, Media* media, bool video, int track, long timeline_in, long length);
+
+  /**
+   * @brief Append up to `count` GLSL shader effects to a clip
+   */
+  void AddShaderEffects(Clip* c, int count);
+
+  bool ShouldRun(const QString& group);
+
+  void RunDecode(const QString& name, Media* media);
+  void RunCompose(const QString& name, Sequence* seq, long frame_count);
+  void RunAudioMix(const QString& name, Sequence* seq, long frame_count);
+  void RunExport(const QString& name, Sequence* seq, long frame_count);
+
+  /**
+   * @brief Start a thread and keep processing main thread events until it finishes
+   *
+   * Clips, renderers and export threads all queue work onto the main thread, so it can't simply block on wait().
+   */
+  void RunThread(QThread* thread);
+
+  void AddResult(const QString& group, const QString& name, QJsonObject values);
+
+  bool Save();
+
+  BenchmarkParams params_;
+
+  QTemporaryDir media_dir_;
+
+  QOffscreenSurface surface_;
+
+  MediaPtr h264_media_;
+  MediaPtr prores_media_;
+  MediaPtr image_sequence_media_;
+  MediaPtr audio_media_;
+
+  QJsonArray results_;
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,349 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "mediagenerator.h"
+
+#include <QDebug>
+#include <QtMath>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libswscale/swscale.h>
+}
+
+/**
+ * @brief An open output file with a single encoded stream
+ */
+struct OutputFile {
+  AVFormatContext* fmt_ctx = nullptr;
+  AVCodecContext* codec_ctx = nullptr;
+  AVStream* stream = nullptr;
+  AVPacket* packet = nullptr;
+};
+
+static void CloseOutput(OutputFile& out) {
+  if (out.fmt_ctx != nullptr && out.fmt_ctx->pb != nullptr && !(out.fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+    avio_closep(&out.fmt_ctx->pb);
+  }
+  avformat_free_context(out.fmt_ctx);
+  avcodec_free_context(&out.codec_ctx);
+  av_packet_free(&out.packet);
+}
+
+/**
+ * @brief Send a frame (or nullptr to flush) to the encoder and write out every packet it returns
+ */
+static bool EncodeFrame(OutputFile& out, AVFrame* frame) {
+  int err = avcodec_send_frame(out.codec_ctx, frame);
+  if (err < 0) {
+    char err_str[256];
+    av_strerror(err, err_str, sizeof(err_str));
+    qCritical() << "Failed to send frame to encoder" << err_str;
+    return false;
+  }
+
+  while (true) {
+    err = avcodec_receive_packet(out.codec_ctx, out.packet);
+    if (err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
+      return true;
+    } else if (err < 0) {
+      char err_str[256];
+      av_strerror(err, err_str, sizeof(err_str));
+      qCritical() << "Failed to receive packet from encoder" << err_str;
+      return false;
+    }
+
+    av_packet_rescale_ts(out.packet, out.codec_ctx->time_base, out.stream->time_base);
+    out.packet->stream_index = out.stream->index;
+    av_interleaved_write_frame(out.fmt_ctx, out.packet);
+    av_packet_unref(out.packet);
+  }
+}
+
+/**
+ * @brief Create the output file and encoder
+ *
+ * `setup` fills in the codec specific parameters of the codec context before it's opened.
+ */
+static bool OpenOutput(OutputFile& out,
+                       const QString& filename,
+                       const AVCodec* codec,
+                       void (*setup)(AVCodecContext*, const void*),
+                       const void* setup_data) {
+  QByteArray filename_bytes = filename.toUtf8();
+
+  avformat_alloc_output_context2(&out.fmt_ctx, nullptr, nullptr, filename_bytes.constData());
+  if (out.fmt_ctx == nullptr) {
+    qCritical() << "Failed to find a container format for" << filename;
+    return false;
+  }
+
+  out.stream = avformat_new_stream(out.fmt_ctx, nullptr);
+  out.codec_ctx = avcodec_alloc_context3(codec);
+  out.packet = av_packet_alloc();
+
+  setup(out.codec_ctx, setup_data);
+
+  if (out.fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
+    out.codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  if (avcodec_open2(out.codec_ctx, codec, nullptr) < 0) {
+    qCritical() << "Failed to open encoder" << codec->name;
+    return false;
+  }
+
+  avcodec_parameters_from_context(out.stream->codecpar, out.codec_ctx);
+  out.stream->time_base = out.codec_ctx->time_base;
+
+  if (!(out.fmt_ctx->oformat->flags & AVFMT_NOFILE)
+      && avio_open(&out.fmt_ctx->pb, filename_bytes.constData(), AVIO_FLAG_WRITE) < 0) {
+    qCritical() << "Failed to open" << filename << "for writing";
+    return false;
+  }
+
+  if (avformat_write_header(out.fmt_ctx, nullptr) < 0) {
+    qCritical() << "Failed to write header of" << filename;
+    return false;
+  }
+
+  return true;
+}
+
+struct VideoSetup {
+  int width;
+  int height;
+  int frame_rate;
+  AVPixelFormat pix_fmt;
+};
+
+static void SetupVideoCodec(AVCodecContext* ctx, const void* data) {
+  const VideoSetup* v = static_cast<const VideoSetup*>(data);
+  ctx->width = v->width;
+  ctx->height = v->height;
+  ctx->pix_fmt = v->pix_fmt;
+  ctx->time_base = {1, v->frame_rate};
+  ctx->framerate = {v->frame_rate, 1};
+  ctx->sample_aspect_ratio = {1, 1};
+
+  // one keyframe per second, roughly what a camera or a typical delivery file would have
+  ctx->gop_size = v->frame_rate;
+  ctx->bit_rate = qint64(v->width) * v->height * v->frame_rate / 10;
+}
+
+struct AudioSetup {
+  uint64_t channel_layout;
+  int sample_rate;
+};
+
+static void SetupAudioCodec(AVCodecContext* ctx, const void* data) {
+  const AudioSetup* a = static_cast<const AudioSetup*>(data);
+  ctx->sample_fmt = AV_SAMPLE_FMT_S16;
+  ctx->sample_rate = a->sample_rate;
+  ctx->channel_layout = a->channel_layout;
+  ctx->channels = av_get_channel_layout_nb_channels(a->channel_layout);
+  ctx->time_base = {1, a->sample_rate};
+}
+
+/**
+ * @brief Draw one frame of the test pattern
+ *
+ * A diagonal gradient scrolling with the frame number plus a bar moving across the frame, enough motion that
+ * inter-frame codecs can't reduce every frame to nothing.
+ */
+static void DrawPattern(uint8_t* rgba, int linesize, int width, int height, int frame) {
+  int bar_x = (frame * 8) % width;
+
+  for (int y=0;y<height;y++) {
+    uint8_t* row = rgba + y * linesize;
+    for (int x=0;x<width;x++) {
+      uint8_t* px = row + x * 4;
+      px[0] = uint8_t((x + frame * 2) & 0xFF);
+      px[1] = uint8_t((y + frame) & 0xFF);
+      px[2] = uint8_t(((x + y) / 2) & 0xFF);
+      px[3] = 0xFF;
+
+      if (x >= bar_x && x < bar_x + 16) {
+        px[0] = px[1] = px[2] = 0xFF;
+      }
+    }
+  }
+}
+
+static bool EncodeVideo(const QString& filename,
+                        const AVCodec* codec,
+                        int width,
+                        int height,
+                        int frame_rate,
+                        int frame_count) {
+  VideoSetup setup;
+  setup.width = width;
+  setup.height = height;
+  setup.frame_rate = frame_rate;
+  setup.pix_fmt = (codec->pix_fmts != nullptr) ? codec->pix_fmts[0] : AV_PIX_FMT_YUV420P;
+
+  OutputFile out;
+  bool ok = OpenOutput(out, filename, codec, SetupVideoCodec, &setup);
+
+  AVFrame* rgba_frame = av_frame_alloc();
+  AVFrame* frame = av_frame_alloc();
+  SwsContext* sws_ctx = nullptr;
+
+  if (ok) {
+    rgba_frame->format = AV_PIX_FMT_RGBA;
+    rgba_frame->width = width;
+    rgba_frame->height = height;
+    av_frame_get_buffer(rgba_frame, 0);
+
+    frame->format = setup.pix_fmt;
+    frame->width = width;
+    frame->height = height;
+    av_frame_get_buffer(frame, 0);
+
+    sws_ctx = sws_getContext(width,
+                             height,
+                             AV_PIX_FMT_RGBA,
+                             width,
+                             height,
+                             setup.pix_fmt,
+                             SWS_BILINEAR,
+                             nullptr,
+                             nullptr,
+                             nullptr);
+  }
+
+  for (int i=0;ok && i<frame_count;i++) {
+    av_frame_make_writable(frame);
+
+    DrawPattern(rgba_frame->data[0], rgba_frame->linesize[0], width, height, i);
+
+    sws_scale(sws_ctx,
+              rgba_frame->data,
+              rgba_frame->linesize,
+              0,
+              height,
+              frame->data,
+              frame->linesize);
+
+    frame->pts = i;
+
+    ok = EncodeFrame(out, frame);
+  }
+
+  if (ok) {
+    ok = EncodeFrame(out, nullptr) && av_write_trailer(out.fmt_ctx) >= 0;
+  }
+
+  sws_freeContext(sws_ctx);
+  av_frame_free(&frame);
+  av_frame_free(&rgba_frame);
+  CloseOutput(out);
+
+  return ok;
+}
+
+bool olive::benchmark::GenerateVideo(const QString &filename,
+                                     const char *encoder_name,
+                                     int width,
+                                     int height,
+                                     int frame_rate,
+                                     int frame_count) {
+  const AVCodec* codec = avcodec_find_encoder_by_name(encoder_name);
+  if (codec == nullptr) {
+    qWarning() << "Encoder" << encoder_name << "is not available in this FFmpeg build";
+    return false;
+  }
+
+  return EncodeVideo(filename, codec, width, height, frame_rate, frame_count);
+}
+
+bool olive::benchmark::GenerateImageSequence(const QString &pattern,
+                                             int width,
+                                             int height,
+                                             int frame_count) {
+  const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_PNG);
+  if (codec == nullptr) {
+    qWarning() << "PNG encoder is not available in this FFmpeg build";
+    return false;
+  }
+
+  // the image2 muxer is picked from the numbered pattern and writes one file per frame
+  return EncodeVideo(pattern, codec, width, height, 25, frame_count);
+}
+
+bool olive::benchmark::GenerateAudio(const QString &filename,
+                                     uint64_t channel_layout,
+                                     int sample_rate,
+                                     double seconds) {
+  const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_PCM_S16LE);
+  if (codec == nullptr) {
+    qWarning() << "PCM encoder is not available in this FFmpeg build";
+    return false;
+  }
+
+  AudioSetup setup;
+  setup.channel_layout = channel_layout;
+  setup.sample_rate = sample_rate;
+
+  OutputFile out;
+  bool ok = OpenOutput(out, filename, codec, SetupAudioCodec, &setup);
+
+  const int samples_per_frame = 1024;
+  int channels = av_get_channel_layout_nb_channels(channel_layout);
+  int64_t total_samples = qRound64(seconds * sample_rate);
+
+  AVFrame* frame = av_frame_alloc();
+  if (ok) {
+    frame->format = AV_SAMPLE_FMT_S16;
+    frame->channel_layout = channel_layout;
+    frame->channels = channels;
+    frame->sample_rate = sample_rate;
+    frame->nb_samples = samples_per_frame;
+    av_frame_get_buffer(frame, 0);
+  }
+
+  for (int64_t pos=0;ok && pos<total_samples;pos+=samples_per_frame) {
+    av_frame_make_writable(frame);
+
+    frame->nb_samples = int(qMin(int64_t(samples_per_frame), total_samples - pos));
+    frame->pts = pos;
+
+    int16_t* samples = reinterpret_cast<int16_t*>(frame->data[0]);
+    for (int i=0;i<frame->nb_samples;i++) {
+      double t = double(pos + i) / sample_rate;
+      for (int j=0;j<channels;j++) {
+        // every channel gets its own pitch so a downmix that drops or swaps channels is audible
+        samples[i*channels + j] = int16_t(qSin(2.0 * M_PI * (220.0 * (j + 1)) * t) * 8192.0);
+      }
+    }
+
+    ok = EncodeFrame(out, frame);
+  }
+
+  if (ok) {
+    ok = EncodeFrame(out, nullptr) && av_write_trailer(out.fmt_ctx) >= 0;
+  }
+
+  av_frame_free(&frame);
+  CloseOutput(out);
+
+  return ok;
+}
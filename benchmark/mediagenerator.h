@@ -0,0 +1,87 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef MEDIAGENERATOR_H
+#define MEDIAGENERATOR_H
+
+#include <QString>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+/**
+ * @brief Functions for writing synthetic media files used by olive-bench
+ *
+ * Every file is encoded from a generated test pattern (a moving gradient for video, a different sine tone per channel
+ * for audio), so the benchmarks don't depend on any media being present on the machine they run on and give
+ * comparable numbers from one run to the next.
+ */
+namespace olive {
+  namespace benchmark {
+
+    /**
+     * @brief Encode a test pattern video file
+     *
+     * @param filename
+     *
+     * File to write, the container is guessed from its extension.
+     *
+     * @param encoder_name
+     *
+     * Name of the FFmpeg encoder to use (e.g. "libx264" or "prores_ks").
+     *
+     * @return **TRUE** if the file was written, **FALSE** if the encoder isn't available or encoding failed.
+     */
+    bool GenerateVideo(const QString& filename,
+                       const char* encoder_name,
+                       int width,
+                       int height,
+                       int frame_rate,
+                       int frame_count);
+
+    /**
+     * @brief Write a numbered sequence of PNG images
+     *
+     * @param pattern
+     *
+     * printf-style filename pattern (e.g. "frame_%04d.png"), numbered from 0.
+     */
+    bool GenerateImageSequence(const QString& pattern,
+                               int width,
+                               int height,
+                               int frame_count);
+
+    /**
+     * @brief Write an uncompressed multichannel WAV file
+     *
+     * @param channel_layout
+     *
+     * FFmpeg channel layout (AV_CH_LAYOUT_*) of the file.
+     */
+    bool GenerateAudio(const QString& filename,
+                       uint64_t channel_layout,
+                       int sample_rate,
+                       double seconds);
+
+  }
+}
+
+#endif // MEDIAGENERATOR_H
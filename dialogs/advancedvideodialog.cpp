@@ -89,6 +89,24 @@ AdvancedVideoDialog::AdvancedVideoDialog(QWidget *parent,
 
   row++;
 
+  // create row for parallel segment count
+  layout->addWidget(new QLabel(tr("Parallel Segments:")), row, 0);
+
+  segment_spinbox_ = new QSpinBox();
+
+  // "0" lets the export pick a segment count based on the CPU, "1" exports the whole range as one segment
+  segment_spinbox_->setMinimum(0);
+  segment_spinbox_->setMaximum(64);
+  segment_spinbox_->setSpecialValueText("Auto");
+  segment_spinbox_->setToolTip(tr("Splits the export into segments that are rendered and encoded simultaneously. "
+                                  "Only used by codecs that can be joined losslessly (set to 1 to disable)."));
+
+  segment_spinbox_->setValue(params_.segments);
+
+  layout->addWidget(segment_spinbox_, row, 1);
+
+  row++;
+
   // buttons
   QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
   buttons->setCenterButtons(true);
@@ -102,6 +120,7 @@ void AdvancedVideoDialog::accept() {
 
   params_.pix_fmt = pix_fmt_combo_->currentData().toInt();
   params_.threads = thread_spinbox_->value();
+  params_.segments = segment_spinbox_->value();
 
   QDialog::accept();
 }
@@ -75,6 +75,11 @@ private:
    * @brief SpinBox for multithreading settings
    */
   QSpinBox* thread_spinbox_;
+
+  /**
+   * @brief SpinBox for the number of segments to export in parallel
+   */
+  QSpinBox* segment_spinbox_;
 };
 
 #endif // ADVANCEDVIDEODIALOG_H
@@ -20,7 +20,7 @@
 
 #include "debugdialog.h"
 
-#include <QTextEdit>
+#include <QPlainTextEdit>
 #include <QVBoxLayout>
 #include <QScrollBar>
 #include <QEvent>
@@ -29,11 +29,16 @@
 
 DebugDialog* olive::DebugDialog = nullptr;
 
-DebugDialog::DebugDialog(QWidget *parent) : QDialog(parent) {
+DebugDialog::DebugDialog(QWidget *parent) :
+  QDialog(parent),
+  next_line_(0)
+{
   QVBoxLayout* layout = new QVBoxLayout(this);
 
-  textEdit = new QTextEdit(this);
+  textEdit = new QPlainTextEdit(this);
+  textEdit->setReadOnly(true);
   textEdit->setWordWrapMode(QTextOption::NoWrap);
+  textEdit->setMaximumBlockCount(kDebugHistorySize);
   layout->addWidget(textEdit);
 
   Retranslate();
@@ -45,7 +50,13 @@ void DebugDialog::Retranslate()
 }
 
 void DebugDialog::update_log() {
-  textEdit->setHtml(get_debug_str());
+  QStringList lines;
+  next_line_ = get_debug_lines(next_line_, lines);
+
+  for (int i=0;i<lines.size();i++) {
+    textEdit->appendHtml(lines.at(i));
+  }
+
   textEdit->verticalScrollBar()->setValue(textEdit->verticalScrollBar()->maximum());
 }
 
@@ -59,5 +70,6 @@ void DebugDialog::changeEvent(QEvent *e)
 }
 
 void DebugDialog::showEvent(QShowEvent *) {
+  // catch up on messages logged while the dialog was hidden
   update_log();
 }
@@ -22,7 +22,7 @@
 #define DEBUGDIALOG_H
 
 #include <QDialog>
-#include <QTextEdit>
+#include <QPlainTextEdit>
 
 /**
  * @brief The DebugDialog class
@@ -49,7 +49,7 @@ public:
   void Retranslate();
 public slots:
   /**
-   * @brief Update the visual log with the debug text from get_debug_str()
+   * @brief Append any messages logged since the last update to the visual log (see get_debug_lines())
    */
   void update_log();
 protected:
@@ -65,8 +65,15 @@ protected:
 private:
   /**
    * @brief Display widget for the debug dialog.
+   *
+   * Limited to kDebugHistorySize lines, so appending to it never gets slower over a long session.
+   */
+  QPlainTextEdit* textEdit;
+
+  /**
+   * @brief Number of the next message to append to the visual log
    */
-  QTextEdit* textEdit;
+  int next_line_;
 };
 
 namespace olive {
@@ -116,6 +116,7 @@ ExportDialog::ExportDialog(QWidget *parent) :
 
   // set some advanced defaults
   vcodec_params.threads = 0;
+  vcodec_params.segments = 0;
 }
 
 void ExportDialog::add_codec_to_combobox(QComboBox* box, enum AVCodecID codec) {
@@ -344,16 +345,11 @@ void ExportDialog::export_thread_finished() {
           );
   }
 
-  // Clear audio buffer
-  clear_audio_ibuffer();
+  olive::Global->set_rendering_state(false);
 
   // Re-enable/disable UI widgets based on the rendering state
   prep_ui_for_render(false);
 
-  // Move OpenGL context back to the sequence viewer
-  panel_sequence_viewer->viewer_widget->makeCurrent();
-  panel_sequence_viewer->viewer_widget->initializeGL();
-
   // Update the application UI
   update_ui(false);
 
@@ -537,6 +533,7 @@ void ExportDialog::StartExport() {
 
     // Set up export parameters to send to the ExportThread
     ExportParams params;
+    params.sequence = olive::ActiveSequence.get();
     params.filename = filename;
     params.video_enabled = videoGroupbox->isChecked();
     if (params.video_enabled) {
@@ -552,6 +549,7 @@ void ExportDialog::StartExport() {
       params.audio_codec = acodecCombobox->currentData().toInt();
       params.audio_sampling_rate = samplingRateSpinbox->value();
       params.audio_bitrate = audiobitrateSpinbox->value();
+      params.audio_stems = !params.video_enabled && audioStemsCheckbox->isChecked();
     }
 
     params.start_frame = 0;
@@ -569,14 +567,9 @@ void ExportDialog::StartExport() {
     connect(export_thread_, SIGNAL(ProgressChanged(int, qint64)), this, SLOT(update_progress_bar(int, qint64)));
     connect(renderCancel, SIGNAL(clicked(bool)), export_thread_, SLOT(Interrupt()));
 
-    // Close all effects in effect controls (prevents UI threading issues)
-    panel_effect_controls->Clear();
-
+    // The export thread renders its own copy of the sequence, so the viewers and open clips are left alone
     olive::Global->set_rendering_state(true);
 
-    // Close all currently open clips
-    close_active_clips(olive::ActiveSequence.get());
-
     olive::Global->save_autorecovery_file();
 
     prep_ui_for_render(true);
@@ -764,6 +757,12 @@ void ExportDialog::setup_ui() {
   audiobitrateSpinbox->setValue(256);
   audioGridLayout->addWidget(audiobitrateSpinbox, 3, 1, 1, 1);
 
+  // stems are only available for audio-only exports
+  audioStemsCheckbox = new QCheckBox(tr("Export each track to a separate file"), audioGroupbox);
+  audioStemsCheckbox->setEnabled(!videoGroupbox->isChecked());
+  connect(videoGroupbox, SIGNAL(toggled(bool)), audioStemsCheckbox, SLOT(setDisabled(bool)));
+  audioGridLayout->addWidget(audioStemsCheckbox, 4, 0, 1, 2);
+
   verticalLayout->addWidget(audioGroupbox);
 
   QHBoxLayout* progressLayout = new QHBoxLayout();
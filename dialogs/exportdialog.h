@@ -28,6 +28,7 @@
 #include <QLabel>
 #include <QProgressBar>
 #include <QGroupBox>
+#include <QCheckBox>
 
 #include "timeline/sequence.h"
 #include "rendering/exportthread.h"
@@ -221,6 +222,11 @@ private:
    */
   QSpinBox* audiobitrateSpinbox;
 
+  /**
+   * @brief CheckBox for exporting every audio track to its own file (audio-only exports)
+   */
+  QCheckBox* audioStemsCheckbox;
+
   /**
    * @brief Progress bar for visually showing the export progress
    */
@@ -43,11 +43,14 @@
 #include <QApplication>
 #include <QProcess>
 #include <QDebug>
+#include <QTimer>
 
 #include "global/global.h"
 #include "global/config.h"
 #include "global/path.h"
+#include "project/previewcache.h"
 #include "rendering/audio.h"
+#include "rendering/framebudget.h"
 #include "panels/panels.h"
 #include "ui/columnedgridlayout.h"
 #include "ui/mainwindow.h"
@@ -118,39 +121,6 @@ void PreferencesDialog::setup_kbd_shortcut_worker(QMenu* menu, QTreeWidgetItem*
   }
 }
 
-void PreferencesDialog::delete_previews(char type) {
-  if (type != 't' && type != 'w' && type != 1) return;
-
-  QDir preview_path(get_data_path() + "/previews");
-
-  if (type == 1) {
-    // indiscriminately delete everything
-    preview_path.removeRecursively();
-  } else {
-    QStringList preview_file_list = preview_path.entryList(QDir::Files | QDir::NoDotAndDotDot);
-    for (int i=0;i<preview_file_list.size();i++) {
-
-      const QString& preview_file_str = preview_file_list.at(i);
-
-      // use filename to determine whether this is a thumbnail or a waveform
-      int identifier_char_index = qMax(0, preview_file_str.size()-2);
-
-      // find identifier char
-      while (identifier_char_index >= 0
-             && preview_file_str.at(identifier_char_index) >= 48
-             && preview_file_str.at(identifier_char_index) <= 57) {
-        identifier_char_index--;
-      }
-
-      // thumbnails will have a 't' towards the end of the filenames, waveforms will have a 'w'
-      // if they match the type of preview we're deleting, remove them
-      if (preview_file_str.at(identifier_char_index) == type) {
-        QFile::remove(preview_path.filePath(preview_file_str));
-      }
-    }
-  }
-}
-
 void PreferencesDialog::AddBoolPair(QCheckBox *ui, bool *value, bool restart_required)
 {
   bool_ui.append(ui);
@@ -265,6 +235,9 @@ void PreferencesDialog::accept() {
   olive::CurrentConfig.upcoming_queue_type = upcoming_queue_type->currentIndex();
   olive::CurrentConfig.previous_queue_size = previous_queue_spinbox->value();
   olive::CurrentConfig.previous_queue_type = previous_queue_type->currentIndex();
+  olive::CurrentConfig.frame_memory_budget = frame_memory_budget_spinbox->value();
+  olive::CurrentConfig.prefetch_window = prefetch_window_spinbox->value();
+  olive::CurrentConfig.max_open_decoders = max_open_decoders_spinbox->value();
 
   olive::CurrentConfig.preferred_audio_output = audio_output_devices->currentData().toString();
   olive::CurrentConfig.preferred_audio_input = audio_input_devices->currentData().toString();
@@ -284,39 +257,12 @@ void PreferencesDialog::accept() {
   }
 
   olive::CurrentConfig.style = static_cast<olive::styling::Style>(ui_style->currentData().toInt());
+  olive::CurrentConfig.preview_cache_limit = preview_cache_limit_spinbox->value();
 
-  // Check if the thumbnail or waveform icon
-  if (olive::CurrentConfig.thumbnail_resolution != thumbnail_res_spinbox->value()
-      || olive::CurrentConfig.waveform_resolution != waveform_res_spinbox->value()) {
-    // we're changing the size of thumbnails and waveforms, so let's delete them and regenerate them next start
-
-    // delete nothing
-    char delete_match = 0;
-
-    if (olive::CurrentConfig.thumbnail_resolution != thumbnail_res_spinbox->value()) {
-      // delete existing thumbnails
-      olive::CurrentConfig.thumbnail_resolution = thumbnail_res_spinbox->value();
-
-      // delete only thumbnails
-      delete_match = 't';
-    }
-
-    if (olive::CurrentConfig.waveform_resolution != waveform_res_spinbox->value()) {
-      // delete existing waveforms
-      olive::CurrentConfig.waveform_resolution = waveform_res_spinbox->value();
-
-      // if we're already deleting thumbnails
-      if (delete_match == 't') {
-        // delete all
-        delete_match = 1;
-      } else {
-        // just delete waveforms
-        delete_match = 'w';
-      }
-    }
-
-    delete_previews(delete_match);
-  }
+  // Cached previews are stored per resolution, so previews at the old resolution are simply no longer used and get
+  // evicted from the preview cache over time
+  olive::CurrentConfig.thumbnail_resolution = thumbnail_res_spinbox->value();
+  olive::CurrentConfig.waveform_resolution = waveform_res_spinbox->value();
 
   // Save keyboard shortcuts
   for (int i=0;i<key_shortcut_fields.size();i++) {
@@ -476,7 +422,7 @@ void PreferencesDialog::delete_all_previews() {
                             tr("Delete All Previews"),
                             tr("Are you sure you want to delete all previews?"),
                             QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
-    delete_previews(1);
+    PreviewCache::Clear();
     QMessageBox::information(this,
                              tr("Previews Deleted"),
                              tr("All previews deleted succesfully. You may have to re-open your current project for changes to take effect."),
@@ -484,6 +430,13 @@ void PreferencesDialog::delete_all_previews() {
   }
 }
 
+void PreferencesDialog::update_frame_memory_usage() {
+  frame_memory_usage_label->setText(tr("Currently using %1 MB for decoded frames of %n clip(s)",
+                                       nullptr,
+                                       olive::frame_budget.count())
+                                    .arg(olive::frame_budget.usage() / 1024 / 1024));
+}
+
 void PreferencesDialog::edit_default_sequence_settings()
 {
   NewSequenceDialog nsd(this, nullptr, &default_sequence);
@@ -572,6 +525,17 @@ void PreferencesDialog::setup_ui() {
 
   row++;
 
+  // General -> Preview Cache Limit
+  general_layout->addWidget(new QLabel(tr("Preview Cache Limit (MB):"), this), row, 0);
+
+  preview_cache_limit_spinbox = new QSpinBox(this);
+  preview_cache_limit_spinbox->setMinimum(16);
+  preview_cache_limit_spinbox->setMaximum(INT_MAX);
+  preview_cache_limit_spinbox->setValue(olive::CurrentConfig.preview_cache_limit);
+  general_layout->addWidget(preview_cache_limit_spinbox, row, 1);
+
+  row++;
+
   // General -> Use Software Fallbacks When Possible
   QCheckBox* use_software_fallbacks_checkbox = new QCheckBox(tr("Use Software Fallbacks When Possible"));
   AddBoolPair(use_software_fallbacks_checkbox, &olive::CurrentConfig.use_software_fallback, true);
@@ -737,8 +701,41 @@ void PreferencesDialog::setup_ui() {
   previous_queue_type->addItem(tr("seconds"));
   previous_queue_type->setCurrentIndex(olive::CurrentConfig.previous_queue_type);
   memory_usage_layout->addWidget(previous_queue_type, 1, 2);
+  memory_usage_layout->addWidget(new QLabel(tr("Frame Memory Budget (MB):"), playback_tab), 2, 0);
+  frame_memory_budget_spinbox = new QSpinBox(playback_tab);
+  frame_memory_budget_spinbox->setMinimum(0);
+  frame_memory_budget_spinbox->setMaximum(INT_MAX);
+  frame_memory_budget_spinbox->setSpecialValueText(tr("Unlimited"));
+  frame_memory_budget_spinbox->setValue(olive::CurrentConfig.frame_memory_budget);
+  memory_usage_layout->addWidget(frame_memory_budget_spinbox, 2, 1, 1, 2);
+  frame_memory_usage_label = new QLabel(playback_tab);
+  memory_usage_layout->addWidget(frame_memory_usage_label, 3, 0, 1, 3);
   playback_tab_layout->addWidget(memory_usage_group);
 
+  // Playback -> Prefetch
+  QGroupBox* prefetch_group = new QGroupBox(playback_tab);
+  prefetch_group->setTitle(tr("Prefetch"));
+  QGridLayout* prefetch_layout = new QGridLayout(prefetch_group);
+  prefetch_layout->addWidget(new QLabel(tr("Open Clips Ahead (seconds):"), playback_tab), 0, 0);
+  prefetch_window_spinbox = new QDoubleSpinBox(playback_tab);
+  prefetch_window_spinbox->setMinimum(0.5);
+  prefetch_window_spinbox->setValue(olive::CurrentConfig.prefetch_window);
+  prefetch_layout->addWidget(prefetch_window_spinbox, 0, 1);
+  prefetch_layout->addWidget(new QLabel(tr("Maximum Open Decoders:"), playback_tab), 1, 0);
+  max_open_decoders_spinbox = new QSpinBox(playback_tab);
+  max_open_decoders_spinbox->setMinimum(0);
+  max_open_decoders_spinbox->setMaximum(1024);
+  max_open_decoders_spinbox->setSpecialValueText(tr("Unlimited"));
+  max_open_decoders_spinbox->setValue(olive::CurrentConfig.max_open_decoders);
+  prefetch_layout->addWidget(max_open_decoders_spinbox, 1, 1);
+  playback_tab_layout->addWidget(prefetch_group);
+
+  // keep the usage up to date while the dialog is open
+  update_frame_memory_usage();
+  QTimer* frame_memory_timer = new QTimer(this);
+  connect(frame_memory_timer, SIGNAL(timeout()), this, SLOT(update_frame_memory_usage()));
+  frame_memory_timer->start(1000);
+
   tabWidget->addTab(playback_tab, tr("Playback"));
 
   // Audio
@@ -33,6 +33,7 @@
 #include <QCheckBox>
 #include <QDoubleSpinBox>
 #include <QSpinBox>
+#include <QLabel>
 
 #include "timeline/sequence.h"
 
@@ -118,6 +119,11 @@ private slots:
    */
   void delete_all_previews();
 
+  /**
+   * @brief Refresh the label showing how much of the frame memory budget is in use
+   */
+  void update_frame_memory_usage();
+
   /**
    * @brief Shows a NewSequenceDialog attached to default_sequence
    */
@@ -157,17 +163,6 @@ private:
    */
   void setup_kbd_shortcut_worker(QMenu* menu, QTreeWidgetItem* parent);
 
-  // used to delete previews
-  // type can be: 't' for thumbnails, 'w' for waveforms, or 1 for all
-  /**
-   * @brief Delete disk cached preview files (thumbnails, waveforms, etc.)
-   *
-   * @param type
-   *
-   * The types of previews to
-   */
-  void delete_previews(char type);
-
   /**
    * @brief UI widget for editing the CSS filename
    */
@@ -208,6 +203,26 @@ private:
    */
   QComboBox* previous_queue_type;
 
+  /**
+   * @brief UI widget for editing the frame memory budget
+   */
+  QSpinBox* frame_memory_budget_spinbox;
+
+  /**
+   * @brief UI widget showing the current frame memory usage
+   */
+  QLabel* frame_memory_usage_label;
+
+  /**
+   * @brief UI widget for editing the prefetch window
+   */
+  QDoubleSpinBox* prefetch_window_spinbox;
+
+  /**
+   * @brief UI widget for editing the maximum number of open decoders
+   */
+  QSpinBox* max_open_decoders_spinbox;
+
   /**
    * @brief UI widget for editing the size of textboxes in the EffectControls panel
    */
@@ -243,6 +258,11 @@ private:
    */
   QSpinBox* waveform_res_spinbox;
 
+  /**
+   * @brief UI widget for setting how much disk space cached previews can use
+   */
+  QSpinBox* preview_cache_limit_spinbox;
+
   /**
    * @brief UI widget for selecting the current UI style
    */
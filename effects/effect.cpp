@@ -50,6 +50,7 @@
 #include "global/math.h"
 #include "project/clipboard.h"
 #include "global/config.h"
+#include "rendering/shaderprogram.h"
 #include "transition.h"
 #include "undo/undostack.h"
 
@@ -120,6 +121,12 @@ Effect::Effect(Clip* c, const EffectMeta *em) :
   texture(nullptr),
   isOpen(false),
   bound(false),
+  mergeable_(false),
+  resolution_uniform_(-1),
+  time_uniform_(-1),
+  iteration_uniform_(-1),
+  high_quality_uniform_(-1),
+  high_quality_(false),
   iterations(1),
   enabled_(true),
   expanded_(true)
@@ -306,6 +313,8 @@ Effect::Effect(Clip* c, const EffectMeta *em) :
                 fragPath = attr.value().toString();
               } else if (attr.name() == "iterations") {
                 setIterations(attr.value().toInt());
+              } else if (attr.name() == "mipmaps" && attr.value() == "1") {
+                SetFlags(Flags() | MipmapFlag);
               }
             }
           }/* else if (reader.name() == "superimpose" && reader.isStartElement()) {
@@ -404,6 +413,7 @@ int Effect::gizmo_count() {
 void Effect::refresh() {}
 
 void Effect::FieldChanged() {
+  olive::BumpContentRevision();
   update_ui(false);
 }
 
@@ -507,6 +517,11 @@ bool Effect::IsEnabled() {
   return enabled_;
 }
 
+bool Effect::IsIdentity()
+{
+  return !IsEnabled();
+}
+
 bool Effect::IsExpanded()
 {
   return expanded_;
@@ -743,32 +758,25 @@ void Effect::open() {
     if (QOpenGLContext::currentContext() == nullptr) {
       qWarning() << "No current context to create a shader program for - will retry next repaint";
     } else {
-      glslProgram = new QOpenGLShaderProgram();
       validate_meta_path();
-      bool glsl_compiled = true;
-      if (!vertPath.isEmpty()) {
-        if (glslProgram->addShaderFromSourceFile(QOpenGLShader::Vertex, meta->path + "/" + vertPath)) {
-          qInfo() << "Vertex shader added successfully";
-        } else {
-          glsl_compiled = false;
-          qWarning() << "Vertex shader could not be added";
-        }
-      }
-      if (!fragPath.isEmpty()) {
-        if (glslProgram->addShaderFromSourceFile(QOpenGLShader::Fragment, meta->path + "/" + fragPath)) {
-          qInfo() << "Fragment shader added successfully";
-        } else {
-          glsl_compiled = false;
-          qWarning() << "Fragment shader could not be added";
-        }
-      }
-      if (glsl_compiled) {
-        if (glslProgram->link()) {
-          qInfo() << "Shader program linked successfully";
-        } else {
-          qWarning() << "Shader program failed to link";
-        }
+
+      // shaders are translated to run without the fixed-function pipeline, effects without their own vertex shader
+      // get a default one. Every effect using the same shaders shares one program.
+      glslProgram = olive::rendering::AcquireProgram(vertPath.isEmpty() ? QString() : meta->path + "/" + vertPath,
+                                                     fragPath.isEmpty() ? QString() : meta->path + "/" + fragPath);
+
+      mergeable_ = false;
+
+      if (glslProgram->isLinked()) {
+        mergeable_ = ((vertPath.isEmpty() || vertPath == "common.vert")
+                      && !(Flags() & MipmapFlag)
+                      && !olive::rendering::ProgramSource(glslProgram).contains("gl_FragCoord"));
+
+        LookUpUniforms();
+      } else {
+        qWarning() << "Shader program failed to link";
       }
+
       isOpen = true;
     }
   } else {
@@ -782,7 +790,7 @@ void Effect::close() {
   }
   delete_texture();
   if (glslProgram != nullptr) {
-    delete glslProgram;
+    olive::rendering::ReleaseProgram(glslProgram);
     glslProgram = nullptr;
   }
   isOpen = false;
@@ -792,6 +800,31 @@ bool Effect::is_glsl_linked() {
   return glslProgram != nullptr && glslProgram->isLinked();
 }
 
+QOpenGLShaderProgram *Effect::glsl_program() {
+  return glslProgram;
+}
+
+bool Effect::IsMergeable() {
+  return is_glsl_linked() && mergeable_;
+}
+
+void Effect::LookUpUniforms() {
+  resolution_uniform_ = glslProgram->uniformLocation("resolution");
+  time_uniform_ = glslProgram->uniformLocation("time");
+  iteration_uniform_ = glslProgram->uniformLocation("iteration");
+  high_quality_uniform_ = glslProgram->uniformLocation("high_quality");
+
+  field_uniforms_.clear();
+
+  for (int i=0;i<rows.size();i++) {
+    EffectRow* row = rows.at(i);
+    for (int j=0;j<row->FieldCount();j++) {
+      const QString& id = row->Field(j)->id();
+      field_uniforms_.append(id.isEmpty() ? -1 : glslProgram->uniformLocation(id));
+    }
+  }
+}
+
 void Effect::startEffect() {
   if (!isOpen) {
     open();
@@ -829,6 +862,10 @@ void Effect::setIterations(int i) {
   iterations = i;
 }
 
+void Effect::SetHighQuality(bool high_quality) {
+  high_quality_ = high_quality;
+}
+
 void Effect::process_image(double, uint8_t *, uint8_t *, int){}
 
 EffectPtr Effect::copy(Clip *c) {
@@ -839,39 +876,41 @@ EffectPtr Effect::copy(Clip *c) {
 }
 
 void Effect::process_shader(double timecode, GLTextureCoords&, int iteration) {
-  glslProgram->setUniformValue("resolution", parent_clip->media_width(), parent_clip->media_height());
-  glslProgram->setUniformValue("time", GLfloat(timecode));
-  glslProgram->setUniformValue("iteration", iteration);
+  // the program may be shared with other effects, so every uniform is set again even if it hasn't changed
+  glslProgram->setUniformValue(resolution_uniform_, parent_clip->media_width(), parent_clip->media_height());
+  glslProgram->setUniformValue(time_uniform_, GLfloat(timecode));
+  glslProgram->setUniformValue(iteration_uniform_, iteration);
+  glslProgram->setUniformValue(high_quality_uniform_, high_quality_);
+
+  int field_index = 0;
 
   for (int i=0;i<rows.size();i++) {
     EffectRow* row = rows.at(i);
     for (int j=0;j<row->FieldCount();j++) {
       EffectField* field = row->Field(j);
-      if (!field->id().isEmpty()) {
+      int location = field_uniforms_.at(field_index);
+      field_index++;
+
+      if (location >= 0) {
         switch (field->type()) {
         case EffectField::EFFECT_FIELD_DOUBLE:
         {
           DoubleField* double_field = static_cast<DoubleField*>(field);
-          glslProgram->setUniformValue(double_field->id().toUtf8().constData(),
-                                       GLfloat(double_field->GetDoubleAt(timecode)));
+          glslProgram->setUniformValue(location, GLfloat(double_field->GetDoubleAt(timecode)));
         }
           break;
         case EffectField::EFFECT_FIELD_COLOR:
         {
           ColorField* color_field = static_cast<ColorField*>(field);
-          glslProgram->setUniformValue(
-                color_field->id().toUtf8().constData(),
-                GLfloat(color_field->GetColorAt(timecode).redF()),
-                GLfloat(color_field->GetColorAt(timecode).greenF()),
-                GLfloat(color_field->GetColorAt(timecode).blueF())
-                );
+          QColor color = color_field->GetColorAt(timecode);
+          glslProgram->setUniformValue(location, GLfloat(color.redF()), GLfloat(color.greenF()), GLfloat(color.blueF()));
         }
           break;
         case EffectField::EFFECT_FIELD_BOOL:
-          glslProgram->setUniformValue(field->id().toUtf8().constData(), field->GetValueAt(timecode).toBool());
+          glslProgram->setUniformValue(location, field->GetValueAt(timecode).toBool());
           break;
         case EffectField::EFFECT_FIELD_COMBO:
-          glslProgram->setUniformValue(field->id().toUtf8().constData(), field->GetValueAt(timecode).toInt());
+          glslProgram->setUniformValue(location, field->GetValueAt(timecode).toInt());
           break;
 
           // can you even send a string to a uniform value?
@@ -912,7 +951,7 @@ GLuint Effect::process_superimpose(double timecode) {
     texture = new QOpenGLTexture(QOpenGLTexture::Target2D);
     texture->setSize(img.width(), img.height());
     texture->setFormat(QOpenGLTexture::RGBA8_UNorm);
-    texture->setMipLevels(texture->maximumMipLevels());
+    texture->setMipLevels(1);
     texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
     texture->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
 
@@ -1000,20 +1039,12 @@ void Effect::gizmo_move(EffectGizmo* gizmo, int x_movement, int y_movement, doub
   }
 }
 
-void Effect::gizmo_world_to_screen() {
-  GLfloat view_val[16];
-  GLfloat projection_val[16];
-  glGetFloatv(GL_MODELVIEW_MATRIX, view_val);
-  glGetFloatv(GL_PROJECTION_MATRIX, projection_val);
-
-  QMatrix4x4 view_matrix(view_val);
-  QMatrix4x4 projection_matrix(projection_val);
-
+void Effect::gizmo_world_to_screen(const QMatrix4x4& mvp) {
   for (int i=0;i<gizmos.size();i++) {
     EffectGizmo* g = gizmos.at(i);
 
     for (int j=0;j<g->get_point_count();j++) {
-      QVector4D screen_pos = QVector4D(g->world_pos[j].x(), g->world_pos[j].y(), 0, 1.0) * (view_matrix * projection_matrix);
+      QVector4D screen_pos = mvp * QVector4D(g->world_pos[j].x(), g->world_pos[j].y(), 0, 1.0);
 
       int adjusted_sx1 = qRound(((screen_pos.x()*0.5f)+0.5f)*parent_clip->sequence->width);
       int adjusted_sy1 = qRound((1.0f-((screen_pos.y()*0.5f)+0.5f))*parent_clip->sequence->height);
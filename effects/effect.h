@@ -38,6 +38,7 @@
 #include <QMouseEvent>
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
+#include <QMatrix4x4>
 #include <random>
 
 #include "ui/collapsiblewidget.h"
@@ -96,9 +97,47 @@ enum EffectInternal {
   EFFECT_INTERNAL_COUNT
 };
 
+/**
+ * @brief Blending modes implemented by effects/internal/blending.frag
+ *
+ * Values must match the constants in the shader. GLTextureCoords::blendmode is -1 for normal alpha blending, which
+ * doesn't need the shader at all.
+ */
+enum BlendMode {
+  kBlendModeAdd,
+  kBlendModeAverage,
+  kBlendModeColorBurn,
+  kBlendModeColorDodge,
+  kBlendModeDarken,
+  kBlendModeDifference,
+  kBlendModeExclusion,
+  kBlendModeGlow,
+  kBlendModeHardLight,
+  kBlendModeHardMix,
+  kBlendModeLighten,
+  kBlendModeLinearBurn,
+  kBlendModeLinearDodge,
+  kBlendModeLinearLight,
+  kBlendModeMultiply,
+  kBlendModeNegation,
+  kBlendModeNormal,
+  kBlendModeOverlay,
+  kBlendModePhoenix,
+  kBlendModePinLight,
+  kBlendModeReflect,
+  kBlendModeScreen,
+  kBlendModeSoftLight,
+  kBlendModeSubstract,
+  kBlendModeSubtract,
+  kBlendModeVividLight
+};
+
 struct GLTextureCoords {
   int grid_size;
 
+  // transform from the clip's coordinates to the sequence's, replaces the fixed-function modelview matrix
+  QMatrix4x4 matrix;
+
   int vertexTopLeftX;
   int vertexTopLeftY;
   int vertexTopLeftZ;
@@ -156,6 +195,14 @@ public:
   bool IsEnabled();
   bool IsExpanded();
 
+  /**
+   * @brief Returns whether this effect currently leaves its clip's image and audio unchanged
+   *
+   * Used by export to find clips that can be copied from their source file without rendering. The default is only
+   * true for disabled effects, effects whose default values are a no-op can override this.
+   */
+  virtual bool IsIdentity();
+
   virtual void refresh();
 
   virtual EffectPtr copy(Clip* c);
@@ -173,6 +220,17 @@ public:
   void open();
   void close();
   bool is_glsl_linked();
+  QOpenGLShaderProgram* glsl_program();
+
+  /**
+   * @brief Returns whether this effect's last shader pass can be drawn straight into the sequence
+   *
+   * Normally every shader pass renders into a framebuffer at the clip's resolution. Shaders that only sample their
+   * input through `vTexCoord` produce the same image when drawn directly with the clip's transform, which saves a
+   * pass (see RenderGraph). Shaders that read gl_FragCoord or use their own vertex shader depend on the pass's pixel
+   * grid and geometry, so they always get a framebuffer.
+   */
+  bool IsMergeable();
   virtual void startEffect();
   virtual void endEffect();
 
@@ -180,7 +238,10 @@ public:
     ShaderFlag        = 0x1,
     CoordsFlag        = 0x2,
     SuperimposeFlag   = 0x4,
-    ImageFlag         = 0x8
+    ImageFlag         = 0x8,
+
+    // the shader samples lower mipmap levels of its input (set with mipmaps="1" on the <shader> element)
+    MipmapFlag        = 0x10
   };
   int Flags();
   void SetFlags(int flags);
@@ -188,6 +249,14 @@ public:
   int getIterations();
   void setIterations(int i);
 
+  /**
+   * @brief Set whether the next shader passes are for a final render
+   *
+   * Passed to shaders as the `high_quality` uniform. Effects like blurs take fewer samples while previewing and more
+   * when exporting. Set by RenderGraph before every run of the effect.
+   */
+  void SetHighQuality(bool high_quality);
+
   const char* ffmpeg_filter;
 
   virtual void process_image(double timecode, uint8_t* input, uint8_t* output, int size);
@@ -198,7 +267,7 @@ public:
 
   virtual void gizmo_draw(double timecode, GLTextureCoords& coords);
   void gizmo_move(EffectGizmo* sender, int x_movement, int y_movement, double timecode, bool done);
-  void gizmo_world_to_screen();
+  void gizmo_world_to_screen(const QMatrix4x4& mvp);
   bool are_gizmos_enabled();
 
   template <typename T>
@@ -242,6 +311,16 @@ private:
   QVector<EffectRow*> rows;
   QVector<EffectGizmo*> gizmos;
   bool bound;
+  bool mergeable_;
+
+  // uniform locations in glslProgram, looked up once in open() rather than by name every frame
+  void LookUpUniforms();
+  int resolution_uniform_;
+  int time_uniform_;
+  int iteration_uniform_;
+  int high_quality_uniform_;
+  bool high_quality_;
+  QVector<int> field_uniforms_;
   int iterations;
 
   bool enabled_;
@@ -90,9 +90,13 @@ TimecodeEffect::TimecodeEffect(Clip* c, const EffectMeta* em) :
 
 void TimecodeEffect::redraw(double timecode) {
   if (tc_select->GetValueAt(timecode).toBool()) {
-    display_timecode = prepend_text->GetStringAt(timecode) + frame_to_timecode(olive::ActiveSequence->playhead,
+    // derive the sequence frame from the clip time rather than reading a playhead, so this also works when the clip's
+    // sequence is rendered offline
+    double sequence_rate = parent_clip->sequence->frame_rate;
+    long sequence_frame = qRound(timecode * sequence_rate) - parent_clip->clip_in(true) + parent_clip->timeline_in(true);
+    display_timecode = prepend_text->GetStringAt(timecode) + frame_to_timecode(sequence_frame,
                                                                                olive::CurrentConfig.timecode_view,
-                                                                               olive::ActiveSequence->frame_rate);
+                                                                               sequence_rate);
   } else {
     double media_rate = parent_clip->media_frame_rate();
     display_timecode = prepend_text->GetStringAt(timecode) + frame_to_timecode(qRound(timecode * media_rate),
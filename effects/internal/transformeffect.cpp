@@ -87,6 +87,30 @@ TransformEffect::TransformEffect(Clip* c, const EffectMeta* em) : Effect(c, em)
   blend_mode_box = new ComboField(blend_mode_row, "blendmode");
   blend_mode_box->SetColumnSpan(2);
   blend_mode_box->AddItem(tr("Normal"), "");
+  blend_mode_box->AddItem(tr("Add"), QString::number(kBlendModeAdd));
+  blend_mode_box->AddItem(tr("Average"), QString::number(kBlendModeAverage));
+  blend_mode_box->AddItem(tr("Color Burn"), QString::number(kBlendModeColorBurn));
+  blend_mode_box->AddItem(tr("Color Dodge"), QString::number(kBlendModeColorDodge));
+  blend_mode_box->AddItem(tr("Darken"), QString::number(kBlendModeDarken));
+  blend_mode_box->AddItem(tr("Difference"), QString::number(kBlendModeDifference));
+  blend_mode_box->AddItem(tr("Exclusion"), QString::number(kBlendModeExclusion));
+  blend_mode_box->AddItem(tr("Glow"), QString::number(kBlendModeGlow));
+  blend_mode_box->AddItem(tr("Hard Light"), QString::number(kBlendModeHardLight));
+  blend_mode_box->AddItem(tr("Hard Mix"), QString::number(kBlendModeHardMix));
+  blend_mode_box->AddItem(tr("Lighten"), QString::number(kBlendModeLighten));
+  blend_mode_box->AddItem(tr("Linear Burn"), QString::number(kBlendModeLinearBurn));
+  blend_mode_box->AddItem(tr("Linear Dodge"), QString::number(kBlendModeLinearDodge));
+  blend_mode_box->AddItem(tr("Linear Light"), QString::number(kBlendModeLinearLight));
+  blend_mode_box->AddItem(tr("Multiply"), QString::number(kBlendModeMultiply));
+  blend_mode_box->AddItem(tr("Negation"), QString::number(kBlendModeNegation));
+  blend_mode_box->AddItem(tr("Overlay"), QString::number(kBlendModeOverlay));
+  blend_mode_box->AddItem(tr("Phoenix"), QString::number(kBlendModePhoenix));
+  blend_mode_box->AddItem(tr("Pin Light"), QString::number(kBlendModePinLight));
+  blend_mode_box->AddItem(tr("Reflect"), QString::number(kBlendModeReflect));
+  blend_mode_box->AddItem(tr("Screen"), QString::number(kBlendModeScreen));
+  blend_mode_box->AddItem(tr("Soft Light"), QString::number(kBlendModeSoftLight));
+  blend_mode_box->AddItem(tr("Subtract"), QString::number(kBlendModeSubtract));
+  blend_mode_box->AddItem(tr("Vivid Light"), QString::number(kBlendModeVividLight));
 
   // set up gizmos
   top_left_gizmo = add_gizmo(GIZMO_TYPE_DOT);
@@ -190,9 +214,8 @@ void TransformEffect::toggle_uniform_scale(bool enabled) {
 
 void TransformEffect::process_coords(double timecode, GLTextureCoords& coords, int) {
   // position
-  glTranslated(position_x->GetDoubleAt(timecode)-(parent_clip->sequence->width/2),
-               position_y->GetDoubleAt(timecode)-(parent_clip->sequence->height/2),
-               0);
+  coords.matrix.translate(position_x->GetDoubleAt(timecode)-(parent_clip->sequence->width/2),
+                          position_y->GetDoubleAt(timecode)-(parent_clip->sequence->height/2));
 
   // anchor point
   int anchor_x_offset = qRound(anchor_x_box->GetDoubleAt(timecode));
@@ -207,20 +230,44 @@ void TransformEffect::process_coords(double timecode, GLTextureCoords& coords, i
   coords.vertexBottomRightY -= anchor_y_offset;
 
   // rotation
-  glRotated(rotation->GetDoubleAt(timecode), 0, 0, 1);
+  coords.matrix.rotate(rotation->GetDoubleAt(timecode), 0, 0, 1);
 
   // scale
   double sx = scale_x->GetDoubleAt(timecode)*0.01;
   double sy = (uniform_scale_field->GetBoolAt(timecode)) ? sx : scale_y->GetDoubleAt(timecode)*0.01;
-  glScaled(sx, sy, 1);
+  coords.matrix.scale(sx, sy);
 
-  // blend mode
-  coords.blendmode = blend_mode_box->GetValueAt(timecode).toInt();
+  // blend mode ("Normal" is stored as an empty string)
+  QString blend_mode = blend_mode_box->GetValueAt(timecode).toString();
+  coords.blendmode = blend_mode.isEmpty() ? -1 : blend_mode.toInt();
 
   // opacity
   coords.opacity *= float(opacity->GetDoubleAt(timecode)*0.01);
 }
 
+bool TransformEffect::IsIdentity() {
+  if (Effect::IsIdentity()) {
+    return true;
+  }
+
+  // animated transforms are never treated as a no-op, even if some keyframes happen to be
+  for (int i=0;i<row_count();i++) {
+    if (row(i)->IsKeyframing()) {
+      return false;
+    }
+  }
+
+  return position_x->GetDoubleAt(0) == parent_clip->sequence->width/2
+      && position_y->GetDoubleAt(0) == parent_clip->sequence->height/2
+      && anchor_x_box->GetDoubleAt(0) == 0.0
+      && anchor_y_box->GetDoubleAt(0) == 0.0
+      && rotation->GetDoubleAt(0) == 0.0
+      && scale_x->GetDoubleAt(0) == 100.0
+      && (uniform_scale_field->GetBoolAt(0) || scale_y->GetDoubleAt(0) == 100.0)
+      && opacity->GetDoubleAt(0) == 100.0
+      && blend_mode_box->GetValueAt(0).toString().isEmpty();
+}
+
 void TransformEffect::gizmo_draw(double, GLTextureCoords& coords) {
   top_left_gizmo->world_pos[0] = QPoint(coords.vertexTopLeftX, coords.vertexTopLeftY);
   top_center_gizmo->world_pos[0] = QPoint(lerp(coords.vertexTopLeftX, coords.vertexTopRightX, 0.5), lerp(coords.vertexTopLeftY, coords.vertexTopRightY, 0.5));
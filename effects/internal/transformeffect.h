@@ -29,6 +29,7 @@ public:
   TransformEffect(Clip* c, const EffectMeta* em);
   void refresh();
   void process_coords(double timecode, GLTextureCoords& coords, int data);
+  virtual bool IsIdentity() override;
 
   void gizmo_draw(double timecode, GLTextureCoords& coords);
 public slots:
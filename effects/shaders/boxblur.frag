@@ -7,27 +7,40 @@ uniform vec2 resolution;
 uniform bool horiz_blur;
 uniform bool vert_blur;
 uniform int iteration;
+uniform bool high_quality;
 
 varying vec2 vTexCoord;
 
+// linear samples taken across the box. Wider boxes read from a smaller mipmap level with the same number of samples,
+// so the cost of the blur doesn't depend on its size.
+const float kDraftSamples = 16.0;
+const float kHighQualitySamples = 64.0;
+
 void main(void) {
-	float rad = ceil(radius);
-	
-	float divider = 1.0 / rad;		
-	vec4 color = vec4(0.0);
-	bool radius_is_zero = (rad == 0.0);
-
-	if (iteration == 0 && horiz_blur && !radius_is_zero) {
-		for (float x=-rad+0.5;x<=rad;x+=2.0) {					
-			color += texture2D(image, (vec2(gl_FragCoord.x+x, gl_FragCoord.y))/resolution)*(divider);
-		}
-		gl_FragColor = color;
-	} else if (iteration == 1 && vert_blur && !radius_is_zero) {
-		for (float x=-rad+0.5;x<=rad;x+=2.0) {					
-			color += texture2D(image, (vec2(gl_FragCoord.x, gl_FragCoord.y+x))/resolution)*(divider);
-		}
-		gl_FragColor = color;
-	} else {
+	bool horizontal = (iteration == 0 && horiz_blur);
+	bool vertical = (iteration == 1 && vert_blur);
+
+	float extent = ceil(radius);
+
+	if (extent == 0.0 || !(horizontal || vertical)) {
 		gl_FragColor = texture2D(image, vTexCoord);
+		return;
 	}
-}
\ No newline at end of file
+
+	vec2 direction = horizontal ? vec2(1.0/resolution.x, 0.0) : vec2(0.0, 1.0/resolution.y);
+
+	float samples = min(extent, high_quality ? kHighQualitySamples : kDraftSamples);
+	float spacing = extent / samples;
+	float lod = log2(spacing);
+
+	vec4 color = vec4(0.0);
+	float count = 0.0;
+
+	// every linear sample sits between two texels of the level it reads from and averages both
+	for (float x=-extent+0.5*spacing;x<=extent;x+=2.0*spacing) {
+		color += texture2D(image, vTexCoord + direction * x, lod);
+		count += 1.0;
+	}
+
+	gl_FragColor = color / count;
+}
@@ -8,23 +8,35 @@ uniform float angle; // degrees
 uniform float length;
 
 uniform vec2 resolution;
+uniform bool high_quality;
+
+varying vec2 vTexCoord;
+
+// linear samples taken along the blur. Longer blurs read from a smaller mipmap level with the same number of samples,
+// so the cost of the blur doesn't depend on its length.
+const float kDraftSamples = 16.0;
+const float kHighQualitySamples = 64.0;
 
 void main(void) {
 	if (length > 0.0) {
 		float ceillen = ceil(length);
 		float radians = (angle*M_PI)/180.0;
-		float divider = 1.0 / ceillen;
-		float sin_angle = sin(radians);
-		float cos_angle = cos(radians);
+		vec2 direction = vec2(cos(radians), sin(radians)) / resolution;
+
+		float samples = min(ceillen, high_quality ? kHighQualitySamples : kDraftSamples);
+		float spacing = ceillen / samples;
+		float lod = log2(spacing);
 
 		vec4 color = vec4(0.0);
-		for (float i=-ceillen+0.5;i<=ceillen;i+=2.0) {
-			float y = sin_angle * i;
-			float x = cos_angle * i;
-			color += texture2D(image, vec2(gl_FragCoord.x+x, gl_FragCoord.y+y)/resolution)*(divider);
+		float count = 0.0;
+
+		for (float i=-ceillen+0.5*spacing;i<=ceillen;i+=2.0*spacing) {
+			color += texture2D(image, vTexCoord + direction * i, lod);
+			count += 1.0;
 		}
-		gl_FragColor = color;
+
+		gl_FragColor = color / count;
 	} else {
-		gl_FragColor = texture2D(image, gl_FragCoord.xy/resolution);
+		gl_FragColor = texture2D(image, vTexCoord);
 	}
-}
\ No newline at end of file
+}
@@ -1,54 +1,64 @@
 #version 110
 
-#define M_PI 3.1415926535897932384626433832795
-
 uniform sampler2D image;
 
-//uniform float radius;
 uniform float sigma;
 uniform vec2 resolution;
 uniform bool horiz_blur;
 uniform bool vert_blur;
 uniform int iteration;
+uniform bool high_quality;
 
 varying vec2 vTexCoord;
 
-float gaussian(float x, float sigma) {
-	return (1.0/(sigma*sqrt(2.0*M_PI)))*exp(-0.5*pow(x/sigma, 2.0));
-}
-
-float gaussian2(float x, float y, float sigma) {
-	return (1.0/(pow(sigma, 2.0)*2.0*M_PI))*exp(-0.5*((pow(x, 2.0) + pow(y, 2.0))/pow(sigma, 2.0)));
-}
+// samples taken on each side of the kernel. Wider kernels read from a smaller mipmap level with the same number of
+// samples, so the cost of the blur doesn't depend on its size.
+const float kDraftSamples = 12.0;
+const float kHighQualitySamples = 48.0;
 
 void main(void) {
-	float rad = ceil(3.0 * sigma);
+	bool horizontal = (iteration == 0 && horiz_blur);
+	bool vertical = (iteration == 1 && vert_blur);
 
-	float sum = 0.0;
+	float extent = ceil(3.0 * sigma);
 
-	vec4 color = vec4(0.0);
+	if (extent == 0.0 || sigma == 0.0 || !(horizontal || vertical)) {
+		gl_FragColor = texture2D(image, vTexCoord);
+		return;
+	}
 
-	bool radius_is_zero = (rad == 0.0 || sigma == 0.0);
+	vec2 direction = horizontal ? vec2(1.0/resolution.x, 0.0) : vec2(0.0, 1.0/resolution.y);
 
-	if (!radius_is_zero) {
-		for (float x=-rad+0.5;x<=rad;x+=2.0) {
-			sum += gaussian2(x, 0.0, sigma);
-		}
-	}
+	float samples = min(extent, high_quality ? kHighQualitySamples : kDraftSamples);
+	float spacing = extent / samples;
+	float lod = log2(spacing);
 
-	if (iteration == 0 && horiz_blur && !radius_is_zero) {
-		for (float x=-rad+0.5;x<=rad;x+=2.0) {
-			float weight = (gaussian2(x, 0.0, sigma)/sum);
-			color += texture2D(image, (vec2(gl_FragCoord.x+x, gl_FragCoord.y))/resolution)*(weight);
-		}
-		gl_FragColor = color;
-	} else if (iteration == 1 && vert_blur && !radius_is_zero) {
-		for (float x=-rad+0.5;x<=rad;x+=2.0) {
-			float weight = (gaussian2(0.0, x, sigma)/sum);
-			color += texture2D(image, (vec2(gl_FragCoord.x, gl_FragCoord.y+x))/resolution)*(weight);
-		}
-		gl_FragColor = color;
-	} else {
-		gl_FragColor = texture2D(image, vTexCoord);
+	// the weights are computed incrementally (g(x+1) = g(x)*r, r = r*c) instead of calling exp() for every sample
+	float a = (spacing * spacing) / (2.0 * sigma * sigma);
+	float g = 1.0;
+	float r = exp(-a);
+	float c = r * r;
+
+	vec4 color = texture2D(image, vTexCoord, lod);
+	float sum = 1.0;
+
+	// neighboring samples are fetched together with one linear sample placed between them by weight
+	for (float i=1.0;i<=samples;i+=2.0) {
+		g *= r;
+		r *= c;
+		float w1 = g;
+
+		g *= r;
+		r *= c;
+		float w2 = (i + 1.0 <= samples) ? g : 0.0;
+
+		float weight = w1 + w2;
+		float offset = ((i * w1 + (i + 1.0) * w2) / weight) * spacing;
+
+		color += texture2D(image, vTexCoord + direction * offset, lod) * weight;
+		color += texture2D(image, vTexCoord - direction * offset, lod) * weight;
+		sum += 2.0 * weight;
 	}
-}
\ No newline at end of file
+
+	gl_FragColor = color / sum;
+}
@@ -8,30 +8,42 @@ uniform float center_x;
 uniform float center_y;
 
 uniform vec2 resolution;
+uniform bool high_quality;
+
+varying vec2 vTexCoord;
+
+// samples taken along the blur. The blur's length changes across the image, so every pixel takes the same number of
+// samples and spreads them further apart (reading from a smaller mipmap level) the longer its blur is.
+const float kDraftSamples = 16.0;
+const float kHighQualitySamples = 64.0;
 
 void main(void) {
 	if (radius > 0.0) {
-		vec2 distance = vec2((gl_FragCoord.x - (resolution.x/2.0) - center_x), (gl_FragCoord.y - (resolution.y/2.0) - center_y));
+		vec2 pixel = vTexCoord * resolution;
+		vec2 distance = vec2((pixel.x - (resolution.x/2.0) - center_x), (pixel.y - (resolution.y/2.0) - center_y));
 
 		float angle = atan(distance.y/distance.x);
-		float sin_angle = sin(angle);
-		float cos_angle = cos(angle);
+		vec2 direction = vec2(cos(angle), sin(angle)) / resolution;
 
 		float multiplier = length(distance/resolution);
 
-		float limit = ceil(radius * multiplier);
+		float limit = radius * multiplier;
 
-		float divider = 1.0 / limit;
+		float samples = high_quality ? kHighQualitySamples : kDraftSamples;
+		float spacing = (2.0 * limit) / samples;
+
+		// below one pixel apart there's nothing to gain from a smaller level
+		float lod = log2(max(spacing, 1.0));
 
 		vec4 color = vec4(0.0);
 
-		for (float i=-limit+0.5;i<=limit;i+=2.0) {
-			float y = sin_angle * i;
-			float x = cos_angle * i;
-			color += texture2D(image, vec2(gl_FragCoord.x+x, gl_FragCoord.y+y)/resolution)*(divider);
+		for (float i=0.0;i<samples;i+=1.0) {
+			float offset = -limit + (i + 0.5) * spacing;
+			color += texture2D(image, vTexCoord + direction * offset, lod);
 		}
-		gl_FragColor = color;
+
+		gl_FragColor = color / samples;
 	} else {
-		gl_FragColor = texture2D(image, gl_FragCoord.xy/resolution);
+		gl_FragColor = texture2D(image, vTexCoord);
 	}
-}
\ No newline at end of file
+}
@@ -44,6 +44,7 @@ Config::Config()
     default_transition_length(30),
     timecode_view(olive::kTimecodeDrop),
     show_title_safe_area(false),
+    show_performance_overlay(false),
     use_custom_title_safe_ratio(false),
     custom_title_safe_ratio(1),
     enable_drag_files_to_timeline(true),
@@ -62,6 +63,9 @@ Config::Config()
     previous_queue_type(olive::FRAME_QUEUE_TYPE_FRAMES),
     upcoming_queue_size(0.5),
     upcoming_queue_type(olive::FRAME_QUEUE_TYPE_SECONDS),
+    frame_memory_budget(4096),
+    prefetch_window(2.0),
+    max_open_decoders(16),
     loop(false),
     seek_also_selects(false),
     auto_seek_to_beginning(true),
@@ -70,6 +74,7 @@ Config::Config()
     center_timeline_timecodes(true),
     waveform_resolution(64),
     thumbnail_resolution(120),
+    preview_cache_limit(1024),
     add_default_effects_to_clips(true),
     invert_timeline_scroll_axes(true),
     style(olive::styling::kOliveDefaultDark),
@@ -126,6 +131,9 @@ void Config::load(QString path) {
         } else if (stream.name() == "ShowTitleSafeArea") {
           stream.readNext();
           show_title_safe_area = (stream.text() == "1");
+        } else if (stream.name() == "ShowPerformanceOverlay") {
+          stream.readNext();
+          show_performance_overlay = (stream.text() == "1");
         } else if (stream.name() == "UseCustomTitleSafeRatio") {
           stream.readNext();
           use_custom_title_safe_ratio = (stream.text() == "1");
@@ -180,6 +188,15 @@ void Config::load(QString path) {
         } else if (stream.name() == "UpcomingFrameQueueType") {
           stream.readNext();
           upcoming_queue_type = stream.text().toInt();
+        } else if (stream.name() == "FrameMemoryBudget") {
+          stream.readNext();
+          frame_memory_budget = stream.text().toInt();
+        } else if (stream.name() == "PrefetchWindow") {
+          stream.readNext();
+          prefetch_window = stream.text().toDouble();
+        } else if (stream.name() == "MaxOpenDecoders") {
+          stream.readNext();
+          max_open_decoders = stream.text().toInt();
         } else if (stream.name() == "Loop") {
           stream.readNext();
           loop = (stream.text() == "1");
@@ -213,6 +230,9 @@ void Config::load(QString path) {
         } else if (stream.name() == "ThumbnailResolution") {
           stream.readNext();
           thumbnail_resolution = stream.text().toInt();
+        } else if (stream.name() == "PreviewCacheLimit") {
+          stream.readNext();
+          preview_cache_limit = stream.text().toInt();
         } else if (stream.name() == "WaveformResolution") {
           stream.readNext();
           waveform_resolution = stream.text().toInt();
@@ -279,6 +299,7 @@ void Config::save(QString path) {
   stream.writeTextElement("DefaultTransitionLength", QString::number(default_transition_length));
   stream.writeTextElement("TimecodeView", QString::number(timecode_view));
   stream.writeTextElement("ShowTitleSafeArea", QString::number(show_title_safe_area));
+  stream.writeTextElement("ShowPerformanceOverlay", QString::number(show_performance_overlay));
   stream.writeTextElement("UseCustomTitleSafeRatio", QString::number(use_custom_title_safe_ratio));
   stream.writeTextElement("CustomTitleSafeRatio", QString::number(custom_title_safe_ratio));
   stream.writeTextElement("EnableDragFilesToTimeline", QString::number(enable_drag_files_to_timeline));
@@ -297,6 +318,9 @@ void Config::save(QString path) {
   stream.writeTextElement("PreviousFrameQueueType", QString::number(previous_queue_type));
   stream.writeTextElement("UpcomingFrameQueueSize", QString::number(upcoming_queue_size));
   stream.writeTextElement("UpcomingFrameQueueType", QString::number(upcoming_queue_type));
+  stream.writeTextElement("FrameMemoryBudget", QString::number(frame_memory_budget));
+  stream.writeTextElement("PrefetchWindow", QString::number(prefetch_window));
+  stream.writeTextElement("MaxOpenDecoders", QString::number(max_open_decoders));
   stream.writeTextElement("Loop", QString::number(loop));
   stream.writeTextElement("SeekAlsoSelects", QString::number(seek_also_selects));
   stream.writeTextElement("AutoSeekToBeginning", QString::number(auto_seek_to_beginning));
@@ -309,6 +333,7 @@ void Config::save(QString path) {
   stream.writeTextElement("LanguageFile", language_file);
   stream.writeTextElement("ThumbnailResolution", QString::number(thumbnail_resolution));
   stream.writeTextElement("WaveformResolution", QString::number(waveform_resolution));
+  stream.writeTextElement("PreviewCacheLimit", QString::number(preview_cache_limit));
   stream.writeTextElement("AddDefaultEffectsToClips", QString::number(add_default_effects_to_clips));
   stream.writeTextElement("Style", QString::number(style));
   stream.writeTextElement("NativeMenuStyling", QString::number(use_native_menu_styling));
@@ -326,5 +351,8 @@ void Config::save(QString path) {
 
 RuntimeConfig::RuntimeConfig() :
   shaders_are_enabled(true),
-  disable_blending(false)
+  disable_blending(false),
+  log_clip_latency(false),
+  log_frame_pool(false),
+  core_profile(false)
 {}
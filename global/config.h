@@ -241,6 +241,14 @@ struct Config {
    */
   bool show_title_safe_area;
 
+  /**
+   * @brief Show performance overlay
+   *
+   * **TRUE** if the Viewer should show render times, per-clip decode latency and queue levels, dropped frames, audio
+   * buffer headroom and memory usage on top of the frame.
+   */
+  bool show_performance_overlay;
+
   /**
    * @brief Use custom title/action safe area aspect ratio
    *
@@ -398,6 +406,31 @@ struct Config {
    */
   int upcoming_queue_type;
 
+  /**
+   * @brief Frame memory budget
+   *
+   * Maximum amount of memory in megabytes that decoded frames of all open clips can use together, on top of the
+   * per-clip limits set by the previous and upcoming queue sizes. Divided between clips by how visible they are (see
+   * FrameBudget). 0 means unlimited.
+   */
+  int frame_memory_budget;
+
+  /**
+   * @brief Prefetch window
+   *
+   * How many seconds ahead of the playhead clips are opened and pre-rolled so they're ready by the time they're
+   * shown. Scales with the playback speed. Clips are kept open for half this long after they've been passed.
+   */
+  double prefetch_window;
+
+  /**
+   * @brief Maximum open decoders
+   *
+   * Clips that are about to be shown are only opened early while fewer than this many decoders are open. Clips
+   * that are on screen are always opened. 0 means unlimited.
+   */
+  int max_open_decoders;
+
   /**
    * @brief Loop
    *
@@ -504,6 +537,14 @@ struct Config {
    */
   int thumbnail_resolution;
 
+  /**
+   * @brief Preview cache limit
+   *
+   * Maximum size in megabytes of the previews directory (thumbnails, waveforms and filmstrips). Once exceeded, the
+   * least recently used previews are deleted.
+   */
+  int preview_cache_limit;
+
   /**
    * @brief Add default effects to clips
    *
@@ -621,6 +662,38 @@ struct RuntimeConfig {
    * Overrides Config::language_file and sets the path to a language file to use.
    */
   QString external_translation_file;
+
+  /**
+   * @brief Log per-clip decode latency
+   *
+   * Debugging tool. Set to **TRUE** to print how long each clip spent requesting, waiting for and uploading its frame
+   * every time the viewer renders.
+   */
+  bool log_clip_latency;
+
+  /**
+   * @brief Log frame pool statistics
+   *
+   * Debugging tool. Set to **TRUE** to print how many frames and decoder buffers were allocated every second. During
+   * steady-state playback these should be zero.
+   */
+  bool log_frame_pool;
+
+  /**
+   * @brief Request a core profile OpenGL context
+   *
+   * Set to **TRUE** to request an OpenGL 3.2 core profile context instead of the default compatibility context.
+   * Some drivers (e.g. Mesa's llvmpipe) only offer newer OpenGL versions in core profile.
+   */
+  bool core_profile;
+
+  /**
+   * @brief Record a frame timing trace for the whole session
+   *
+   * Debugging tool. If not empty, tracing starts on launch and the trace is written to this file in Chrome's trace
+   * event format when Olive exits (see olive::trace::Save()).
+   */
+  QString trace_file;
 };
 
 namespace olive {
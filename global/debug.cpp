@@ -25,88 +25,381 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QMutex>
+#include <QThread>
+#include <QAtomicInteger>
+#include <QHash>
 
 #include "dialogs/debugdialog.h"
 
-QString debug_info;
-QMutex debug_mutex;
-QFile debug_file;
-QTextStream debug_stream;
+namespace {
 
-void open_debug_file() {
-  QDir debug_dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
-  debug_dir.mkpath(".");
-  if (debug_dir.exists()) {
-    debug_file.setFileName(debug_dir.path() + "/debug_log");
-    if (debug_file.open(QFile::WriteOnly)) {
-      debug_stream.setDevice(&debug_file);
-    } else {
-      qWarning() << "Couldn't open debug log file, debug log will not be saved";
+// number of messages that can wait for the writer thread (must be a power of two)
+const quint32 kQueueSize = 4096;
+
+// how often the writer thread wakes up to write queued messages (in milliseconds)
+const unsigned long kWriteInterval = 50;
+
+// number of identical messages from the same place that are written per second before the rest are summarized
+const int kRateLimit = 10;
+const qint64 kRateWindow = 1000;
+
+struct LogMessage {
+  QAtomicInteger<quint32> sequence;
+  QtMsgType type;
+  qint64 time;
+  QString text;
+  const char* file;
+  int line;
+  const char* function;
+};
+
+/**
+ * Bounded multi-producer, single-consumer queue. Every slot's sequence number tells producers and the writer
+ * whether it's free (sequence == position) or holds a message (sequence == position + 1), so claiming a slot is a
+ * single compare-and-swap and nobody ever waits on a lock.
+ */
+struct LogQueue {
+  LogQueue() :
+    dequeue_pos(0)
+  {
+    for (quint32 i=0;i<kQueueSize;i++) {
+      messages[i].sequence.store(i);
     }
   }
-}
 
-void close_debug_file()
-{
-  if (debug_file.isOpen()) {
-    debug_file.close();
+  LogMessage messages[kQueueSize];
+  QAtomicInteger<quint32> enqueue_pos;
+  quint32 dequeue_pos;
+  QAtomicInt dropped;
+};
+
+struct RateState {
+  QtMsgType type;
+  qint64 window_start;
+  int count;
+  int suppressed;
+  QString last_suppressed;
+};
+
+class LogWriter : public QThread {
+public:
+  LogWriter();
+  void Stop();
+protected:
+  virtual void run() override;
+private:
+  QAtomicInt running_;
+};
+
+LogQueue log_queue;
+LogWriter* log_writer = nullptr;
+QAtomicInt log_writer_running;
+
+// everything below is only touched by the writer thread, or by whoever writes synchronously while it isn't running,
+// never by a thread that's just logging a message while the writer is running
+QMutex output_lock;
+QFile debug_file;
+QTextStream debug_stream;
+QStringList history;
+int history_first = 0;
+QHash<QString, RateState> rate_states;
+
+const char* MessageTag(QtMsgType type) {
+  switch (type) {
+  case QtDebugMsg:
+    return "DEBUG";
+  case QtInfoMsg:
+    return "INFO";
+  case QtWarningMsg:
+    return "WARNING";
+  case QtCriticalMsg:
+    return "ERROR";
+  case QtFatalMsg:
+    return "FATAL";
   }
+
+  return "UNKNOWN";
 }
 
-void debug_message_handler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
-{
-  debug_mutex.lock();
-  const QByteArray localMsg = msg.toLocal8Bit();
-  const QDateTime now = QDateTime::currentDateTime();
-  const QByteArray timeRepr(now.toString(Qt::ISODate).toLocal8Bit());
-  QString msgTag;
-  QString fontColor;
+const char* MessageColor(QtMsgType type) {
   switch (type) {
   case QtDebugMsg:
-    msgTag = "DEBUG";
-    fontColor = "grey";
-    break;
+    return "grey";
   case QtInfoMsg:
-    msgTag = "INFO";
-    fontColor = "blue";
-    break;
+    return "blue";
   case QtWarningMsg:
-    msgTag = "WARNING";
-    fontColor = "yellow";
-    break;
+    return "yellow";
   case QtCriticalMsg:
-    msgTag = "ERROR";
-    fontColor = "red";
-    break;
   case QtFatalMsg:
-    msgTag = "FATAL";
-    fontColor = "red";
-    break;
-  default:
-    fprintf(stderr, "Unknown debug msg type");
-    fflush(stderr);
-    break;
-  }//switch
+    return "red";
+  }
 
-  /*fprintf(stderr, "%s [%s] %s (%s:%u, %s)\n", timeRepr.data(), msgTag.toLocal8Bit().constData(), localMsg.data(),
-            context.file, context.line, context.function);*/
+  return "grey";
+}
 
-  fprintf(stderr, "%s [%s] %s\n", timeRepr.data(), msgTag.toLocal8Bit().constData(), localMsg.data());
+void AppendHistory(const QString& html) {
+  history.append(html);
+
+  while (history.size() > kDebugHistorySize) {
+    history.removeFirst();
+    history_first++;
+  }
+}
+
+void WriteLine(QtMsgType type, qint64 time, const QString& text, const char* file, int line, const char* function) {
+  const QByteArray time_repr = QDateTime::fromMSecsSinceEpoch(time).toString(Qt::ISODate).toLocal8Bit();
+  const char* tag = MessageTag(type);
+
+  // the location is only known in builds with QT_MESSAGELOGCONTEXT
+  QString location;
+  if (file != nullptr) {
+    location = QString(" (%1:%2, %3)").arg(file, QString::number(line), function);
+  }
+
+  fprintf(stderr, "%s [%s] %s\n", time_repr.constData(), tag, text.toLocal8Bit().constData());
 
   if (debug_file.isOpen()) {
-    debug_stream << QString("[%1] %2 (%3:%4, %5)\n")
-                    .arg(msgTag, localMsg, context.file, QString::number(context.line), context.function);
+    debug_stream << "[" << tag << "] " << text << location << "\n";
+  }
+
+  AppendHistory(QString("<font color='%1'><b>[%2]</b> %3%4</font>")
+                .arg(MessageColor(type), tag, text.toHtmlEscaped(), location.toHtmlEscaped()));
+}
+
+void WriteSuppressed(const RateState& state) {
+  WriteLine(state.type,
+            QDateTime::currentMSecsSinceEpoch(),
+            QString("(%1 more messages like this suppressed: %2)").arg(QString::number(state.suppressed),
+                                                                      state.last_suppressed),
+            nullptr,
+            0,
+            nullptr);
+}
+
+/**
+ * Write a message unless the same message has been written too often in the last second
+ */
+void WriteMessage(QtMsgType type, qint64 time, const QString& text, const char* file, int line, const char* function) {
+  // messages are told apart by where they came from if that's known (the text often includes changing details like
+  // clip names), otherwise by their text
+  QString key = (file != nullptr) ? QString("%1:%2:%3").arg(QString::number(type), file, QString::number(line))
+                                  : QString("%1:%2").arg(QString::number(type), text);
+
+  QHash<QString, RateState>::iterator state = rate_states.find(key);
+
+  if (state == rate_states.end()) {
+    RateState new_state;
+    new_state.type = type;
+    new_state.window_start = time;
+    new_state.count = 0;
+    new_state.suppressed = 0;
+    state = rate_states.insert(key, new_state);
+  } else if (time - state->window_start >= kRateWindow) {
+    if (state->suppressed > 0) {
+      WriteSuppressed(*state);
+    }
+    state->window_start = time;
+    state->count = 0;
+    state->suppressed = 0;
+    state->last_suppressed.clear();
+  }
+
+  if (state->count < kRateLimit) {
+    state->count++;
+    WriteLine(type, time, text, file, line, function);
+  } else {
+    state->suppressed++;
+    state->last_suppressed = text;
+  }
+}
+
+/**
+ * Summarize messages that were suppressed in windows that have ended, and forget about quiet ones
+ */
+void ExpireRateStates(qint64 now) {
+  QHash<QString, RateState>::iterator i = rate_states.begin();
+  while (i != rate_states.end()) {
+    if (now - i->window_start >= kRateWindow) {
+      if (i->suppressed > 0) {
+        WriteSuppressed(i.value());
+      }
+      i = rate_states.erase(i);
+    } else {
+      i++;
+    }
   }
-  debug_info.append(QString("<font color='%1'><b>[%2]</b> %3 (%4:%5, %6)</font><br>")
-                     .arg(fontColor, msgTag, localMsg, context.file, QString::number(context.line), context.function));
+}
+
+void FlushOutput() {
   fflush(stderr);
-  if (olive::DebugDialog != nullptr && olive::DebugDialog->isVisible()) {
-    QMetaObject::invokeMethod(olive::DebugDialog, "update_log", Qt::QueuedConnection);
+  if (debug_file.isOpen()) {
+    debug_stream.flush();
   }
-  debug_mutex.unlock();
 }
 
-const QString &get_debug_str()
+bool Enqueue(QtMsgType type, const QMessageLogContext &context, const QString &msg) {
+  quint32 pos = log_queue.enqueue_pos.load();
+
+  forever {
+    LogMessage& slot = log_queue.messages[pos & (kQueueSize - 1)];
+    qint32 diff = qint32(slot.sequence.loadAcquire() - pos);
+
+    if (diff == 0) {
+      if (log_queue.enqueue_pos.testAndSetRelaxed(pos, pos + 1)) {
+        slot.type = type;
+        slot.time = QDateTime::currentMSecsSinceEpoch();
+        slot.text = msg;
+        slot.file = context.file;
+        slot.line = context.line;
+        slot.function = context.function;
+        slot.sequence.storeRelease(pos + 1);
+        return true;
+      }
+      pos = log_queue.enqueue_pos.load();
+    } else if (diff < 0) {
+      // the writer hasn't caught up with the queue yet
+      return false;
+    } else {
+      pos = log_queue.enqueue_pos.load();
+    }
+  }
+}
+
+/**
+ * Write every queued message, only ever called by the writer thread
+ */
+void WriteQueued() {
+  QMutexLocker locker(&output_lock);
+
+  int history_end = history_first + history.size();
+
+  forever {
+    LogMessage& slot = log_queue.messages[log_queue.dequeue_pos & (kQueueSize - 1)];
+
+    if (slot.sequence.loadAcquire() != log_queue.dequeue_pos + 1) {
+      break;
+    }
+
+    WriteMessage(slot.type, slot.time, slot.text, slot.file, slot.line, slot.function);
+    slot.text.clear();
+
+    slot.sequence.storeRelease(log_queue.dequeue_pos + kQueueSize);
+    log_queue.dequeue_pos++;
+  }
+
+  int dropped = log_queue.dropped.fetchAndStoreRelaxed(0);
+  if (dropped > 0) {
+    WriteLine(QtWarningMsg,
+              QDateTime::currentMSecsSinceEpoch(),
+              QString("(%1 messages dropped, the log couldn't keep up)").arg(dropped),
+              nullptr,
+              0,
+              nullptr);
+  }
+
+  ExpireRateStates(QDateTime::currentMSecsSinceEpoch());
+
+  if (history_first + history.size() != history_end) {
+    FlushOutput();
+
+    if (olive::DebugDialog != nullptr && olive::DebugDialog->isVisible()) {
+      QMetaObject::invokeMethod(olive::DebugDialog, "update_log", Qt::QueuedConnection);
+    }
+  }
+}
+
+LogWriter::LogWriter() :
+  running_(1)
+{}
+
+void LogWriter::Stop() {
+  running_.store(0);
+  wait();
+}
+
+void LogWriter::run() {
+  while (running_.load()) {
+    WriteQueued();
+    msleep(kWriteInterval);
+  }
+
+  WriteQueued();
+}
+
+}
+
+void open_debug_file() {
+  {
+    QMutexLocker locker(&output_lock);
+
+    QDir debug_dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    debug_dir.mkpath(".");
+    if (debug_dir.exists()) {
+      debug_file.setFileName(debug_dir.path() + "/debug_log");
+      if (debug_file.open(QFile::WriteOnly)) {
+        debug_stream.setDevice(&debug_file);
+      }
+    }
+  }
+
+  // logged outside the lock, we'd still be writing synchronously at this point
+  if (!debug_file.isOpen()) {
+    qWarning() << "Couldn't open debug log file, debug log will not be saved";
+  }
+
+  if (log_writer == nullptr) {
+    log_writer = new LogWriter();
+    log_writer->start(QThread::LowPriority);
+    log_writer_running.store(1);
+  }
+}
+
+void close_debug_file()
+{
+  if (log_writer != nullptr) {
+    // anything logged from here on is written synchronously
+    log_writer_running.store(0);
+    log_writer->Stop();
+    delete log_writer;
+    log_writer = nullptr;
+
+    // pick up anything that was queued while the writer was stopping
+    WriteQueued();
+  }
+
+  QMutexLocker locker(&output_lock);
+
+  // the writer thread may have been stopped before it could summarize everything
+  ExpireRateStates(QDateTime::currentMSecsSinceEpoch() + kRateWindow);
+  FlushOutput();
+
+  if (debug_file.isOpen()) {
+    debug_file.close();
+  }
+}
+
+void debug_message_handler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
 {
-  return debug_info;
+  // fatal messages abort right after this returns, so they're always written immediately
+  if (log_writer_running.load() && type != QtFatalMsg) {
+    if (!Enqueue(type, context, msg)) {
+      log_queue.dropped.ref();
+    }
+    return;
+  }
+
+  QMutexLocker locker(&output_lock);
+  WriteMessage(type, QDateTime::currentMSecsSinceEpoch(), msg, context.file, context.line, context.function);
+  FlushOutput();
+}
+
+int get_debug_lines(int first, QStringList &lines)
+{
+  QMutexLocker locker(&output_lock);
+
+  for (int i=qMax(first, history_first)-history_first;i<history.size();i++) {
+    lines.append(history.at(i));
+  }
+
+  return history_first + history.size();
 }
@@ -22,10 +22,53 @@
 #define DEBUG_H
 
 #include <QDebug>
+#include <QStringList>
 
+/**
+ * @brief Number of messages kept in memory for the debug dialog
+ *
+ * Older messages are still written to the console and the debug log file.
+ */
+const int kDebugHistorySize = 5000;
+
+/**
+ * @brief Qt message handler for Olive's internal log
+ *
+ * Messages are put in a lock-free queue and written to the console, the debug log file and the debug dialog's history
+ * by a background thread (see open_debug_file()), so logging from a hot path never waits on a lock or on I/O. If the
+ * queue is full the message is dropped and counted. Repeats of the same message from the same place are limited to a
+ * few per second, the rest are summarized.
+ *
+ * Until the background thread is running (and after it's stopped), messages are written synchronously.
+ */
 void debug_message_handler(QtMsgType type, const QMessageLogContext &context, const QString &msg);
-const QString& get_debug_str();
+
+/**
+ * @brief Get messages from the in-memory history formatted as HTML
+ *
+ * Messages are numbered from the start of the session, only the last kDebugHistorySize are kept.
+ *
+ * @param first
+ *
+ * Number of the first message wanted. If it's no longer in the history, the oldest message that is will be the
+ * first returned.
+ *
+ * @param lines
+ *
+ * Filled with the messages from `first` onwards.
+ *
+ * @return The number of the message after the last one returned, to pass as `first` next time.
+ */
+int get_debug_lines(int first, QStringList& lines);
+
+/**
+ * @brief Open the debug log file and start writing messages in the background
+ */
 void open_debug_file();
+
+/**
+ * @brief Write any queued messages, stop the background thread and close the debug log file
+ */
 void close_debug_file();
 
 #endif // DEBUG_H
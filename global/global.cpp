@@ -30,7 +30,10 @@
 #include "panels/panels.h"
 #include "global/path.h"
 #include "global/config.h"
+#include "global/trace.h"
 #include "rendering/audio.h"
+#include "rendering/audiopagecache.h"
+#include "rendering/decoderpool.h"
 #include "dialogs/demonotice.h"
 #include "dialogs/preferencesdialog.h"
 #include "dialogs/exportdialog.h"
@@ -109,7 +112,6 @@ void OliveGlobal::check_for_autorecovery_file() {
 }
 
 void OliveGlobal::set_rendering_state(bool rendering) {
-  audio_rendering = rendering;
   if (rendering) {
     autorecovery_timer.stop();
   } else {
@@ -210,6 +212,12 @@ void OliveGlobal::ClearProject()
   // clear project contents (footage, sequences, etc.)
   panel_project->clear();
 
+  // close decoders kept warm for the old project's footage
+  olive::decoder_pool.Clear();
+
+  // free audio decoded for scrubbing the old project's footage
+  olive::audio_page_cache.Clear();
+
   // clear undo stack
   olive::UndoStack.clear();
 
@@ -426,6 +434,32 @@ void OliveGlobal::open_debug_log() {
   olive::DebugDialog->show();
 }
 
+void OliveGlobal::toggle_frame_trace(bool record) {
+  if (record) {
+    olive::trace::Start();
+    return;
+  }
+
+  olive::trace::Stop();
+
+  QString fn = QFileDialog::getSaveFileName(olive::MainWindow,
+                                            tr("Save Frame Trace"),
+                                            "",
+                                            tr("Chrome Trace (*.json)"));
+  if (!fn.isEmpty()) {
+    if (!fn.endsWith(".json", Qt::CaseInsensitive)) {
+      fn += ".json";
+    }
+
+    if (!olive::trace::Save(fn)) {
+      QMessageBox::critical(olive::MainWindow,
+                            tr("Save Frame Trace"),
+                            tr("Failed to write frame trace to \"%1\". Check the debug log for details.").arg(fn),
+                            QMessageBox::Ok);
+    }
+  }
+}
+
 void OliveGlobal::open_speed_dialog() {
   if (olive::ActiveSequence != nullptr) {
 
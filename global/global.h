@@ -270,6 +270,17 @@ public slots:
      */
     void open_debug_log();
 
+    /**
+     * @brief Start or stop recording a frame timing trace
+     *
+     * When recording stops, asks the user where to save the trace (see olive::trace::Save()).
+     *
+     * @param record
+     *
+     * **TRUE** to start recording, **FALSE** to stop recording and save.
+     */
+    void toggle_frame_trace(bool record);
+
     /**
      * @brief Open the Speed/Duration dialog.
      */
@@ -21,6 +21,7 @@
 #include "path.h"
 
 #include <QStandardPaths>
+#include <QFile>
 #include <QFileInfo>
 #include <QCoreApplication>
 #include <QCryptographicHash>
@@ -89,14 +90,43 @@ QList<QString> get_effects_paths() {
   return effects_paths;
 }
 
+// size of each block of the file sampled by get_file_hash()
+const qint64 kHashBlockSize = 65536;
+
+// number of blocks sampled, spread evenly from the start to the end of the file
+const int kHashBlockCount = 4;
+
 QString get_file_hash(const QString& filename) {
-  QFileInfo file_info(filename);
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    // image sequences (e.g. "image%04d.png") aren't a single file, fall back to identifying them by name and date
+    QFileInfo file_info(filename);
+
+    QString cache_file = filename.mid(filename.lastIndexOf('/')+1)
+        + QString::number(file_info.size())
+        + QString::number(file_info.lastModified().toMSecsSinceEpoch());
+
+    return QCryptographicHash::hash(cache_file.toUtf8(), QCryptographicHash::Md5).toHex();
+  }
+
+  // hash the file's size and a few blocks of its contents, so the same file is recognized wherever it's moved or
+  // copied to without reading all of it
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  qint64 size = file.size();
+  hash.addData(QByteArray::number(size));
 
-  QString cache_file = filename.mid(filename.lastIndexOf('/')+1)
-      + QString::number(file_info.size())
-      + QString::number(file_info.lastModified().toMSecsSinceEpoch());
+  if (size <= kHashBlockSize * kHashBlockCount) {
+    hash.addData(file.readAll());
+  } else {
+    for (int i=0;i<kHashBlockCount;i++) {
+      file.seek((size - kHashBlockSize) * i / (kHashBlockCount - 1));
+      hash.addData(file.read(kHashBlockSize));
+    }
+  }
 
-  return QCryptographicHash::hash(cache_file.toUtf8(), QCryptographicHash::Md5).toHex();
+  return hash.result().toHex();
 }
 
 QList<QString> get_language_paths() {
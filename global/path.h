@@ -32,7 +32,7 @@ QDir get_config_dir();
 QList<QString> get_effects_paths();
 QList<QString> get_language_paths();
 
-// generate hash algorithm used to uniquely identify files
+// generate hash algorithm used to uniquely identify files by their contents (used as the key of cached previews)
 QString get_file_hash(const QString& filename);
 
 #endif // PATH_H
@@ -0,0 +1,388 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "trace.h"
+
+#include <QAtomicInteger>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QDebug>
+
+namespace {
+
+// number of events each thread keeps before overwriting its oldest ones (must be a power of two)
+const quint32 kBufferSize = 16384;
+
+// number of thread buffers allocated before the buffers of finished threads start being reused
+const int kMaxBuffers = 64;
+
+// how much of the trace file is built in memory before it's written out
+const int kWriteChunkSize = 1048576;
+
+struct TraceEvent {
+  const char* category;
+  const char* name;
+  const char* detail;
+  qint64 start;
+  qint64 duration;
+};
+
+/**
+ * Events recorded by one thread. Only the owning thread ever writes to it, Save() reads the event count before and
+ * after copying the events out and discards any that may have been overwritten in between, so neither has to lock.
+ */
+struct ThreadBuffer {
+  TraceEvent events[kBufferSize];
+
+  // total number of events written this session, the newest kBufferSize of which are still in `events`
+  QAtomicInteger<quint32> count;
+
+  // the recording session the events belong to
+  QAtomicInt session;
+
+  // set while a thread is writing to this buffer, cleared when that thread finishes
+  QAtomicInt owned;
+
+  // set when a thread takes over the buffer (with buffer_lock held)
+  int thread_id;
+  QString thread_name;
+};
+
+struct ThreadSlot {
+  ThreadSlot() :
+    buffer(nullptr)
+  {}
+
+  ~ThreadSlot() {
+    if (buffer != nullptr) {
+      buffer->owned.storeRelease(0);
+    }
+  }
+
+  ThreadBuffer* buffer;
+
+  // strings this thread already interned, so it only has to lock on the first use of a string
+  QHash<QString, const char*> strings;
+};
+
+thread_local ThreadSlot current_thread;
+
+QAtomicInt enabled;
+QAtomicInt current_session;
+
+// started once by the first call to Start() and never restarted, so timestamps from every thread are comparable
+QElapsedTimer timer;
+
+// protects the list of buffers and which thread owns each of them
+QMutex buffer_lock;
+QVector<ThreadBuffer*> buffers;
+int next_thread_id = 1;
+
+QMutex string_lock;
+QHash<QString, QByteArray> interned_strings;
+
+const char* Intern(const QString& s) {
+  QHash<QString, const char*>::const_iterator cached = current_thread.strings.constFind(s);
+  if (cached != current_thread.strings.constEnd()) {
+    return cached.value();
+  }
+
+  string_lock.lock();
+  QHash<QString, QByteArray>::iterator i = interned_strings.find(s);
+  if (i == interned_strings.end()) {
+    i = interned_strings.insert(s, s.toUtf8());
+  }
+  const char* str = i.value().constData();
+  string_lock.unlock();
+
+  current_thread.strings.insert(s, str);
+
+  return str;
+}
+
+ThreadBuffer* CurrentBuffer() {
+  int session = current_session.loadAcquire();
+
+  ThreadBuffer* buffer = current_thread.buffer;
+
+  if (buffer == nullptr) {
+    QMutexLocker locker(&buffer_lock);
+
+    if (buffers.size() < kMaxBuffers) {
+      buffer = new ThreadBuffer();
+      buffer->owned.store(1);
+      buffers.append(buffer);
+    } else {
+      // take over the buffer of a thread that has finished
+      for (int i=0;i<buffers.size();i++) {
+        if (buffers.at(i)->owned.testAndSetOrdered(0, 1)) {
+          buffer = buffers.at(i);
+          break;
+        }
+      }
+
+      if (buffer == nullptr) {
+        // every buffer belongs to a running thread, this thread's events are dropped
+        return nullptr;
+      }
+    }
+
+    QThread* thread = QThread::currentThread();
+
+    buffer->thread_id = next_thread_id++;
+    if (QCoreApplication::instance() != nullptr && thread == QCoreApplication::instance()->thread()) {
+      buffer->thread_name = "Main";
+    } else if (!thread->objectName().isEmpty()) {
+      buffer->thread_name = thread->objectName();
+    } else {
+      buffer->thread_name = thread->metaObject()->className();
+    }
+
+    buffer->count.store(0);
+    buffer->session.storeRelease(session);
+
+    current_thread.buffer = buffer;
+  } else if (buffer->session.load() != session) {
+    // first event of a new recording, discard the previous one
+    buffer->count.store(0);
+    buffer->session.storeRelease(session);
+  }
+
+  return buffer;
+}
+
+void AppendString(QByteArray& out, const char* str) {
+  out.append('"');
+  for (const char* c=str;*c!='\0';c++) {
+    if (*c == '"' || *c == '\\') {
+      out.append('\\');
+      out.append(*c);
+    } else if (static_cast<unsigned char>(*c) < 0x20) {
+      out.append("\\u00");
+      out.append(QByteArray::number(static_cast<int>(*c), 16).rightJustified(2, '0'));
+    } else {
+      out.append(*c);
+    }
+  }
+  out.append('"');
+}
+
+void AppendTime(QByteArray& out, qint64 nsecs) {
+  // trace event timestamps are in microseconds
+  out.append(QByteArray::number(double(nsecs) / 1000.0, 'f', 3));
+}
+
+}
+
+TraceScope::TraceScope(const char *category, const char *name) :
+  category_(category),
+  name_(name),
+  detail_(nullptr),
+  start_(-1)
+{
+  if (enabled.loadAcquire()) {
+    start_ = timer.nsecsElapsed();
+  }
+}
+
+TraceScope::TraceScope(const char *category, const char *name, const QString &detail) :
+  category_(category),
+  name_(name),
+  detail_(nullptr),
+  start_(-1)
+{
+  if (enabled.loadAcquire()) {
+    detail_ = Intern(detail);
+    start_ = timer.nsecsElapsed();
+  }
+}
+
+TraceScope::TraceScope(const char *category, const QString &name, const QString &detail) :
+  category_(category),
+  name_(nullptr),
+  detail_(nullptr),
+  start_(-1)
+{
+  if (enabled.loadAcquire()) {
+    name_ = Intern(name);
+    detail_ = Intern(detail);
+    start_ = timer.nsecsElapsed();
+  }
+}
+
+TraceScope::~TraceScope()
+{
+  if (start_ < 0) {
+    return;
+  }
+
+  qint64 end = timer.nsecsElapsed();
+
+  ThreadBuffer* buffer = CurrentBuffer();
+  if (buffer == nullptr) {
+    return;
+  }
+
+  quint32 index = buffer->count.load();
+
+  TraceEvent& event = buffer->events[index & (kBufferSize - 1)];
+  event.category = category_;
+  event.name = name_;
+  event.detail = detail_;
+  event.start = start_;
+  event.duration = end - start_;
+
+  buffer->count.storeRelease(index + 1);
+}
+
+bool olive::trace::IsEnabled()
+{
+  return enabled.loadAcquire();
+}
+
+void olive::trace::Start()
+{
+  QMutexLocker locker(&buffer_lock);
+
+  if (!timer.isValid()) {
+    timer.start();
+  }
+
+  current_session.fetchAndAddOrdered(1);
+  enabled.storeRelease(1);
+}
+
+void olive::trace::Stop()
+{
+  enabled.storeRelease(0);
+}
+
+bool olive::trace::Save(const QString &filename)
+{
+  QFile file(filename);
+  if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+    qCritical() << "Failed to open trace file" << filename << "-" << file.errorString();
+    return false;
+  }
+
+  QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+  int session = current_session.loadAcquire();
+  int event_count = 0;
+
+  QByteArray out("{\"traceEvents\":[");
+  bool first_event = true;
+
+  QMutexLocker locker(&buffer_lock);
+
+  for (int i=0;i<buffers.size();i++) {
+    ThreadBuffer* buffer = buffers.at(i);
+
+    if (buffer->session.loadAcquire() != session) {
+      continue;
+    }
+
+    // copy the events out while the thread may still be adding more
+    quint32 end = buffer->count.loadAcquire();
+    quint32 begin = (end > kBufferSize) ? end - kBufferSize : 0;
+
+    QVector<TraceEvent> events(int(end - begin));
+    for (quint32 j=begin;j<end;j++) {
+      events[int(j - begin)] = buffer->events[j & (kBufferSize - 1)];
+    }
+
+    quint32 end_after_copy = buffer->count.loadAcquire();
+    if (buffer->session.loadAcquire() != session || end_after_copy < end) {
+      // the thread started a new recording while we were copying
+      continue;
+    }
+
+    // skip any events the thread overwrote while we were copying, including the slot it may be in the middle of
+    // writing (event number end_after_copy, which hasn't been published yet)
+    int first = 0;
+    if (end_after_copy + 1 - begin > kBufferSize) {
+      first = qMin(int(end_after_copy + 1 - begin - kBufferSize), events.size());
+    }
+
+    QByteArray tid = QByteArray::number(buffer->thread_id);
+
+    if (!first_event) {
+      out.append(',');
+    }
+    first_event = false;
+
+    out.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":");
+    out.append(pid);
+    out.append(",\"tid\":");
+    out.append(tid);
+    out.append(",\"args\":{\"name\":");
+    AppendString(out, buffer->thread_name.toUtf8().constData());
+    out.append("}}");
+
+    for (int j=first;j<events.size();j++) {
+      const TraceEvent& event = events.at(j);
+
+      out.append(",{\"name\":");
+      AppendString(out, event.name);
+      out.append(",\"cat\":");
+      AppendString(out, event.category);
+      out.append(",\"ph\":\"X\",\"ts\":");
+      AppendTime(out, event.start);
+      out.append(",\"dur\":");
+      AppendTime(out, event.duration);
+      out.append(",\"pid\":");
+      out.append(pid);
+      out.append(",\"tid\":");
+      out.append(tid);
+      if (event.detail != nullptr) {
+        out.append(",\"args\":{\"detail\":");
+        AppendString(out, event.detail);
+        out.append('}');
+      }
+      out.append('}');
+
+      event_count++;
+
+      if (out.size() >= kWriteChunkSize) {
+        file.write(out);
+        out.clear();
+      }
+    }
+  }
+
+  locker.unlock();
+
+  out.append("],\"displayTimeUnit\":\"ms\"}\n");
+
+  if (file.write(out) < 0) {
+    qCritical() << "Failed to write trace file" << filename << "-" << file.errorString();
+    return false;
+  }
+
+  file.close();
+
+  qInfo() << "Wrote" << event_count << "trace events to" << filename;
+
+  return true;
+}
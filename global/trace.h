@@ -0,0 +1,85 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+
+/**
+ * @brief Record how long a block of code took
+ *
+ * Create one on the stack at the start of the block to be measured, it records an event covering its own lifetime
+ * when it goes out of scope. Events are only recorded while tracing is enabled (see olive::trace::Start()), otherwise
+ * a TraceScope costs a single atomic load.
+ *
+ * Category and name strings passed as `const char*` must stay valid for the rest of the session (i.e. string
+ * literals). QStrings (usually the clip or effect the event belongs to) are copied.
+ */
+class TraceScope {
+public:
+  TraceScope(const char* category, const char* name);
+  TraceScope(const char* category, const char* name, const QString& detail);
+  TraceScope(const char* category, const QString& name, const QString& detail);
+  ~TraceScope();
+
+private:
+  const char* category_;
+  const char* name_;
+  const char* detail_;
+  qint64 start_;
+};
+
+namespace olive {
+namespace trace {
+
+/**
+ * @brief Returns whether events are currently being recorded
+ */
+bool IsEnabled();
+
+/**
+ * @brief Start recording events
+ *
+ * Discards any events from a previous recording. Every thread records into its own fixed-size buffer without locking,
+ * once a thread's buffer is full its oldest events are overwritten.
+ */
+void Start();
+
+/**
+ * @brief Stop recording events
+ *
+ * Recorded events are kept until the next call to Start() so they can be saved with Save().
+ */
+void Stop();
+
+/**
+ * @brief Write the recorded events to a file in Chrome's trace event format
+ *
+ * The file can be opened in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * @return **TRUE** if the file was written successfully.
+ */
+bool Save(const QString& filename);
+
+}
+}
+
+#endif // TRACE_H
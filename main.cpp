@@ -22,6 +22,7 @@
 
 #include "global/debug.h"
 #include "global/config.h"
+#include "global/trace.h"
 #include "global/global.h"
 #include "panels/timeline.h"
 #include "ui/mediaiconservice.h"
@@ -60,6 +61,10 @@ int main(int argc, char *argv[]) {
                  "\t--no-debug\t\tDisable internal debug log and output directly to console\n"
                  "\t--disable-blend-modes\tDisable shader-based blending for older GPUs\n"
                  "\t--translation <file>\tSet an external language file to use\n"
+                 "\t--log-clip-latency\tPrint per-clip decode latency for every rendered frame\n"
+                 "\t--log-frame-pool\tPrint decoded frame allocation statistics every second\n"
+                 "\t--core-profile\t\tRequest an OpenGL 3.2 core profile context (e.g. for llvmpipe)\n"
+                 "\t--trace <file>\t\tRecord frame timings and write them to a Chrome trace file on exit\n"
                  "\n"
                  "Environment Variables:\n"
                  "\tOLIVE_EFFECTS_PATH\tSpecify a path to search for GLSL shader effects\n"
@@ -75,6 +80,12 @@ int main(int argc, char *argv[]) {
           use_internal_logger = false;
         } else if (!strcmp(argv[i], "--disable-blend-modes")) {
           olive::CurrentRuntimeConfig.disable_blending = true;
+        } else if (!strcmp(argv[i], "--log-clip-latency")) {
+          olive::CurrentRuntimeConfig.log_clip_latency = true;
+        } else if (!strcmp(argv[i], "--log-frame-pool")) {
+          olive::CurrentRuntimeConfig.log_frame_pool = true;
+        } else if (!strcmp(argv[i], "--core-profile")) {
+          olive::CurrentRuntimeConfig.core_profile = true;
         } else if (!strcmp(argv[i], "--translation")) {
           if (i + 1 < argc && argv[i + 1][0] != '-') {
             // load translation file
@@ -85,6 +96,15 @@ int main(int argc, char *argv[]) {
             printf("[ERROR] No translation file specified\n");
             return 1;
           }
+        } else if (!strcmp(argv[i], "--trace")) {
+          if (i + 1 < argc && argv[i + 1][0] != '-') {
+            olive::CurrentRuntimeConfig.trace_file = argv[i + 1];
+
+            i++;
+          } else {
+            printf("[ERROR] No trace file specified\n");
+            return 1;
+          }
         } else {
           printf("[ERROR] Unknown argument '%s'\n", argv[1]);
           return 1;
@@ -99,6 +119,10 @@ int main(int argc, char *argv[]) {
     qInstallMessageHandler(debug_message_handler);
   }
 
+  if (!olive::CurrentRuntimeConfig.trace_file.isEmpty()) {
+    olive::trace::Start();
+  }
+
   // Initialize ffmpeg subsystem
   // (these have been deprecated in FFmpeg 4, but are still necessary for FFmpeg 3)
 #if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
@@ -113,6 +137,10 @@ int main(int argc, char *argv[]) {
 
   QSurfaceFormat format;
   format.setDepthBufferSize(24);
+  if (olive::CurrentRuntimeConfig.core_profile) {
+    format.setVersion(3, 2);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+  }
   QSurfaceFormat::setDefaultFormat(format);
 
   QApplication a(argc, argv);
@@ -144,5 +172,12 @@ int main(int argc, char *argv[]) {
     w.showMaximized();
   }
 
-  return a.exec();
+  int ret = a.exec();
+
+  if (!olive::CurrentRuntimeConfig.trace_file.isEmpty()) {
+    olive::trace::Stop();
+    olive::trace::Save(olive::CurrentRuntimeConfig.trace_file);
+  }
+
+  return ret;
 }
@@ -58,8 +58,10 @@ SOURCES += \
     ui/sourcetable.cpp \
     dialogs/aboutdialog.cpp \
     ui/timelinewidget.cpp \
+    ui/timelinerasterizer.cpp \
     project/media.cpp \
     project/footage.cpp \
+    project/filmstrip.cpp \
     timeline/sequence.cpp \
     timeline/clip.cpp \
     global/config.cpp \
@@ -72,6 +74,7 @@ SOURCES += \
     rendering/exportthread.cpp \
     ui/timelineheader.cpp \
     project/previewgenerator.cpp \
+    project/previewcache.cpp \
     ui/labelslider.cpp \
     dialogs/preferencesdialog.cpp \
     ui/audiomonitor.cpp \
@@ -91,6 +94,7 @@ SOURCES += \
     project/loadthread.cpp \
     dialogs/loaddialog.cpp \
     global/debug.cpp \
+    global/trace.cpp \
     global/path.cpp \
     effects/internal/linearfadetransition.cpp \
     effects/internal/transformeffect.cpp \
@@ -151,6 +155,15 @@ SOURCES += \
     rendering/audio.cpp \
     dialogs/clippropertiesdialog.cpp \
     rendering/framebufferobject.cpp \
+    rendering/framebufferpool.cpp \
+    rendering/framepool.cpp \
+    rendering/framebudget.cpp \
+    rendering/decoderpool.cpp \
+    rendering/audiopagecache.cpp \
+    rendering/offlinerenderer.cpp \
+    rendering/quadrenderer.cpp \
+    rendering/rendergraph.cpp \
+    rendering/shaderprogram.cpp \
     ui/updatenotification.cpp \
     ui/icons.cpp \
     effects/fields/doublefield.cpp \
@@ -183,8 +196,10 @@ HEADERS += \
     ui/sourcetable.h \
     dialogs/aboutdialog.h \
     ui/timelinewidget.h \
+    ui/timelinerasterizer.h \
     project/media.h \
     project/footage.h \
+    project/filmstrip.h \
     timeline/sequence.h \
     timeline/clip.h \
     global/config.h \
@@ -198,6 +213,7 @@ HEADERS += \
     ui/timelinetools.h \
     ui/timelineheader.h \
     project/previewgenerator.h \
+    project/previewcache.h \
     ui/labelslider.h \
     dialogs/preferencesdialog.h \
     ui/audiomonitor.h \
@@ -218,6 +234,7 @@ HEADERS += \
     project/loadthread.h \
     dialogs/loaddialog.h \
     global/debug.h \
+    global/trace.h \
     global/path.h \
     effects/internal/transformeffect.h \
     effects/internal/solideffect.h \
@@ -280,6 +297,15 @@ HEADERS += \
     rendering/audio.h \
     dialogs/clippropertiesdialog.h \
     rendering/framebufferobject.h \
+    rendering/framebufferpool.h \
+    rendering/framepool.h \
+    rendering/framebudget.h \
+    rendering/decoderpool.h \
+    rendering/audiopagecache.h \
+    rendering/offlinerenderer.h \
+    rendering/quadrenderer.h \
+    rendering/rendergraph.h \
+    rendering/shaderprogram.h \
     ui/updatenotification.h \
     ui/icons.h \
     effects/fields/doublefield.h \
@@ -29,6 +29,7 @@
 
 #include <QScrollBar>
 #include <QCoreApplication>
+#include <QElapsedTimer>
 
 Project* panel_project = nullptr;
 EffectControls* panel_effect_controls = nullptr;
@@ -47,6 +48,35 @@ void update_ui(bool modified) {
   panel_graph_editor->update_panel();
 }
 
+// minimum time between side panel refreshes during playback (in milliseconds)
+const int kPlaybackPanelInterval = 100;
+
+void update_ui_playback() {
+  static QElapsedTimer panel_timer;
+
+  panel_sequence_viewer->update_viewer();
+
+  if (panel_timer.isValid() && panel_timer.elapsed() < kPlaybackPanelInterval) {
+    panel_timeline->repaint_playhead();
+    return;
+  }
+
+  panel_timer.start();
+
+  if (olive::CurrentConfig.seek_also_selects) {
+    panel_timeline->select_from_playhead();
+    panel_effect_controls->SetClips();
+
+    // selections are drawn over the whole timeline
+    panel_timeline->repaint_timeline();
+  } else {
+    panel_timeline->repaint_playhead();
+  }
+
+  panel_effect_controls->update_keyframes();
+  panel_graph_editor->update_panel();
+}
+
 QDockWidget *get_focused_panel(bool force_hover) {
   QDockWidget* w = nullptr;
   if (olive::CurrentConfig.hover_focus || force_hover) {
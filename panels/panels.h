@@ -35,6 +35,14 @@ extern Timeline* panel_timeline;
 extern GraphEditor* panel_graph_editor;
 
 void update_ui(bool modified);
+
+/**
+ * @brief Lighter version of update_ui() called for every frame during playback
+ *
+ * The viewer and the timeline's playhead are updated every call. The Effect Controls and Graph Editor panels (and the
+ * selection if "Seek Also Selects" is on) are only refreshed a few times per second.
+ */
+void update_ui_playback();
 QDockWidget* get_focused_panel(bool force_hover = false);
 void alloc_panels(QWidget *parent);
 void free_panels();
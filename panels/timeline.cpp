@@ -576,30 +576,32 @@ bool Timeline::focused() {
   return (olive::ActiveSequence != nullptr && (headers->hasFocus() || video_area->hasFocus() || audio_area->hasFocus()));
 }
 
-void Timeline::repaint_timeline() {
-  if (!block_repaints) {
-    bool draw = true;
-
-    if (olive::ActiveSequence != nullptr
-        && !horizontalScrollBar->isSliderDown()
-        && !horizontalScrollBar->is_resizing()
-        && panel_sequence_viewer->playing
-        && !zoom_just_changed) {
-      // auto scroll
-      if (olive::CurrentConfig.autoscroll == olive::AUTOSCROLL_PAGE_SCROLL) {
-        int playhead_x = getTimelineScreenPointFromFrame(olive::ActiveSequence->playhead);
-        if (playhead_x < 0 || playhead_x > (editAreas->width() - videoScrollbar->width())) {
-          horizontalScrollBar->setValue(getScreenPointFromFrame(zoom, olive::ActiveSequence->playhead));
-          draw = false;
-        }
-      } else if (olive::CurrentConfig.autoscroll == olive::AUTOSCROLL_SMOOTH_SCROLL) {
-        if (center_scroll_to_playhead(horizontalScrollBar, zoom, olive::ActiveSequence->playhead)) {
-          draw = false;
-        }
+bool Timeline::autoscroll_to_playhead() {
+  if (olive::ActiveSequence != nullptr
+      && !horizontalScrollBar->isSliderDown()
+      && !horizontalScrollBar->is_resizing()
+      && panel_sequence_viewer->playing
+      && !zoom_just_changed) {
+    // auto scroll
+    if (olive::CurrentConfig.autoscroll == olive::AUTOSCROLL_PAGE_SCROLL) {
+      int playhead_x = getTimelineScreenPointFromFrame(olive::ActiveSequence->playhead);
+      if (playhead_x < 0 || playhead_x > (editAreas->width() - videoScrollbar->width())) {
+        horizontalScrollBar->setValue(getScreenPointFromFrame(zoom, olive::ActiveSequence->playhead));
+        return true;
+      }
+    } else if (olive::CurrentConfig.autoscroll == olive::AUTOSCROLL_SMOOTH_SCROLL) {
+      if (center_scroll_to_playhead(horizontalScrollBar, zoom, olive::ActiveSequence->playhead)) {
+        return true;
       }
     }
+  }
+
+  return false;
+}
 
-    if (draw) {
+void Timeline::repaint_timeline() {
+  if (!block_repaints) {
+    if (!autoscroll_to_playhead()) {
       headers->update();
       video_area->update();
       audio_area->update();
@@ -614,6 +616,18 @@ void Timeline::repaint_timeline() {
   }
 }
 
+void Timeline::repaint_playhead() {
+  if (!block_repaints) {
+    if (!autoscroll_to_playhead()) {
+      headers->update();
+      video_area->update_playhead();
+      audio_area->update_playhead();
+    }
+
+    zoom_just_changed = false;
+  }
+}
+
 void Timeline::select_all() {
   if (olive::ActiveSequence != nullptr) {
     olive::ActiveSequence->selections.clear();
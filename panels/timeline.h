@@ -235,6 +235,11 @@ protected:
 public slots:
   void paste(bool insert = false);
   void repaint_timeline();
+
+  /**
+   * @brief Lighter version of repaint_timeline() for playback that only repaints around the playhead
+   */
+  void repaint_playhead();
   void toggle_show_all();
   void deselect();
   void toggle_links();
@@ -285,6 +290,13 @@ private:
   void set_sb_max();
   void UpdateTitle();
 
+  /**
+   * @brief Scroll to keep the playhead in view during playback according to the autoscroll setting
+   *
+   * @return **TRUE** if the view was scrolled (which repaints the timeline by itself).
+   */
+  bool autoscroll_to_playhead();
+
   void setup_ui();
 
   // ripple delete empty space variables
@@ -136,11 +136,11 @@ void Viewer::reset_all_audio() {
       }
     }
 
-    audio_ibuffer_frame = seq->playhead;
+    playback_audio.frame = seq->playhead;
     if (playback_speed < 0) {
-      audio_ibuffer_frame = last_frame - audio_ibuffer_frame;
+      playback_audio.frame = last_frame - playback_audio.frame;
     }
-    audio_ibuffer_timecode = double(audio_ibuffer_frame) / seq->frame_rate;
+    playback_audio.timecode = double(playback_audio.frame) / seq->frame_rate;
   }
   clear_audio_ibuffer();
 }
@@ -418,7 +418,7 @@ void Viewer::play(bool in_to_out) {
 
     playhead_start = seq->playhead;
     playing = true;
-    SetAudioWakeObject(this);
+    playback_audio.SetWakeObject(this);
     set_playpause_icon(false);
     start_msecs = QDateTime::currentMSecsSinceEpoch();
 
@@ -433,12 +433,22 @@ void Viewer::play_wake() {
 }
 
 void Viewer::pause() {
+  bool was_playing = playing;
+
   playing = false;
-  SetAudioWakeObject(nullptr);
+  playback_audio.SetWakeObject(nullptr);
   set_playpause_icon(true);
   playback_updater.stop();
   playback_speed = 0;
 
+  // side panels are only refreshed periodically during playback, bring everything up to date with where it stopped
+  if (was_playing && main_sequence && seq != nullptr) {
+    if (olive::CurrentConfig.seek_also_selects) {
+      panel_timeline->select_from_playhead();
+    }
+    update_parents(olive::CurrentConfig.seek_also_selects);
+  }
+
   if (is_recording_cued()) {
     uncue_recording();
 
@@ -864,12 +874,12 @@ void Viewer::timer_update() {
 
   seq->playhead = qMax(0, qRound(playhead_start + ((QDateTime::currentMSecsSinceEpoch()-start_msecs) * 0.001 * seq->frame_rate * playback_speed)));
 
-  if (olive::CurrentConfig.seek_also_selects) {
-    panel_timeline->select_from_playhead();
+  if (main_sequence) {
+    update_ui_playback();
+  } else {
+    update_parents(false);
   }
 
-  update_parents(olive::CurrentConfig.seek_also_selects);
-
   if (playing) {
     if (playback_speed < 0 && seq->playhead == 0) {
       pause();
@@ -0,0 +1,545 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "filmstrip.h"
+
+#include "global/config.h"
+#include "global/path.h"
+#include "project/previewcache.h"
+
+#include <QBuffer>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QtMath>
+#include <QFileInfo>
+#include <QDebug>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+// identifies a filmstrip pack file ("OFS1")
+const quint32 kPackMagic = 0x4F465331;
+
+// magic, thumbnail height and count
+const int kPackHeaderSize = 12;
+
+// offset and size of each thumbnail
+const int kPackEntrySize = 8;
+
+// finest and coarsest thumbnail interval (as powers of two in seconds)
+const int kMinLevel = 0;
+const int kMaxLevel = 10;
+
+const int kJpegQuality = 70;
+
+// memory used by decoded thumbnails
+const qint64 kFilmstripMemoryLimit = 64 * 1024 * 1024;
+
+// number of packs that can be mapped at once
+const int kMaxMappedPacks = 32;
+
+// requests beyond this are dropped, oldest first, as they're most likely no longer on screen
+const int kMaxQueuedRequests = 512;
+
+// FilmstripReady() is emitted at least this often while working through the queue
+const int kReadySignalInterval = 16;
+
+FilmstripGenerator::FilmstripGenerator() :
+  thumbnail_bytes_(0),
+  cancelled_(false)
+{
+}
+
+void FilmstripGenerator::run() {
+  int ready_count = 0;
+
+  mutex_.lock();
+
+  while (!cancelled_) {
+    if (queue_.isEmpty()) {
+      if (ready_count > 0) {
+        ready_count = 0;
+        mutex_.unlock();
+        emit FilmstripReady();
+        mutex_.lock();
+        continue;
+      }
+
+      wait_cond_.wait(&mutex_);
+      continue;
+    }
+
+    // the newest requests are the ones currently on screen, so they go first
+    Request r = queue_.takeLast();
+
+    mutex_.unlock();
+
+    QImage image;
+    Pack* pack = OpenPack(r);
+    if (pack != nullptr && r.index < pack->count) {
+      image = DecodeThumbnail(pack, r.index);
+    }
+
+    mutex_.lock();
+
+    QString key = RequestKey(r);
+    queued_.remove(key);
+    if (image.isNull()) {
+      failed_.insert(key);
+    } else {
+      CacheThumbnail(key, image);
+    }
+
+    ready_count++;
+    if (ready_count == kReadySignalInterval) {
+      ready_count = 0;
+      mutex_.unlock();
+      emit FilmstripReady();
+      mutex_.lock();
+    }
+  }
+
+  mutex_.unlock();
+
+  QHash<QString, Pack*>::iterator i;
+  for (i=packs_.begin();i!=packs_.end();i++) {
+    ClosePack(i.value());
+  }
+  packs_.clear();
+  pack_lru_.clear();
+}
+
+void FilmstripGenerator::cancel() {
+  mutex_.lock();
+  cancelled_ = true;
+  wait_cond_.wakeAll();
+  mutex_.unlock();
+
+  wait();
+}
+
+int FilmstripGenerator::LevelForScale(double pixels_per_second, int thumb_width) {
+  if (pixels_per_second <= 0.0) {
+    return kMaxLevel;
+  }
+
+  // smallest interval where thumbnails don't overlap
+  double ideal_interval = double(thumb_width) / pixels_per_second;
+
+  int level = kMinLevel;
+  while (level < kMaxLevel && LevelInterval(level) < ideal_interval) {
+    level++;
+  }
+  return level;
+}
+
+double FilmstripGenerator::LevelInterval(int level) {
+  return double(1 << level);
+}
+
+QImage FilmstripGenerator::GetThumbnail(const QString &url, int file_index, int level, int index, bool* pending) {
+  Request r;
+  r.url = url;
+  r.file_index = file_index;
+  r.level = level;
+  r.index = index;
+
+  QString key = RequestKey(r);
+
+  QMutexLocker locker(&mutex_);
+
+  QHash<QString, QImage>::const_iterator cached = thumbnails_.constFind(key);
+  if (cached != thumbnails_.constEnd()) {
+    lru_.removeOne(key);
+    lru_.append(key);
+
+    *pending = false;
+    return cached.value();
+  }
+
+  if (failed_.contains(key)) {
+    *pending = false;
+    return QImage();
+  }
+
+  *pending = true;
+
+  if (queued_.contains(key)) {
+    // move it to the back of the queue so it's processed sooner
+    for (int i=0;i<queue_.size();i++) {
+      if (RequestKey(queue_.at(i)) == key) {
+        queue_.removeAt(i);
+        break;
+      }
+    }
+  } else {
+    queued_.insert(key);
+  }
+
+  queue_.append(r);
+
+  while (queue_.size() > kMaxQueuedRequests) {
+    queued_.remove(RequestKey(queue_.first()));
+    queue_.removeFirst();
+  }
+
+  wait_cond_.wakeAll();
+
+  return QImage();
+}
+
+FilmstripGenerator::Pack *FilmstripGenerator::OpenPack(const Request &r) {
+  QString pack_key = PackKey(r);
+
+  Pack* pack = packs_.value(pack_key, nullptr);
+  if (pack != nullptr) {
+    pack_lru_.removeOne(pack_key);
+    pack_lru_.append(pack_key);
+    return pack;
+  }
+
+  if (failed_packs_.contains(pack_key)) {
+    return nullptr;
+  }
+
+  QString hash = hashes_.value(r.url);
+  if (hash.isEmpty()) {
+    hash = get_file_hash(r.url);
+    hashes_.insert(r.url, hash);
+  }
+
+  // the thumbnail height is part of the name so instances with different settings sharing the cache don't clash
+  QString filename = PreviewCache::Directory().filePath(QString("%1f%2_%3_%4").arg(hash,
+                                                                                    QString::number(r.file_index),
+                                                                                    QString::number(r.level),
+                                                                                    QString::number(olive::CurrentConfig.thumbnail_resolution)));
+
+  pack = MapPack(filename);
+
+  if (pack == nullptr) {
+    if (!GeneratePack(r, filename)) {
+      // don't try again for this session, unless it was cancelled partway
+      if (!cancelled_) {
+        failed_packs_.insert(pack_key);
+      }
+      return nullptr;
+    }
+
+    EnforceDiskLimit();
+
+    pack = MapPack(filename);
+
+    if (pack == nullptr) {
+      failed_packs_.insert(pack_key);
+      return nullptr;
+    }
+  }
+
+  packs_.insert(pack_key, pack);
+  pack_lru_.append(pack_key);
+
+  while (pack_lru_.size() > kMaxMappedPacks) {
+    ClosePack(packs_.take(pack_lru_.takeFirst()));
+  }
+
+  return pack;
+}
+
+FilmstripGenerator::Pack *FilmstripGenerator::MapPack(const QString &filename) {
+  QFile* file = new QFile(filename);
+
+  if (!file->open(QFile::ReadOnly)) {
+    delete file;
+    return nullptr;
+  }
+
+  Pack* pack = new Pack();
+  pack->file = file;
+  pack->size = file->size();
+  pack->data = file->map(0, pack->size);
+  pack->count = 0;
+
+  bool valid = (pack->data != nullptr && pack->size >= kPackHeaderSize);
+
+  if (valid) {
+    quint32 magic = qFromBigEndian<quint32>(pack->data);
+    quint32 height = qFromBigEndian<quint32>(pack->data + 4);
+    quint32 count = qFromBigEndian<quint32>(pack->data + 8);
+
+    valid = (magic == kPackMagic
+             && int(height) == olive::CurrentConfig.thumbnail_resolution
+             && count <= quint32(INT_MAX / kPackEntrySize)
+             && kPackHeaderSize + qint64(count) * kPackEntrySize <= pack->size);
+
+    pack->count = int(count);
+  }
+
+  if (!valid) {
+    // corrupt, this pack will be generated again
+    qWarning() << "Discarding corrupt filmstrip" << filename;
+    ClosePack(pack);
+    QFile::remove(filename);
+    return nullptr;
+  }
+
+  PreviewCache::Touch(filename);
+
+  return pack;
+}
+
+void FilmstripGenerator::ClosePack(Pack *pack) {
+  if (pack->data != nullptr) {
+    pack->file->unmap(const_cast<uchar*>(pack->data));
+  }
+  pack->file->close();
+  delete pack->file;
+  delete pack;
+}
+
+QImage FilmstripGenerator::DecodeThumbnail(Pack *pack, int index) {
+  const uchar* entry = pack->data + kPackHeaderSize + index * kPackEntrySize;
+
+  quint32 offset = qFromBigEndian<quint32>(entry);
+  quint32 size = qFromBigEndian<quint32>(entry + 4);
+
+  if (size == 0 || qint64(offset) + qint64(size) > pack->size) {
+    return QImage();
+  }
+
+  QImage image;
+  image.loadFromData(pack->data + offset, int(size), "JPG");
+  return image;
+}
+
+bool FilmstripGenerator::GeneratePack(const Request &r, const QString &filename) {
+  int thumb_height = olive::CurrentConfig.thumbnail_resolution;
+  if (thumb_height <= 0) {
+    return false;
+  }
+
+  AVFormatContext* fmt_ctx = nullptr;
+  if (avformat_open_input(&fmt_ctx, r.url.toUtf8(), nullptr, nullptr) < 0) {
+    qWarning() << "Failed to open" << r.url << "for filmstrip generation";
+    return false;
+  }
+
+  if (avformat_find_stream_info(fmt_ctx, nullptr) < 0
+      || r.file_index < 0
+      || r.file_index >= int(fmt_ctx->nb_streams)
+      || fmt_ctx->streams[r.file_index]->codecpar->codec_type != AVMEDIA_TYPE_VIDEO
+      || fmt_ctx->duration == AV_NOPTS_VALUE
+      || fmt_ctx->duration <= 0) {
+    // stills and streams without a known duration don't get filmstrips
+    avformat_close_input(&fmt_ctx);
+    return false;
+  }
+
+  AVStream* stream = fmt_ctx->streams[r.file_index];
+
+  AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+  if (codec == nullptr) {
+    avformat_close_input(&fmt_ctx);
+    return false;
+  }
+
+  AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
+  avcodec_parameters_to_context(codec_ctx, stream->codecpar);
+
+  // we only ever want the first frame after a seek, so frame threading would just add latency
+  codec_ctx->thread_count = 1;
+
+  // only decode keyframes, everything else is discarded before decoding
+  codec_ctx->skip_frame = AVDISCARD_NONKEY;
+
+  if (avcodec_open2(codec_ctx, codec, nullptr) < 0) {
+    avcodec_free_context(&codec_ctx);
+    avformat_close_input(&fmt_ctx);
+    return false;
+  }
+
+  double interval = LevelInterval(r.level);
+  double duration = double(fmt_ctx->duration) / double(AV_TIME_BASE);
+  int count = qMax(1, qCeil(duration / interval));
+
+  QVector<QByteArray> thumbnails;
+  thumbnails.reserve(count);
+
+  AVPacket* packet = av_packet_alloc();
+  AVFrame* frame = av_frame_alloc();
+  SwsContext* sws_ctx = nullptr;
+
+  int64_t last_pts = AV_NOPTS_VALUE;
+
+  for (int i=0;i<count && !cancelled_;i++) {
+    int64_t target = av_rescale_q(qRound64(i * interval * AV_TIME_BASE), AV_TIME_BASE_Q, stream->time_base);
+    if (stream->start_time != AV_NOPTS_VALUE) {
+      target += stream->start_time;
+    }
+
+    av_seek_frame(fmt_ctx, stream->index, target, AVSEEK_FLAG_BACKWARD);
+    avcodec_flush_buffers(codec_ctx);
+
+    bool got_frame = false;
+    while (!got_frame && av_read_frame(fmt_ctx, packet) >= 0) {
+      if (packet->stream_index == stream->index
+          && avcodec_send_packet(codec_ctx, packet) >= 0) {
+        got_frame = (avcodec_receive_frame(codec_ctx, frame) >= 0);
+      }
+      av_packet_unref(packet);
+    }
+
+    if (!got_frame) {
+      // end of file, drain whatever the decoder is still holding
+      avcodec_send_packet(codec_ctx, nullptr);
+      got_frame = (avcodec_receive_frame(codec_ctx, frame) >= 0);
+    }
+
+    if (!got_frame) {
+      // keep the table complete, an empty entry is treated as a missing thumbnail
+      thumbnails.append(thumbnails.isEmpty() ? QByteArray() : thumbnails.last());
+      continue;
+    }
+
+    if (frame->best_effort_timestamp == last_pts && !thumbnails.isEmpty()) {
+      // interval is shorter than the GOP, this is the same keyframe as last time
+      thumbnails.append(thumbnails.last());
+      av_frame_unref(frame);
+      continue;
+    }
+    last_pts = frame->best_effort_timestamp;
+
+    int thumb_width = qMax(1, qRound(thumb_height * (double(frame->width)/double(frame->height))));
+
+    sws_ctx = sws_getCachedContext(sws_ctx,
+                                   frame->width,
+                                   frame->height,
+                                   static_cast<AVPixelFormat>(frame->format),
+                                   thumb_width,
+                                   thumb_height,
+                                   AV_PIX_FMT_RGB24,
+                                   SWS_FAST_BILINEAR,
+                                   nullptr,
+                                   nullptr,
+                                   nullptr);
+
+    QImage image(thumb_width, thumb_height, QImage::Format_RGB888);
+    uint8_t* data = image.bits();
+    int linesize[AV_NUM_DATA_POINTERS];
+    linesize[0] = image.bytesPerLine();
+
+    sws_scale(sws_ctx, frame->data, frame->linesize, 0, frame->height, &data, linesize);
+
+    av_frame_unref(frame);
+
+    QByteArray jpeg;
+    QBuffer buffer(&jpeg);
+    buffer.open(QBuffer::WriteOnly);
+    image.save(&buffer, "JPG", kJpegQuality);
+
+    thumbnails.append(jpeg);
+  }
+
+  sws_freeContext(sws_ctx);
+  av_frame_free(&frame);
+  av_packet_free(&packet);
+  avcodec_free_context(&codec_ctx);
+  avformat_close_input(&fmt_ctx);
+
+  if (cancelled_) {
+    return false;
+  }
+
+  // build the pack in memory, thumbnails that are repeats of the previous one share its data
+  QByteArray pack_data;
+  pack_data.resize(kPackHeaderSize + count * kPackEntrySize);
+
+  uchar* header = reinterpret_cast<uchar*>(pack_data.data());
+  qToBigEndian<quint32>(kPackMagic, header);
+  qToBigEndian<quint32>(quint32(thumb_height), header + 4);
+  qToBigEndian<quint32>(quint32(count), header + 8);
+
+  quint32 last_offset = 0;
+  for (int i=0;i<count;i++) {
+    quint32 offset;
+    if (i > 0 && thumbnails.at(i).isSharedWith(thumbnails.at(i-1))) {
+      offset = last_offset;
+    } else {
+      offset = quint32(pack_data.size());
+      pack_data.append(thumbnails.at(i));
+    }
+    last_offset = offset;
+
+    uchar* entry = reinterpret_cast<uchar*>(pack_data.data()) + kPackHeaderSize + i * kPackEntrySize;
+    qToBigEndian<quint32>(offset, entry);
+    qToBigEndian<quint32>(quint32(thumbnails.at(i).size()), entry + 4);
+  }
+
+  // QSaveFile writes to a temporary file first so a partially written pack is never mapped, by this or any other
+  // instance sharing the preview cache
+  QSaveFile file(filename);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning() << "Failed to write filmstrip" << filename;
+    return false;
+  }
+  file.write(pack_data);
+
+  if (!file.commit()) {
+    qWarning() << "Failed to write filmstrip" << filename;
+    return false;
+  }
+
+  return true;
+}
+
+void FilmstripGenerator::EnforceDiskLimit() {
+  // mapped packs can't be removed
+  QStringList in_use;
+  QHash<QString, Pack*>::const_iterator i;
+  for (i=packs_.constBegin();i!=packs_.constEnd();i++) {
+    in_use.append(QFileInfo(i.value()->file->fileName()).absoluteFilePath());
+  }
+
+  PreviewCache::EnforceLimit(in_use);
+}
+
+void FilmstripGenerator::CacheThumbnail(const QString &key, const QImage &image) {
+  thumbnails_.insert(key, image);
+  lru_.append(key);
+  thumbnail_bytes_ += image.byteCount();
+
+  while (thumbnail_bytes_ > kFilmstripMemoryLimit && lru_.size() > 1) {
+    QImage removed = thumbnails_.take(lru_.takeFirst());
+    thumbnail_bytes_ -= removed.byteCount();
+  }
+}
+
+QString FilmstripGenerator::RequestKey(const Request &r) {
+  return QString("%1:%2").arg(PackKey(r), QString::number(r.index));
+}
+
+QString FilmstripGenerator::PackKey(const Request &r) {
+  return QString("%1:%2:%3").arg(r.url, QString::number(r.file_index), QString::number(r.level));
+}
+
+// filmstrip generator is a global entity like the proxy generator
+FilmstripGenerator olive::filmstrip_generator;
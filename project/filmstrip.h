@@ -0,0 +1,198 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FILMSTRIP_H
+#define FILMSTRIP_H
+
+#include <QThread>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <QSet>
+#include <QImage>
+#include <QFile>
+
+/**
+ * @brief Background generator and cache of filmstrip thumbnails
+ *
+ * PreviewGenerator only creates one poster frame per video stream. For the Timeline to show what's actually happening
+ * in a clip, FilmstripGenerator creates a row of thumbnails spaced at a fixed interval through the footage.
+ *
+ * Intervals are powers of two in seconds, called levels (level 0 is a thumbnail every second, level 1 every two
+ * seconds, etc.), so the Timeline can pick the level that matches its zoom and zooming in or out only ever needs a
+ * handful of different filmstrips. Only keyframes are decoded to create them, which keeps generation fast at the cost
+ * of thumbnails being a little off from their exact time in footage with long GOPs.
+ *
+ * Each level of each stream is stored as one pack file in the previews directory, containing a table of offsets
+ * followed by every thumbnail as a separate JPEG. Packs are memory mapped and thumbnails are decoded individually as
+ * they're needed, into a cache limited by kFilmstripMemoryLimit. Packs are part of the PreviewCache and count towards
+ * its size limit.
+ *
+ * All file access and decoding happens in this thread. GetThumbnail() only ever looks in memory, so it can be called
+ * while painting without blocking.
+ */
+class FilmstripGenerator : public QThread {
+  Q_OBJECT
+public:
+  FilmstripGenerator();
+
+  /**
+   * @brief Thread loop, processes thumbnail and pack requests until cancel() is called
+   */
+  void run();
+
+  /**
+   * @brief Stop the thread and wait for it to finish
+   */
+  void cancel();
+
+  /**
+   * @brief Get the level whose interval best matches a given thumbnail width on the Timeline
+   *
+   * @param pixels_per_second
+   *
+   * Width of one second of media on screen.
+   *
+   * @param thumb_width
+   *
+   * Width of one thumbnail on screen.
+   */
+  static int LevelForScale(double pixels_per_second, int thumb_width);
+
+  /**
+   * @brief Interval in seconds between thumbnails at a level
+   */
+  static double LevelInterval(int level);
+
+  /**
+   * @brief Get a thumbnail without blocking
+   *
+   * @param url
+   *
+   * Filename of the footage.
+   *
+   * @param file_index
+   *
+   * Index of the video stream in the file.
+   *
+   * @param level
+   *
+   * Interval level retrieved from LevelForScale().
+   *
+   * @param index
+   *
+   * Index of the thumbnail, i.e. the time in seconds divided by LevelInterval().
+   *
+   * @param pending
+   *
+   * Set to **TRUE** if the thumbnail isn't in memory yet but is being worked on, or **FALSE** if it's either returned
+   * or can't be created at all (e.g. the file can't be decoded).
+   *
+   * @return The decoded thumbnail, or a null image if it isn't available. Missing thumbnails are queued and
+   * FilmstripReady() is emitted once they (or any other queued thumbnails) are available.
+   */
+  QImage GetThumbnail(const QString& url, int file_index, int level, int index, bool* pending);
+
+signals:
+  /**
+   * @brief Emitted from the generator's thread whenever queued thumbnails become available
+   */
+  void FilmstripReady();
+
+private:
+  struct Request {
+    QString url;
+    int file_index;
+    int level;
+    int index;
+  };
+
+  struct Pack {
+    QFile* file;
+    const uchar* data;
+    qint64 size;
+    int count;
+  };
+
+  /**
+   * @brief Open the pack a request refers to, generating it first if necessary
+   *
+   * @return The pack, or nullptr if it couldn't be created (e.g. the stream isn't a video).
+   */
+  Pack* OpenPack(const Request& r);
+
+  /**
+   * @brief Map an existing pack file and check that it's valid for the current settings
+   *
+   * Invalid packs (e.g. made at a different thumbnail resolution) are deleted.
+   */
+  Pack* MapPack(const QString& filename);
+
+  void ClosePack(Pack* pack);
+
+  /**
+   * @brief Decode one thumbnail from a mapped pack
+   */
+  QImage DecodeThumbnail(Pack* pack, int index);
+
+  /**
+   * @brief Create a pack file by decoding the keyframes at each interval
+   */
+  bool GeneratePack(const Request& r, const QString& filename);
+
+  /**
+   * @brief Evict least recently used previews from the PreviewCache, except for packs that are currently mapped
+   */
+  void EnforceDiskLimit();
+
+  void CacheThumbnail(const QString& key, const QImage& image);
+
+  static QString RequestKey(const Request& r);
+  static QString PackKey(const Request& r);
+
+  QVector<Request> queue_;
+  QSet<QString> queued_;
+  QSet<QString> failed_;
+  QSet<QString> failed_packs_;
+
+  // decoded thumbnails, least recently used first in lru_
+  QHash<QString, QImage> thumbnails_;
+  QList<QString> lru_;
+  qint64 thumbnail_bytes_;
+
+  // mapped packs keyed by PackKey(), least recently used first in pack_lru_
+  QHash<QString, Pack*> packs_;
+  QList<QString> pack_lru_;
+
+  // get_file_hash() touches the disk, so it's cached here by URL
+  QHash<QString, QString> hashes_;
+
+  QWaitCondition wait_cond_;
+  QMutex mutex_;
+  bool cancelled_;
+};
+
+namespace olive {
+  // filmstrip generator is a global entity like the proxy generator
+  extern FilmstripGenerator filmstrip_generator;
+}
+
+#endif // FILMSTRIP_H
@@ -0,0 +1,279 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "previewcache.h"
+
+#include "global/config.h"
+#include "global/path.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QLockFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QMutex>
+#include <QVector>
+#include <QDebug>
+
+// identifies a preview pack file ("OPC1")
+const quint32 kPackMagic = 0x4F504331;
+const quint32 kPackVersion = 1;
+
+// sanity limit on the entry table so a corrupt count doesn't allocate a huge table
+const quint32 kMaxEntries = 4096;
+
+// how long to wait for another instance to finish writing a pack (in milliseconds)
+const int kLockTimeout = 10000;
+
+// files younger than this (in seconds) are never evicted, they may be another instance's file being written
+const int kMinEvictAge = 60;
+
+// QLockFile only locks between processes, threads of this process (e.g. several PreviewGenerators) use this
+QMutex cache_mutex;
+
+QDir PreviewCache::Directory() {
+  QDir dir(get_data_dir().filePath("previews"));
+  if (!dir.exists()) {
+    dir.mkpath(".");
+  }
+  return dir;
+}
+
+bool PreviewCache::Load(const QString &hash, QMap<QString, QByteArray>* entries) {
+  QString filename = PackPath(hash);
+
+  if (!QFileInfo::exists(filename)) {
+    return false;
+  }
+
+  if (!Read(filename, entries)) {
+    entries->clear();
+
+    QMutexLocker locker(&cache_mutex);
+
+    // check again under the lock, another instance may have just replaced the pack
+    QLockFile lock(filename + ".lock");
+    if (lock.tryLock(kLockTimeout)) {
+      QMap<QString, QByteArray> check;
+      if (!Read(filename, &check)) {
+        qWarning() << "Discarding corrupt preview pack" << filename;
+        QFile::remove(filename);
+      }
+    }
+
+    return false;
+  }
+
+  Touch(filename);
+
+  return true;
+}
+
+bool PreviewCache::Store(const QString &hash, const QMap<QString, QByteArray> &entries) {
+  QMutexLocker locker(&cache_mutex);
+
+  QString filename = PackPath(hash);
+
+  QLockFile lock(filename + ".lock");
+  if (!lock.tryLock(kLockTimeout)) {
+    qWarning() << "Timed out waiting for lock on preview pack" << filename;
+    return false;
+  }
+
+  // merge with whatever is already stored, a missing or corrupt pack just starts empty
+  QMap<QString, QByteArray> merged;
+  if (!Read(filename, &merged)) {
+    merged.clear();
+  }
+
+  QMap<QString, QByteArray>::const_iterator i;
+  for (i=entries.constBegin();i!=entries.constEnd();i++) {
+    QString name = i.key().section('@', 0, 0);
+
+    QMap<QString, QByteArray>::iterator j = merged.begin();
+    while (j != merged.end()) {
+      if (j.key().section('@', 0, 0) == name) {
+        j = merged.erase(j);
+      } else {
+        j++;
+      }
+    }
+
+    merged.insert(i.key(), i.value());
+  }
+
+  if (!Write(filename, merged)) {
+    qWarning() << "Failed to write preview pack" << filename;
+    return false;
+  }
+
+  return true;
+}
+
+void PreviewCache::Touch(const QString &filename) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+  // opened for appending since changing file times isn't allowed through a read-only handle on every platform
+  QFile file(filename);
+  if (file.open(QFile::Append)) {
+    file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+  }
+#else
+  // file times can't be set before Qt 5.10, files are evicted in the order they were written instead
+  Q_UNUSED(filename);
+#endif
+}
+
+void PreviewCache::EnforceLimit(const QStringList &in_use) {
+  QMutexLocker locker(&cache_mutex);
+
+  QDir dir = Directory();
+
+  // if another instance is already evicting, leave it to that one
+  QLockFile lock(dir.filePath("evict.lock"));
+  if (!lock.tryLock(0)) {
+    return;
+  }
+
+  qint64 limit = qint64(olive::CurrentConfig.preview_cache_limit) * 1024 * 1024;
+  QDateTime now = QDateTime::currentDateTime();
+
+  // newest first
+  QFileInfoList files = dir.entryInfoList(QDir::Files, QDir::Time);
+
+  qint64 total = 0;
+  for (int i=0;i<files.size();i++) {
+    const QFileInfo& info = files.at(i);
+
+    if (info.suffix() == "lock") {
+      continue;
+    }
+
+    total += info.size();
+
+    if (total > limit
+        && info.lastModified().secsTo(now) > kMinEvictAge
+        && !in_use.contains(info.absoluteFilePath())) {
+      // removing can fail if another instance has the file open on some platforms, it'll be tried again next time
+      if (QFile::remove(info.absoluteFilePath())) {
+        total -= info.size();
+      }
+    }
+  }
+}
+
+void PreviewCache::Clear() {
+  QMutexLocker locker(&cache_mutex);
+
+  QDir(get_data_dir().filePath("previews")).removeRecursively();
+}
+
+QString PreviewCache::PackPath(const QString &hash) {
+  return Directory().filePath(hash + ".pack");
+}
+
+bool PreviewCache::Read(const QString &filename, QMap<QString, QByteArray>* entries) {
+  QFile file(filename);
+  if (!file.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QByteArray data = file.readAll();
+  file.close();
+
+  QDataStream stream(data);
+  stream.setVersion(QDataStream::Qt_5_6);
+
+  quint32 magic, version, count;
+  stream >> magic >> version >> count;
+
+  if (stream.status() != QDataStream::Ok
+      || magic != kPackMagic
+      || version != kPackVersion
+      || count > kMaxEntries) {
+    return false;
+  }
+
+  QVector<QString> names(int(count));
+  QVector<quint32> offsets(int(count));
+  QVector<quint32> sizes(int(count));
+  QVector<QByteArray> checksums(int(count));
+
+  for (int i=0;i<int(count);i++) {
+    stream >> names[i] >> offsets[i] >> sizes[i] >> checksums[i];
+  }
+
+  if (stream.status() != QDataStream::Ok) {
+    return false;
+  }
+
+  // entry offsets are relative to the end of the table
+  qint64 data_start = stream.device()->pos();
+
+  for (int i=0;i<int(count);i++) {
+    qint64 start = data_start + offsets.at(i);
+
+    if (start + sizes.at(i) > data.size()) {
+      return false;
+    }
+
+    QByteArray payload = data.mid(int(start), int(sizes.at(i)));
+
+    if (QCryptographicHash::hash(payload, QCryptographicHash::Md5) != checksums.at(i)) {
+      return false;
+    }
+
+    entries->insert(names.at(i), payload);
+  }
+
+  return true;
+}
+
+bool PreviewCache::Write(const QString &filename, const QMap<QString, QByteArray> &entries) {
+  QByteArray table;
+  QByteArray payload;
+
+  QDataStream stream(&table, QIODevice::WriteOnly);
+  stream.setVersion(QDataStream::Qt_5_6);
+
+  stream << kPackMagic << kPackVersion << quint32(entries.size());
+
+  QMap<QString, QByteArray>::const_iterator i;
+  for (i=entries.constBegin();i!=entries.constEnd();i++) {
+    stream << i.key()
+           << quint32(payload.size())
+           << quint32(i.value().size())
+           << QCryptographicHash::hash(i.value(), QCryptographicHash::Md5);
+    payload.append(i.value());
+  }
+
+  // QSaveFile writes to a temporary file and renames it over the pack on commit(), so other instances never see a
+  // partially written pack
+  QSaveFile file(filename);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+
+  file.write(table);
+  file.write(payload);
+
+  return file.commit();
+}
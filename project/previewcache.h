@@ -0,0 +1,101 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PREVIEWCACHE_H
+#define PREVIEWCACHE_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QMap>
+#include <QDir>
+
+/**
+ * @brief Disk cache of footage previews (thumbnails, waveforms and filmstrips)
+ *
+ * Previews are stored in the previews directory keyed by get_file_hash(), which is derived from the file's contents
+ * rather than its name, so moved, renamed or copied footage finds its existing previews.
+ *
+ * All small previews of one footage item are stored together in one pack file, made of a table of named entries
+ * followed by their data. Each entry carries an MD5 checksum, and a pack that fails any check is discarded and
+ * regenerated rather than trusted.
+ *
+ * The directory may be shared by several instances of Olive at once (e.g. on a network drive used by a team):
+ *
+ * * Packs are only ever replaced whole through QSaveFile, so readers see either the old or the new pack and never a
+ *   partially written one.
+ * * Adding entries to an existing pack is a read-modify-write done under a QLockFile, so entries written by another
+ *   instance in the meantime aren't lost.
+ * * Only one instance at a time evicts files, others skip eviction while it's running.
+ *
+ * The total size of the directory is limited by Config::preview_cache_limit. Files are evicted least recently used
+ * first, using their modification time, which is updated whenever a file is read.
+ */
+class PreviewCache {
+public:
+  /**
+   * @brief The directory previews are stored in, created if it doesn't exist
+   */
+  static QDir Directory();
+
+  /**
+   * @brief Read every entry of a footage item's pack
+   *
+   * @return **FALSE** if there's no pack for this hash or it's corrupt (in which case it's deleted).
+   */
+  static bool Load(const QString& hash, QMap<QString, QByteArray>* entries);
+
+  /**
+   * @brief Add entries to a footage item's pack, creating it if necessary
+   *
+   * Entry names are in the format "name@variant", e.g. "t0@120" for the thumbnail of stream 0 at a height of 120. An
+   * entry replaces every existing entry with the same name regardless of its variant, so previews made with different
+   * settings don't pile up in the pack.
+   */
+  static bool Store(const QString& hash, const QMap<QString, QByteArray>& entries);
+
+  /**
+   * @brief Mark a file in the cache as recently used
+   */
+  static void Touch(const QString& filename);
+
+  /**
+   * @brief Delete least recently used files until the cache is under its size limit
+   *
+   * @param in_use
+   *
+   * Absolute paths of files that must not be deleted (e.g. because they're currently memory mapped).
+   */
+  static void EnforceLimit(const QStringList& in_use = QStringList());
+
+  /**
+   * @brief Delete every cached preview
+   */
+  static void Clear();
+
+private:
+  static QString PackPath(const QString& hash);
+
+  static bool Read(const QString& filename, QMap<QString, QByteArray>* entries);
+
+  static bool Write(const QString& filename, const QMap<QString, QByteArray>& entries);
+};
+
+#endif // PREVIEWCACHE_H
@@ -28,14 +28,15 @@
 #include "global/config.h"
 #include "global/path.h"
 #include "global/debug.h"
+#include "project/previewcache.h"
+#include "rendering/decoderpool.h"
 
 #include <QPainter>
 #include <QPixmap>
 #include <QtMath>
 #include <QTreeWidgetItem>
 #include <QSemaphore>
-#include <QFile>
-#include <QDir>
+#include <QBuffer>
 
 QSemaphore sem(5); // only 5 preview generators can run at one time
 
@@ -51,11 +52,6 @@ PreviewGenerator::PreviewGenerator(Media* i) :
 
   footage_->preview_gen = this;
 
-  data_dir_ = QDir(get_data_dir().filePath("previews"));
-  if (!data_dir_.exists()) {
-    data_dir_.mkpath(".");
-  }
-
   connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
 
   // set up throbber animation
@@ -147,36 +143,28 @@ bool PreviewGenerator::retrieve_preview(const QString& hash) {
     return true;
   }
 
-  bool found = true;
-  for (int i=0;i<footage_->video_tracks.size();i++) {
+  QMap<QString, QByteArray> entries;
+  bool found = PreviewCache::Load(hash, &entries);
+
+  for (int i=0;i<footage_->video_tracks.size() && found;i++) {
     FootageStream& ms = footage_->video_tracks[i];
-    QString thumb_path = get_thumbnail_path(hash, ms);
-    QFile f(thumb_path);
-    if (f.exists() && ms.video_preview.load(thumb_path)) {
+    QByteArray data = entries.value(get_thumbnail_entry(ms));
+    if (!data.isEmpty() && ms.video_preview.loadFromData(data, "PNG")) {
       ms.preview_done = true;
     } else {
       found = false;
-      break;
     }
   }
-  for (int i=0;i<footage_->audio_tracks.size();i++) {
+  for (int i=0;i<footage_->audio_tracks.size() && found;i++) {
     FootageStream& ms = footage_->audio_tracks[i];
-    QString waveform_path = get_waveform_path(hash, ms);
-    QFile f(waveform_path);
-    if (f.exists()) {
-      //dout << "loaded wave" << ms->file_index << "from" << waveform_path;
-      f.open(QFile::ReadOnly);
-      QByteArray data = f.readAll();
+    QString entry = get_waveform_entry(ms);
+    if (entries.contains(entry)) {
+      const QByteArray& data = entries[entry];
       ms.audio_preview.resize(data.size());
-      for (int j=0;j<data.size();j++) {
-        // faster way?
-        ms.audio_preview[j] = data.at(j);
-      }
+      memcpy(ms.audio_preview.data(), data.constData(), size_t(data.size()));
       ms.preview_done = true;
-      f.close();
     } else {
       found = false;
-      break;
     }
   }
   if (!found) {
@@ -525,12 +513,12 @@ void PreviewGenerator::generate_waveform() {
   delete [] codec_ctx;
 }
 
-QString PreviewGenerator::get_thumbnail_path(const QString& hash, const FootageStream& ms) {
-  return data_dir_.filePath(QString("%1t%2").arg(hash, QString::number(ms.file_index)));
+QString PreviewGenerator::get_thumbnail_entry(const FootageStream& ms) {
+  return QString("t%1@%2").arg(QString::number(ms.file_index), QString::number(olive::CurrentConfig.thumbnail_resolution));
 }
 
-QString PreviewGenerator::get_waveform_path(const QString& hash, const FootageStream& ms) {
-  return data_dir_.filePath(QString("%1w%2").arg(hash, QString::number(ms.file_index)));
+QString PreviewGenerator::get_waveform_entry(const FootageStream& ms) {
+  return QString("w%1@%2").arg(QString::number(ms.file_index), QString::number(olive::CurrentConfig.waveform_resolution));
 }
 
 void PreviewGenerator::run() {
@@ -566,6 +554,9 @@ void PreviewGenerator::run() {
       errorStr = tr("Could not find stream information - %1").arg(err);
       error = true;
     } else {
+      // clips of this footage can skip probing when they're opened
+      olive::decoder_pool.StoreProbe(url, fmt_ctx_);
+
       av_dump_format(fmt_ctx_, 0, filename, 0);
       parse_media();
 
@@ -579,20 +570,24 @@ void PreviewGenerator::run() {
           generate_waveform();
 
           if (!cancelled_) {
-            // save preview to file
+            // save previews to this footage's pack in the preview cache
+            QMap<QString, QByteArray> entries;
+
             for (int i=0;i<footage_->video_tracks.size();i++) {
               FootageStream& ms = footage_->video_tracks[i];
-              ms.video_preview.save(get_thumbnail_path(hash, ms), "PNG");
-              //dout << "saved" << ms->file_index << "thumbnail to" << get_thumbnail_path(hash, ms);
+              QByteArray png;
+              QBuffer buffer(&png);
+              buffer.open(QBuffer::WriteOnly);
+              ms.video_preview.save(&buffer, "PNG");
+              entries.insert(get_thumbnail_entry(ms), png);
             }
             for (int i=0;i<footage_->audio_tracks.size();i++) {
               FootageStream& ms = footage_->audio_tracks[i];
-              QFile f(get_waveform_path(hash, ms));
-              f.open(QFile::WriteOnly);
-              f.write(ms.audio_preview.constData(), ms.audio_preview.size());
-              f.close();
-              //dout << "saved" << ms->file_index << "waveform to" << get_waveform_path(hash, ms);
+              entries.insert(get_waveform_entry(ms), QByteArray(ms.audio_preview.constData(), ms.audio_preview.size()));
             }
+
+            PreviewCache::Store(hash, entries);
+            PreviewCache::EnforceLimit();
           }
         }
 
@@ -23,7 +23,6 @@
 
 #include <QThread>
 #include <QSemaphore>
-#include <QDir>
 
 #include "project/footage.h"
 #include "project/media.h"
@@ -50,8 +49,8 @@ private:
   void generate_waveform();
   void finalize_media();
   void invalidate_media(const QString& error_msg);
-  QString get_thumbnail_path(const QString &hash, const FootageStream &ms);
-  QString get_waveform_path(const QString& hash, const FootageStream &ms);
+  QString get_thumbnail_entry(const FootageStream &ms);
+  QString get_waveform_entry(const FootageStream &ms);
 
   AVFormatContext* fmt_ctx_;
   Media* media_;
@@ -59,7 +58,6 @@ private:
   bool retrieve_duration_;
   bool contains_still_image_;
   bool cancelled_;
-  QDir data_dir_;
 };
 
 #endif // PREVIEWGENERATOR_H
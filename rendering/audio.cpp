@@ -30,6 +30,7 @@
 #include "ui/audiomonitor.h"
 #include "rendering/renderfunctions.h"
 #include "global/debug.h"
+#include "global/trace.h"
 
 #include <QApplication>
 #include <QAudioOutput>
@@ -47,18 +48,11 @@ QAudioOutput* audio_output;
 QIODevice* audio_io_device;
 bool audio_device_set = false;
 bool audio_scrub = false;
-QMutex audio_write_lock;
 QAudioInput* audio_input = nullptr;
 QFile output_recording;
 bool recording = false;
 
-bool audio_rendering = false;
-int audio_rendering_rate = 0;
-
-qint8 audio_ibuffer[audio_ibuffer_size];
-qint64 audio_ibuffer_read = 0;
-long audio_ibuffer_frame = 0;
-double audio_ibuffer_timecode = 0;
+AudioMixBuffer playback_audio;
 
 AudioSenderThread* audio_thread = nullptr;
 
@@ -146,27 +140,122 @@ void stop_audio() {
 
 void clear_audio_ibuffer() {
   if (audio_thread != nullptr) audio_thread->lock.lock();
-  audio_write_lock.lock();
-  memset(audio_ibuffer, 0, audio_ibuffer_size);
-  audio_ibuffer_read = 0;
-  audio_write_lock.unlock();
+  playback_audio.Clear();
   if (audio_thread != nullptr) audio_thread->lock.unlock();
 }
 
 int current_audio_freq() {
-  return audio_rendering ? audio_rendering_rate : audio_output->format().sampleRate();
+  return playback_audio.SampleRate();
+}
+
+AudioMixBuffer::AudioMixBuffer(int buffer_size) :
+  size(buffer_size),
+  read(0),
+  mixed(0),
+  frame(0),
+  timecode(0),
+  sample_rate_(0),
+  wake_object_(nullptr)
+{
+  data = new qint8[size];
+  memset(data, 0, size);
+}
+
+AudioMixBuffer::~AudioMixBuffer()
+{
+  delete [] data;
+}
+
+int AudioMixBuffer::SampleRate()
+{
+  if (sample_rate_ > 0) {
+    return sample_rate_;
+  }
+  return audio_output->format().sampleRate();
+}
+
+void AudioMixBuffer::SetSampleRate(int rate)
+{
+  sample_rate_ = rate;
 }
 
-qint64 get_buffer_offset_from_frame(double framerate, long frame) {
-  if (frame >= audio_ibuffer_frame) {
+qint64 AudioMixBuffer::OffsetFromFrame(double framerate, long f)
+{
+  if (f >= frame) {
     int multiplier = av_get_bytes_per_sample(AV_SAMPLE_FMT_S16)*av_get_channel_layout_nb_channels(AV_CH_LAYOUT_STEREO);
-    return qFloor((double(frame - audio_ibuffer_frame)/framerate)*current_audio_freq())*multiplier;
+    return qFloor((double(f - frame)/framerate)*SampleRate())*multiplier;
   } else {
-    qWarning() << "Invalid values passed to get_buffer_offset_from_frame" << frame << "<" << audio_ibuffer_frame;
+    qWarning() << "Invalid values passed to AudioMixBuffer::OffsetFromFrame" << f << "<" << frame;
     return 0;
   }
 }
 
+int AudioMixBuffer::BufferedMilliseconds()
+{
+  lock.lock();
+  qint64 buffered = qMax(qint64(0), mixed - read);
+  lock.unlock();
+
+  int multiplier = av_get_bytes_per_sample(AV_SAMPLE_FMT_S16)*av_get_channel_layout_nb_channels(AV_CH_LAYOUT_STEREO);
+  return int(buffered * 1000 / (qint64(SampleRate()) * multiplier));
+}
+
+void AudioMixBuffer::Reset(long f, double framerate)
+{
+  frame = f;
+  timecode = double(f) / framerate;
+  Clear();
+}
+
+void AudioMixBuffer::Clear()
+{
+  lock.lock();
+  memset(data, 0, size);
+  read = 0;
+  mixed = 0;
+  lock.unlock();
+}
+
+void AudioMixBuffer::Pull(qint8 *dest, int len)
+{
+  lock.lock();
+
+  int adjusted_read = read%size;
+  int copylen = qMin(len, size-adjusted_read);
+  memcpy(dest, data+adjusted_read, copylen);
+  memset(data+adjusted_read, 0, copylen);
+
+  // if we reached the end of the buffer, continue from the start
+  if (copylen < len) {
+    memcpy(dest+copylen, data, len-copylen);
+    memset(data, 0, len-copylen);
+  }
+
+  read += len;
+
+  lock.unlock();
+}
+
+void AudioMixBuffer::SetWakeObject(QObject *o)
+{
+  wake_mutex_.lock();
+  wake_object_ = o;
+  wake_mutex_.unlock();
+}
+
+void AudioMixBuffer::Wake()
+{
+  // the wake object is only woken once, whoever set it sets it again when it wants to be woken again
+  wake_mutex_.lock();
+  QObject* wake_object = wake_object_;
+  wake_object_ = nullptr;
+  wake_mutex_.unlock();
+
+  if (wake_object != nullptr) {
+    QMetaObject::invokeMethod(wake_object, "play_wake", Qt::QueuedConnection);
+  }
+}
+
 AudioSenderThread::AudioSenderThread() : close(false) {
   connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
 }
@@ -183,7 +272,7 @@ void AudioSenderThread::notifyReceiver() {
 
 void AudioSenderThread::run() {
   // start data loop
-  send_audio_to_output(0, audio_ibuffer_size);
+  send_audio_to_output(0, playback_audio.size);
 
   lock.lock();
   while (true) {
@@ -193,13 +282,13 @@ void AudioSenderThread::run() {
     } else if (panel_sequence_viewer->playing || panel_footage_viewer->playing || audio_scrub) {
       int written_bytes = 0;
 
-      int adjusted_read_index = audio_ibuffer_read%audio_ibuffer_size;
-      int max_write = audio_ibuffer_size - adjusted_read_index;
+      int adjusted_read_index = playback_audio.read%playback_audio.size;
+      int max_write = playback_audio.size - adjusted_read_index;
       int actual_write = send_audio_to_output(adjusted_read_index, max_write);
       written_bytes += actual_write;
       if (actual_write == max_write) {
         // got all the bytes, write again
-        written_bytes += send_audio_to_output(0, audio_ibuffer_size);
+        written_bytes += send_audio_to_output(0, playback_audio.size);
       }
 
       audio_scrub = false;
@@ -209,10 +298,12 @@ void AudioSenderThread::run() {
 }
 
 int AudioSenderThread::send_audio_to_output(qint64 offset, int max) {
+  TraceScope trace("audio", "output");
+
   // send audio to device
-  qint64 actual_write = audio_io_device->write(reinterpret_cast<const char*>(audio_ibuffer)+offset, max);
+  qint64 actual_write = audio_io_device->write(reinterpret_cast<const char*>(playback_audio.data)+offset, max);
 
-  qint64 audio_ibuffer_limit = audio_ibuffer_read + actual_write;
+  qint64 audio_ibuffer_limit = playback_audio.read + actual_write;
 
   if (actual_write > 0) {
     // average values and send to audio monitor
@@ -225,7 +316,7 @@ int AudioSenderThread::send_audio_to_output(qint64 offset, int max) {
     int counter = 0;
     qint16 sample;
     for (qint64 i=offset;i<lim;i+=2) {
-      sample = qint16(((audio_ibuffer[i+1] & 0xFF) << 8) | (audio_ibuffer[i] & 0xFF));
+      sample = qint16(((playback_audio.data[i+1] & 0xFF) << 8) | (playback_audio.data[i] & 0xFF));
       averages[counter] = qMax((double(qAbs(sample))/32768.0), averages[counter]);
       counter = (counter+1)%channels;
     }
@@ -236,9 +327,9 @@ int AudioSenderThread::send_audio_to_output(qint64 offset, int max) {
     panel_timeline->audio_monitor->set_value(averages);
   }
 
-  memset(audio_ibuffer+offset, 0, actual_write);
+  memset(playback_audio.data+offset, 0, actual_write);
 
-  audio_ibuffer_read = audio_ibuffer_limit;
+  playback_audio.read = audio_ibuffer_limit;
 
   return actual_write;
 }
@@ -401,33 +492,3 @@ void combobox_audio_sample_rates(QComboBox *combobox) {
   combobox->addItem("88200 Hz", 88200);
   combobox->addItem("96000 Hz", 96000);
 }
-
-QObject* audio_wake_object = nullptr;
-QMutex audio_wake_mutex;
-
-QObject* GetAudioWakeObject()
-{
-  audio_wake_mutex.lock();
-
-  QObject* wake_object = audio_wake_object;
-  audio_wake_object = nullptr;
-
-  audio_wake_mutex.unlock();
-
-  return wake_object;
-}
-
-void SetAudioWakeObject(QObject *o)
-{
-  audio_wake_mutex.lock();
-  audio_wake_object = o;
-  audio_wake_mutex.unlock();
-}
-
-void WakeAudioWakeObject() {  
-  QObject* audio_wake_object = GetAudioWakeObject();
-
-  if (audio_wake_object != nullptr) {
-    QMetaObject::invokeMethod(audio_wake_object, "play_wake", Qt::QueuedConnection);
-  }
-}
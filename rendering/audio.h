@@ -49,33 +49,131 @@ private:
 
 double log_volume(double linear);
 
+#define audio_ibuffer_size 192000
+
+/**
+ * @brief Ring buffer that clip audio is mixed into
+ *
+ * Each audio clip's Cacher mixes its samples into the buffer at a byte offset calculated from the sequence frame the
+ * buffer starts at (see OffsetFromFrame()), while a consumer drains it from `read`. The live playback buffer
+ * (playback_audio) is drained by AudioSenderThread. Offline rendering mixes into a private buffer instead, so an
+ * export never touches playback.
+ *
+ * Samples are always interleaved signed 16-bit stereo.
+ */
+class AudioMixBuffer {
+public:
+  AudioMixBuffer(int buffer_size = audio_ibuffer_size);
+  ~AudioMixBuffer();
+
+  /**
+   * @brief Raw sample data, `size` bytes long
+   */
+  qint8* data;
+
+  /**
+   * @brief Size of the buffer in bytes
+   */
+  int size;
+
+  /**
+   * @brief Total amount of bytes consumed so far (not wrapped to the buffer size)
+   */
+  qint64 read;
+
+  /**
+   * @brief Furthest byte any clip has mixed up to so far (not wrapped to the buffer size)
+   */
+  qint64 mixed;
+
+  /**
+   * @brief Sequence frame that byte 0 of the mix corresponds to
+   */
+  long frame;
+
+  /**
+   * @brief `frame` in seconds
+   */
+  double timecode;
+
+  /**
+   * @brief Held while mixing samples into or reading samples from the buffer
+   */
+  QMutex lock;
+
+  /**
+   * @brief Sample rate of this mix
+   *
+   * Follows the audio output device unless a rate was set with SetSampleRate().
+   */
+  int SampleRate();
+
+  /**
+   * @brief Override the sample rate of this mix (e.g. to the rate of an export), or 0 to follow the output device
+   */
+  void SetSampleRate(int rate);
+
+  /**
+   * @brief Get the byte offset of a sequence frame relative to the start of the mix
+   */
+  qint64 OffsetFromFrame(double framerate, long f);
+
+  /**
+   * @brief Get how much mixed audio is waiting to be consumed, in milliseconds
+   */
+  int BufferedMilliseconds();
+
+  /**
+   * @brief Clear the buffer and restart the mix at a given sequence frame
+   */
+  void Reset(long f, double framerate);
+
+  /**
+   * @brief Silence the buffer and rewind the read position
+   */
+  void Clear();
+
+  /**
+   * @brief Copy `len` bytes out of the buffer from the current read position
+   *
+   * The bytes are silenced in the buffer so they can be mixed into again once the buffer wraps around.
+   */
+  void Pull(qint8* dest, int len);
+
+  /**
+   * @brief Set an object whose `play_wake()` slot is invoked the next time a clip finishes mixing into this buffer
+   *
+   * The object is only woken once and then cleared.
+   */
+  void SetWakeObject(QObject* o);
+
+  /**
+   * @brief Invoke the wake object set with SetWakeObject() (if any)
+   */
+  void Wake();
+
+private:
+  int sample_rate_;
+
+  QMutex wake_mutex_;
+  QObject* wake_object_;
+};
+
 extern QAudioOutput* audio_output;
 extern QIODevice* audio_io_device;
 extern AudioSenderThread* audio_thread;
-extern QMutex audio_write_lock;
 
-#define audio_ibuffer_size 192000
-extern qint8 audio_ibuffer[audio_ibuffer_size];
-extern qint64 audio_ibuffer_read;
-extern long audio_ibuffer_frame;
-extern double audio_ibuffer_timecode;
+extern AudioMixBuffer playback_audio;
 extern bool audio_scrub;
 extern bool recording;
-extern bool audio_rendering;
-extern int audio_rendering_rate;
 void clear_audio_ibuffer();
 
-QObject *GetAudioWakeObject();
-void SetAudioWakeObject(QObject* o);
-void WakeAudioWakeObject();
-
 int current_audio_freq();
 
 bool is_audio_device_set();
 
 void init_audio();
 void stop_audio();
-qint64 get_buffer_offset_from_frame(double framerate, long frame);
 
 bool start_recording();
 void stop_recording();
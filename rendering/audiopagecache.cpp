@@ -0,0 +1,683 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audiopagecache.h"
+
+#include <QDir>
+#include <QMutexLocker>
+#include <QtMath>
+#include <QDebug>
+#include <limits>
+
+#include "rendering/decoderpool.h"
+
+AudioPageCache olive::audio_page_cache;
+
+// maximum memory used by pages that aren't memory-mapped
+const qint64 kMaxMemory = 256 * 1024 * 1024;
+
+// streams at least this long (in seconds) are decoded into a memory-mapped temporary file
+const qint64 kMapThreshold = 300;
+
+// amount of pages (i.e. seconds) decoded ahead of a request in the direction it's playing
+const int kLookAheadPages = 8;
+
+AudioPageCache::AudioPageCache() :
+  cancelled_(false),
+  reset_decoder_(false),
+  memory_usage_(0),
+  clock_(0)
+{
+  decoder_.fmt_ctx = nullptr;
+  decoder_.codec_ctx = nullptr;
+  decoder_.swr_ctx = nullptr;
+  decoder_.stream = nullptr;
+  decoder_.pkt = nullptr;
+  decoder_.frame = nullptr;
+  decoder_.position = -1;
+  decoder_.leftover_position = 0;
+}
+
+AudioPageCache::~AudioPageCache()
+{
+  CloseDecoder();
+
+  QMap<QString, Stream*>::iterator i;
+  for (i=streams_.begin();i!=streams_.end();i++) {
+    FreeStream(i.value());
+  }
+}
+
+void AudioPageCache::run()
+{
+  QVector<float> page_data;
+
+  mutex_.lock();
+
+  while (!cancelled_) {
+    if (reset_decoder_) {
+      reset_decoder_ = false;
+
+      mutex_.unlock();
+      CloseDecoder();
+      mutex_.lock();
+
+      continue;
+    }
+
+    if (requests_.isEmpty()) {
+      wait_cond_.wait(&mutex_);
+      continue;
+    }
+
+    // newest requests are the most relevant
+    Request r = requests_.takeLast();
+
+    Stream* s = streams_.value(r.key, nullptr);
+    qint64 page = (s == nullptr || s->failed) ? -1 : NextMissingPage(s, r);
+    if (page < 0) {
+      continue;
+    }
+
+    QString filename = s->filename;
+    int stream_index = s->stream_index;
+    int sample_rate = s->sample_rate;
+
+    mutex_.unlock();
+
+    bool eof;
+    bool ok = DecodePage(r.key, filename, stream_index, sample_rate, page, page_data, &eof);
+
+    mutex_.lock();
+
+    // the stream may have been freed by Clear() in the meantime
+    s = streams_.value(r.key, nullptr);
+    if (s == nullptr) {
+      continue;
+    }
+
+    if (!ok) {
+      qWarning() << "Could not decode audio of" << filename << "for scrubbing";
+      s->failed = true;
+      continue;
+    }
+
+    CommitPage(s, page, page_data);
+
+    if (eof) {
+      s->length = (decoder_.position >= 0) ? decoder_.position : (page + 1) * sample_rate;
+    }
+
+    // keep working through this request after any newer ones, unless it's been replaced
+    bool replaced = false;
+    for (int i=0;i<requests_.size();i++) {
+      if (requests_.at(i).key == r.key) {
+        replaced = true;
+        break;
+      }
+    }
+    if (!replaced) {
+      requests_.prepend(r);
+    }
+  }
+
+  mutex_.unlock();
+
+  CloseDecoder();
+}
+
+void AudioPageCache::cancel()
+{
+  mutex_.lock();
+  cancelled_ = true;
+  wait_cond_.wakeAll();
+  mutex_.unlock();
+
+  wait();
+}
+
+int AudioPageCache::Read(const QString &filename,
+                         int stream_index,
+                         int sample_rate,
+                         double position,
+                         double step,
+                         float *dest,
+                         int frames)
+{
+  QString key = StreamKey(filename, stream_index, sample_rate);
+
+  QMutexLocker locker(&mutex_);
+
+  Stream* s = streams_.value(key, nullptr);
+  if (s == nullptr) {
+    s = new Stream();
+    s->filename = filename;
+    s->stream_index = stream_index;
+    s->sample_rate = sample_rate;
+    s->length = -1;
+    s->file = nullptr;
+    s->map = nullptr;
+    s->map_pages = 0;
+    s->failed = false;
+    streams_.insert(key, s);
+  }
+
+  if (s->failed) {
+    return 0;
+  }
+
+  int direction = (step < 0) ? -1 : 1;
+
+  clock_++;
+
+  int rendered = 0;
+  qint64 missing_page = -1;
+
+  for (int i=0;i<frames;i++) {
+    double p = position + i*step;
+    qint64 index = qFloor(p);
+    float t = float(p - index);
+
+    // the two samples to interpolate between, samples outside of the stream are silent
+    float samples[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    for (int j=0;j<2;j++) {
+      qint64 sample = index + j;
+
+      if (sample < 0 || (s->length >= 0 && sample >= s->length)) {
+        continue;
+      }
+
+      const float* page = PageOf(s, sample);
+      if (page == nullptr) {
+        missing_page = sample / sample_rate;
+        break;
+      }
+
+      int offset = int(sample % sample_rate) * 2;
+      samples[j*2] = page[offset];
+      samples[j*2+1] = page[offset+1];
+    }
+
+    if (missing_page >= 0) {
+      break;
+    }
+
+    dest[i*2] = samples[0] + (samples[2] - samples[0]) * t;
+    dest[i*2+1] = samples[1] + (samples[3] - samples[1]) * t;
+
+    rendered++;
+  }
+
+  if (missing_page >= 0) {
+    RequestPage(key, missing_page, direction);
+  } else {
+    // keep decoding ahead of wherever reading has got to
+    qint64 end = qMax(qint64(0), qint64(qFloor(position + frames*step)));
+    RequestPage(key, end / sample_rate, direction);
+  }
+
+  return rendered;
+}
+
+void AudioPageCache::Clear()
+{
+  QMutexLocker locker(&mutex_);
+
+  QMap<QString, Stream*>::iterator i;
+  for (i=streams_.begin();i!=streams_.end();i++) {
+    FreeStream(i.value());
+  }
+  streams_.clear();
+  requests_.clear();
+
+  memory_usage_ = 0;
+
+  // the thread closes its decoder the next time it wakes up
+  reset_decoder_ = true;
+  wait_cond_.wakeAll();
+}
+
+qint64 AudioPageCache::memory_usage()
+{
+  QMutexLocker locker(&mutex_);
+  return memory_usage_;
+}
+
+QString AudioPageCache::StreamKey(const QString &filename, int stream_index, int sample_rate)
+{
+  return QString("%1:%2:%3").arg(QString::number(stream_index), QString::number(sample_rate), filename);
+}
+
+const float *AudioPageCache::PageOf(Stream *s, qint64 sample)
+{
+  qint64 page = sample / s->sample_rate;
+
+  if (page >= s->pages.size() || s->pages.at(int(page)) == nullptr) {
+    return nullptr;
+  }
+
+  s->last_used[int(page)] = clock_;
+
+  return s->pages.at(int(page));
+}
+
+void AudioPageCache::RequestPage(const QString &key, qint64 page, int direction)
+{
+  Request r;
+  r.key = key;
+  r.page = page;
+  r.direction = direction;
+
+  // don't wake the thread if there's nothing to do
+  Stream* s = streams_.value(key, nullptr);
+  if (s == nullptr || s->failed || NextMissingPage(s, r) < 0) {
+    return;
+  }
+
+  for (int i=0;i<requests_.size();i++) {
+    if (requests_.at(i).key == key) {
+      requests_.removeAt(i);
+      i--;
+    }
+  }
+
+  requests_.append(r);
+
+  wait_cond_.wakeAll();
+}
+
+qint64 AudioPageCache::NextMissingPage(Stream *s, const AudioPageCache::Request &r)
+{
+  // the requested page first, then the ones after it in the direction of playback, then the one before it so
+  // scrubbing back and forth over the same spot stays smooth
+  for (int i=0;i<=kLookAheadPages+1;i++) {
+    qint64 page = (i <= kLookAheadPages) ? r.page + i*r.direction : r.page - r.direction;
+
+    if (page < 0 || (s->length >= 0 && page * s->sample_rate >= s->length)) {
+      continue;
+    }
+
+    if (page >= s->pages.size() || s->pages.at(int(page)) == nullptr) {
+      return page;
+    }
+  }
+
+  return -1;
+}
+
+bool AudioPageCache::DecodePage(const QString &key,
+                                const QString &filename,
+                                int stream_index,
+                                int sample_rate,
+                                qint64 page,
+                                QVector<float> &out,
+                                bool *eof)
+{
+  *eof = false;
+
+  qint64 page_start = page * sample_rate;
+  qint64 page_end = page_start + sample_rate;
+
+  out.fill(0.0f, sample_rate * 2);
+
+  if (decoder_.key != key) {
+    CloseDecoder();
+
+    if (!OpenDecoder(key, filename, stream_index, sample_rate)) {
+      CloseDecoder();
+      return false;
+    }
+  }
+
+  int64_t start_time = qMax(static_cast<int64_t>(0), decoder_.stream->start_time);
+
+  // if the decoder stopped right where this page starts we can just keep reading, otherwise we have to seek
+  bool contiguous = decoder_.position >= 0
+      && (decoder_.leftover.isEmpty() ? decoder_.position == page_start : decoder_.leftover_position == page_start);
+
+  if (!contiguous) {
+    int64_t timestamp = start_time + qRound64(double(page_start) / sample_rate / av_q2d(decoder_.stream->time_base));
+
+    av_seek_frame(decoder_.fmt_ctx, stream_index, timestamp, AVSEEK_FLAG_BACKWARD);
+    avcodec_flush_buffers(decoder_.codec_ctx);
+    swr_init(decoder_.swr_ctx);
+
+    decoder_.position = -1;
+    decoder_.leftover.clear();
+  }
+
+  qint64 filled = page_start;
+
+  // samples decoded past the end of the last page go first
+  if (!decoder_.leftover.isEmpty()) {
+    QVector<float> leftover = decoder_.leftover;
+    decoder_.leftover.clear();
+
+    filled = qMax(filled,
+                  WriteSamples(leftover.constData(), decoder_.leftover_position, leftover.size() / 2,
+                               page_start, sample_rate, out));
+  }
+
+  AVFrame* converted = av_frame_alloc();
+
+  while (filled < page_end) {
+    if (av_read_frame(decoder_.fmt_ctx, decoder_.pkt) < 0) {
+      *eof = true;
+      break;
+    }
+
+    if (decoder_.pkt->stream_index != stream_index) {
+      av_packet_unref(decoder_.pkt);
+      continue;
+    }
+
+    int ret = avcodec_send_packet(decoder_.codec_ctx, decoder_.pkt);
+    av_packet_unref(decoder_.pkt);
+    if (ret < 0) {
+      // skip corrupt packets
+      continue;
+    }
+
+    while (avcodec_receive_frame(decoder_.codec_ctx, decoder_.frame) >= 0) {
+      if (decoder_.position < 0) {
+        // we just seeked, so work out where we are from the frame's timestamp
+        int64_t pts = decoder_.frame->best_effort_timestamp;
+        if (pts == AV_NOPTS_VALUE) {
+          pts = start_time;
+        }
+        decoder_.position = qRound64((pts - start_time) * av_q2d(decoder_.stream->time_base) * sample_rate);
+      }
+
+      if (decoder_.frame->channel_layout == 0) {
+        decoder_.frame->channel_layout = decoder_.codec_ctx->channel_layout;
+      }
+
+      converted->channel_layout = AV_CH_LAYOUT_STEREO;
+      converted->sample_rate = sample_rate;
+      converted->format = AV_SAMPLE_FMT_FLT;
+
+      if (swr_convert_frame(decoder_.swr_ctx, converted, decoder_.frame) >= 0 && converted->nb_samples > 0) {
+        filled = qMax(filled,
+                      WriteSamples(reinterpret_cast<float*>(converted->data[0]), decoder_.position,
+                                   converted->nb_samples, page_start, sample_rate, out));
+        decoder_.position += converted->nb_samples;
+      }
+
+      av_frame_unref(converted);
+      av_frame_unref(decoder_.frame);
+    }
+  }
+
+  av_frame_free(&converted);
+
+  return true;
+}
+
+bool AudioPageCache::OpenDecoder(const QString &key, const QString &filename, int stream_index, int sample_rate)
+{
+  QByteArray ba = filename.toUtf8();
+
+  if (avformat_open_input(&decoder_.fmt_ctx, ba.constData(), nullptr, nullptr) != 0) {
+    return false;
+  }
+
+  if (!olive::decoder_pool.ApplyProbe(filename, decoder_.fmt_ctx)) {
+    if (avformat_find_stream_info(decoder_.fmt_ctx, nullptr) < 0) {
+      return false;
+    }
+    olive::decoder_pool.StoreProbe(filename, decoder_.fmt_ctx);
+  }
+
+  if (stream_index < 0
+      || stream_index >= int(decoder_.fmt_ctx->nb_streams)
+      || decoder_.fmt_ctx->streams[stream_index]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+    return false;
+  }
+
+  decoder_.stream = decoder_.fmt_ctx->streams[stream_index];
+
+  AVCodec* codec = avcodec_find_decoder(decoder_.stream->codecpar->codec_id);
+  if (codec == nullptr) {
+    return false;
+  }
+
+  decoder_.codec_ctx = avcodec_alloc_context3(codec);
+  avcodec_parameters_to_context(decoder_.codec_ctx, decoder_.stream->codecpar);
+  if (avcodec_open2(decoder_.codec_ctx, codec, nullptr) < 0) {
+    return false;
+  }
+
+  if (decoder_.codec_ctx->channel_layout == 0) {
+    decoder_.codec_ctx->channel_layout = av_get_default_channel_layout(decoder_.codec_ctx->channels);
+  }
+
+  decoder_.swr_ctx = swr_alloc_set_opts(nullptr,
+                                        AV_CH_LAYOUT_STEREO,
+                                        AV_SAMPLE_FMT_FLT,
+                                        sample_rate,
+                                        decoder_.codec_ctx->channel_layout,
+                                        decoder_.codec_ctx->sample_fmt,
+                                        decoder_.codec_ctx->sample_rate,
+                                        0,
+                                        nullptr);
+  if (decoder_.swr_ctx == nullptr || swr_init(decoder_.swr_ctx) < 0) {
+    return false;
+  }
+
+  decoder_.pkt = av_packet_alloc();
+  decoder_.frame = av_frame_alloc();
+  decoder_.key = key;
+  decoder_.position = -1;
+  decoder_.leftover.clear();
+
+  // now that we know roughly how long the stream is, decide where its pages should live
+  qint64 estimated_length = -1;
+  if (decoder_.stream->duration != AV_NOPTS_VALUE) {
+    estimated_length = qRound64(decoder_.stream->duration * av_q2d(decoder_.stream->time_base) * sample_rate);
+  } else if (decoder_.fmt_ctx->duration != AV_NOPTS_VALUE) {
+    estimated_length = qRound64(double(decoder_.fmt_ctx->duration) / AV_TIME_BASE * sample_rate);
+  }
+
+  mutex_.lock();
+  Stream* s = streams_.value(key, nullptr);
+  if (s != nullptr) {
+    SetUpStorage(s, estimated_length);
+  }
+  mutex_.unlock();
+
+  return true;
+}
+
+void AudioPageCache::CloseDecoder()
+{
+  if (decoder_.frame != nullptr) {
+    av_frame_free(&decoder_.frame);
+  }
+
+  if (decoder_.pkt != nullptr) {
+    av_packet_free(&decoder_.pkt);
+  }
+
+  if (decoder_.swr_ctx != nullptr) {
+    swr_free(&decoder_.swr_ctx);
+  }
+
+  if (decoder_.codec_ctx != nullptr) {
+    avcodec_free_context(&decoder_.codec_ctx);
+  }
+
+  if (decoder_.fmt_ctx != nullptr) {
+    avformat_close_input(&decoder_.fmt_ctx);
+  }
+
+  decoder_.stream = nullptr;
+  decoder_.key.clear();
+  decoder_.position = -1;
+  decoder_.leftover.clear();
+}
+
+qint64 AudioPageCache::WriteSamples(const float *samples,
+                                    qint64 position,
+                                    int count,
+                                    qint64 page_start,
+                                    int page_size,
+                                    QVector<float> &out)
+{
+  qint64 page_end = page_start + page_size;
+  qint64 end = position + count;
+
+  // part of the samples that falls inside the page
+  qint64 copy_start = qMax(position, page_start);
+  qint64 copy_end = qMin(end, page_end);
+  if (copy_end > copy_start) {
+    memcpy(out.data() + (copy_start - page_start) * 2,
+           samples + (copy_start - position) * 2,
+           size_t(copy_end - copy_start) * 2 * sizeof(float));
+  }
+
+  // anything after the page is kept for the next one
+  if (end > page_end) {
+    qint64 keep_start = qMax(position, page_end);
+    if (decoder_.leftover.isEmpty()) {
+      decoder_.leftover_position = keep_start;
+    }
+    int old_size = decoder_.leftover.size();
+    decoder_.leftover.resize(old_size + int(end - keep_start) * 2);
+    memcpy(decoder_.leftover.data() + old_size,
+           samples + (keep_start - position) * 2,
+           size_t(end - keep_start) * 2 * sizeof(float));
+  }
+
+  return qBound(page_start, end, page_end);
+}
+
+void AudioPageCache::CommitPage(Stream *s, qint64 page, const QVector<float> &data)
+{
+  if (page >= s->pages.size()) {
+    s->pages.resize(int(page) + 1);
+    s->last_used.resize(int(page) + 1);
+  }
+
+  if (s->pages.at(int(page)) != nullptr) {
+    return;
+  }
+
+  int page_size = s->sample_rate * 2;
+  float* dest;
+
+  if (s->map != nullptr && page < s->map_pages) {
+    dest = s->map + page * page_size;
+  } else {
+    dest = new float[page_size];
+    memory_usage_ += qint64(page_size) * sizeof(float);
+  }
+
+  memcpy(dest, data.constData(), size_t(page_size) * sizeof(float));
+
+  s->pages[int(page)] = dest;
+  s->last_used[int(page)] = clock_;
+
+  EnforceLimit(s, page);
+}
+
+void AudioPageCache::SetUpStorage(Stream *s, qint64 estimated_length)
+{
+  if (s->file != nullptr || estimated_length < kMapThreshold * s->sample_rate) {
+    return;
+  }
+
+  // leave some room in case the estimate is short
+  qint64 pages = estimated_length / s->sample_rate + 2;
+
+  QTemporaryFile* file = new QTemporaryFile(QDir::temp().filePath("olive-audio-XXXXXX"));
+
+  if (file->open() && file->resize(pages * s->sample_rate * 2 * qint64(sizeof(float)))) {
+    uchar* map = file->map(0, file->size());
+    if (map != nullptr) {
+      s->file = file;
+      s->map = reinterpret_cast<float*>(map);
+      s->map_pages = pages;
+      return;
+    }
+  }
+
+  qWarning() << "Could not map a file for decoded audio of" << s->filename << "- keeping it in memory instead";
+  delete file;
+}
+
+void AudioPageCache::EnforceLimit(Stream *keep_stream, qint64 keep_page)
+{
+  while (memory_usage_ > kMaxMemory) {
+    Stream* oldest_stream = nullptr;
+    int oldest_page = -1;
+    qint64 oldest_time = std::numeric_limits<qint64>::max();
+
+    QMap<QString, Stream*>::iterator i;
+    for (i=streams_.begin();i!=streams_.end();i++) {
+      Stream* s = i.value();
+      float* map_end = (s->map != nullptr) ? s->map + s->map_pages * s->sample_rate * 2 : nullptr;
+
+      for (int j=0;j<s->pages.size();j++) {
+        float* page = s->pages.at(j);
+
+        // mapped pages don't count towards the limit
+        if (page == nullptr
+            || (s->map != nullptr && page >= s->map && page < map_end)
+            || (s == keep_stream && j == keep_page)) {
+          continue;
+        }
+
+        if (s->last_used.at(j) < oldest_time) {
+          oldest_stream = s;
+          oldest_page = j;
+          oldest_time = s->last_used.at(j);
+        }
+      }
+    }
+
+    if (oldest_stream == nullptr) {
+      break;
+    }
+
+    delete [] oldest_stream->pages.at(oldest_page);
+    oldest_stream->pages[oldest_page] = nullptr;
+    memory_usage_ -= qint64(oldest_stream->sample_rate) * 2 * sizeof(float);
+  }
+}
+
+void AudioPageCache::FreeStream(Stream *s)
+{
+  float* map_end = (s->map != nullptr) ? s->map + s->map_pages * s->sample_rate * 2 : nullptr;
+
+  for (int i=0;i<s->pages.size();i++) {
+    float* page = s->pages.at(i);
+    if (page != nullptr && !(s->map != nullptr && page >= s->map && page < map_end)) {
+      delete [] page;
+    }
+  }
+
+  if (s->file != nullptr) {
+    s->file->unmap(reinterpret_cast<uchar*>(s->map));
+    delete s->file;
+  }
+
+  delete s;
+}
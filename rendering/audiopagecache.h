@@ -0,0 +1,299 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOPAGECACHE_H
+#define AUDIOPAGECACHE_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswresample/swresample.h>
+}
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QTemporaryFile>
+#include <QVector>
+#include <QMap>
+
+/**
+ * @brief Decoded audio kept in memory for scrubbing and shuttle playback
+ *
+ * Normal playback decodes audio linearly, which FFmpeg is good at. Scrubbing and J/K/L shuttle jump around constantly
+ * though, and every jump used to make the clip's Cacher flush its decoder, seek the file and rebuild its position
+ * before it could mix a single sample. Across a long dialogue track this is choppy and CPU-heavy.
+ *
+ * This thread decodes footage audio into pages of one second of interleaved stereo float samples at the mix sample
+ * rate, starting wherever audio is requested and working ahead in the direction it's being played. Read() then renders
+ * audio straight from those pages at any speed (including reverse) with linear interpolation, so once the pages around
+ * the playhead are decoded, scrubbing never touches a decoder.
+ *
+ * Pages are evicted least recently used first once they use more than a fixed amount of memory. Streams longer than
+ * a few minutes are decoded into a memory-mapped temporary file instead, so the operating system can page them out
+ * rather than them taking up RAM.
+ *
+ * All public functions are thread-safe.
+ */
+class AudioPageCache : public QThread {
+  Q_OBJECT
+public:
+  AudioPageCache();
+
+  /**
+   * @brief AudioPageCache Destructor
+   *
+   * Frees all decoded audio. The thread must have been stopped with cancel() beforehand.
+   */
+  ~AudioPageCache();
+
+  /**
+   * @brief Thread loop, decodes requested pages until cancel() is called
+   */
+  void run();
+
+  /**
+   * @brief Stop the thread and wait for it to finish
+   */
+  void cancel();
+
+  /**
+   * @brief Render audio from the cache at a variable speed
+   *
+   * Audio that hasn't been decoded yet is queued for decoding, along with the audio following it in the direction of
+   * `step`.
+   *
+   * @param filename
+   *
+   * File the audio is decoded from.
+   *
+   * @param stream_index
+   *
+   * Index of the audio stream in the file.
+   *
+   * @param sample_rate
+   *
+   * Sample rate to render at, the audio is decoded at this rate too.
+   *
+   * @param position
+   *
+   * Position of the first rendered sample, in samples from the start of the stream.
+   *
+   * @param step
+   *
+   * How far to advance through the stream per rendered sample, e.g. 2.0 for double speed or -1.0 for reverse.
+   *
+   * @param dest
+   *
+   * Array of at least `frames * 2` floats to render interleaved stereo samples into.
+   *
+   * @return The amount of samples rendered. Less than `frames` if the audio hasn't been decoded that far yet.
+   */
+  int Read(const QString& filename,
+           int stream_index,
+           int sample_rate,
+           double position,
+           double step,
+           float* dest,
+           int frames);
+
+  /**
+   * @brief Free all decoded audio and forget any pending requests
+   */
+  void Clear();
+
+  /**
+   * @brief Memory used by decoded pages that aren't memory-mapped, in bytes
+   */
+  qint64 memory_usage();
+
+private:
+  struct Stream {
+    QString filename;
+    int stream_index;
+    int sample_rate;
+
+    /**
+     * @brief Total amount of samples in the stream, or -1 until the decoder has reached the end of it
+     */
+    qint64 length;
+
+    /**
+     * @brief Decoded pages, nullptr for pages that haven't been decoded
+     */
+    QVector<float*> pages;
+
+    /**
+     * @brief Last time each page was read, for evicting least recently used pages
+     */
+    QVector<qint64> last_used;
+
+    /**
+     * @brief Backing file for long streams, nullptr if pages are allocated on the heap
+     */
+    QTemporaryFile* file;
+
+    /**
+     * @brief Memory-mapped contents of `file`
+     */
+    float* map;
+
+    /**
+     * @brief Amount of pages that fit in `map`
+     */
+    qint64 map_pages;
+
+    /**
+     * @brief Set if the stream couldn't be decoded, in which case it's never requested again
+     */
+    bool failed;
+  };
+
+  struct Request {
+    QString key;
+    qint64 page;
+    int direction;
+  };
+
+  /**
+   * @brief Decoder state, only ever used from the thread
+   */
+  struct Decoder {
+    QString key;
+    AVFormatContext* fmt_ctx;
+    AVCodecContext* codec_ctx;
+    SwrContext* swr_ctx;
+    AVStream* stream;
+    AVPacket* pkt;
+    AVFrame* frame;
+
+    /**
+     * @brief Position of the next sample the decoder will output, or -1 if it's unknown (e.g. after seeking)
+     */
+    qint64 position;
+
+    /**
+     * @brief Decoded samples that belong to pages after the last decoded one
+     */
+    QVector<float> leftover;
+    qint64 leftover_position;
+  };
+
+  static QString StreamKey(const QString& filename, int stream_index, int sample_rate);
+
+  /**
+   * @brief Get the decoded page containing a sample, or nullptr if it hasn't been decoded
+   *
+   * mutex_ must be held.
+   */
+  const float* PageOf(Stream* s, qint64 sample);
+
+  /**
+   * @brief Queue a page for decoding, replacing any other request for the same stream
+   *
+   * mutex_ must be held.
+   */
+  void RequestPage(const QString& key, qint64 page, int direction);
+
+  /**
+   * @brief Find the next page around a requested page that still has to be decoded
+   *
+   * mutex_ must be held.
+   *
+   * @return The page index, or -1 if everything around the request has been decoded.
+   */
+  qint64 NextMissingPage(Stream* s, const Request& r);
+
+  /**
+   * @brief Decode one page of a stream into `out`
+   *
+   * Reuses the open decoder if it's positioned right before the page, otherwise (re)opens and seeks it.
+   *
+   * @param eof
+   *
+   * Set to **TRUE** if the end of the stream was reached while decoding the page.
+   *
+   * @return **FALSE** if the stream couldn't be decoded.
+   */
+  bool DecodePage(const QString& key,
+                  const QString& filename,
+                  int stream_index,
+                  int sample_rate,
+                  qint64 page,
+                  QVector<float>& out,
+                  bool* eof);
+
+  bool OpenDecoder(const QString& key, const QString& filename, int stream_index, int sample_rate);
+
+  void CloseDecoder();
+
+  /**
+   * @brief Copy decoded samples that fall inside a page into it
+   *
+   * @return The position up to which `out` is filled.
+   */
+  qint64 WriteSamples(const float* samples, qint64 position, int count, qint64 page_start, int page_size,
+                      QVector<float>& out);
+
+  /**
+   * @brief Store a decoded page, evicting old pages if over the memory limit
+   *
+   * mutex_ must be held.
+   */
+  void CommitPage(Stream* s, qint64 page, const QVector<float>& data);
+
+  /**
+   * @brief Set up memory-mapped storage for a stream if it's long enough to need it
+   *
+   * mutex_ must be held.
+   */
+  void SetUpStorage(Stream* s, qint64 estimated_length);
+
+  /**
+   * @brief Evict least recently used pages until the memory limit is met
+   *
+   * mutex_ must be held.
+   */
+  void EnforceLimit(Stream* keep_stream, qint64 keep_page);
+
+  static void FreeStream(Stream* s);
+
+  QMutex mutex_;
+  QWaitCondition wait_cond_;
+  bool cancelled_;
+  bool reset_decoder_;
+
+  QMap<QString, Stream*> streams_;
+  QVector<Request> requests_;
+
+  qint64 memory_usage_;
+  qint64 clock_;
+
+  Decoder decoder_;
+};
+
+namespace olive {
+  /**
+   * @brief Decoded audio shared by every audio Cacher
+   */
+  extern AudioPageCache audio_page_cache;
+}
+
+#endif // AUDIOPAGECACHE_H
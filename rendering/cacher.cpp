@@ -29,6 +29,7 @@
 #include <inttypes.h>
 
 #include <QOpenGLFramebufferObject>
+#include <QAtomicInt>
 #include <QtMath>
 #include <QAudioOutput>
 #include <QStatusBar>
@@ -36,10 +37,14 @@
 
 #include "project/projectelements.h"
 #include "rendering/audio.h"
+#include "rendering/audiopagecache.h"
+#include "rendering/decoderpool.h"
+#include "rendering/framebudget.h"
 #include "rendering/renderfunctions.h"
 #include "panels/panels.h"
 #include "global/config.h"
 #include "global/debug.h"
+#include "global/trace.h"
 #include "ui/mainwindow.h"
 
 // Enable verbose audio messages - good for debugging reversed audio
@@ -48,6 +53,9 @@
 const AVPixelFormat kDestPixFmt = AV_PIX_FMT_RGBA;
 const AVSampleFormat kDestSampleFmt = AV_SAMPLE_FMT_S16;
 
+// number of cachers between Open() and the end of run()
+static QAtomicInt open_cacher_count;
+
 double bytes_to_seconds(int nb_bytes, int nb_channels, int sample_rate) {
   return (double(nb_bytes >> 1) / nb_channels / sample_rate);
 }
@@ -100,11 +108,205 @@ void apply_audio_effects(Clip* clip, double timecode_start, AVFrame* frame, int
   }
 }
 
+// shortest burst of audio played for a scrub, in milliseconds
+const int kScrubGrainMs = 40;
+
+// fade applied to both ends of a scrub burst to avoid clicks, in milliseconds
+const int kScrubFadeMs = 2;
+
+// byte offset of a sequence frame in an audio buffer that's being played `speed` times faster than normal
+static qint64 buffer_offset(AudioMixBuffer* buffer, double frame_rate, long f, int speed) {
+  if (f <= buffer->frame) {
+    return 0;
+  }
+  return qFloor((double(f - buffer->frame) / frame_rate / speed) * buffer->SampleRate()) * 4;
+}
+
+bool Cacher::MixPagedAudio()
+{
+  // normal playback decodes linearly, which is what the decoder is best at
+  bool shuttling = (playback_speed_ != 0 && playback_speed_ != 1);
+  if (!scrubbing_ && !shuttling) {
+    paged_audio_ = false;
+    return false;
+  }
+
+  // nested clips are mixed by the decoder
+  if (clip->media() == nullptr
+      || clip->media()->get_type() != MEDIA_TYPE_FOOTAGE
+      || !nests_.isEmpty()
+      || stream == nullptr) {
+    paged_audio_ = false;
+    return false;
+  }
+
+  // whether to use the page cache is decided after a reset and kept until the next one
+  if (!audio_reset_ && !paged_audio_) {
+    return false;
+  }
+
+  if (scrubbing_) {
+    if (!audio_reset_) {
+      // each scrub only plays one burst
+      return true;
+    } else if (!olive::CurrentConfig.enable_audio_scrubbing) {
+      audio_reset_ = false;
+      paged_audio_ = true;
+      return true;
+    }
+  }
+
+  double frame_rate = clip->sequence->frame_rate;
+  int speed = qMax(1, qAbs(playback_speed_));
+  int sample_rate = audio_buffer_->SampleRate();
+
+  // reversed playback is mirrored around the end of the sequence, like in CacheAudioWorker()
+  long seq_end = clip->sequence->getEndFrame();
+  long mirrored_in = clip->timeline_in(true);
+  long mirrored_out = clip->timeline_out(true);
+  long mirrored_playhead = playhead_;
+  if (playback_speed_ < 0) {
+    mirrored_in = seq_end - clip->timeline_out(true);
+    mirrored_out = seq_end - clip->timeline_in(true);
+    mirrored_playhead = seq_end - playhead_;
+  }
+
+  qint64 write = audio_reset_
+      ? qMax(buffer_offset(audio_buffer_, frame_rate, mirrored_in, speed),
+             buffer_offset(audio_buffer_, frame_rate, mirrored_playhead, speed))
+      : audio_buffer_write;
+  write = qMax(write, audio_buffer_->read);
+
+  qint64 end = qMin(buffer_offset(audio_buffer_, frame_rate, mirrored_out, speed),
+                    audio_buffer_->read + (audio_buffer_->size >> 1));
+  if (scrubbing_) {
+    qint64 grain = qMax(qint64(sample_rate / frame_rate), qint64(sample_rate * kScrubGrainMs / 1000));
+    end = qMin(end, write + grain * 4);
+  }
+
+  int frames = int(qMax(qint64(0), end - write) / 4);
+
+  // work out where in the stream the first sample is and how fast to move through it
+  double timeline_seconds = audio_buffer_->timecode + double(write) / (sample_rate * 4) * speed;
+  if (playback_speed_ < 0) {
+    timeline_seconds = double(seq_end) / frame_rate - timeline_seconds;
+  }
+
+  double clip_frame = timeline_seconds * frame_rate - clip->timeline_in(true) + clip->clip_in(true);
+  double clip_seconds = clip_frame / frame_rate;
+  double media_speed = clip->speed().value * clip->media()->to_footage()->speed;
+  double step = speed * media_speed * ((playback_speed_ < 0) ? -1 : 1);
+
+  if (clip->reversed()) {
+    clip_frame = clip->media_length() - clip_frame;
+    step = -step;
+  }
+
+  int rendered = 0;
+  if (frames > 0) {
+    paged_samples_.resize(frames * 2);
+    rendered = olive::audio_page_cache.Read(filename_,
+                                            clip->media_stream()->file_index,
+                                            sample_rate,
+                                            clip_frame / frame_rate * media_speed * sample_rate,
+                                            step,
+                                            paged_samples_.data(),
+                                            frames);
+  }
+
+  if (audio_reset_) {
+    if (rendered < frames) {
+      // the audio around the playhead hasn't been decoded yet (it's been queued now), use the decoder this time
+      paged_audio_ = false;
+      return false;
+    }
+
+    audio_reset_ = false;
+    paged_audio_ = true;
+  }
+
+  if (rendered == 0) {
+    audio_buffer_write = write;
+    return true;
+  }
+
+  // convert to the mix's sample format
+  if (paged_frame_ == nullptr) {
+    paged_frame_ = av_frame_alloc();
+  }
+  av_frame_unref(paged_frame_);
+  paged_frame_->format = kDestSampleFmt;
+  paged_frame_->channel_layout = AV_CH_LAYOUT_STEREO;
+  paged_frame_->channels = 2;
+  paged_frame_->sample_rate = sample_rate;
+  paged_frame_->nb_samples = rendered;
+  if (av_frame_get_buffer(paged_frame_, 0) < 0) {
+    qCritical() << "Could not allocate buffer for scrubbing audio";
+    return true;
+  }
+
+  qint16* samples = reinterpret_cast<qint16*>(paged_frame_->data[0]);
+  int fade = sample_rate * kScrubFadeMs / 1000;
+
+  for (int i=0;i<rendered;i++) {
+    float gain = 1.0f;
+    if (scrubbing_ && fade > 0) {
+      gain = qMin(1.0f, float(qMin(i, rendered - 1 - i)) / fade);
+    }
+
+    for (int j=0;j<2;j++) {
+      samples[i*2+j] = qint16(qBound(-32768.0f, paged_samples_.at(i*2+j) * gain * 32767.0f, 32767.0f));
+    }
+  }
+
+  int nb_bytes = rendered * 4;
+
+  apply_audio_effects(clip, clip_seconds, paged_frame_, nb_bytes, nests_);
+
+  // mix audio into internal buffer
+  audio_buffer_->lock.lock();
+
+  qint8* mix_data = audio_buffer_->data;
+  int mix_size = audio_buffer_->size;
+
+  for (int i=0;i<rendered*2;i++) {
+    int upper_byte_index = (write+1)%mix_size;
+    int lower_byte_index = (write)%mix_size;
+    qint16 old_sample = static_cast<qint16>((mix_data[upper_byte_index] & 0xFF) << 8 | (mix_data[lower_byte_index] & 0xFF));
+    qint16 mixed_sample = mix_audio_sample(old_sample, samples[i]);
+
+    mix_data[upper_byte_index] = quint8((mixed_sample >> 8) & 0xFF);
+    mix_data[lower_byte_index] = quint8(mixed_sample & 0xFF);
+
+    write += 2;
+  }
+
+  audio_buffer_->mixed = qMax(audio_buffer_->mixed, write);
+
+  audio_buffer_->lock.unlock();
+
+  audio_buffer_write = write;
+
+  if (scrubbing_) {
+    if (audio_thread != nullptr) audio_thread->notifyReceiver();
+  }
+
+  return true;
+}
+
 #define AUDIO_BUFFER_PADDING 2048
 void Cacher::CacheAudioWorker() {
+  TraceScope trace("audio", "mix", clip->name());
+
   // main thread waits until cacher starts fully, wake it up here
   WakeMainThread();
 
+  // scrubbing and shuttle playback are mixed straight from decoded audio in memory if it's available
+  if (MixPagedAudio()) {
+    audio_buffer_->Wake();
+    return;
+  }
+
   bool audio_just_reset = false;
 
   // for audio clips, something may have triggered an audio reset (common if the user seeked)
@@ -144,7 +346,9 @@ void Cacher::CacheAudioWorker() {
   }
 
   if (temp_reverse) {
-    long seq_end = olive::ActiveSequence->getEndFrame();
+    // reversed playback is mirrored around the end of the top-level sequence being played
+    Sequence* top_sequence = nests_.isEmpty() ? clip->sequence : nests_.first()->sequence;
+    long seq_end = top_sequence->getEndFrame();
     timeline_in = seq_end - timeline_in;
     timeline_out = seq_end - timeline_out;
     target_frame = seq_end - target_frame;
@@ -168,9 +372,9 @@ void Cacher::CacheAudioWorker() {
         frame_->pts += nb_bytes;
         frame_sample_index_ = 0;
         if (audio_buffer_write == 0) {
-          audio_buffer_write = get_buffer_offset_from_frame(last_fr, qMax(timeline_in, target_frame));
+          audio_buffer_write = audio_buffer_->OffsetFromFrame(last_fr, qMax(timeline_in, target_frame));
         }
-        int offset = audio_ibuffer_read - audio_buffer_write;
+        int offset = audio_buffer_->read - audio_buffer_write;
         if (offset > 0) {
           audio_buffer_write += offset;
           frame_sample_index_ += offset;
@@ -194,6 +398,7 @@ void Cacher::CacheAudioWorker() {
             reached_end = false;
             int64_t backtrack_seek = qMax(reverse_target_ - static_cast<int64_t>(av_q2d(av_inv_q(stream->time_base))),
                                           static_cast<int64_t>(0));
+            TraceScope trace("cacher", "seek", clip->name());
             av_seek_frame(formatCtx, stream->index, backtrack_seek, AVSEEK_FLAG_BACKWARD);
 #ifdef AUDIOWARNINGS
             if (backtrack_seek == 0) {
@@ -292,7 +497,7 @@ void Cacher::CacheAudioWorker() {
                   dout << "pre cutoff deets::: rev_frame.pts:" << rev_frame->pts << "rev_frame.nb_samples" << rev_frame->nb_samples << "rev_target:" << reverse_target;
 #endif
                   double playback_speed_ = clip->speed().value * clip->media()->to_footage()->speed;
-                  rev_frame->nb_samples = qRound64(double(reverse_target_ - rev_frame->pts) * timebase * (current_audio_freq() / playback_speed_));
+                  rev_frame->nb_samples = qRound64(double(reverse_target_ - rev_frame->pts) * timebase * (audio_buffer_->SampleRate() / playback_speed_));
 #ifdef AUDIOWARNINGS
                   dout << "post cutoff deets::" << rev_frame->nb_samples;
 #endif
@@ -349,7 +554,7 @@ void Cacher::CacheAudioWorker() {
           int64_t stream_start = qMax(static_cast<int64_t>(0), stream->start_time);
           double frame_sts = ((frame->pts - stream_start) * timebase);
 
-          int nb_samples = qRound64((target_sts - frame_sts)*current_audio_freq());
+          int nb_samples = qRound64((target_sts - frame_sts)*audio_buffer_->SampleRate());
           frame_sample_index_ = nb_samples * 4;
 #ifdef AUDIOWARNINGS
           dout << "fsts:" << frame_sts << "tsts:" << target_sts << "nbs:" << nb_samples << "nbb:" << nb_bytes << "rev_targetToSec:" << (reverse_target * timebase);
@@ -363,16 +568,16 @@ void Cacher::CacheAudioWorker() {
         dout << "fsi-post-post:" << frame_sample_index;
 #endif
         if (audio_buffer_write == 0) {
-          audio_buffer_write = get_buffer_offset_from_frame(last_fr, qMax(timeline_in, target_frame));
+          audio_buffer_write = audio_buffer_->OffsetFromFrame(last_fr, qMax(timeline_in, target_frame));
 
           if (frame_skip > 0) {
-            int target = get_buffer_offset_from_frame(last_fr, qMax(timeline_in + frame_skip, target_frame));
+            int target = audio_buffer_->OffsetFromFrame(last_fr, qMax(timeline_in + frame_skip, target_frame));
             frame_sample_index_ += (target - audio_buffer_write);
             audio_buffer_write = target;
           }
         }
 
-        int offset = audio_ibuffer_read - audio_buffer_write;
+        int offset = audio_buffer_->read - audio_buffer_write;
         if (offset > 0) {
           audio_buffer_write += offset;
           frame_sample_index_ += offset;
@@ -394,7 +599,7 @@ void Cacher::CacheAudioWorker() {
       // apply any audio effects to the data
       if (nb_bytes == INT_MAX) nb_bytes = frame->nb_samples * av_get_bytes_per_sample(static_cast<AVSampleFormat>(frame->format)) * frame->channels;
       if (new_frame) {
-        apply_audio_effects(clip, bytes_to_seconds(audio_buffer_write, 2, current_audio_freq()) + audio_ibuffer_timecode + ((double)clip->clip_in(true)/clip->sequence->frame_rate) - ((double)timeline_in/last_fr), frame, nb_bytes, nests_);
+        apply_audio_effects(clip, bytes_to_seconds(audio_buffer_write, 2, audio_buffer_->SampleRate()) + audio_buffer_->timecode + ((double)clip->clip_in(true)/clip->sequence->frame_rate) - ((double)timeline_in/last_fr), frame, nb_bytes, nests_);
       }
     }
 
@@ -402,25 +607,28 @@ void Cacher::CacheAudioWorker() {
     if (frame->nb_samples == 0) {
       break;
     } else {
-      qint64 buffer_timeline_out = get_buffer_offset_from_frame(clip->sequence->frame_rate, timeline_out);
+      qint64 buffer_timeline_out = audio_buffer_->OffsetFromFrame(clip->sequence->frame_rate, timeline_out);
 
-      audio_write_lock.lock();
+      audio_buffer_->lock.lock();
+
+      qint8* mix_data = audio_buffer_->data;
+      int mix_size = audio_buffer_->size;
 
       int sample_skip = 4*qMax(0, qAbs(playback_speed_)-1);
       int sample_byte_size = av_get_bytes_per_sample(static_cast<AVSampleFormat>(frame->format));
 
       while (frame_sample_index_ < nb_bytes
-             && audio_buffer_write < audio_ibuffer_read+(audio_ibuffer_size>>1)
+             && audio_buffer_write < audio_buffer_->read+(mix_size>>1)
              && audio_buffer_write < buffer_timeline_out) {
         for (int i=0;i<frame->channels;i++) {
-          int upper_byte_index = (audio_buffer_write+1)%audio_ibuffer_size;
-          int lower_byte_index = (audio_buffer_write)%audio_ibuffer_size;
-          qint16 old_sample = static_cast<qint16>((audio_ibuffer[upper_byte_index] & 0xFF) << 8 | (audio_ibuffer[lower_byte_index] & 0xFF));
+          int upper_byte_index = (audio_buffer_write+1)%mix_size;
+          int lower_byte_index = (audio_buffer_write)%mix_size;
+          qint16 old_sample = static_cast<qint16>((mix_data[upper_byte_index] & 0xFF) << 8 | (mix_data[lower_byte_index] & 0xFF));
           qint16 new_sample = static_cast<qint16>((frame->data[0][frame_sample_index_+1] & 0xFF) << 8 | (frame->data[0][frame_sample_index_] & 0xFF));
           qint16 mixed_sample = mix_audio_sample(old_sample, new_sample);
 
-          audio_ibuffer[upper_byte_index] = quint8((mixed_sample >> 8) & 0xFF);
-          audio_ibuffer[lower_byte_index] = quint8(mixed_sample & 0xFF);
+          mix_data[upper_byte_index] = quint8((mixed_sample >> 8) & 0xFF);
+          mix_data[lower_byte_index] = quint8(mixed_sample & 0xFF);
 
           audio_buffer_write+=sample_byte_size;
           frame_sample_index_+=sample_byte_size;
@@ -435,7 +643,9 @@ void Cacher::CacheAudioWorker() {
       if (audio_buffer_write >= buffer_timeline_out) dout << "timeline out at fsi" << frame_sample_index << "of frame ts" << frame_->pts;
 #endif
 
-      audio_write_lock.unlock();
+      audio_buffer_->mixed = qMax(audio_buffer_->mixed, qint64(audio_buffer_write));
+
+      audio_buffer_->lock.unlock();
 
       if (audio_reset_) return;
 
@@ -461,7 +671,7 @@ void Cacher::CacheAudioWorker() {
   }
 
   // If there's a QObject waiting for audio to be rendered, wake it now
-  WakeAudioWakeObject();
+  audio_buffer_->Wake();
 }
 
 bool Cacher::IsReversed()
@@ -489,24 +699,27 @@ void Cacher::CacheVideoWorker() {
 
       if (RetrieveFrameAndProcess(&still_image_frame) >= 0) {
 
-        queue_.lock();
         queue_.append(still_image_frame);
-        queue_.unlock();
 
         SetRetrievedFrame(still_image_frame);
+      } else {
+        frame_pool_.Release(&still_image_frame);
       }
 
     }
 
+  } else if (IsReversed()) {
+
+    // reversed playback has its own GOP-based caching routine
+    CacheVideoReverseWorker();
+    return;
+
   } else {
     // this media is not a still image and will require more complex caching
 
     // main thread waits until cacher starts fully, wake it up here
     WakeMainThread();
 
-    // determine if this media is reversed, which will affect how the queue is constructed
-    bool reversed = IsReversed();
-
     // get the timestamp we want in terms of the media's timebase
     int64_t target_pts = seconds_to_timestamp(clip, playhead_to_clip_seconds(clip, playhead_));
 
@@ -550,14 +763,17 @@ void Cacher::CacheVideoWorker() {
 
         // if we already allocated a frame here, we'd better free it
         if (have_existing_frame_to_use) {
-          av_frame_free(&decoded_frame);
+          frame_pool_.Release(&decoded_frame);
         }
 
         // If we already seeked to a timestamp of zero, there's no further we can go, so we have to exit the loop if so
         seeked_to_zero = (seek_ts == 0);
 
-        avcodec_flush_buffers(codecCtx);
-        av_seek_frame(formatCtx, clip->media_stream_index(), seek_ts, AVSEEK_FLAG_BACKWARD);
+        {
+          TraceScope trace("cacher", "seek", clip->name());
+          avcodec_flush_buffers(codecCtx);
+          av_seek_frame(formatCtx, clip->media_stream_index(), seek_ts, AVSEEK_FLAG_BACKWARD);
+        }
 
         retrieve_code = RetrieveFrameAndProcess(&decoded_frame);
 
@@ -569,9 +785,7 @@ void Cacher::CacheVideoWorker() {
       } while (retrieve_code >= 0 && decoded_frame->pts > target_pts && !seeked_to_zero);
 
       // also we assume none of the frames in the queue are usable
-      queue_.lock();
       queue_.clear();
-      queue_.unlock();
 
       // reset upcoming frame count and latest pts for later calculations
       frames_greater_than_target = 0;
@@ -591,22 +805,10 @@ void Cacher::CacheVideoWorker() {
     int64_t maximum_ts;
 
     // Get queue configuration
-    int previous_queue_type, upcoming_queue_type;
-    double previous_queue_size, upcoming_queue_size;
-
-    // For reversed playback, we flip the queue stats as "upcoming" frames are going to be played before the "previous"
-    // frames now
-    if (reversed) {
-      previous_queue_type = olive::CurrentConfig.upcoming_queue_type;
-      previous_queue_size = olive::CurrentConfig.upcoming_queue_size;
-      upcoming_queue_type = olive::CurrentConfig.previous_queue_type;
-      upcoming_queue_size = olive::CurrentConfig.previous_queue_size;
-    } else {
-      previous_queue_type = olive::CurrentConfig.previous_queue_type;
-      previous_queue_size = olive::CurrentConfig.previous_queue_size;
-      upcoming_queue_type = olive::CurrentConfig.upcoming_queue_type;
-      upcoming_queue_size = olive::CurrentConfig.upcoming_queue_size;
-    }
+    int previous_queue_type = olive::CurrentConfig.previous_queue_type;
+    double previous_queue_size = olive::CurrentConfig.previous_queue_size;
+    int upcoming_queue_type = olive::CurrentConfig.upcoming_queue_type;
+    double upcoming_queue_size = olive::CurrentConfig.upcoming_queue_size;
 
     // Determine "previous" queue statistics
     if (previous_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES) {
@@ -632,6 +834,14 @@ void Cacher::CacheVideoWorker() {
       start_loop = false;
     }
 
+    // likewise if the global frame budget has no room left for this clip to cache any further ahead
+    if (start_loop
+        && retrieved_frame != nullptr
+        && frames_greater_than_target > 0
+        && !olive::frame_budget.RequestMore(this, QueuedFrameSize())) {
+      start_loop = false;
+    }
+
 
     if (start_loop) {
 
@@ -663,7 +873,7 @@ void Cacher::CacheVideoWorker() {
               && decoded_frame->pts < minimum_ts) {
 
             // if so, we don't need it
-            av_frame_free(&decoded_frame);
+            frame_pool_.Release(&decoded_frame);
 
           } else {
 
@@ -692,10 +902,11 @@ void Cacher::CacheVideoWorker() {
               }
             }
 
-            // add the frame to the queue
-            queue_.lock();
+            // add the frame to the queue, making room by dropping the oldest frame if it's completely full
+            if (queue_.isFull()) {
+              queue_.removeFirst();
+            }
             queue_.append(decoded_frame);
-            queue_.unlock();
 
             // check the amount of previous frames in the queue by using the current queue size for if we need to
             // remove any old entries (assumes the queue is chronological)
@@ -722,14 +933,21 @@ void Cacher::CacheVideoWorker() {
 
               // remove frames while the amount of previous frames exceeds the maximum
               while (previous_frame_count > minimum_ts) {
-                queue_.lock();
                 queue_.removeFirst();
-                queue_.unlock();
                 previous_frame_count--;
               }
 
             }
 
+            UpdateFrameBudget();
+
+            // stop caching ahead once the global frame budget has no room for another frame of this clip
+            if (retrieved_frame != nullptr
+                && decoded_frame->pts > target_pts
+                && !olive::frame_budget.RequestMore(this, QueuedFrameSize())) {
+              break;
+            }
+
             // check if the queue is full according to olive::CurrentConfig
             if (upcoming_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES) {
 
@@ -758,7 +976,7 @@ void Cacher::CacheVideoWorker() {
           // if a frame has no timestamp (pts == AV_NOPTS_VALUE), we assume it's an invalid frame and don't use it
 
           qWarning() << clip->name() << "frame had no PTS value";
-          av_frame_free(&decoded_frame);
+          frame_pool_.Release(&decoded_frame);
 
           if (retrieve_code == AVERROR_EOF && retrieved_frame == nullptr && !queue_.isEmpty()) {
             // if we reached the end of the file, it's not an error but there are no more frames to retrieve
@@ -784,6 +1002,8 @@ void Cacher::CacheVideoWorker() {
 
   }
 
+  UpdateFrameBudget();
+
   // For some reason we couldn't get the frame, we should wake up the RenderThread anyway
   if (retrieved_frame == nullptr) {
     qCritical() << "Couldn't retrieve an appropriate frame. This is an error and may mean this media is corrupt.";
@@ -791,6 +1011,236 @@ void Cacher::CacheVideoWorker() {
   }
 }
 
+void Cacher::CacheVideoReverseWorker()
+{
+  // main thread waits until cacher starts fully, wake it up here
+  WakeMainThread();
+
+  // get the timestamp we want in terms of the media's timebase
+  int64_t target_pts = seconds_to_timestamp(clip, playhead_to_clip_seconds(clip, playhead_));
+
+  // get the value of one second in terms of the media's timebase
+  int64_t second_pts = seconds_to_timestamp(clip, 1);
+
+  // In reverse, frames earlier than the target are the ones about to be played, so they use the "upcoming" queue
+  // configuration, and frames later than the target have already been played so they use the "previous" one.
+  int ahead_frames = INT_MAX;
+  int64_t ahead_minimum_ts = INT64_MIN;
+  int max_chunk_frames;
+
+  if (olive::CurrentConfig.upcoming_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES) {
+    ahead_frames = qCeil(olive::CurrentConfig.upcoming_queue_size);
+    max_chunk_frames = ahead_frames + 1;
+  } else {
+    ahead_minimum_ts = qRound64(target_pts - second_pts * olive::CurrentConfig.upcoming_queue_size);
+    max_chunk_frames = qCeil(olive::CurrentConfig.upcoming_queue_size * clip->media_frame_rate()) + 1;
+  }
+
+  max_chunk_frames = qMax(1, max_chunk_frames);
+
+  int64_t chunk_end;
+  bool chunk_end_inclusive;
+
+
+  if (!queue_.isEmpty() && target_pts >= queue_.first()->pts && target_pts <= queue_.last()->pts) {
+
+    // we already have the target, continue decoding backwards from the earliest frame we have
+    chunk_end = queue_.first()->pts;
+    chunk_end_inclusive = false;
+
+    // remove frames that have already been played
+    if (olive::CurrentConfig.previous_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES) {
+      int played_frames = 0;
+      for (int i=0;i<queue_.size();i++) {
+        if (queue_.at(i)->pts > target_pts) {
+          played_frames++;
+        }
+      }
+
+      while (played_frames > qCeil(olive::CurrentConfig.previous_queue_size)) {
+        queue_.removeLast();
+        played_frames--;
+      }
+    } else {
+      int64_t maximum_ts = qRound64(target_pts + second_pts * olive::CurrentConfig.previous_queue_size);
+
+      while (queue_.last()->pts > maximum_ts) {
+        queue_.removeLast();
+      }
+    }
+
+  } else {
+
+    // none of the frames in the queue are usable, start again from the GOP containing the target
+    queue_.clear();
+    chunk_end = target_pts;
+    chunk_end_inclusive = true;
+
+  }
+
+
+  interrupt_ = false;
+  bool reached_start = false;
+
+  while (!interrupt_ && !reached_start) {
+
+    // check if we've already buffered enough frames ahead of the target
+    if (retrieved_frame != nullptr) {
+      int ahead_count = 0;
+
+      for (int i=0;i<queue_.size();i++) {
+        if (queue_.at(i)->pts < target_pts) {
+          ahead_count++;
+        } else {
+          break;
+        }
+      }
+      bool buffer_full = (ahead_count >= ahead_frames
+                          || (!queue_.isEmpty() && queue_.first()->pts <= ahead_minimum_ts)
+                          || !olive::frame_budget.RequestMore(this, QueuedFrameSize()));
+
+      if (buffer_full) {
+        break;
+      }
+    }
+
+    QVector<AVFrame*> chunk;
+
+    if (!DecodeReverseChunk(chunk_end, chunk_end_inclusive, max_chunk_frames, chunk, reached_start)) {
+      break;
+    }
+
+    // the chunk is chronological and ends right where the queue starts, so we can just put it in front (making room
+    // by dropping the latest frames, which have already been played, if the queue is completely full)
+    for (int i=chunk.size()-1;i>=0;i--) {
+      if (queue_.isFull()) {
+        queue_.removeLast();
+      }
+      queue_.prepend(chunk.at(i));
+    }
+
+    UpdateFrameBudget();
+
+    if (retrieved_frame == nullptr) {
+      // use the latest frame at or before the target, or the earliest we could get if there are none
+      AVFrame* target_frame = chunk.first();
+      for (int i=1;i<chunk.size();i++) {
+        if (chunk.at(i)->pts <= target_pts) {
+          target_frame = chunk.at(i);
+        }
+      }
+      SetRetrievedFrame(target_frame);
+    }
+
+    chunk_end = chunk.first()->pts;
+    chunk_end_inclusive = false;
+  }
+
+  UpdateFrameBudget();
+
+  // For some reason we couldn't get the frame, we should wake up the RenderThread anyway
+  if (retrieved_frame == nullptr) {
+    qCritical() << "Couldn't retrieve an appropriate frame. This is an error and may mean this media is corrupt.";
+    SetRetrievedFrame(nullptr);
+  }
+}
+
+bool Cacher::DecodeReverseChunk(int64_t end_pts,
+                                bool end_inclusive,
+                                int max_frames,
+                                QVector<AVFrame*> &chunk,
+                                bool &reached_start)
+{
+  int64_t last_pts = end_inclusive ? end_pts : end_pts - 1;
+  int64_t second_pts = seconds_to_timestamp(clip, 1);
+  int64_t zero = 0;
+
+  AVFrame* decoded_frame = nullptr;
+  int retrieve_code;
+  int64_t seek_ts = last_pts;
+
+  // Seek to the keyframe that starts the GOP containing last_pts. Some formats don't seek reliably to the last
+  // keyframe, so we keep stepping back until we land on a frame at or before it.
+  do {
+    if (decoded_frame != nullptr) {
+      frame_pool_.Release(&decoded_frame);
+    }
+
+    reached_start = (seek_ts == 0);
+
+    {
+      TraceScope trace("cacher", "seek", clip->name());
+      avcodec_flush_buffers(codecCtx);
+      av_seek_frame(formatCtx, clip->media_stream_index(), seek_ts, AVSEEK_FLAG_BACKWARD);
+    }
+
+    retrieve_code = RetrieveFrameAndProcess(&decoded_frame);
+
+    seek_ts = qMax(zero, seek_ts - second_pts);
+  } while (retrieve_code >= 0 && decoded_frame->pts > last_pts && !reached_start);
+
+  // decode the GOP forward up to last_pts
+  bool complete = false;
+
+  forever {
+    if (retrieve_code < 0) {
+
+      frame_pool_.Release(&decoded_frame);
+
+      if (retrieve_code == AVERROR_EOF) {
+        // the end of the file counts as the end of the chunk
+        complete = true;
+      } else {
+        qCritical() << "Failed to retrieve frame from buffersink." << retrieve_code;
+      }
+
+      break;
+
+    } else if (decoded_frame->pts == AV_NOPTS_VALUE) {
+
+      qWarning() << clip->name() << "frame had no PTS value";
+      frame_pool_.Release(&decoded_frame);
+
+    } else if (decoded_frame->pts > last_pts) {
+
+      // we've reached frames that are already in the queue
+      frame_pool_.Release(&decoded_frame);
+      complete = true;
+      break;
+
+    } else {
+
+      chunk.append(decoded_frame);
+
+      // keep the chunk within the buffer limit, the earliest frames are the ones that will be played last so we drop
+      // those and pick them up again with the next chunk
+      if (chunk.size() > max_frames) {
+        frame_pool_.Release(&chunk.first());
+        chunk.removeFirst();
+        reached_start = false;
+      }
+
+    }
+
+    if (interrupt_) {
+      break;
+    }
+
+    retrieve_code = RetrieveFrameAndProcess(&decoded_frame);
+  }
+
+  // an incomplete chunk would leave a gap in the queue, so it's discarded
+  if (!complete || chunk.isEmpty()) {
+    for (int i=0;i<chunk.size();i++) {
+      frame_pool_.Release(&chunk[i]);
+    }
+    chunk.clear();
+    return false;
+  }
+
+  return true;
+}
+
 void Cacher::Reset() {
   // if we seek to a whole other place in the timeline, we'll need to reset the cache with new values
   if (clip->media() == nullptr) {
@@ -823,6 +1273,7 @@ void Cacher::Reset() {
         dout << "reset called; seeking to" << timestamp;
 #endif
       }
+      TraceScope trace("cacher", "seek", clip->name());
       av_seek_frame(formatCtx, ms->file_index, timestamp, AVSEEK_FLAG_BACKWARD);
       audio_target_frame = playhead_;
       frame_sample_index_ = -1;
@@ -855,8 +1306,14 @@ Cacher::Cacher(Clip* c) :
   opts(nullptr),
   filter_graph(nullptr),
   codecCtx(nullptr),
-  is_valid_state_(false)
-{}
+  audio_buffer_(&playback_audio),
+  is_valid_state_(false),
+  paged_audio_(false),
+  paged_frame_(nullptr)
+{
+  // frames removed from the queue go back to the frame pool
+  queue_.SetFramePool(&frame_pool_);
+}
 
 void Cacher::OpenWorker() {
   qint64 time_start = QDateTime::currentMSecsSinceEpoch();
@@ -866,6 +1323,7 @@ void Cacher::OpenWorker() {
     audio_reset_ = false;
     frame_sample_index_ = -1;
     audio_buffer_write = 0;
+    paged_audio_ = false;
   }
   reached_end = false;
 
@@ -875,7 +1333,7 @@ void Cacher::OpenWorker() {
       frame_->format = kDestSampleFmt;
       frame_->channel_layout = clip->sequence->audio_layout;
       frame_->channels = av_get_channel_layout_nb_channels(frame_->channel_layout);
-      frame_->sample_rate = current_audio_freq();
+      frame_->sample_rate = audio_buffer_->SampleRate();
       frame_->nb_samples = 2048;
       av_frame_make_writable(frame_);
       if (av_frame_get_buffer(frame_, 0)) {
@@ -902,57 +1360,81 @@ void Cacher::OpenWorker() {
     const char* filename = ba.constData();
     const FootageStream* ms = clip->media_stream();
 
-    // for image sequences that don't start at 0, set the index where it does start
-    AVDictionary* format_opts = nullptr;
-    if (m->start_number > 0) {
-      av_dict_set(&format_opts, "start_number", QString::number(m->start_number).toUtf8(), 0);
-    }
-
+    filename_ = QString::fromUtf8(ba);
     formatCtx = nullptr;
-    int errCode = avformat_open_input(
-          &formatCtx,
-          filename,
-          nullptr,
-          &format_opts
-          );
-    if (errCode != 0) {
-      char err[1024];
-      av_strerror(errCode, err, 1024);
-      qCritical() << "Could not open" << filename << "-" << err;
-      olive::MainWindow->statusBar()->showMessage(tr("Could not open %1 - %2").arg(filename, err));
-      return;
-    }
+    codecCtx = nullptr;
+    opts = nullptr;
 
-    errCode = avformat_find_stream_info(formatCtx, nullptr);
-    if (errCode < 0) {
-      char err[1024];
-      av_strerror(errCode, err, 1024);
-      qCritical() << "Could not open" << filename << "-" << err;
-      olive::MainWindow->statusBar()->showMessage(tr("Could not open %1 - %2").arg(filename, err));
-      return;
-    }
+    if (olive::decoder_pool.Take(filename_, ms->file_index, &formatCtx, &codecCtx)) {
 
-    av_dump_format(formatCtx, 0, filename, 0);
+      // another clip of this file closed recently, its demuxer and decoder are already open and flushed
+      stream = formatCtx->streams[ms->file_index];
+      codec = avcodec_find_decoder(codecCtx->codec_id);
 
-    stream = formatCtx->streams[ms->file_index];
-    codec = avcodec_find_decoder(stream->codecpar->codec_id);
-    codecCtx = avcodec_alloc_context3(codec);
-    avcodec_parameters_to_context(codecCtx, stream->codecpar);
+      // serve the decoder's picture buffers from the frame pool
+      frame_pool_.SetUpDecoder(codecCtx);
 
-    opts = nullptr;
+    } else {
 
-    // enable multithreading on decoding
-    av_dict_set(&opts, "threads", "auto", 0);
+      // for image sequences that don't start at 0, set the index where it does start
+      AVDictionary* format_opts = nullptr;
+      if (m->start_number > 0) {
+        av_dict_set(&format_opts, "start_number", QString::number(m->start_number).toUtf8(), 0);
+      }
 
-    // enable extra optimization code on h264 (not even sure if they help)
-    if (stream->codecpar->codec_id == AV_CODEC_ID_H264) {
-      av_dict_set(&opts, "tune", "fastdecode", 0);
-      av_dict_set(&opts, "tune", "zerolatency", 0);
-    }
+      int errCode = avformat_open_input(
+            &formatCtx,
+            filename,
+            nullptr,
+            &format_opts
+            );
+      av_dict_free(&format_opts);
+      if (errCode != 0) {
+        char err[1024];
+        av_strerror(errCode, err, 1024);
+        qCritical() << "Could not open" << filename << "-" << err;
+        olive::MainWindow->statusBar()->showMessage(tr("Could not open %1 - %2").arg(filename, err));
+        return;
+      }
+
+      // probing can read megabytes of the file, skip it if the file has been probed before
+      if (!olive::decoder_pool.ApplyProbe(filename_, formatCtx)) {
+        errCode = avformat_find_stream_info(formatCtx, nullptr);
+        if (errCode < 0) {
+          char err[1024];
+          av_strerror(errCode, err, 1024);
+          qCritical() << "Could not open" << filename << "-" << err;
+          olive::MainWindow->statusBar()->showMessage(tr("Could not open %1 - %2").arg(filename, err));
+          return;
+        }
+
+        olive::decoder_pool.StoreProbe(filename_, formatCtx);
+      }
+
+      av_dump_format(formatCtx, 0, filename, 0);
+
+      stream = formatCtx->streams[ms->file_index];
+      codec = avcodec_find_decoder(stream->codecpar->codec_id);
+      codecCtx = avcodec_alloc_context3(codec);
+      avcodec_parameters_to_context(codecCtx, stream->codecpar);
+
+      // enable multithreading on decoding
+      av_dict_set(&opts, "threads", "auto", 0);
+
+      // enable extra optimization code on h264 (not even sure if they help)
+      if (stream->codecpar->codec_id == AV_CODEC_ID_H264) {
+        av_dict_set(&opts, "tune", "fastdecode", 0);
+        av_dict_set(&opts, "tune", "zerolatency", 0);
+      }
+
+      // serve the decoder's picture buffers from the frame pool
+      frame_pool_.SetUpDecoder(codecCtx);
+
+      // Open codec
+      if (avcodec_open2(codecCtx, codec, &opts) < 0) {
+        qCritical() << "Could not open codec";
+      }
 
-    // Open codec
-    if (avcodec_open2(codecCtx, codec, &opts) < 0) {
-      qCritical() << "Could not open codec";
     }
 
     // allocate filtergraph
@@ -1010,7 +1492,7 @@ void Cacher::OpenWorker() {
         AVFrame* reverse_frame = av_frame_alloc();
 
         reverse_frame->format = kDestSampleFmt;
-        reverse_frame->nb_samples = current_audio_freq()*10;
+        reverse_frame->nb_samples = audio_buffer_->SampleRate()*10;
         reverse_frame->channel_layout = clip->sequence->audio_layout;
         reverse_frame->channels = av_get_channel_layout_nb_channels(clip->sequence->audio_layout);
         av_frame_get_buffer(reverse_frame, 0);
@@ -1039,7 +1521,7 @@ void Cacher::OpenWorker() {
         qCritical() << "Could not set output sample format";
       }
 
-      int target_sample_rate = current_audio_freq();
+      int target_sample_rate = audio_buffer_->SampleRate();
 
       double playback_speed_ = clip->speed().value * m->speed;
 
@@ -1109,9 +1591,7 @@ void Cacher::CacheWorker() {
 
 void Cacher::CloseWorker() {
   retrieved_frame = nullptr;
-  queue_.lock();
   queue_.clear();
-  queue_.unlock();
 
   if (frame_ != nullptr) {
     av_frame_free(&frame_);
@@ -1123,28 +1603,45 @@ void Cacher::CloseWorker() {
     pkt = nullptr;
   }
 
+  if (paged_frame_ != nullptr) {
+    av_frame_free(&paged_frame_);
+  }
+
   if (clip->media() != nullptr && clip->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
     if (filter_graph != nullptr) {
       avfilter_graph_free(&filter_graph);
       filter_graph = nullptr;
     }
 
-    if (codecCtx != nullptr) {
-      avcodec_close(codecCtx);
-      avcodec_free_context(&codecCtx);
-      codecCtx = nullptr;
-    }
-
     if (opts != nullptr) {
       av_dict_free(&opts);
     }
 
+    if (formatCtx != nullptr && codecCtx != nullptr && avcodec_is_open(codecCtx)) {
+
+      // keep the demuxer and decoder warm for the next clip that opens this stream
+      olive::decoder_pool.Release(filename_, stream->index, formatCtx, codecCtx);
+      formatCtx = nullptr;
+      codecCtx = nullptr;
+
+    } else {
+
+      if (codecCtx != nullptr) {
+        avcodec_close(codecCtx);
+        avcodec_free_context(&codecCtx);
+        codecCtx = nullptr;
+      }
+
+      if (formatCtx != nullptr) {
+        avformat_close_input(&formatCtx);
+      }
+
+    }
+
     // protection for get_timebase()
     stream = nullptr;
 
-    if (formatCtx != nullptr) {
-      avformat_close_input(&formatCtx);
-    }
+    frame_pool_.Clear();
   }
 
   qInfo() << "Clip closed on track" << clip->track();
@@ -1155,12 +1652,37 @@ void Cacher::run() {
 
   OpenWorker();
 
+  // only video queues hold decoded frames
+  if (clip->track() < 0) {
+    olive::frame_budget.Register(this);
+  }
+
   clip->state_change_lock.unlock();
 
   while (caching_) {
     if (!queued_) {
-      wait_cond_.wait(&clip->cache_lock);
+      // cache_lock is released while idle. Requests are signalled under wake_lock_, so checking for them under it too
+      // means none can slip in between the check and the wait.
+      clip->cache_lock.unlock();
+
+      wake_lock_.lock();
+      while (!queued_ && trim_requested_.load() == 0 && caching_) {
+        wait_cond_.wait(&wake_lock_);
+      }
+      wake_lock_.unlock();
+
+      clip->cache_lock.lock();
+    }
+
+    if (trim_requested_.testAndSetOrdered(1, 0) && is_valid_state_) {
+      TrimToBudget();
+    }
+
+    // if we were only woken up to trim, go straight back to waiting
+    if (!queued_ && caching_) {
+      continue;
     }
+
     queued_ = false;
     if (!caching_) {
       break;
@@ -1174,8 +1696,12 @@ void Cacher::run() {
 
   is_valid_state_ = false;
 
+  olive::frame_budget.Unregister(this);
+
   CloseWorker();
 
+  open_cacher_count.fetchAndAddRelaxed(-1);
+
   clip->state_change_lock.unlock();
 
   clip->cache_lock.unlock();
@@ -1188,10 +1714,20 @@ void Cacher::Open()
   // set variable defaults for caching
   caching_ = true;
   queued_ = false;
+  trim_requested_.store(0);
+  direction_ = 1;
+  prefetch_playhead_ = -1;
+
+  open_cacher_count.fetchAndAddRelaxed(1);
 
   start((clip->track() < 0) ? QThread::HighPriority : QThread::TimeCriticalPriority);
 }
 
+int Cacher::open_count()
+{
+  return open_cacher_count.load();
+}
+
 void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int playback_speed)
 {
 
@@ -1199,6 +1735,11 @@ void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int pla
     return;
   }
 
+  // video frames we find in the queue must stay valid until Clip::Retrieve() has finished with them
+  if (clip->track() < 0) {
+    queue_.BeginRead();
+  }
+
   if (clip->media_stream() != nullptr
       && queue_.size() > 0
       && clip->media_stream()->infinite_length) {
@@ -1206,10 +1747,23 @@ void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int pla
     return;
   }
 
+  if (clip->track() < 0) {
+    // remember which way the media is moving so TrimToBudget() knows which frames have already been seen
+    if (playback_speed != 0) {
+      direction_ = (playback_speed > 0) ? 1 : -1;
+    } else if (playhead != playhead_) {
+      direction_ = (playhead > playhead_) ? 1 : -1;
+    }
+
+    // the clip in the viewed sequence determines how visible this clip is
+    olive::frame_budget.Touch(this, nests.isEmpty() ? clip->track() : nests.first()->track());
+  }
+
   playhead_ = playhead;
   nests_ = nests;
   scrubbing_ = scrubbing;
   playback_speed_ = playback_speed;
+  prefetch_playhead_ = -1;
   queued_ = true;
 
   bool wait_for_cacher_to_respond = true;
@@ -1217,28 +1771,11 @@ void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int pla
   if (clip->media() != nullptr) {
     // see if we already have this frame
     retrieve_lock_.lock();
-    queue_.lock();
-    retrieved_frame = nullptr;
     int64_t target_pts = seconds_to_timestamp(clip, playhead_to_clip_seconds(clip, playhead_));
-    for (int i=0;i<queue_.size();i++) {
-
-      if (queue_.at(i)->pts == target_pts) {
-
-        // the queue has a frame with the exact timestamp
-
-        retrieved_frame = queue_.at(i);
-        wait_for_cacher_to_respond = false;
-        break;
-      } else if (i > 0 && queue_.at(i-1)->pts < target_pts && queue_.at(i)->pts > target_pts) {
-
-        // the queue has a frame with a close timestamp that we'll assume is different due to a rounding error
-
-        retrieved_frame = queue_.at(i-1);
-        wait_for_cacher_to_respond = false;
-        break;
-      }
+    retrieved_frame = queue_.Find(target_pts);
+    if (retrieved_frame != nullptr) {
+      wait_for_cacher_to_respond = false;
     }
-    queue_.unlock();
     retrieve_lock_.unlock();
   }
 
@@ -1247,7 +1784,9 @@ void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int pla
   }
 
   // wake up cacher
+  wake_lock_.lock();
   wait_cond_.wakeAll();
+  wake_lock_.unlock();
 
   // if not, wait for cacher to respond
   if (wait_for_cacher_to_respond) {
@@ -1260,6 +1799,33 @@ void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int pla
   }
 }
 
+void Cacher::Prefetch(long playhead, QVector<Clip *> &nests, int playback_speed)
+{
+  // requesting the same frame again would only queue another cache cycle behind the one that's seeking to it
+  if (!is_valid_state_ || playhead == prefetch_playhead_) {
+    return;
+  }
+
+  prefetch_playhead_ = playhead;
+
+  if (playback_speed != 0) {
+    direction_ = (playback_speed > 0) ? 1 : -1;
+  }
+
+  olive::frame_budget.Touch(this, nests.isEmpty() ? clip->track() : nests.first()->track());
+
+  playhead_ = playhead;
+  nests_ = nests;
+  scrubbing_ = false;
+  playback_speed_ = playback_speed;
+
+  // wake up cacher, nothing waits for it to respond
+  wake_lock_.lock();
+  queued_ = true;
+  wait_cond_.wakeAll();
+  wake_lock_.unlock();
+}
+
 AVFrame *Cacher::Retrieve()
 {
   if (!caching_) {
@@ -1298,24 +1864,56 @@ AVFrame *Cacher::Retrieve()
 
 void Cacher::Close(bool wait_for_finish)
 {
+  wake_lock_.lock();
   caching_ = false;
   wait_cond_.wakeAll();
+  wake_lock_.unlock();
 
   if (wait_for_finish) {
     wait();
   }
 }
 
+void Cacher::RequestTrim()
+{
+  wake_lock_.lock();
+  trim_requested_.store(1);
+  wait_cond_.wakeAll();
+  wake_lock_.unlock();
+}
+
+void Cacher::SetAudioBuffer(AudioMixBuffer *buffer)
+{
+  audio_buffer_ = buffer;
+}
+
+void Cacher::WaitUntilIdle()
+{
+  // the cacher thread only releases Clip::cache_lock while it's waiting for a new request, so if we can hold it while
+  // there's nothing queued, every request has been fully processed
+  while (isRunning()) {
+    clip->cache_lock.lock();
+    bool idle = !queued_;
+    clip->cache_lock.unlock();
+
+    if (idle) {
+      break;
+    }
+
+    QThread::yieldCurrentThread();
+  }
+}
+
 void Cacher::ResetAudio()
 {
-  // using audio_write_lock seems like a good idea, but hasn't been tested yet. If there are audio issues when seeking,
+  // using the audio buffer's lock seems like a good idea, but hasn't been tested yet. If there are audio issues when seeking,
   // try uncommenting them
 
-//  audio_write_lock.lock();
+//  audio_buffer_->lock.lock();
   audio_reset_ = true;
   frame_sample_index_ = -1;
   audio_buffer_write = 0;
-//  audio_write_lock.unlock();
+//  audio_buffer_->lock.unlock();
 }
 
 int Cacher::media_width()
@@ -1328,6 +1926,14 @@ int Cacher::media_height()
   return stream->codecpar->height;
 }
 
+bool Cacher::media_has_alpha()
+{
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(stream->codecpar->format));
+
+  // assume the worst if we don't know the format
+  return (desc == nullptr || (desc->flags & AV_PIX_FMT_FLAG_ALPHA));
+}
+
 AVRational Cacher::media_time_base()
 {
   return stream->time_base;
@@ -1339,6 +1945,8 @@ ClipQueue *Cacher::queue()
 }
 
 int Cacher::RetrieveFrameFromDecoder(AVFrame* f) {
+  TraceScope trace("cacher", "decode", clip->name());
+
   int result = 0;
   int receive_ret;
 
@@ -1382,11 +1990,14 @@ int Cacher::RetrieveFrameFromDecoder(AVFrame* f) {
 
 int Cacher::RetrieveFrameAndProcess(AVFrame **f)
 {
+  // decoding happens inside this function too, and shows up as nested "decode" events
+  TraceScope trace("cacher", "filter", clip->name());
+
   // error codes from FFmpeg
   int retrieve_code, read_code, send_code;
 
   // frame for FFmpeg to decode into
-  *f = av_frame_alloc();
+  *f = frame_pool_.Get();
 
   // loop to pull frames from the AVFilter stack
   while ((retrieve_code = av_buffersink_get_frame(buffersink_ctx, *f)) == AVERROR(EAGAIN)) {
@@ -1423,3 +2034,55 @@ int Cacher::RetrieveFrameAndProcess(AVFrame **f)
   }
   return retrieve_code;
 }
+
+qint64 Cacher::QueuedFrameSize()
+{
+  if (queue_.isEmpty()) {
+    return 0;
+  }
+
+  // every frame in the queue comes out of the same filter graph, so they're all the same size
+  AVFrame* f = queue_.first();
+  return qint64(f->linesize[0]) * f->height;
+}
+
+void Cacher::UpdateFrameBudget()
+{
+  olive::frame_budget.SetUsage(this, queue_.size() * QueuedFrameSize());
+}
+
+void Cacher::TrimToBudget()
+{
+  qint64 frame_size = QueuedFrameSize();
+
+  if (frame_size == 0) {
+    return;
+  }
+
+  qint64 share = olive::frame_budget.Share(this);
+
+  int64_t target_pts = seconds_to_timestamp(clip, playhead_to_clip_seconds(clip, playhead_));
+
+  // a reversed clip moves backwards through its media
+  bool forward = ((clip->reversed() ? -direction_ : direction_) > 0);
+
+  while (queue_.size() > 1 && queue_.size() * frame_size > share) {
+    if (forward) {
+      if (queue_.first()->pts < target_pts) {
+        // already played
+        queue_.removeFirst();
+      } else {
+        // furthest ahead
+        queue_.removeLast();
+      }
+    } else {
+      if (queue_.last()->pts > target_pts) {
+        queue_.removeLast();
+      } else {
+        queue_.removeFirst();
+      }
+    }
+  }
+
+  UpdateFrameBudget();
+}
@@ -38,13 +38,16 @@ extern "C" {
 
 #include <memory>
 #include <QThread>
+#include <QAtomicInt>
 #include <QVector>
 #include <QWaitCondition>
 #include <QMutex>
 
 #include "rendering/clipqueue.h"
+#include "rendering/framepool.h"
 
 class Clip;
+class AudioMixBuffer;
 
 /**
  * @brief The Cacher class
@@ -129,6 +132,14 @@ public:
    */
   void Open();
 
+  /**
+   * @brief Number of cachers that are currently open
+   *
+   * Counts every cacher from Open() until its thread has finished closing its file handles. Used to cap how many
+   * decoders clips opened ahead of time by compose_sequence() can hold at once (see Config::max_open_decoders).
+   */
+  static int open_count();
+
   /**
    * @brief Request a frame to be cached
    *
@@ -162,6 +173,15 @@ public:
    */
   void Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int playback_speed);
 
+  /**
+   * @brief Start caching a video frame that isn't needed yet
+   *
+   * Used for clips that are opened ahead of time by compose_sequence() to seek to the frame they'll be shown at.
+   * Unlike Cache(), this never waits for the cacher and doesn't expect Retrieve() to be called afterwards. Each frame
+   * is only requested once, so calling this again for the same frame doesn't restart the seek.
+   */
+  void Prefetch(long playhead, QVector<Clip*>& nests, int playback_speed);
+
   /**
    * @brief Retrieve frame requested by Cache()
    *
@@ -202,6 +222,30 @@ public:
    */
   void ResetAudio();
 
+  /**
+   * @brief Ask the cacher to trim its queue down to its share of the frame memory budget
+   *
+   * Called by FrameBudget when a more important Cacher needs memory. The queue can only be changed from the cacher's
+   * own thread, so this only wakes it up to do the trimming.
+   */
+  void RequestTrim();
+
+  /**
+   * @brief Set the buffer audio is mixed into
+   *
+   * Defaults to the live playback buffer (playback_audio). Only valid for audio clips and must be set before Open(),
+   * since the audio filter graph is built for the buffer's sample rate.
+   */
+  void SetAudioBuffer(AudioMixBuffer* buffer);
+
+  /**
+   * @brief Block until the cacher has finished processing every request made with Cache()
+   *
+   * Mostly useful for audio where Cache() returns before the samples have been mixed, and an offline render needs them
+   * all before it can continue.
+   */
+  void WaitUntilIdle();
+
   /**
    * @brief Retrieve current media width
    *
@@ -230,6 +274,16 @@ public:
    */
   int media_height();
 
+  /**
+   * @brief Returns whether the decoded media has an alpha channel
+   *
+   * Frames are always converted to RGBA, but if the source pixel format has no alpha channel, every pixel is opaque
+   * and there's no need to premultiply it.
+   *
+   * Only call after the thread has been opened by Open().
+   */
+  bool media_has_alpha();
+
   /**
    * @brief Retrieve media time base
    *
@@ -260,6 +314,14 @@ private:
    */
   Clip* clip;
 
+  /**
+   * @brief Frame pool
+   *
+   * Recycles frames removed from the queue and serves the decoder's buffers. Declared before queue_ so that it outlives
+   * it.
+   */
+  FramePool frame_pool_;
+
   /**
    * @brief Frame queue
    *
@@ -270,11 +332,20 @@ private:
   /**
    * @brief Main wait condition
    *
-   * Used with Clip::cache_lock as the main block while the the Cacher thread isn't running. Wake this condition
-   * to start caching.
+   * Used with wake_lock_ as the main block while the the Cacher thread isn't running. Wake this condition (while
+   * holding wake_lock_) to start caching.
    */
   QWaitCondition wait_cond_;
 
+  /**
+   * @brief Lock the cacher waits on wait_cond_ with
+   *
+   * Separate from Clip::cache_lock (which is held for a whole cache cycle) so other cachers' threads can take it in
+   * RequestTrim() without risking a deadlock. Every request that wakes the cacher is signalled while holding it, so
+   * no wakeup can be lost between the cacher checking for work and starting to wait.
+   */
+  QMutex wake_lock_;
+
   /**
    * @brief Main thread wait condition
    *
@@ -351,12 +422,37 @@ private:
    */
   bool interrupt_;
 
+  /**
+   * @brief Set by RequestTrim() to make the cacher trim its queue before (or instead of) its next cache cycle
+   *
+   * Set while holding wake_lock_, atomic since it's cleared after the cacher has released wake_lock_.
+   */
+  QAtomicInt trim_requested_;
+
+  /**
+   * @brief Direction the clip's media was last moving in, 1 for forwards, -1 for backwards
+   *
+   * Follows the playback speed during playback and the direction of the last playhead movement while scrubbing. Used
+   * to decide which frames are least likely to be needed when trimming the queue (see TrimToBudget()).
+   */
+  int direction_;
+
+  /**
+   * @brief Frame last requested with Prefetch(), -1 if Cache() was called since
+   */
+  long prefetch_playhead_;
+
   // ffmpeg media handling
   /**
    * @brief FFmpeg format/file context - used for media decoding
    */
   AVFormatContext* formatCtx;
 
+  /**
+   * @brief Filename formatCtx was opened from, used to hand it back to olive::decoder_pool when closing
+   */
+  QString filename_;
+
   /**
    * @brief FFmpeg decoder context - used for media decoding
    */
@@ -452,11 +548,33 @@ private:
    */
   qint64 audio_buffer_write;
 
+  /**
+   * @brief Whether audio is currently mixed from olive::audio_page_cache rather than the decoder
+   *
+   * Decided by MixPagedAudio() after every audio reset and kept until the next one.
+   */
+  bool paged_audio_;
+
+  /**
+   * @brief Frame MixPagedAudio() converts audio from the page cache into before effects are applied to it
+   */
+  AVFrame* paged_frame_;
+
+  /**
+   * @brief Float samples read from the page cache by MixPagedAudio()
+   */
+  QVector<float> paged_samples_;
+
   /**
    * @brief Internal variable that holds the playhead the last time the audio state was reset
    */
   long audio_target_frame;
 
+  /**
+   * @brief Buffer audio is mixed into, set by SetAudioBuffer()
+   */
+  AudioMixBuffer* audio_buffer_;
+
   /**
    * @brief Main while loop condition to determine whether thread should continue looping
    *
@@ -552,9 +670,9 @@ private:
    *
    * @param f
    *
-   * A pointer to an AVFrame object. It does not need to be allocated, as this function allocates an AVFrame itself.
-   * You'll also need to free it later with av_frame_free() (though ClipQueue will do this automatically if the frame is
-   * added to it).
+   * A pointer to an AVFrame object. It does not need to be allocated, as this function gets an AVFrame from the frame
+   * pool itself. You'll also need to release it later with FramePool::Release() (though ClipQueue will do this
+   * automatically if the frame is added to it).
    *
    * @return
    *
@@ -570,6 +688,54 @@ private:
    */
   void CacheVideoWorker();
 
+  /**
+   * @brief Internal reversed video caching function
+   *
+   * Called by CacheVideoWorker() when the media is playing in reverse (see IsReversed()). Rather than seeking backwards
+   * for every frame, this decodes one GOP at a time forward from its keyframe and puts it in front of the queue so the
+   * frames can be retrieved in reverse order. Once the target frame has been delivered, it keeps decoding earlier GOPs
+   * in the background until the "upcoming" queue limit is reached, and trims frames that have already been played
+   * according to the "previous" queue limit.
+   */
+  void CacheVideoReverseWorker();
+
+  /**
+   * @brief Internal function for decoding one chunk of frames for reversed playback
+   *
+   * Seeks to the keyframe before `end_pts` and decodes forward up to it.
+   *
+   * @param end_pts
+   *
+   * Timestamp to decode up to.
+   *
+   * @param end_inclusive
+   *
+   * **TRUE** if the frame at `end_pts` should be included in the chunk, **FALSE** if the chunk should stop right before
+   * it (e.g. because it's already in the queue).
+   *
+   * @param max_frames
+   *
+   * Maximum amount of frames to keep. If the GOP is longer than this, the earliest frames are dropped.
+   *
+   * @param chunk
+   *
+   * Array to fill with decoded frames in chronological order. Ownership of the frames is passed to the caller.
+   *
+   * @param reached_start
+   *
+   * Set to **TRUE** if the chunk starts at the beginning of the stream and there's nothing earlier to decode.
+   *
+   * @return
+   *
+   * **TRUE** if a complete chunk was decoded, **FALSE** if there was an error or the cacher was interrupted, in which
+   * case `chunk` is left empty.
+   */
+  bool DecodeReverseChunk(int64_t end_pts,
+                          bool end_inclusive,
+                          int max_frames,
+                          QVector<AVFrame*>& chunk,
+                          bool& reached_start);
+
   /**
    * @brief Internal audio caching function
    *
@@ -578,10 +744,39 @@ private:
    */
   void CacheAudioWorker();
 
+  /**
+   * @brief Mix audio for scrubbing or shuttle playback from olive::audio_page_cache
+   *
+   * Renders audio straight from decoded pages in memory at the current playback speed, which avoids seeking the
+   * decoder every time the playhead jumps. Only used while scrubbing or playing at a speed other than 1x, and only
+   * once the audio around the playhead has been decoded into the page cache.
+   *
+   * @return **TRUE** if the audio was handled here, **FALSE** if CacheAudioWorker() should decode it as usual.
+   */
+  bool MixPagedAudio();
+
   /**
    * @brief Internal function using the Cacher's known information to determine whether this media is playing in reverse
    */
   bool IsReversed();
+
+  /**
+   * @brief Size in bytes of one frame in the queue, or 0 if the queue is empty
+   */
+  qint64 QueuedFrameSize();
+
+  /**
+   * @brief Report the queue's current memory usage to the global FrameBudget
+   */
+  void UpdateFrameBudget();
+
+  /**
+   * @brief Trim the queue down to this cacher's share of the global FrameBudget
+   *
+   * Frames that are behind the playhead in the direction the media is moving go first, then the frames furthest
+   * ahead. The frame closest to the playhead is always kept.
+   */
+  void TrimToBudget();
 };
 
 #endif // CACHER_H
@@ -20,86 +20,221 @@
 
 #include "clipqueue.h"
 
+#include "rendering/framepool.h"
+
+ClipQueue::ClipQueue() :
+  head_(0),
+  tail_(0),
+  version_(0),
+  epoch_(1),
+  reader_epoch_(0),
+  frame_pool_(nullptr)
+{
+  for (quint64 i=0;i<kCapacity;i++) {
+    slots_[i].store(nullptr);
+  }
+}
 
-ClipQueue::ClipQueue()
+ClipQueue::~ClipQueue()
 {
+  clear();
 
+  // nothing can be reading anymore, free everything
+  for (int i=0;i<retired_.size();i++) {
+    FreeFrame(&retired_[i].frame);
+  }
 }
 
-ClipQueue::~ClipQueue()
+void ClipQueue::SetFramePool(FramePool *pool)
 {
-  clear();
+  frame_pool_ = pool;
 }
 
-void ClipQueue::lock()
+bool ClipQueue::append(AVFrame *frame)
 {
-  queue_lock.lock();
+  if (isFull()) {
+    return false;
+  }
+
+  quint64 tail = tail_.load(std::memory_order_relaxed);
+
+  // the frame must be visible before the reader can see the new tail
+  slots_[tail & (kCapacity - 1)].store(frame, std::memory_order_release);
+  tail_.store(tail + 1, std::memory_order_release);
+  version_.fetch_add(1);
+
+  return true;
 }
 
-bool ClipQueue::tryLock()
+bool ClipQueue::prepend(AVFrame *frame)
 {
-  return queue_lock.tryLock();
+  if (isFull()) {
+    return false;
+  }
+
+  quint64 head = head_.load(std::memory_order_relaxed) - 1;
+
+  slots_[head & (kCapacity - 1)].store(frame, std::memory_order_release);
+  head_.store(head, std::memory_order_release);
+  version_.fetch_add(1);
+
+  return true;
 }
 
-void ClipQueue::unlock()
+void ClipQueue::removeFirst()
 {
-  queue_lock.unlock();
+  quint64 head = head_.load(std::memory_order_relaxed);
+
+  AVFrame* frame = slots_[head & (kCapacity - 1)].exchange(nullptr);
+  head_.store(head + 1);
+  version_.fetch_add(1);
+
+  Retire(frame);
 }
 
-void ClipQueue::append(AVFrame *frame)
+void ClipQueue::removeLast()
 {
-  queue.append(frame);
+  quint64 tail = tail_.load(std::memory_order_relaxed) - 1;
+
+  tail_.store(tail);
+  AVFrame* frame = slots_[tail & (kCapacity - 1)].exchange(nullptr);
+  version_.fetch_add(1);
+
+  Retire(frame);
 }
 
-AVFrame *ClipQueue::at(int i)
+void ClipQueue::clear()
 {
-  return queue.at(i);
+  while (!isEmpty()) {
+    removeFirst();
+  }
 }
 
-AVFrame *ClipQueue::first()
+bool ClipQueue::isFull()
 {
-  return queue.first();
+  return quint64(size()) >= kCapacity;
 }
 
-AVFrame *ClipQueue::last()
+void ClipQueue::BeginRead()
 {
-  return queue.last();
+  // keep the original epoch if we're already reading
+  if (reader_epoch_.load(std::memory_order_relaxed) == 0) {
+    reader_epoch_.store(epoch_.load());
+
+    // the announcement must be visible to the writer before we look at any slots
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
 }
 
-void ClipQueue::removeFirst()
+void ClipQueue::EndRead()
 {
-  removeAt(0);
+  reader_epoch_.store(0);
 }
 
-void ClipQueue::removeLast()
+AVFrame *ClipQueue::Find(int64_t pts)
 {
-  removeAt(queue.size()-1);
+  // if the writer changed the queue while we were scanning, the frames we saw may not have been in order, so scan again
+  for (int attempt=0;attempt<3;attempt++) {
+    quint64 version = version_.load(std::memory_order_acquire);
+    quint64 head = head_.load(std::memory_order_acquire);
+    quint64 tail = tail_.load(std::memory_order_acquire);
+
+    AVFrame* previous = nullptr;
+    AVFrame* found = nullptr;
+
+    for (quint64 i=head;i!=tail;i++) {
+      AVFrame* f = slots_[i & (kCapacity - 1)].load(std::memory_order_acquire);
+
+      if (f == nullptr) {
+        continue;
+      }
+
+      if (f->pts == pts) {
+
+        // the queue has a frame with the exact timestamp
+        found = f;
+        break;
+
+      } else if (previous != nullptr && previous->pts < pts && f->pts > pts) {
+
+        // the queue has a frame with a close timestamp that we'll assume is different due to a rounding error
+        found = previous;
+        break;
+
+      }
+
+      previous = f;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (version == version_.load(std::memory_order_relaxed)) {
+      return found;
+    }
+  }
+
+  return nullptr;
 }
 
-void ClipQueue::removeAt(int i)
+AVFrame *ClipQueue::at(int i)
 {
-  av_frame_free(&queue[i]);
-  queue.removeAt(i);
+  return slots_[(head_.load(std::memory_order_acquire) + quint64(i)) & (kCapacity - 1)].load(std::memory_order_acquire);
 }
 
-void ClipQueue::clear()
+AVFrame *ClipQueue::first()
 {
-  while (queue.size() > 0) {
-    removeAt(0);
-  }
+  return at(0);
+}
+
+AVFrame *ClipQueue::last()
+{
+  return at(size() - 1);
 }
 
 int ClipQueue::size()
 {
-  return queue.size();
+  return int(tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire));
 }
 
 bool ClipQueue::isEmpty()
 {
-  return queue.isEmpty();
+  return size() == 0;
+}
+
+void ClipQueue::Retire(AVFrame *frame)
+{
+  if (frame != nullptr) {
+    RetiredFrame r;
+    r.frame = frame;
+    r.epoch = epoch_.fetch_add(1);
+    retired_.append(r);
+  }
+
+  Reclaim();
 }
 
-bool ClipQueue::contains(AVFrame *frame)
+void ClipQueue::Reclaim()
 {
-  return queue.contains(frame);
+  // make sure the removal is visible to the reader before we check whether it's reading
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  quint64 reader_epoch = reader_epoch_.load();
+
+  for (int i=retired_.size()-1;i>=0;i--) {
+    // a frame is safe to free if the reader isn't reading, or started reading after the frame was retired (and
+    // therefore can't have seen it)
+    if (reader_epoch == 0 || reader_epoch > retired_.at(i).epoch) {
+      FreeFrame(&retired_[i].frame);
+      retired_.removeAt(i);
+    }
+  }
+}
+
+void ClipQueue::FreeFrame(AVFrame **frame)
+{
+  if (frame_pool_ != nullptr) {
+    frame_pool_->Release(frame);
+  } else {
+    av_frame_free(frame);
+  }
 }
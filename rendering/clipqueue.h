@@ -25,13 +25,25 @@ extern "C" {
 #include <libavformat/avformat.h>
 }
 
+#include <atomic>
 #include <QVector>
-#include <QMutex>
+
+class FramePool;
 
 /**
  * @brief The ClipQueue class
  *
- * A fairly simple wrapper for a QVector and QMutex that cleans up AVFrames automatically when removing them.
+ * A fixed-capacity ring buffer of decoded frames shared between a Cacher thread and the render thread without any
+ * locking.
+ *
+ * The queue has exactly one writer (the Cacher thread), which is the only thread allowed to add or remove frames and
+ * keeps them in chronological (pts) order. The render thread is the only reader and may look up frames at any time,
+ * as long as it does so between BeginRead() and EndRead().
+ *
+ * Frames removed by the writer aren't freed immediately. They're "retired" and tagged with the current epoch, and only
+ * freed once the reader is guaranteed not to be holding a pointer to them, i.e. the reader is outside of a read
+ * section or started its current one after the frame was retired. This means a frame that's being uploaded by the
+ * render thread can never be freed underneath it, even if the Cacher has already moved on.
  */
 class ClipQueue {
 public:
@@ -43,49 +55,105 @@ public:
   /**
    * @brief ClipQueue Destructor
    *
-   * Automatically clears queue freeing any memory consumed by any AVFrames
+   * Automatically clears queue freeing any memory consumed by any AVFrames, including retired ones
    */
   ~ClipQueue();
 
-  // Thread safety (QMutex compatible)
   /**
-   * @brief Lock queue mutex
+   * @brief Set a FramePool to return removed frames to
    *
-   * Used for multithreading to ensure queue is only accessed by one thread at a time. See QMutex::lock() for more
-   * information.
+   * If no pool is set, removed frames are simply freed.
    */
-  void lock();
+  void SetFramePool(FramePool* pool);
 
+  // Writer functions (Cacher thread only)
   /**
-   * @brief Try to lock queue mutex
+   * @brief Add a frame to the end of the queue
+   *
+   * @param frame
    *
-   * Used for multithreading to ensure queue is only accessed by one thread at a time. Tries to lock, but doesn't block
-   * the calling thread and wait if it can't lock it. See QMutex::tryLock() for more information.
+   * The frame to add
    *
    * @return
    *
-   * **TRUE** if the lock succeeded, **FALSE** if not.
+   * **TRUE** if the frame was added, **FALSE** if the queue is full. If the frame couldn't be added, ownership stays
+   * with the caller.
    */
-  bool tryLock();
+  bool append(AVFrame* frame);
 
   /**
-   * @brief Unlock queue mutex
+   * @brief Add a frame to the start of the queue
+   *
+   * @param frame
+   *
+   * The frame to add
+   *
+   * @return
    *
-   * Used for multithreading to ensure queue is only accessed by one thread at a time. See QMutex::unlock() for more
-   * information.
+   * **TRUE** if the frame was added, **FALSE** if the queue is full. If the frame couldn't be added, ownership stays
+   * with the caller.
    */
-  void unlock();
+  bool prepend(AVFrame* frame);
 
-  // Array handling (QVector compatible)
   /**
-   * @brief Add a frame to the end of the queue
+   * @brief Remove first frame in the queue
    *
-   * @param frame
+   * Removes the frame from the queue and frees it as soon as the reader can no longer be using it
+   */
+  void removeFirst();
+
+  /**
+   * @brief Remove last frame in the queue
    *
-   * The frame to add
+   * Removes the frame from the queue and frees it as soon as the reader can no longer be using it
    */
-  void append(AVFrame* frame);
+  void removeLast();
 
+  /**
+   * @brief Clear entire queue
+   *
+   * Removes all frames, freeing them as soon as the reader can no longer be using them
+   */
+  void clear();
+
+  /**
+   * @brief Returns whether the queue has room for more frames
+   */
+  bool isFull();
+
+  // Reader functions (render thread only)
+  /**
+   * @brief Start a read section
+   *
+   * Any frame retrieved from the queue after this call stays valid until EndRead() is called, even if the writer
+   * removes it in the meantime. Calling BeginRead() again without EndRead() keeps the original section open.
+   */
+  void BeginRead();
+
+  /**
+   * @brief End a read section
+   *
+   * Frame pointers obtained during the read section must not be used after this.
+   */
+  void EndRead();
+
+  /**
+   * @brief Find the frame for a timestamp
+   *
+   * Must be called during a read section.
+   *
+   * @param pts
+   *
+   * Timestamp to search for
+   *
+   * @return
+   *
+   * The frame with exactly this timestamp, or the frame directly before it if the timestamp falls between two
+   * frames (usually a rounding error). `nullptr` if no appropriate frame is in the queue.
+   */
+  AVFrame* Find(int64_t pts);
+
+  // Common functions (safe for both, but the reader must be in a read section and may see a slightly stale queue)
   /**
    * @brief Retrieve a frame at a certain index
    *
@@ -117,45 +185,12 @@ public:
    */
   AVFrame* last();
 
-  /**
-   * @brief Remove first frame in the queue
-   *
-   * Frees all memory occupied by this frame and removes it from the queue
-   */
-  void removeFirst();
-
-  /**
-   * @brief Remove last frame in the queue
-   *
-   * Frees all memory occupied by this frame and removes it from the queue
-   */
-  void removeLast();
-
-  /**
-   * @brief Remove frame in the queue at a certain index
-   *
-   * Frees all memory occupied by this frame and removes it from the queue
-   *
-   * @param i
-   *
-   * Index to remove a frame at
-   */
-  void removeAt(int i);
-
-  /**
-   * @brief Clear entire queue
-   *
-   * Frees all memory occupied by all frames and clears the entire queue
-   */
-  void clear();
-
   /**
    * @brief Retrieve current size of the queue
    *
    * @return
    *
-   * Current the current size of the queue. All indexes in the queue are guaranteed to be valid references to an
-   * AVFrame.
+   * Current the current size of the queue.
    */
   int size();
 
@@ -168,18 +203,49 @@ public:
    */
   bool isEmpty();
 
+private:
   /**
-   * @brief Returns whether the queue contains a frame or not
-   *
-   * @return
-   *
-   * **TRUE** if the queue contains the specified frame, **FALSE** if not.
+   * @brief Internal function to retire a frame that's been removed from the queue
    */
-  bool contains(AVFrame* frame);
+  void Retire(AVFrame* frame);
 
-private:
-  QVector<AVFrame*> queue;
-  QMutex queue_lock;
+  /**
+   * @brief Internal function to free any retired frames the reader can no longer be using
+   */
+  void Reclaim();
+
+  /**
+   * @brief Internal function to free a frame or return it to the frame pool
+   */
+  void FreeFrame(AVFrame** frame);
+
+  struct RetiredFrame {
+    AVFrame* frame;
+    quint64 epoch;
+  };
+
+  // must be a power of two
+  static const quint64 kCapacity = 1024;
+
+  std::atomic<AVFrame*> slots_[kCapacity];
+
+  // head_ and tail_ are free-running counters, wrapping around is fine since kCapacity is a power of two
+  std::atomic<quint64> head_;
+  std::atomic<quint64> tail_;
+
+  // incremented after every change to the queue so the reader can tell if it changed while scanning
+  std::atomic<quint64> version_;
+
+  // incremented every time a frame is retired
+  std::atomic<quint64> epoch_;
+
+  // epoch the reader entered its current read section at, 0 if the reader is not reading
+  std::atomic<quint64> reader_epoch_;
+
+  // only accessed by the writer
+  QVector<RetiredFrame> retired_;
+
+  FramePool* frame_pool_;
 };
 
 #endif // CLIPQUEUE_H
@@ -0,0 +1,300 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "decoderpool.h"
+
+#include <QFileInfo>
+#include <QMutexLocker>
+
+DecoderPool olive::decoder_pool;
+
+// maximum amount of warm decoders kept across all files, each one holds a demuxer, a decoder and its threads
+const int kMaxWarmDecoders = 8;
+
+// maximum amount of warm decoders kept for the same stream of the same file
+const int kMaxWarmPerStream = 2;
+
+DecoderPool::DecoderPool() {}
+
+DecoderPool::~DecoderPool()
+{
+  Clear();
+
+  QMap<QString, Probe>::iterator i;
+  for (i=probes_.begin();i!=probes_.end();i++) {
+    FreeProbe(i.value());
+  }
+  probes_.clear();
+}
+
+void DecoderPool::StoreProbe(const QString &filename, AVFormatContext *ctx)
+{
+  Probe probe;
+  if (!IdentifyFile(filename, &probe.id)) {
+    return;
+  }
+
+  probe.start_time = ctx->start_time;
+  probe.duration = ctx->duration;
+  probe.bit_rate = ctx->bit_rate;
+
+  for (unsigned int i=0;i<ctx->nb_streams;i++) {
+    AVStream* s = ctx->streams[i];
+
+    StreamProbe sp;
+    sp.codecpar = avcodec_parameters_alloc();
+    if (sp.codecpar == nullptr || avcodec_parameters_copy(sp.codecpar, s->codecpar) < 0) {
+      avcodec_parameters_free(&sp.codecpar);
+      FreeProbe(probe);
+      return;
+    }
+    sp.avg_frame_rate = s->avg_frame_rate;
+    sp.r_frame_rate = s->r_frame_rate;
+    sp.sample_aspect_ratio = s->sample_aspect_ratio;
+    sp.start_time = s->start_time;
+    sp.duration = s->duration;
+    sp.nb_frames = s->nb_frames;
+
+    probe.streams.append(sp);
+  }
+
+  QMutexLocker locker(&lock_);
+
+  QMap<QString, Probe>::iterator existing = probes_.find(filename);
+  if (existing != probes_.end()) {
+    FreeProbe(existing.value());
+  }
+
+  probes_.insert(filename, probe);
+}
+
+bool DecoderPool::ApplyProbe(const QString &filename, AVFormatContext *ctx)
+{
+  FileId id;
+  if (!IdentifyFile(filename, &id)) {
+    return false;
+  }
+
+  // formats without a header only find their streams while probing
+  if (ctx->ctx_flags & AVFMTCTX_NOHEADER) {
+    return false;
+  }
+
+  QMutexLocker locker(&lock_);
+
+  QMap<QString, Probe>::iterator i = probes_.find(filename);
+  if (i == probes_.end()) {
+    return false;
+  }
+
+  Probe& probe = i.value();
+
+  // the file has changed since it was probed
+  if (!(probe.id == id)) {
+    FreeProbe(probe);
+    probes_.erase(i);
+    return false;
+  }
+
+  // make sure the header describes the same streams we probed
+  if (int(ctx->nb_streams) != probe.streams.size()) {
+    return false;
+  }
+
+  for (unsigned int j=0;j<ctx->nb_streams;j++) {
+    AVCodecID header_codec = ctx->streams[j]->codecpar->codec_id;
+    if (header_codec != AV_CODEC_ID_NONE && header_codec != probe.streams.at(j).codecpar->codec_id) {
+      return false;
+    }
+  }
+
+  for (unsigned int j=0;j<ctx->nb_streams;j++) {
+    AVStream* s = ctx->streams[j];
+    const StreamProbe& sp = probe.streams.at(j);
+
+    if (avcodec_parameters_copy(s->codecpar, sp.codecpar) < 0) {
+      return false;
+    }
+
+    s->avg_frame_rate = sp.avg_frame_rate;
+    s->r_frame_rate = sp.r_frame_rate;
+    s->sample_aspect_ratio = sp.sample_aspect_ratio;
+
+    if (s->start_time == AV_NOPTS_VALUE) {
+      s->start_time = sp.start_time;
+    }
+    if (s->duration == AV_NOPTS_VALUE) {
+      s->duration = sp.duration;
+    }
+    if (s->nb_frames == 0) {
+      s->nb_frames = sp.nb_frames;
+    }
+  }
+
+  if (ctx->start_time == AV_NOPTS_VALUE) {
+    ctx->start_time = probe.start_time;
+  }
+  if (ctx->duration == AV_NOPTS_VALUE) {
+    ctx->duration = probe.duration;
+  }
+  if (ctx->bit_rate == 0) {
+    ctx->bit_rate = probe.bit_rate;
+  }
+
+  return true;
+}
+
+bool DecoderPool::Take(const QString &filename, int stream_index, AVFormatContext **fmt_ctx, AVCodecContext **codec_ctx)
+{
+  FileId id;
+  if (!IdentifyFile(filename, &id)) {
+    return false;
+  }
+
+  QVector<WarmDecoder> stale;
+  bool found = false;
+
+  lock_.lock();
+
+  // prefer the most recently released decoder
+  for (int i=warm_.size()-1;i>=0;i--) {
+    if (warm_.at(i).filename == filename) {
+      if (!(warm_.at(i).id == id)) {
+        // the file has changed since this decoder was opened
+        stale.append(warm_.takeAt(i));
+      } else if (!found && warm_.at(i).stream_index == stream_index) {
+        *fmt_ctx = warm_.at(i).fmt_ctx;
+        *codec_ctx = warm_.at(i).codec_ctx;
+        warm_.removeAt(i);
+        found = true;
+      }
+    }
+  }
+
+  lock_.unlock();
+
+  for (int i=0;i<stale.size();i++) {
+    FreeWarmDecoder(stale[i]);
+  }
+
+  return found;
+}
+
+void DecoderPool::Release(const QString &filename, int stream_index, AVFormatContext *fmt_ctx, AVCodecContext *codec_ctx)
+{
+  WarmDecoder w;
+  w.filename = filename;
+  w.stream_index = stream_index;
+  w.fmt_ctx = fmt_ctx;
+  w.codec_ctx = codec_ctx;
+
+  if (!IdentifyFile(filename, &w.id)) {
+    FreeWarmDecoder(w);
+    return;
+  }
+
+  avcodec_flush_buffers(codec_ctx);
+
+  // the decoder's picture buffers came from the closing Cacher's FramePool, the next owner will set up its own
+  codec_ctx->opaque = nullptr;
+
+  QVector<WarmDecoder> evicted;
+
+  lock_.lock();
+
+  // evict the oldest decoder for this stream if there are too many
+  int same_stream = 0;
+  for (int i=warm_.size()-1;i>=0;i--) {
+    if (warm_.at(i).filename == filename && warm_.at(i).stream_index == stream_index) {
+      same_stream++;
+      if (same_stream >= kMaxWarmPerStream) {
+        evicted.append(warm_.takeAt(i));
+      }
+    }
+  }
+
+  warm_.append(w);
+
+  while (warm_.size() > kMaxWarmDecoders) {
+    evicted.append(warm_.takeFirst());
+  }
+
+  lock_.unlock();
+
+  for (int i=0;i<evicted.size();i++) {
+    FreeWarmDecoder(evicted[i]);
+  }
+}
+
+void DecoderPool::Clear()
+{
+  lock_.lock();
+  QVector<WarmDecoder> warm = warm_;
+  warm_.clear();
+  lock_.unlock();
+
+  for (int i=0;i<warm.size();i++) {
+    FreeWarmDecoder(warm[i]);
+  }
+}
+
+int DecoderPool::warm_count()
+{
+  QMutexLocker locker(&lock_);
+  return warm_.size();
+}
+
+bool DecoderPool::IdentifyFile(const QString &filename, FileId *id)
+{
+  QFileInfo info(filename);
+
+  if (!info.isFile()) {
+    return false;
+  }
+
+  id->size = info.size();
+  id->modified = info.lastModified();
+
+  return true;
+}
+
+void DecoderPool::FreeProbe(Probe &probe)
+{
+  for (int i=0;i<probe.streams.size();i++) {
+    avcodec_parameters_free(&probe.streams[i].codecpar);
+  }
+  probe.streams.clear();
+}
+
+void DecoderPool::FreeWarmDecoder(WarmDecoder &w)
+{
+  if (w.codec_ctx != nullptr) {
+    avcodec_free_context(&w.codec_ctx);
+  }
+
+  if (w.fmt_ctx != nullptr) {
+    avformat_close_input(&w.fmt_ctx);
+  }
+}
+
+bool DecoderPool::FileId::operator==(const DecoderPool::FileId &rhs) const
+{
+  return size == rhs.size && modified == rhs.modified;
+}
@@ -0,0 +1,170 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DECODERPOOL_H
+#define DECODERPOOL_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+#include <QDateTime>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <QMap>
+
+/**
+ * @brief Process-wide cache of probed stream parameters and recently closed decoders
+ *
+ * Every time a clip is opened, its Cacher opens the file, probes it and opens a decoder. avformat_find_stream_info()
+ * alone can read megabytes of the file and take hundreds of milliseconds on long-GOP or network-mounted media, and
+ * clips are opened and closed constantly while playing or scrubbing across cuts. This class removes most of that cost
+ * in two ways:
+ *
+ * * The stream parameters found by probing a file are stored (by PreviewGenerator when the footage is imported, or by
+ *   the first Cacher that opens it) and applied to later opens instead of probing again.
+ * * When a Cacher closes, its demuxer and decoder aren't destroyed but flushed and kept "warm" for a while. The next
+ *   Cacher that opens the same stream of the same file takes them over. Cachers always seek before decoding their
+ *   first frame, so the previous read position doesn't matter.
+ *
+ * Entries are keyed by filename and are discarded if the file's size or modification time has changed since. Only
+ * regular files are cached, image sequence patterns and URLs are always opened from scratch.
+ *
+ * All functions are thread-safe.
+ */
+class DecoderPool {
+public:
+  DecoderPool();
+
+  /**
+   * @brief DecoderPool Destructor
+   *
+   * Frees all probes and warm decoders.
+   */
+  ~DecoderPool();
+
+  /**
+   * @brief Remember the stream parameters of a file that has just been probed with avformat_find_stream_info()
+   */
+  void StoreProbe(const QString& filename, AVFormatContext* ctx);
+
+  /**
+   * @brief Apply stored stream parameters to a file that has just been opened with avformat_open_input()
+   *
+   * @return **TRUE** if stored parameters matching the file's streams were found and applied, in which case
+   * avformat_find_stream_info() can be skipped. **FALSE** if the file has to be probed as usual.
+   */
+  bool ApplyProbe(const QString& filename, AVFormatContext* ctx);
+
+  /**
+   * @brief Take over a warm demuxer and decoder for a stream of a file
+   *
+   * The decoder is already open and flushed. The caller owns both contexts and should either hand them back with
+   * Release() or free them itself.
+   *
+   * @return **TRUE** if a warm decoder was found, **FALSE** if the caller has to open the file itself.
+   */
+  bool Take(const QString& filename, int stream_index, AVFormatContext** fmt_ctx, AVCodecContext** codec_ctx);
+
+  /**
+   * @brief Hand back a demuxer and an open decoder that are no longer needed
+   *
+   * The decoder is flushed and kept for reuse by Take(). If too many decoders are already kept, the least recently
+   * used ones are freed. Ownership of both contexts passes to the pool.
+   */
+  void Release(const QString& filename, int stream_index, AVFormatContext* fmt_ctx, AVCodecContext* codec_ctx);
+
+  /**
+   * @brief Free all warm decoders
+   *
+   * Stored probes are kept since they're only valid for as long as the file doesn't change anyway.
+   */
+  void Clear();
+
+  /**
+   * @brief Number of warm decoders currently kept
+   */
+  int warm_count();
+
+private:
+  struct FileId {
+    qint64 size;
+    QDateTime modified;
+
+    bool operator==(const FileId& rhs) const;
+  };
+
+  struct StreamProbe {
+    AVCodecParameters* codecpar;
+    AVRational avg_frame_rate;
+    AVRational r_frame_rate;
+    AVRational sample_aspect_ratio;
+    int64_t start_time;
+    int64_t duration;
+    int64_t nb_frames;
+  };
+
+  struct Probe {
+    FileId id;
+    int64_t start_time;
+    int64_t duration;
+    int64_t bit_rate;
+    QVector<StreamProbe> streams;
+  };
+
+  struct WarmDecoder {
+    QString filename;
+    FileId id;
+    int stream_index;
+    AVFormatContext* fmt_ctx;
+    AVCodecContext* codec_ctx;
+  };
+
+  /**
+   * @brief Identify the current state of a file on disk
+   *
+   * @return **FALSE** if the file isn't a regular file and shouldn't be cached.
+   */
+  static bool IdentifyFile(const QString& filename, FileId* id);
+
+  static void FreeProbe(Probe& probe);
+
+  static void FreeWarmDecoder(WarmDecoder& w);
+
+  QMutex lock_;
+
+  QMap<QString, Probe> probes_;
+
+  /**
+   * @brief Warm decoders, least recently used first
+   */
+  QVector<WarmDecoder> warm_;
+};
+
+namespace olive {
+  /**
+   * @brief The probe and decoder cache shared by every Cacher
+   */
+  extern DecoderPool decoder_pool;
+}
+
+#endif // DECODERPOOL_H
@@ -28,6 +28,9 @@ extern "C" {
 }
 
 #include <QApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
 #include <QOffscreenSurface>
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLPaintDevice>
@@ -36,13 +39,11 @@ extern "C" {
 
 #include "global/global.h"
 #include "timeline/sequence.h"
-#include "panels/panels.h"
-#include "ui/viewerwidget.h"
-#include "rendering/renderthread.h"
-#include "rendering/renderfunctions.h"
+#include "project/media.h"
+#include "project/footage.h"
 #include "rendering/audio.h"
-#include "ui/mainwindow.h"
 #include "global/debug.h"
+#include "global/trace.h"
 
 ExportThread::ExportThread(const ExportParams &params,
                            const VideoCodecParams& vparams,
@@ -51,6 +52,7 @@ ExportThread::ExportThread(const ExportParams &params,
   params_(params),
   vcodec_params_(vparams),
   interrupt_(false),
+  renderer_(nullptr),
   fmt_ctx(nullptr),
   video_stream(nullptr),
   vcodec(nullptr),
@@ -66,13 +68,47 @@ ExportThread::ExportThread(const ExportParams &params,
   swr_ctx(nullptr),
   vpkt_alloc(false),
   apkt_alloc(false),
-  c_filename(nullptr)
+  c_filename(nullptr),
+  segment_dir_(nullptr),
+  segment_gop_size_(1),
+  segment_intra_only_(false),
+  audio_segment_(nullptr),
+  succeeded_(false)
 {
   // Create offscreen surface for rendering while exporting
   surface.create();
+
+  // Copy the sequence now so the export isn't affected by any later changes. Segmented and stem exports only keep
+  // this copy until every thread that actually renders has made its own (see ReleaseRenderer()).
+  renderer_ = new OfflineRenderer(params_.sequence);
+
+  // Stems mix a single track each
+  if (params_.audio_track >= 0) {
+    renderer_->SoloAudioTrack(params_.audio_track);
+  }
+
+  if (params_.audio_stems) {
+    PlanStems();
+  } else {
+    // Split long exports so they can be rendered and encoded on several threads
+    PlanSegments();
+  }
+}
+
+ExportThread::~ExportThread()
+{
+  qDeleteAll(video_segments_);
+  delete audio_segment_;
+  qDeleteAll(stem_exports_);
+  delete renderer_;
+
+  // removes the temporary segment files along with the directory
+  delete segment_dir_;
 }
 
 bool ExportThread::Encode(AVFormatContext* ofmt_ctx, AVCodecContext* codec_ctx, AVFrame* frame, AVPacket* packet, AVStream* stream) {
+  TraceScope trace("export", "encode");
+
   ret = avcodec_send_frame(codec_ctx, frame);
   if (ret < 0) {
     qCritical() << "Failed to send frame to encoder." << ret;
@@ -146,10 +182,16 @@ bool ExportThread::SetupVideo() {
   vcodec_ctx->time_base = av_inv_q(vcodec_ctx->framerate);
   video_stream->time_base = vcodec_ctx->time_base;
 
-  if (fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
+  if ((fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER) || params_.global_header) {
     vcodec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
   }
 
+  // Segments must not reference frames outside of themselves so they can be joined back together
+  if (params_.video_gop_size > 0) {
+    vcodec_ctx->gop_size = params_.video_gop_size;
+    vcodec_ctx->flags |= AV_CODEC_FLAG_CLOSED_GOP;
+  }
+
   // Some codecs require special settings so we set that up here
   switch (vcodec_ctx->codec_id) {
 
@@ -193,16 +235,16 @@ bool ExportThread::SetupVideo() {
   video_frame = av_frame_alloc();
   av_frame_make_writable(video_frame);
   video_frame->format = AV_PIX_FMT_RGBA;
-  video_frame->width = olive::ActiveSequence->width;
-  video_frame->height = olive::ActiveSequence->height;
+  video_frame->width = renderer_->sequence()->width;
+  video_frame->height = renderer_->sequence()->height;
   av_frame_get_buffer(video_frame, 0);
 
   av_init_packet(&video_pkt);
 
   // Set up conversion context
   sws_ctx = sws_getContext(
-        olive::ActiveSequence->width,
-        olive::ActiveSequence->height,
+        renderer_->sequence()->width,
+        renderer_->sequence()->height,
         AV_PIX_FMT_RGBA,
         params_.video_width,
         params_.video_height,
@@ -239,8 +281,9 @@ bool ExportThread::SetupAudio() {
   // Set audio stream's ID to 1
   audio_stream->id = 1;
 
-  // set sample rate to use for project
-  audio_rendering_rate = params_.audio_sampling_rate;
+  // mix audio at the export's sample rate, starting at the first exported frame
+  renderer_->audio_buffer()->SetSampleRate(params_.audio_sampling_rate);
+  renderer_->audio_buffer()->Reset(params_.start_frame, renderer_->sequence()->frame_rate);
 
   // Allocate encoding context
   acodec_ctx = avcodec_alloc_context3(acodec);
@@ -263,7 +306,7 @@ bool ExportThread::SetupAudio() {
   acodec_ctx->time_base.den = params_.audio_sampling_rate;
   audio_stream->time_base = acodec_ctx->time_base;
 
-  if (fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
+  if ((fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER) || params_.global_header) {
     acodec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
   }
 
@@ -289,7 +332,7 @@ bool ExportThread::SetupAudio() {
         acodec_ctx->channel_layout,
         acodec_ctx->sample_fmt,
         acodec_ctx->sample_rate,
-        olive::ActiveSequence->audio_layout,
+        renderer_->sequence()->audio_layout,
         AV_SAMPLE_FMT_S16,
         acodec_ctx->sample_rate,
         0,
@@ -339,9 +382,13 @@ bool ExportThread::SetupAudio() {
 
 bool ExportThread::SetupContainer() {
 
-  // Set up output context (using the filename as the format specification)
+  // Set up output context (using the filename as the format specification unless a format was given)
 
-  avformat_alloc_output_context2(&fmt_ctx, nullptr, nullptr, c_filename);
+  QByteArray format_name = params_.format_name.toUtf8();
+  avformat_alloc_output_context2(&fmt_ctx,
+                                 nullptr,
+                                 format_name.isEmpty() ? nullptr : format_name.constData(),
+                                 c_filename);
   if (fmt_ctx == nullptr) {
 
     // Failed to create the output format context. Exit the export and throw an error.
@@ -407,50 +454,41 @@ void ExportThread::Export()
   // Frame counters - used for generating encoding statistics (e.g. average frame time, ETA, etc.)
   long remaining_frames, frame_count = 1;
 
-  // Use Sequence Viewer's render thread - TODO separate this into a new render thread for background rendering
-  RenderThread* renderer = panel_sequence_viewer->viewer_widget->get_renderer();
+  // Without video there's nothing to do per frame, so audio is mixed and encoded in blocks of several seconds as fast
+  // as the clips can be decoded
+  long frame_step = params_.video_enabled ? 1 : renderer_->AudioBlockLength();
 
-  // Override connection from RenderThread
-  disconnect(renderer, SIGNAL(ready()), panel_sequence_viewer->viewer_widget, SLOT(queue_repaint()));
-  connect(renderer, SIGNAL(ready()), this, SLOT(wake()));
+  // Loop from the beginning frame to the end frame
+  for (long frame=params_.start_frame;frame<=params_.end_frame && !interrupt_;frame+=frame_step) {
 
-  // Loop from now (set to the beginning frame earlier) to the end of the frame
-  while (olive::ActiveSequence->playhead <= params_.end_frame && !interrupt_) {
+    // Last frame handled by this iteration
+    long block_end = qMin(frame + frame_step - 1, params_.end_frame);
 
     // Start timing how long this frame will take
     frame_start_time = QDateTime::currentMSecsSinceEpoch();
 
-    // If we're exporting audio, run compose_audio() which will write mixed audio to the internal audio buffer
+    // If we're exporting audio, mix this frame's audio into the renderer's audio buffer
     if (params_.audio_enabled) {
-      waiting_for_audio_ = true;
-      SetAudioWakeObject(this);
-      olive::rendering::compose_audio(nullptr, olive::ActiveSequence.get(), 1, true);
+      renderer_->MixAudio(frame, block_end);
     }
 
-    // If we're exporting video, trigger a render on the RenderThread
+    // If we're exporting video, render the frame into the raw RGBA frame
     if (params_.video_enabled) {
-      do {
-        // TODO optimize by rendering the next frame while encoding the last
-        renderer->start_render(nullptr, olive::ActiveSequence.get(), 1, nullptr, video_frame->data[0], video_frame->linesize[0]/4);
+      TraceScope trace("export", "render");
 
-        // Wait for RenderThread to return
-        waitCond.wait(&mutex);
+      // TODO optimize by rendering the next frame while encoding the last
+      while (!renderer_->RenderFrame(frame, video_frame->data[0], video_frame->linesize[0]/4)) {
 
+        // If some media wasn't ready, do another render
         if (interrupt_) {
           return;
         }
 
-        // If the RenderThread failed, do another render
-      } while (renderer->did_texture_fail());
-
-      if (interrupt_) {
-        return;
       }
-
     }
 
-    // Get the current sequence playhead in seconds (used for timestamp calculations later on)
-    double timecode_secs = double(olive::ActiveSequence->playhead - params_.start_frame) / olive::ActiveSequence->frame_rate;
+    // Get the current frame in seconds (used for timestamp calculations later on)
+    double timecode_secs = double(frame - params_.start_frame) / renderer_->sequence()->frame_rate;
 
     // If we're exporting video, construct an AVFrame in the destination codec's pixel format to convert the raw RGBA
     // OpenGL buffer to
@@ -487,32 +525,13 @@ void ExportThread::Export()
     // If we're exporting audio, copy audio from the buffer into an AVFrame for encoding
     if (params_.audio_enabled) {
 
-      if (waiting_for_audio_ && !interrupt_) {
-        waitCond.wait(&mutex);
-      }
-
-      // Make sure nothing is writing while we're retrieving
-      audio_write_lock.lock();
-
-      // Check if the count of encoded samples exceeds the current Sequence playhead, in which case we don't need to
-      // encode any audio at this moment
-      while (!interrupt_ && file_audio_samples <= (timecode_secs*params_.audio_sampling_rate)) {
+      // Check if the count of encoded samples exceeds the current frame, in which case we don't need to encode any
+      // audio at this moment
+      double block_end_secs = double(block_end - params_.start_frame) / renderer_->sequence()->frame_rate;
+      while (!interrupt_ && file_audio_samples <= (block_end_secs*params_.audio_sampling_rate)) {
 
         // Copy samples from audio buffer to AVFrame
-        int adjusted_read = audio_ibuffer_read%audio_ibuffer_size;
-        int copylen = qMin(aframe_bytes, audio_ibuffer_size-adjusted_read);
-        memcpy(audio_frame->data[0], audio_ibuffer+adjusted_read, copylen);
-        memset(audio_ibuffer+adjusted_read, 0, copylen);
-        audio_ibuffer_read += copylen;
-
-        // If we reached the end of the buffer without reaching the end of the frame, do another copy from the start
-        // of the buffer
-        if (copylen < aframe_bytes) {
-          int remainder_len = aframe_bytes-copylen;
-          memcpy(audio_frame->data[0]+copylen, audio_ibuffer, remainder_len);
-          memset(audio_ibuffer, 0, remainder_len);
-          audio_ibuffer_read += remainder_len;
-        }
+        renderer_->audio_buffer()->Pull(reinterpret_cast<qint8*>(audio_frame->data[0]), aframe_bytes);
 
         // Convert raw audio samples to the destination codec's sample format
         swr_convert_frame(swr_ctx, swr_frame, audio_frame);
@@ -529,31 +548,22 @@ void ExportThread::Export()
         file_audio_samples += swr_frame->nb_samples;
       }
 
-      audio_write_lock.unlock();
-
     }
 
     // Generating encoding statistics (e.g. the time it took to encode this frame/estimated remaining time)
     frame_time = (QDateTime::currentMSecsSinceEpoch()-frame_start_time);
     total_time += frame_time;
-    remaining_frames = (params_.end_frame - olive::ActiveSequence->playhead);
+    remaining_frames = (params_.end_frame - block_end);
     avg_time = (total_time/frame_count);
-    eta = (remaining_frames*avg_time);
+    eta = (remaining_frames*avg_time)/frame_step;
 
     // Emit a signal for the percent of the sequence that's been encoded so far
-    emit ProgressChanged(qRound((double(olive::ActiveSequence->playhead - params_.start_frame) / double(params_.end_frame - params_.start_frame)) * 100.0), eta);
-
-    // Increment sequence playhead
-    olive::ActiveSequence->playhead++;
+    emit ProgressChanged(qRound((double(block_end - params_.start_frame) / double(params_.end_frame - params_.start_frame)) * 100.0), eta);
 
     // Increment frame count (used for generating encoding statistics above)
     frame_count++;
   }
 
-  // Restore original connection from RenderThread
-  disconnect(renderer, SIGNAL(ready()), this, SLOT(wake()));
-  connect(renderer, SIGNAL(ready()), panel_sequence_viewer->viewer_widget, SLOT(queue_repaint()));
-
   if (interrupt_) {
     return;
   }
@@ -561,9 +571,6 @@ void ExportThread::Export()
   if (params_.video_enabled) vpkt_alloc = true;
   if (params_.audio_enabled) apkt_alloc = true;
 
-  olive::Global->set_rendering_state(false);
-  close_active_clips(olive::ActiveSequence.get());
-
   // If audio is enabled, flush the rest of the audio out of swresample
   if (params_.audio_enabled) {
 
@@ -601,6 +608,8 @@ void ExportThread::Export()
     return;
   }
 
+  succeeded_ = true;
+
   emit ProgressChanged(100, 0);
 }
 
@@ -653,23 +662,998 @@ void ExportThread::Cleanup()
     av_frame_free(&sws_frame);
   }
 
+  for (int i=0;i<segment_inputs_.size();i++) {
+    avformat_close_input(&segment_inputs_[i]);
+  }
+  segment_inputs_.clear();
+
+  for (int i=0;i<segment_bsfs_.size();i++) {
+    av_bsf_free(&segment_bsfs_[i]);
+  }
+  segment_bsfs_.clear();
+
   delete [] c_filename;
 }
 
+void ExportThread::PlanSegments()
+{
+  // Segments are never split any further, and there's nothing to split if video is disabled
+  if (!params_.format_name.isEmpty() || !params_.video_enabled) {
+    return;
+  }
+
+  AVCodecID video_codec = static_cast<AVCodecID>(params_.video_codec);
+  const AVCodecDescriptor* codec_desc = avcodec_descriptor_get(video_codec);
+  if (codec_desc == nullptr) {
+    return;
+  }
+
+  // Segments can only be joined losslessly if none of them reference frames in another, so this is limited to
+  // intra-only codecs and encoders known to respect closed GOPs
+  segment_intra_only_ = (codec_desc->props & AV_CODEC_PROP_INTRA_ONLY);
+  if (!segment_intra_only_) {
+    switch (video_codec) {
+    case AV_CODEC_ID_H264:
+    case AV_CODEC_ID_HEVC:
+    case AV_CODEC_ID_MPEG1VIDEO:
+    case AV_CODEC_ID_MPEG2VIDEO:
+    case AV_CODEC_ID_MPEG4:
+      break;
+    default:
+      return;
+    }
+  }
+
+  // The final file must be a single regular file, and the temporary NUT files must be able to hold the codecs
+  QByteArray filename = params_.filename.toUtf8();
+  AVOutputFormat* final_format = av_guess_format(nullptr, filename.constData(), nullptr);
+  AVOutputFormat* segment_format = av_guess_format("nut", nullptr, nullptr);
+  if (final_format == nullptr
+      || segment_format == nullptr
+      || (final_format->flags & (AVFMT_NOFILE | AVFMT_NOTIMESTAMPS))
+      || avformat_query_codec(segment_format, video_codec, FF_COMPLIANCE_NORMAL) != 1
+      || (params_.audio_enabled
+          && avformat_query_codec(segment_format,
+                                  static_cast<AVCodecID>(params_.audio_codec),
+                                  FF_COMPLIANCE_NORMAL) != 1)) {
+    return;
+  }
+
+  // Segments are cut on GOP boundaries so keyframes stay evenly spaced in the final file
+  segment_gop_size_ = 1;
+  if (!segment_intra_only_) {
+    // x264 and x265's default keyframe interval, used if the encoder doesn't have a default of its own
+    segment_gop_size_ = 250;
+
+    AVCodec* codec = avcodec_find_encoder(video_codec);
+    if (codec == nullptr) {
+      return;
+    }
+
+    AVCodecContext* codec_defaults = avcodec_alloc_context3(codec);
+    if (codec_defaults != nullptr) {
+      if (codec_defaults->gop_size > 0) {
+        segment_gop_size_ = codec_defaults->gop_size;
+      }
+      avcodec_free_context(&codec_defaults);
+    }
+  }
+
+  // Settings shared by every segment thread, each one renders from this thread's copy of the sequence
+  segment_params_ = params_;
+  segment_params_.sequence = renderer_->sequence();
+  segment_params_.format_name = "nut";
+  segment_params_.global_header = (final_format->flags & AVFMT_GLOBALHEADER);
+  segment_params_.audio_enabled = false;
+  if (!segment_intra_only_) {
+    segment_params_.video_gop_size = segment_gop_size_;
+  }
+
+  segment_vparams_ = vcodec_params_;
+  segment_vparams_.segments = 1;
+
+  FindStreamCopyRanges();
+
+  // Without anything to stream copy, segmenting is only worth it if the range can be rendered in parallel
+  if (stream_copy_ranges_.isEmpty() && SegmentCount(params_.start_frame, params_.end_frame) < 2) {
+    return;
+  }
+
+  segment_dir_ = new QTemporaryDir(QDir::temp().filePath("olive-export-XXXXXX"));
+  if (!segment_dir_->isValid()) {
+    qWarning() << "Failed to create temporary directory for export segments, exporting serially";
+    delete segment_dir_;
+    segment_dir_ = nullptr;
+    stream_copy_ranges_.clear();
+    return;
+  }
+
+  // Audio is mixed and encoded once over the whole range
+  if (params_.audio_enabled) {
+    ExportParams audio_params = segment_params_;
+    audio_params.audio_enabled = true;
+    audio_params.video_enabled = false;
+    audio_params.start_frame = params_.start_frame;
+    audio_params.end_frame = params_.end_frame;
+    audio_params.filename = segment_dir_->filePath("audio.nut");
+
+    audio_segment_ = new ExportThread(audio_params, segment_vparams_);
+    connect(audio_segment_, SIGNAL(ProgressChanged(int, qint64)), this, SLOT(SegmentProgressChanged(int, qint64)));
+  }
+
+  // If some of the video can be copied, the video segments are created once PrepareStreamCopy() knows exactly which
+  // frames that is
+  if (stream_copy_ranges_.isEmpty()) {
+    CreateRenderSegments();
+  }
+}
+
+void ExportThread::FindStreamCopyRanges()
+{
+  Sequence* seq = renderer_->sequence();
+
+  // Copied frames are never scaled or retimed
+  if (params_.video_width != seq->width
+      || params_.video_height != seq->height
+      || !qFuzzyCompare(params_.video_frame_rate, seq->frame_rate)) {
+    return;
+  }
+
+  for (int i=0;i<seq->clips.size();i++) {
+    Clip* c = seq->clips.at(i).get();
+
+    if (c == nullptr || c->track() >= 0 || !c->enabled() || !IsStreamCopyClip(c)) {
+      continue;
+    }
+
+    // Start with the part of the clip that's being exported
+    QVector<QPair<long, long> > ranges;
+    ranges.append(QPair<long, long>(qMax(c->timeline_in(), params_.start_frame),
+                                    qMin(c->timeline_out() - 1, params_.end_frame)));
+
+    // Remove anywhere this clip is composited with another video clip
+    for (int j=0;j<seq->clips.size();j++) {
+      Clip* other = seq->clips.at(j).get();
+
+      if (other == nullptr || other == c || other->track() >= 0 || !other->enabled()) {
+        continue;
+      }
+
+      long other_in = other->timeline_in(true);
+      long other_out = other->timeline_out(true) - 1;
+
+      for (int k=ranges.size()-1;k>=0;k--) {
+        QPair<long, long> r = ranges.at(k);
+
+        if (other_out < r.first || other_in > r.second) {
+          continue;
+        }
+
+        ranges.removeAt(k);
+
+        if (r.first < other_in) {
+          ranges.append(QPair<long, long>(r.first, other_in - 1));
+        }
+        if (other_out < r.second) {
+          ranges.append(QPair<long, long>(other_out + 1, r.second));
+        }
+      }
+    }
+
+    for (int j=0;j<ranges.size();j++) {
+      if (ranges.at(j).first > ranges.at(j).second) {
+        continue;
+      }
+
+      StreamCopyRange r;
+      r.start_frame = ranges.at(j).first;
+      r.end_frame = ranges.at(j).second;
+      // read from the same file the renderer would have
+      Footage* footage = c->media()->to_footage();
+      if (footage->proxy && !footage->proxy_path.isEmpty() && QFileInfo::exists(footage->proxy_path)) {
+        r.filename = footage->proxy_path;
+      } else {
+        r.filename = footage->url;
+      }
+      r.stream_index = c->media_stream_index();
+      r.media_frame = c->clip_in() + (r.start_frame - c->timeline_in());
+      r.frame_rate = seq->frame_rate;
+      r.start_pts = AV_NOPTS_VALUE;
+      r.end_pts = AV_NOPTS_VALUE;
+
+      // keep ranges in timeline order
+      int index = 0;
+      while (index < stream_copy_ranges_.size() && stream_copy_ranges_.at(index).start_frame < r.start_frame) {
+        index++;
+      }
+      stream_copy_ranges_.insert(index, r);
+    }
+  }
+}
+
+bool ExportThread::IsStreamCopyClip(Clip *c)
+{
+  if (c->media() == nullptr || c->media()->get_type() != MEDIA_TYPE_FOOTAGE) {
+    return false;
+  }
+
+  Footage* footage = c->media()->to_footage();
+  FootageStream* ms = c->media_stream();
+
+  if (ms == nullptr || ms->infinite_length) {
+    return false;
+  }
+
+  // Retimed, reversed or transitioning clips are always rendered
+  if (c->speed().value != 1.0
+      || footage->speed != 1.0
+      || c->reversed()
+      || c->opening_transition != nullptr
+      || c->closing_transition != nullptr) {
+    return false;
+  }
+
+  if (ms->video_width != c->sequence->width
+      || ms->video_height != c->sequence->height
+      || !qFuzzyCompare(ms->video_frame_rate, c->sequence->frame_rate)) {
+    return false;
+  }
+
+  for (int i=0;i<c->effects.size();i++) {
+    if (!c->effects.at(i)->IsIdentity()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void ExportThread::PrepareStreamCopy()
+{
+  for (int i=stream_copy_ranges_.size()-1;i>=0 && !interrupt_;i--) {
+    if (!ScanStreamCopyRange(stream_copy_ranges_[i])) {
+      stream_copy_ranges_.removeAt(i);
+    }
+  }
+
+  if (interrupt_) {
+    return;
+  }
+
+  long total_frames = params_.end_frame - params_.start_frame + 1;
+  long copied_frames = 0;
+  for (int i=0;i<stream_copy_ranges_.size();i++) {
+    copied_frames += stream_copy_ranges_.at(i).end_frame - stream_copy_ranges_.at(i).start_frame + 1;
+  }
+
+  // With global headers, every piece of the video stream has to share the same codec headers. Our encoder's headers
+  // won't match another encoder's, so copying is only possible if nothing else is rendered or the codec doesn't use
+  // headers at all.
+  if (!stream_copy_ranges_.isEmpty() && segment_params_.global_header) {
+    const QByteArray& extradata = stream_copy_ranges_.first().extradata;
+
+    bool joinable = (copied_frames == total_frames || (segment_intra_only_ && extradata.isEmpty()));
+    for (int i=1;i<stream_copy_ranges_.size() && joinable;i++) {
+      joinable = (stream_copy_ranges_.at(i).extradata == extradata);
+    }
+
+    if (!joinable) {
+      qInfo() << "Media headers don't match the export's headers, rendering every frame";
+      stream_copy_ranges_.clear();
+      copied_frames = 0;
+    }
+  }
+
+  if (copied_frames > 0) {
+    qInfo() << "Copying" << copied_frames << "of" << total_frames << "frames without re-encoding";
+  }
+
+  // Segment threads have to be created on the main thread
+  QMetaObject::invokeMethod(this, "CreateRenderSegments", Qt::BlockingQueuedConnection);
+}
+
+bool ExportThread::ScanStreamCopyRange(StreamCopyRange &range)
+{
+  QByteArray filename = range.filename.toUtf8();
+
+  AVFormatContext* ctx = nullptr;
+  if (avformat_open_input(&ctx, filename.constData(), nullptr, nullptr) < 0) {
+    return false;
+  }
+
+  if (avformat_find_stream_info(ctx, nullptr) < 0
+      || range.stream_index < 0
+      || range.stream_index >= int(ctx->nb_streams)) {
+    avformat_close_input(&ctx);
+    return false;
+  }
+
+  AVStream* stream = ctx->streams[range.stream_index];
+  AVCodecParameters* par = stream->codecpar;
+
+  // The media must already be exactly what the encoder would have produced
+  if (par->codec_id != params_.video_codec
+      || par->width != params_.video_width
+      || par->height != params_.video_height
+      || par->format != vcodec_params_.pix_fmt) {
+    avformat_close_input(&ctx);
+    return false;
+  }
+
+  // Media frames map to timestamps the same way the renderer maps them (see seconds_to_timestamp())
+  double pts_per_frame = 1.0 / (range.frame_rate * av_q2d(stream->time_base));
+  int64_t range_start = qRound64(range.media_frame * pts_per_frame);
+  int64_t range_end = qRound64((range.media_frame + range.end_frame - range.start_frame + 1) * pts_per_frame);
+
+  av_seek_frame(ctx, stream->index, range_start, AVSEEK_FLAG_BACKWARD);
+
+  // Find every keyframe up to the first one at or past the end of the range, and whether it starts an open GOP. An
+  // open GOP has frames after its keyframe in decoding order that are shown before it and reference the previous GOP,
+  // so the copied GOPs can only start and end on keyframes of closed GOPs.
+  QVector<int64_t> keys;
+  QVector<bool> open_keys;
+  int64_t stream_end = AV_NOPTS_VALUE;
+  bool reached_eof = false;
+
+  AVPacket* packet = av_packet_alloc();
+  while (!interrupt_) {
+    if (av_read_frame(ctx, packet) < 0) {
+      reached_eof = true;
+      break;
+    }
+
+    if (packet->stream_index == stream->index && packet->pts != AV_NOPTS_VALUE) {
+      if (packet->flags & AV_PKT_FLAG_KEY) {
+        // the last keyframe's GOP has been read completely, so whether it's open is known now
+        if (!keys.isEmpty() && keys.last() >= range_end) {
+          av_packet_unref(packet);
+          break;
+        }
+
+        keys.append(packet->pts);
+        open_keys.append(false);
+      } else if (!keys.isEmpty() && packet->pts < keys.last()) {
+        open_keys.last() = true;
+      }
+
+      stream_end = qMax(stream_end, packet->pts + packet->duration);
+    }
+
+    av_packet_unref(packet);
+  }
+  av_packet_free(&packet);
+
+  // Find the first and last closed GOP keyframes inside the range, only the GOPs between them can be copied
+  int64_t first_key = AV_NOPTS_VALUE;
+  int64_t last_key = AV_NOPTS_VALUE;
+  bool skipped_open_gop = false;
+  for (int i=0;i<keys.size();i++) {
+    if (keys.at(i) < range_start || keys.at(i) > range_end) {
+      continue;
+    }
+
+    if (open_keys.at(i)) {
+      skipped_open_gop = true;
+      continue;
+    }
+
+    if (first_key == AV_NOPTS_VALUE) {
+      first_key = keys.at(i);
+    }
+    last_key = keys.at(i);
+  }
+
+  // If the media ends inside the range, its last GOP can be copied too
+  if (reached_eof && stream_end != AV_NOPTS_VALUE && stream_end <= range_end) {
+    last_key = stream_end;
+  }
+
+  if (skipped_open_gop) {
+    qInfo() << range.filename << "uses open GOPs, rendering the frames around them instead of copying";
+  }
+
+  if (first_key == AV_NOPTS_VALUE || last_key <= first_key) {
+    avformat_close_input(&ctx);
+    return false;
+  }
+
+  // Trim the range down to the GOPs that'll be copied
+  long first_frame = long(qRound64(first_key / pts_per_frame));
+  long end_frame = long(qRound64(last_key / pts_per_frame));
+
+  range.start_frame += first_frame - range.media_frame;
+  range.end_frame = qMin(range.end_frame, range.start_frame + (end_frame - first_frame) - 1);
+  range.media_frame = first_frame;
+  range.start_pts = first_key;
+  range.end_pts = last_key;
+  range.extradata = QByteArray(reinterpret_cast<const char*>(par->extradata), par->extradata_size);
+
+  avformat_close_input(&ctx);
+
+  return (range.end_frame >= range.start_frame);
+}
+
+long ExportThread::SegmentCount(long start_frame, long end_frame)
+{
+  if (vcodec_params_.segments == 1 || QThread::idealThreadCount() < 2) {
+    return 1;
+  }
+
+  long frame_count = end_frame - start_frame + 1;
+  long gop_count = (frame_count + segment_gop_size_ - 1) / segment_gop_size_;
+
+  long segment_count;
+  if (vcodec_params_.segments == 0) {
+    // Every segment has its own renderer and decoders, so automatic splitting doesn't go below ~10 second segments
+    long min_segment_length = qMax(long(segment_gop_size_), long(qCeil(params_.sequence->frame_rate * 10)));
+    segment_count = qMin(long(QThread::idealThreadCount()), frame_count / min_segment_length);
+  } else {
+    segment_count = vcodec_params_.segments;
+  }
+
+  return qMax(1L, qMin(segment_count, gop_count));
+}
+
+void ExportThread::AddRenderSegments(long start_frame, long end_frame)
+{
+  long segment_count = SegmentCount(start_frame, end_frame);
+  long gop_count = (end_frame - start_frame + segment_gop_size_) / segment_gop_size_;
+  long segment_length = ((gop_count + segment_count - 1) / segment_count) * segment_gop_size_;
+
+  ExportParams segment_params = segment_params_;
+
+  for (long start=start_frame;start<=end_frame;start+=segment_length) {
+    segment_params.start_frame = start;
+    segment_params.end_frame = qMin(start + segment_length - 1, end_frame);
+    segment_params.filename = segment_dir_->filePath(QString("video%1.nut").arg(video_segments_.size()));
+
+    ExportThread* segment = new ExportThread(segment_params, segment_vparams_);
+    connect(segment, SIGNAL(ProgressChanged(int, qint64)), this, SLOT(SegmentProgressChanged(int, qint64)));
+    video_segments_.append(segment);
+  }
+}
+
+void ExportThread::CreateRenderSegments()
+{
+  // Render everything between the stream copied ranges
+  long start = params_.start_frame;
+  for (int i=0;i<stream_copy_ranges_.size();i++) {
+    if (stream_copy_ranges_.at(i).start_frame > start) {
+      AddRenderSegments(start, stream_copy_ranges_.at(i).start_frame - 1);
+    }
+    start = stream_copy_ranges_.at(i).end_frame + 1;
+  }
+  if (start <= params_.end_frame) {
+    AddRenderSegments(start, params_.end_frame);
+  }
+
+  // Divide the encoder threads between the segments rather than letting every encoder use the whole CPU
+  if (vcodec_params_.threads == 0 && !video_segments_.isEmpty()) {
+    int concurrent_segments = qMin(video_segments_.size(), QThread::idealThreadCount());
+    for (int i=0;i<video_segments_.size();i++) {
+      video_segments_.at(i)->vcodec_params_.threads = qMax(1, QThread::idealThreadCount() / concurrent_segments);
+    }
+  }
+
+  // every segment has its own copy of the sequence now
+  ReleaseRenderer();
+}
+
+void ExportThread::PlanStems()
+{
+  if (!params_.audio_enabled || params_.video_enabled) {
+    return;
+  }
+
+  Sequence* seq = renderer_->sequence();
+
+  // Find every audio track that has something on it, in track order
+  QVector<int> tracks;
+  for (int i=0;i<seq->clips.size();i++) {
+    Clip* c = seq->clips.at(i).get();
+    if (c != nullptr && c->track() >= 0 && !tracks.contains(c->track())) {
+      int index = 0;
+      while (index < tracks.size() && tracks.at(index) < c->track()) {
+        index++;
+      }
+      tracks.insert(index, c->track());
+    }
+  }
+
+  QFileInfo file_info(params_.filename);
+
+  for (int i=0;i<tracks.size();i++) {
+    ExportParams stem_params = params_;
+    stem_params.sequence = seq;
+    stem_params.audio_stems = false;
+    stem_params.audio_track = tracks.at(i);
+
+    QString stem_name = QString("%1_A%2").arg(file_info.completeBaseName(), QString::number(tracks.at(i) + 1));
+    if (!file_info.suffix().isEmpty()) {
+      stem_name.append('.');
+      stem_name.append(file_info.suffix());
+    }
+    stem_params.filename = file_info.dir().filePath(stem_name);
+
+    ExportThread* stem = new ExportThread(stem_params, vcodec_params_);
+    connect(stem, SIGNAL(ProgressChanged(int, qint64)), this, SLOT(SegmentProgressChanged(int, qint64)));
+    stem_exports_.append(stem);
+  }
+
+  // every stem has its own copy of the sequence now
+  if (!stem_exports_.isEmpty()) {
+    ReleaseRenderer();
+  }
+}
+
+void ExportThread::ReleaseRenderer()
+{
+  delete renderer_;
+  renderer_ = nullptr;
+}
+
+void ExportThread::ExportStems()
+{
+  // Every stem decodes its own clips, so they all run at once
+  for (int i=0;i<stem_exports_.size();i++) {
+    stem_exports_.at(i)->start();
+  }
+
+  for (int i=0;i<stem_exports_.size();i++) {
+    stem_exports_.at(i)->wait();
+  }
+
+  if (interrupt_) {
+    return;
+  }
+
+  for (int i=0;i<stem_exports_.size();i++) {
+    if (!stem_exports_.at(i)->succeeded_) {
+      export_error = stem_exports_.at(i)->GetError();
+      if (export_error.isEmpty()) {
+        export_error = tr("failed to export %1").arg(stem_exports_.at(i)->params_.filename);
+      }
+      return;
+    }
+  }
+
+  succeeded_ = true;
+
+  emit ProgressChanged(100, 0);
+}
+
+void ExportThread::ExportSegments()
+{
+  // Audio is encoded alongside the video segments, which run in order with at most one per core at a time
+  if (audio_segment_ != nullptr) {
+    audio_segment_->start();
+  }
+
+  int max_running = qMax(1, QThread::idealThreadCount());
+  for (int i=0;i<video_segments_.size() && !interrupt_;i++) {
+    if (i >= max_running) {
+      video_segments_.at(i - max_running)->wait();
+    }
+    if (!interrupt_) {
+      video_segments_.at(i)->start();
+    }
+  }
+
+  for (int i=0;i<video_segments_.size();i++) {
+    video_segments_.at(i)->wait();
+  }
+  if (audio_segment_ != nullptr) {
+    audio_segment_->wait();
+  }
+
+  if (interrupt_) {
+    return;
+  }
+
+  // If any segment failed, the whole export failed
+  QVector<ExportThread*> segments = video_segments_;
+  if (audio_segment_ != nullptr) {
+    segments.append(audio_segment_);
+  }
+  for (int i=0;i<segments.size();i++) {
+    if (!segments.at(i)->succeeded_) {
+      export_error = segments.at(i)->GetError();
+      if (export_error.isEmpty()) {
+        export_error = tr("failed to export segment %1").arg(QString::number(i));
+      }
+      return;
+    }
+  }
+
+  if (ConcatenateSegments()) {
+    succeeded_ = true;
+
+    emit ProgressChanged(100, 0);
+  }
+}
+
+bool ExportThread::OpenSegment(const QString &filename, AVFormatContext **ctx)
+{
+  QByteArray ba = filename.toUtf8();
+
+  ret = avformat_open_input(ctx, ba.constData(), nullptr, nullptr);
+  if (ret < 0) {
+    qCritical() << "Could not open export segment" << filename << ret;
+    export_error = tr("could not open export segment (%1)").arg(QString::number(ret));
+    return false;
+  }
+
+  segment_inputs_.append(*ctx);
+
+  return true;
+}
+
+bool ExportThread::ReadSegmentPacket(SegmentInput& input, AVPacket *packet, AVStream *stream)
+{
+  // the piece's first packet may have been read ahead of time already
+  if (input.pending != nullptr) {
+    av_packet_move_ref(packet, input.pending);
+    av_packet_free(&input.pending);
+    return true;
+  }
+
+  AVStream* input_stream = input.ctx->streams[input.stream_index];
+
+  while (av_read_frame(input.ctx, packet) >= 0) {
+    if (packet->stream_index != input.stream_index) {
+      av_packet_unref(packet);
+      continue;
+    }
+
+    // Copied ranges start and end on keyframes
+    bool keyframe = (packet->flags & AV_PKT_FLAG_KEY);
+    if (!input.started) {
+      if (!keyframe || packet->pts < input.start_pts) {
+        av_packet_unref(packet);
+        continue;
+      }
+      input.started = true;
+    } else if (input.end_pts != AV_NOPTS_VALUE && keyframe && packet->pts >= input.end_pts) {
+      av_packet_unref(packet);
+      return false;
+    } else if (packet->pts != AV_NOPTS_VALUE && packet->pts < input.start_pts) {
+      // leading frames of an open GOP reference the GOP before it, which isn't being copied. ScanStreamCopyRange()
+      // only starts ranges on closed GOPs, so this is just a safeguard.
+      av_packet_unref(packet);
+      continue;
+    }
+
+    if (input.bsf != nullptr) {
+      if (av_bsf_send_packet(input.bsf, packet) < 0 || av_bsf_receive_packet(input.bsf, packet) < 0) {
+        av_packet_unref(packet);
+        continue;
+      }
+    }
+
+    // Shift the piece's timestamps to where it starts in the final file
+    if (packet->pts != AV_NOPTS_VALUE) {
+      packet->pts = av_rescale_q(packet->pts - input.start_pts, input_stream->time_base, stream->time_base)
+          + input.offset;
+    }
+    if (packet->dts != AV_NOPTS_VALUE) {
+      packet->dts = av_rescale_q(packet->dts - input.start_pts, input_stream->time_base, stream->time_base)
+          + input.offset + input.dts_offset;
+    }
+    packet->duration = av_rescale_q(packet->duration, input_stream->time_base, stream->time_base);
+    packet->pos = -1;
+
+    packet->stream_index = stream->index;
+
+    return true;
+  }
+
+  return false;
+}
+
+bool ExportThread::ConcatenateSegments()
+{
+  // Open every piece of the video stream in timeline order, merging the rendered segments with the stream copied
+  // ranges
+  QVector<SegmentInput> video_inputs;
+  QVector<long> video_input_frames;
+  int render_index = 0;
+  int copy_index = 0;
+  while (render_index < video_segments_.size() || copy_index < stream_copy_ranges_.size()) {
+    SegmentInput input;
+    input.ctx = nullptr;
+    input.offset = 0;
+    input.dts_offset = 0;
+    input.pending = nullptr;
+    input.bsf = nullptr;
+
+    bool copy = (copy_index < stream_copy_ranges_.size()
+                 && (render_index == video_segments_.size()
+                     || stream_copy_ranges_.at(copy_index).start_frame
+                        < video_segments_.at(render_index)->params_.start_frame));
+
+    if (copy) {
+      const StreamCopyRange& range = stream_copy_ranges_.at(copy_index);
+      copy_index++;
+
+      if (!OpenSegment(range.filename, &input.ctx)) {
+        return false;
+      }
+
+      ret = avformat_find_stream_info(input.ctx, nullptr);
+      if (ret < 0) {
+        qCritical() << "Could not read stream information from" << range.filename << ret;
+        export_error = tr("could not read stream information from %1 (%2)").arg(range.filename,
+                                                                                 QString::number(ret));
+        return false;
+      }
+
+      input.stream_index = range.stream_index;
+      input.start_pts = range.start_pts;
+      input.end_pts = range.end_pts;
+      input.started = false;
+
+      av_seek_frame(input.ctx, range.stream_index, range.start_pts, AVSEEK_FLAG_BACKWARD);
+
+      // Without global headers the codec headers travel with the packets, so MP4-style H.264/HEVC has to be
+      // converted to Annex B to match the rendered segments
+      AVCodecParameters* par = input.ctx->streams[range.stream_index]->codecpar;
+      if (!segment_params_.global_header
+          && (par->codec_id == AV_CODEC_ID_H264 || par->codec_id == AV_CODEC_ID_HEVC)
+          && par->extradata_size > 0
+          && par->extradata[0] == 1) {
+        const AVBitStreamFilter* filter = av_bsf_get_by_name((par->codec_id == AV_CODEC_ID_H264)
+                                                             ? "h264_mp4toannexb" : "hevc_mp4toannexb");
+        if (filter == nullptr || av_bsf_alloc(filter, &input.bsf) < 0) {
+          qCritical() << "Could not allocate bitstream filter";
+          export_error = tr("could not allocate bitstream filter");
+          return false;
+        }
+
+        segment_bsfs_.append(input.bsf);
+
+        avcodec_parameters_copy(input.bsf->par_in, par);
+        input.bsf->time_base_in = input.ctx->streams[range.stream_index]->time_base;
+
+        ret = av_bsf_init(input.bsf);
+        if (ret < 0) {
+          qCritical() << "Could not initialize bitstream filter." << ret;
+          export_error = tr("could not initialize bitstream filter (%1)").arg(QString::number(ret));
+          return false;
+        }
+      }
+
+      video_input_frames.append(range.start_frame);
+    } else {
+      ExportThread* segment = video_segments_.at(render_index);
+      render_index++;
+
+      if (!OpenSegment(segment->params_.filename, &input.ctx)) {
+        return false;
+      }
+
+      input.stream_index = 0;
+      input.start_pts = 0;
+      input.end_pts = AV_NOPTS_VALUE;
+      input.started = true;
+
+      video_input_frames.append(segment->params_.start_frame);
+    }
+
+    video_inputs.append(input);
+  }
+
+  SegmentInput audio_input;
+  audio_input.ctx = nullptr;
+  if (audio_segment_ != nullptr) {
+    if (!OpenSegment(audio_segment_->params_.filename, &audio_input.ctx)) {
+      return false;
+    }
+
+    audio_input.stream_index = 0;
+    audio_input.start_pts = 0;
+    audio_input.end_pts = AV_NOPTS_VALUE;
+    audio_input.offset = 0;
+    audio_input.dts_offset = 0;
+    audio_input.pending = nullptr;
+    audio_input.started = true;
+    audio_input.bsf = nullptr;
+  }
+
+  AVCodecParameters* video_params = video_inputs.first().ctx->streams[video_inputs.first().stream_index]->codecpar;
+
+  // With global headers every piece must share the same codec headers, otherwise the file won't decode past the first
+  // piece
+  if (segment_params_.global_header) {
+    for (int i=1;i<video_inputs.size();i++) {
+      AVCodecParameters* piece_params = video_inputs.at(i).ctx->streams[video_inputs.at(i).stream_index]->codecpar;
+      if (piece_params->extradata_size != video_params->extradata_size
+          || (video_params->extradata_size > 0
+              && memcmp(piece_params->extradata, video_params->extradata, size_t(video_params->extradata_size)) != 0)) {
+        qCritical() << "Export segment" << i << "was encoded with different codec headers from the first segment";
+        export_error = tr("export segments were encoded with different codec headers");
+        return false;
+      }
+    }
+  }
+
+  // Copy filename from QString to const char
+  QByteArray ba = params_.filename.toUtf8();
+  c_filename = new char[ba.size()+1];
+  strcpy(c_filename, ba.data());
+
+  // Set up final file container
+  if (!SetupContainer()) {
+    return false;
+  }
+
+  AVRational frame_time_base = av_inv_q(av_d2q(params_.video_frame_rate, INT_MAX));
+
+  video_stream = avformat_new_stream(fmt_ctx, nullptr);
+  if (video_stream == nullptr) {
+    qCritical() << "Could not allocate video stream";
+    export_error = tr("could not allocate video stream");
+    return false;
+  }
+  video_stream->id = 0;
+  video_stream->time_base = frame_time_base;
+  avcodec_parameters_copy(video_stream->codecpar, video_params);
+  video_stream->codecpar->codec_tag = 0;
+
+  // Without global headers, the headers in the packets are used instead
+  if (!segment_params_.global_header) {
+    av_freep(&video_stream->codecpar->extradata);
+    video_stream->codecpar->extradata_size = 0;
+  }
+
+  if (audio_input.ctx != nullptr) {
+    audio_stream = avformat_new_stream(fmt_ctx, nullptr);
+    if (audio_stream == nullptr) {
+      qCritical() << "Could not allocate audio stream";
+      export_error = tr("could not allocate audio stream");
+      return false;
+    }
+    audio_stream->id = 1;
+    audio_stream->time_base = {1, params_.audio_sampling_rate};
+    avcodec_parameters_copy(audio_stream->codecpar, audio_input.ctx->streams[0]->codecpar);
+    audio_stream->codecpar->codec_tag = 0;
+  }
+
+  // Write the container header based on the streams copied above
+  ret = avformat_write_header(fmt_ctx, nullptr);
+  if (ret < 0) {
+    qCritical() << "Could not write output file header." << ret;
+    export_error = tr("could not write output file header (%1)").arg(QString::number(ret));
+    return false;
+  }
+
+  // Offset of each piece in the final file, calculated the same way Export() calculates each frame's timestamp
+  for (int i=0;i<video_inputs.size();i++) {
+    double piece_secs = double(video_input_frames.at(i) - params_.start_frame) / params_.sequence->frame_rate;
+    video_inputs[i].offset = av_rescale_q(qRound64(piece_secs / av_q2d(frame_time_base)),
+                                          frame_time_base,
+                                          video_stream->time_base);
+  }
+
+  // Pieces from different encoders can have different decoding delays (how far each packet's DTS is ahead of its PTS).
+  // PTS stay where they are on the timeline, instead every piece's DTS are moved back to the largest delay of any
+  // piece, the same way a muxer shifts negative DTS. That keeps DTS increasing across the joins without ever moving a
+  // DTS past its PTS. Each piece starts on a keyframe, so its first packet tells how large its delay is.
+  int64_t max_delay = 0;
+  for (int i=0;i<video_inputs.size();i++) {
+    AVPacket* first_packet = av_packet_alloc();
+    if (ReadSegmentPacket(video_inputs[i], first_packet, video_stream)) {
+      video_inputs[i].pending = first_packet;
+      if (first_packet->pts != AV_NOPTS_VALUE && first_packet->dts != AV_NOPTS_VALUE) {
+        max_delay = qMax(max_delay, first_packet->pts - first_packet->dts);
+      }
+    } else {
+      av_packet_free(&first_packet);
+    }
+  }
+
+  for (int i=0;i<video_inputs.size();i++) {
+    AVPacket* first_packet = video_inputs.at(i).pending;
+    if (first_packet != nullptr && first_packet->pts != AV_NOPTS_VALUE && first_packet->dts != AV_NOPTS_VALUE) {
+      video_inputs[i].dts_offset = (first_packet->pts - first_packet->dts) - max_delay;
+      first_packet->dts += video_inputs.at(i).dts_offset;
+    }
+  }
+
+  // Copy packets from each piece in order, interleaving audio packets by their timestamps
+  AVPacket* video_packet = av_packet_alloc();
+  AVPacket* audio_packet = av_packet_alloc();
+
+  int piece = 0;
+  bool have_video = false;
+  while (piece < video_inputs.size() && !(have_video = ReadSegmentPacket(video_inputs[piece], video_packet, video_stream))) {
+    piece++;
+  }
+
+  bool have_audio = (audio_input.ctx != nullptr && ReadSegmentPacket(audio_input, audio_packet, audio_stream));
+
+  ret = 0;
+  while ((have_video || have_audio) && !interrupt_) {
+    bool write_video = have_video
+        && (!have_audio
+            || av_compare_ts(video_packet->dts, video_stream->time_base,
+                             audio_packet->dts, audio_stream->time_base) <= 0);
+
+    if (write_video) {
+      ret = av_interleaved_write_frame(fmt_ctx, video_packet);
+
+      // Move on to the next piece once this one runs out of packets
+      have_video = false;
+      while (piece < video_inputs.size()
+             && !(have_video = ReadSegmentPacket(video_inputs[piece], video_packet, video_stream))) {
+        piece++;
+      }
+    } else {
+      ret = av_interleaved_write_frame(fmt_ctx, audio_packet);
+
+      have_audio = ReadSegmentPacket(audio_input, audio_packet, audio_stream);
+    }
+
+    if (ret < 0) {
+      qCritical() << "Could not write segment packet to output file." << ret;
+      export_error = tr("could not write segment packet to output file (%1)").arg(QString::number(ret));
+      break;
+    }
+  }
+
+  av_packet_free(&video_packet);
+  av_packet_free(&audio_packet);
+
+  // free the first packets of any pieces that weren't reached
+  for (int i=0;i<video_inputs.size();i++) {
+    av_packet_free(&video_inputs[i].pending);
+  }
+
+  if (interrupt_ || ret < 0) {
+    return false;
+  }
+
+  // Write container trailer
+  ret = av_write_trailer(fmt_ctx);
+  if (ret < 0) {
+    qCritical() << "Could not write output file trailer." << ret;
+    export_error = tr("could not write output file trailer (%1)").arg(QString::number(ret));
+    return false;
+  }
+
+  return true;
+}
+
 void ExportThread::run() {
-  // Ensure sequence isn't currently playing
-  panel_sequence_viewer->pause();
+  if (!stem_exports_.isEmpty()) {
 
-  // Seek to the first frame we're exporting
-  panel_sequence_viewer->seek(params_.start_frame);
+    // Each stem mixes and encodes in its own thread
+    ExportStems();
 
-  // Lock mutex (used for thread synchronizations)
-  mutex.lock();
+  } else if (segment_dir_ != nullptr) {
 
-  // Run export function (which will return if there's a failure)
-  Export();
+    // Find exactly which frames can be copied from their media, the segments for everything else are created once
+    // that's known
+    if (!stream_copy_ranges_.isEmpty()) {
+      PrepareStreamCopy();
+    }
 
-  mutex.unlock();
+    // Each segment renders and encodes in its own thread, this thread just joins their output together
+    ExportSegments();
+
+  } else if (renderer_->Start(&surface)) {
+
+    // Set up the offline renderer's OpenGL context in this thread and run export function (which will return if
+    // there's a failure)
+    Export();
+
+  } else {
+    export_error = tr("could not create OpenGL context for rendering");
+  }
+
+  // Close all clips opened by the renderer
+  if (renderer_ != nullptr) {
+    renderer_->Stop();
+  }
 
   // Clean up anything that was allocated in Export() (whether it succeeded or not)
   Cleanup();
@@ -686,22 +1670,60 @@ bool ExportThread::WasInterrupted()
 
 void ExportThread::Interrupt()
 {
-  mutex.lock();
   interrupt_ = true;
-  waitCond.wakeAll();
-  mutex.unlock();
+
+  for (int i=0;i<video_segments_.size();i++) {
+    video_segments_.at(i)->Interrupt();
+  }
+  if (audio_segment_ != nullptr) {
+    audio_segment_->Interrupt();
+  }
+  for (int i=0;i<stem_exports_.size();i++) {
+    stem_exports_.at(i)->Interrupt();
+  }
 }
 
-void ExportThread::play_wake()
+void ExportThread::SegmentProgressChanged(int value, qint64 remaining_ms)
 {
-  mutex.lock();
-  waiting_for_audio_ = false;
-  waitCond.wakeAll();
-  mutex.unlock();
-}
+  segment_progress_.insert(sender(), value);
+  segment_remaining_.insert(sender(), remaining_ms);
+
+  // Stems all cover the same range, so they're weighted equally
+  if (!stem_exports_.isEmpty()) {
+    double stem_progress = 0;
+    qint64 remaining = 0;
+    for (int i=0;i<stem_exports_.size();i++) {
+      stem_progress += double(segment_progress_.value(stem_exports_.at(i))) / stem_exports_.size();
+      remaining = qMax(remaining, segment_remaining_.value(stem_exports_.at(i)));
+    }
+
+    // 100 is only emitted once every stem has finished
+    emit ProgressChanged(qMin(qRound(stem_progress), 99), remaining);
+    return;
+  }
+
+  // Video progress is weighted by the length of each segment, the slowest segment determines the remaining time
+  double total_frames = 0;
+  for (int i=0;i<video_segments_.size();i++) {
+    total_frames += double(video_segments_.at(i)->params_.end_frame - video_segments_.at(i)->params_.start_frame + 1);
+  }
+
+  double video_progress = 0;
+  qint64 remaining = 0;
+  for (int i=0;i<video_segments_.size();i++) {
+    ExportThread* segment = video_segments_.at(i);
+    double segment_frames = double(segment->params_.end_frame - segment->params_.start_frame + 1);
+    video_progress += segment_progress_.value(segment) * segment_frames / total_frames;
+    remaining = qMax(remaining, segment_remaining_.value(segment));
+  }
+
+  // Stream copied video is only written once the segments are joined
+  int progress = video_segments_.isEmpty() ? 100 : qRound(video_progress);
+  if (audio_segment_ != nullptr) {
+    progress = qMin(progress, segment_progress_.value(audio_segment_));
+    remaining = qMax(remaining, segment_remaining_.value(audio_segment_));
+  }
 
-void ExportThread::wake() {
-  mutex.lock();
-  waitCond.wakeAll();
-  mutex.unlock();
+  // 100 is only emitted once the segments have been joined
+  emit ProgressChanged(qMin(progress, 99), remaining);
 }
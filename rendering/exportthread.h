@@ -23,8 +23,11 @@
 
 #include <QThread>
 #include <QOffscreenSurface>
-#include <QMutex>
-#include <QWaitCondition>
+#include <QTemporaryDir>
+#include <QMap>
+#include <QVector>
+
+#include "rendering/offlinerenderer.h"
 
 struct AVFormatContext;
 struct AVCodecContext;
@@ -35,6 +38,8 @@ struct AVCodec;
 struct SwsContext;
 struct SwrContext;
 
+class Clip;
+
 extern "C" {
 #include <libavcodec/avcodec.h>
 }
@@ -48,6 +53,7 @@ extern "C" {
 
 struct ExportParams {
   // export parameters
+  Sequence* sequence;
   QString filename;
   bool video_enabled;
   int video_codec;
@@ -62,17 +68,48 @@ struct ExportParams {
   int audio_bitrate;
   long start_frame;
   long end_frame;
+  bool audio_stems = false; // export every audio track to its own file instead of the mix (audio only exports)
+
+  // used internally by segmented exports (see ExportThread::PlanSegments()), left as default by ExportDialog
+  QString format_name; // container format to write, guessed from the filename if empty
+  bool global_header = false; // use global codec headers even if the container doesn't need them
+  int video_gop_size = 0; // force closed GOPs of this size, 0 leaves the encoder's default
+  int audio_track = -1; // only mix this audio track, -1 mixes every track
+};
+
+/**
+ * @brief A range of the exported sequence that's copied straight from its source file without re-encoding
+ */
+struct StreamCopyRange {
+  // timeline frames covered by this range (inclusive)
+  long start_frame;
+  long end_frame;
+
+  QString filename;
+  int stream_index;
+
+  // media frame shown at start_frame, and the media's frame rate
+  long media_frame;
+  double frame_rate;
+
+  // packets are copied from the keyframe at start_pts up to (but not including) the keyframe at end_pts, both are
+  // filled in once the file's keyframes have been found
+  int64_t start_pts;
+  int64_t end_pts;
+  QByteArray extradata;
 };
 
 struct VideoCodecParams {
   int pix_fmt;
   int threads;
+  int segments; // number of segments to export in parallel, 0 = auto, 1 = off
 };
 
 class ExportThread : public QThread {
   Q_OBJECT
 public:
   ExportThread(const ExportParams& params, const VideoCodecParams& vparams, QObject* parent = nullptr);
+  virtual ~ExportThread() override;
   virtual void run() override;
 
   const QString& GetError();
@@ -82,9 +119,43 @@ signals:
   void ProgressChanged(int value, qint64 remaining_ms);
 public slots:
   void Interrupt();
+private slots:
+  /**
+   * @brief Combine the progress of every segment thread into this export's progress
+   */
+  void SegmentProgressChanged(int value, qint64 remaining_ms);
 
-  void play_wake();
+  /**
+   * @brief Create segment threads for every range that isn't stream copied
+   *
+   * Invoked on the main thread by PrepareStreamCopy() once the stream copied ranges are known.
+   */
+  void CreateRenderSegments();
 private:
+  /**
+   * @brief Where to read one piece of the final video or audio stream from
+   */
+  struct SegmentInput {
+    AVFormatContext* ctx;
+    int stream_index;
+
+    // copied packets start at the keyframe at start_pts and stop at the keyframe at end_pts (AV_NOPTS_VALUE for
+    // the end of the file), and are shifted by offset (in the output stream's timebase)
+    int64_t start_pts;
+    int64_t end_pts;
+    int64_t offset;
+    bool started;
+
+    // added to DTS only, moves every piece's DTS back to the same decoding delay (see ConcatenateSegments())
+    int64_t dts_offset;
+
+    // first packet of the piece if it was read ahead of time, returned by the next ReadSegmentPacket()
+    AVPacket* pending;
+
+    // converts MP4-style H.264/HEVC packets to Annex B for containers without global headers
+    AVBSFContext* bsf;
+  };
+
   bool Encode(AVFormatContext* ofmt_ctx, AVCodecContext* codec_ctx, AVFrame* frame, AVPacket* packet, AVStream* stream);
   bool SetupVideo();
   bool SetupAudio();
@@ -92,13 +163,124 @@ private:
   void Export();
   void Cleanup();
 
+  /**
+   * @brief Split the export into segments that can be rendered and encoded in parallel
+   *
+   * Called from the constructor (on the main thread, since every segment needs its own OfflineRenderer copy of the
+   * sequence). If the codec and container allow it, the frame range is cut at GOP boundaries and one video-only
+   * ExportThread is created per segment, plus one audio-only ExportThread that covers the whole range so the audio is
+   * encoded exactly once. Each of them writes a temporary NUT file which ExportSegments() joins into the final file.
+   *
+   * If the export isn't eligible, no segments are created and run() does a regular serial export.
+   *
+   * If any part of the sequence can be stream copied (see FindStreamCopyRanges()), the video segments are created
+   * later by CreateRenderSegments() instead.
+   */
+  void PlanSegments();
+
+  /**
+   * @brief Find ranges of the sequence where a single clip plays its media completely unmodified
+   *
+   * These ranges are candidates for being copied from the media file instead of rendered. Called on the main thread
+   * from PlanSegments(), PrepareStreamCopy() later narrows them down to whole GOPs.
+   */
+  void FindStreamCopyRanges();
+
+  /**
+   * @brief Returns whether a clip shows its media unmodified at the sequence's resolution and frame rate
+   */
+  bool IsStreamCopyClip(Clip* c);
+
+  /**
+   * @brief Narrow stream copy ranges down to the keyframes of their media and drop any that can't be joined
+   *
+   * Runs in this thread since it has to read through each media file's packets.
+   */
+  void PrepareStreamCopy();
+
+  /**
+   * @brief Find the keyframes of a stream copy range's media and trim the range to whole GOPs
+   *
+   * The copied GOPs start and end on keyframes of closed GOPs, frames around open GOPs at either end are rendered.
+   *
+   * @return False if the range's media doesn't match the export settings or no whole GOP falls inside the range.
+   */
+  bool ScanStreamCopyRange(StreamCopyRange& range);
+
+  /**
+   * @brief Returns the number of segments a range of frames should be rendered in
+   */
+  long SegmentCount(long start_frame, long end_frame);
+
+  /**
+   * @brief Create video-only segment threads covering a range of frames
+   */
+  void AddRenderSegments(long start_frame, long end_frame);
+
+  /**
+   * @brief Create one audio-only ExportThread per audio track for a stem export
+   *
+   * Called from the constructor (on the main thread) if ExportParams::audio_stems is set. Each stem is written next to
+   * the requested filename with the track number appended, e.g. "mix_A1.wav", "mix_A2.wav", and all of them are mixed
+   * and encoded in parallel by ExportStems().
+   */
+  void PlanStems();
+
+  /**
+   * @brief Run every stem thread and wait for them to finish
+   */
+  void ExportStems();
+
+  /**
+   * @brief Free this thread's copy of the sequence once it's no longer needed
+   *
+   * Segmented and stem exports never render in this thread, the copy is only used to create the threads that do.
+   * Must be called on the main thread.
+   */
+  void ReleaseRenderer();
+
+  /**
+   * @brief Run every segment thread and concatenate their output into the final file
+   */
+  void ExportSegments();
+
+  /**
+   * @brief Stream copy all segments into the final container without re-encoding
+   */
+  bool ConcatenateSegments();
+
+  bool OpenSegment(const QString& filename, AVFormatContext** ctx);
+  bool ReadSegmentPacket(SegmentInput& input, AVPacket* packet, AVStream* stream);
+
   QOffscreenSurface surface;
   bool interrupt_;
 
+  // renders a private copy of the exported sequence, independent of the viewers. nullptr once released by a segmented
+  // or stem export.
+  OfflineRenderer* renderer_;
+
   // params imported from dialogs
   ExportParams params_;
   VideoCodecParams vcodec_params_;
 
+  // segmented export state, empty if this is a serial export
+  QTemporaryDir* segment_dir_;
+  ExportParams segment_params_;
+  VideoCodecParams segment_vparams_;
+  int segment_gop_size_;
+  bool segment_intra_only_;
+  QVector<ExportThread*> video_segments_;
+  ExportThread* audio_segment_;
+  QVector<StreamCopyRange> stream_copy_ranges_;
+  QVector<AVFormatContext*> segment_inputs_;
+  QVector<AVBSFContext*> segment_bsfs_;
+  QMap<QObject*, int> segment_progress_;
+  QMap<QObject*, qint64> segment_remaining_;
+  bool succeeded_;
+
+  // stem export state, empty unless ExportParams::audio_stems is set
+  QVector<ExportThread*> stem_exports_;
+
   AVFormatContext* fmt_ctx;
   AVStream* video_stream;
   AVCodec* vcodec;
@@ -122,14 +304,7 @@ private:
   int ret;
   char* c_filename;
 
-  QMutex mutex;
-  QWaitCondition waitCond;
-
   QString export_error;
-
-  bool waiting_for_audio_;
-private slots:
-  void wake();
 };
 
 #endif // EXPORTTHREAD_H
@@ -0,0 +1,247 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framebudget.h"
+
+#include <QMutexLocker>
+#include <limits>
+
+#include "global/config.h"
+#include "rendering/cacher.h"
+
+FrameBudget olive::frame_budget;
+
+// a Cacher that hasn't been asked for a frame for this long (in milliseconds) is no longer considered to be under the
+// playhead
+const qint64 kActiveTimeout = 500;
+
+// relative value of the frames of an idle Cacher, one under the playhead, and the one on the topmost track
+const int kIdleWeight = 1;
+const int kActiveWeight = 4;
+const int kTopLayerWeight = 8;
+
+FrameBudget::FrameBudget()
+{
+  clock_.start();
+}
+
+void FrameBudget::Register(Cacher *c)
+{
+  QMutexLocker locker(&lock_);
+
+  if (IndexOf(c) == -1) {
+    Entry e;
+    e.cacher = c;
+    e.usage = 0;
+    e.layer = 0;
+    e.last_touch = clock_.elapsed();
+    entries_.append(e);
+  }
+}
+
+void FrameBudget::Unregister(Cacher *c)
+{
+  QMutexLocker locker(&lock_);
+
+  int index = IndexOf(c);
+  if (index > -1) {
+    entries_.removeAt(index);
+  }
+}
+
+void FrameBudget::Touch(Cacher *c, int layer)
+{
+  QMutexLocker locker(&lock_);
+
+  int index = IndexOf(c);
+  if (index > -1) {
+    entries_[index].layer = layer;
+    entries_[index].last_touch = clock_.elapsed();
+  }
+}
+
+void FrameBudget::SetUsage(Cacher *c, qint64 bytes)
+{
+  QMutexLocker locker(&lock_);
+
+  int index = IndexOf(c);
+  if (index > -1) {
+    entries_[index].usage = bytes;
+  }
+}
+
+bool FrameBudget::RequestMore(Cacher *c, qint64 bytes)
+{
+  qint64 budget = limit();
+
+  if (budget <= 0) {
+    return true;
+  }
+
+  QMutexLocker locker(&lock_);
+
+  int index = IndexOf(c);
+  if (index == -1) {
+    return true;
+  }
+
+  qint64 total_usage = 0;
+  for (int i=0;i<entries_.size();i++) {
+    total_usage += entries_.at(i).usage;
+  }
+
+  // there's still room, anyone can have it
+  if (total_usage + bytes <= budget) {
+    return true;
+  }
+
+  QVector<int> weights = Weights();
+  int total_weight = 0;
+  for (int i=0;i<weights.size();i++) {
+    total_weight += weights.at(i);
+  }
+
+  // if this cacher is already using its share, it has to make do with what it has
+  if (entries_.at(index).usage + bytes > ShareOf(weights.at(index), total_weight, budget)) {
+    return false;
+  }
+
+  // otherwise reclaim memory from the least valuable cachers that are over their share, until enough has been freed
+  qint64 needed = total_usage + bytes - budget;
+  QVector<bool> asked(entries_.size(), false);
+
+  while (needed > 0) {
+    int least_valuable = -1;
+
+    for (int i=0;i<entries_.size();i++) {
+      if (i != index
+          && !asked.at(i)
+          && entries_.at(i).usage > ShareOf(weights.at(i), total_weight, budget)
+          && (least_valuable == -1 || weights.at(i) < weights.at(least_valuable))) {
+        least_valuable = i;
+      }
+    }
+
+    if (least_valuable == -1) {
+      break;
+    }
+
+    asked[least_valuable] = true;
+    needed -= entries_.at(least_valuable).usage - ShareOf(weights.at(least_valuable), total_weight, budget);
+
+    entries_.at(least_valuable).cacher->RequestTrim();
+  }
+
+  return true;
+}
+
+qint64 FrameBudget::Share(Cacher *c)
+{
+  qint64 budget = limit();
+
+  if (budget <= 0) {
+    return std::numeric_limits<qint64>::max();
+  }
+
+  QMutexLocker locker(&lock_);
+
+  int index = IndexOf(c);
+  if (index == -1) {
+    return budget;
+  }
+
+  QVector<int> weights = Weights();
+  int total_weight = 0;
+  for (int i=0;i<weights.size();i++) {
+    total_weight += weights.at(i);
+  }
+
+  return ShareOf(weights.at(index), total_weight, budget);
+}
+
+qint64 FrameBudget::limit()
+{
+  return qint64(olive::CurrentConfig.frame_memory_budget) * 1024 * 1024;
+}
+
+qint64 FrameBudget::usage()
+{
+  QMutexLocker locker(&lock_);
+
+  qint64 total_usage = 0;
+  for (int i=0;i<entries_.size();i++) {
+    total_usage += entries_.at(i).usage;
+  }
+
+  return total_usage;
+}
+
+int FrameBudget::count()
+{
+  QMutexLocker locker(&lock_);
+
+  return entries_.size();
+}
+
+int FrameBudget::IndexOf(Cacher *c)
+{
+  for (int i=0;i<entries_.size();i++) {
+    if (entries_.at(i).cacher == c) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+QVector<int> FrameBudget::Weights()
+{
+  QVector<int> weights(entries_.size(), kIdleWeight);
+
+  qint64 now = clock_.elapsed();
+
+  // video tracks are negative and drawn from -1 upwards, so the lowest track number is on top
+  int top_layer = 0;
+  int top_entry = -1;
+
+  for (int i=0;i<entries_.size();i++) {
+    if (now - entries_.at(i).last_touch < kActiveTimeout) {
+      weights[i] = kActiveWeight;
+
+      if (top_entry == -1 || entries_.at(i).layer < top_layer) {
+        top_layer = entries_.at(i).layer;
+        top_entry = i;
+      }
+    }
+  }
+
+  if (top_entry > -1) {
+    weights[top_entry] = kTopLayerWeight;
+  }
+
+  return weights;
+}
+
+qint64 FrameBudget::ShareOf(int weight, int total_weight, qint64 budget)
+{
+  if (total_weight == 0) {
+    return budget;
+  }
+  return budget * weight / total_weight;
+}
@@ -0,0 +1,157 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEBUDGET_H
+#define FRAMEBUDGET_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVector>
+
+class Cacher;
+
+/**
+ * @brief Global limit on the memory used by decoded frames across every Cacher
+ *
+ * Config::previous_queue_size and Config::upcoming_queue_size limit each Cacher's queue on its own, so the total amount
+ * of decoded frames in memory grows with the number of open clips. Eight 4K layers with a 2 second upcoming queue hold
+ * around 16 GB of RGBA frames.
+ *
+ * Every video Cacher registers itself here, reports how much its queue is holding and asks before it caches further
+ * ahead. The budget (Config::frame_memory_budget) is divided between the Cachers by priority:
+ *
+ * * Cachers that were asked for a frame recently (i.e. their clip is under the playhead) are worth more than ones that
+ *   are only open, e.g. prefetched clips or clips under a paused playhead in another sequence.
+ * * Of those, the clip on the topmost track is worth the most since it's the one that's most likely visible.
+ *
+ * While there's room left in the budget, any Cacher can use it. Once the budget is exhausted, a Cacher that's still
+ * within its share reclaims memory from the least valuable Cachers that are over their own share by asking them to
+ * trim their queues (see Cacher::RequestTrim()). Queues are only ever modified by their own Cacher thread, so the limit
+ * is soft and can be exceeded briefly until those Cachers have trimmed.
+ *
+ * All functions are thread-safe.
+ */
+class FrameBudget {
+public:
+  FrameBudget();
+
+  /**
+   * @brief Start tracking a Cacher, called when it opens
+   */
+  void Register(Cacher* c);
+
+  /**
+   * @brief Stop tracking a Cacher, called when it closes
+   */
+  void Unregister(Cacher* c);
+
+  /**
+   * @brief Update the priority of a Cacher, called every time it's asked for a frame
+   *
+   * @param layer
+   *
+   * Track of the clip in the sequence being viewed, i.e. the track of the outermost nested clip if the clip is inside
+   * a nested sequence.
+   */
+  void Touch(Cacher* c, int layer);
+
+  /**
+   * @brief Report how many bytes of decoded frames a Cacher's queue is holding
+   */
+  void SetUsage(Cacher* c, qint64 bytes);
+
+  /**
+   * @brief Ask whether a Cacher may cache another frame
+   *
+   * If the budget is exhausted but `c` is within its share, less valuable Cachers are asked to trim and this returns
+   * **TRUE**.
+   *
+   * @param bytes
+   *
+   * Size of the frame to be cached.
+   *
+   * @return **FALSE** if there's no room for the frame and `c` should stop caching ahead.
+   */
+  bool RequestMore(Cacher* c, qint64 bytes);
+
+  /**
+   * @brief Amount of memory a Cacher should trim its queue down to when it's asked to trim
+   */
+  qint64 Share(Cacher* c);
+
+  /**
+   * @brief Current budget in bytes, or 0 if unlimited
+   */
+  qint64 limit();
+
+  /**
+   * @brief Total bytes of decoded frames currently held by all Cachers
+   */
+  qint64 usage();
+
+  /**
+   * @brief Number of Cachers currently tracked
+   */
+  int count();
+
+private:
+  struct Entry {
+    Cacher* cacher;
+    qint64 usage;
+    int layer;
+    qint64 last_touch;
+  };
+
+  /**
+   * @brief Index of a Cacher's entry in entries_, or -1 if it isn't registered
+   *
+   * lock_ must be held.
+   */
+  int IndexOf(Cacher* c);
+
+  /**
+   * @brief Relative value of every entry's frames, higher means more valuable
+   *
+   * lock_ must be held.
+   */
+  QVector<int> Weights();
+
+  /**
+   * @brief Fair share of the budget for an entry given its weight
+   *
+   * lock_ must be held.
+   */
+  qint64 ShareOf(int weight, int total_weight, qint64 budget);
+
+  QMutex lock_;
+
+  QVector<Entry> entries_;
+
+  QElapsedTimer clock_;
+};
+
+namespace olive {
+  /**
+   * @brief The frame memory budget shared by every Cacher
+   */
+  extern FrameBudget frame_budget;
+}
+
+#endif // FRAMEBUDGET_H
@@ -0,0 +1,235 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framebufferpool.h"
+
+#include <QOpenGLFramebufferObjectFormat>
+
+// number of frames a free framebuffer can go unused before it's destroyed
+const int kMaxIdleFrames = 30;
+
+FramebufferPool::FramebufferPool() {}
+
+FramebufferPool::~FramebufferPool()
+{
+  Clear();
+}
+
+QOpenGLFramebufferObject *FramebufferPool::Acquire(int width, int height, GLenum internal_format)
+{
+  Key key;
+  key.width = width;
+  key.height = height;
+  key.format = internal_format;
+
+  QOpenGLFramebufferObject* fbo;
+
+  QVector<FreeEntry>& free_list = free_[key];
+
+  if (free_list.isEmpty()) {
+    QOpenGLFramebufferObjectFormat format;
+    format.setInternalTextureFormat(internal_format);
+    fbo = new QOpenGLFramebufferObject(width, height, format);
+  } else {
+    fbo = free_list.takeLast().fbo;
+  }
+
+  in_use_.append(fbo);
+
+  return fbo;
+}
+
+void FramebufferPool::Release(QOpenGLFramebufferObject *fbo)
+{
+  if (fbo == nullptr) {
+    return;
+  }
+
+  in_use_.removeOne(fbo);
+  kept_.removeOne(fbo);
+
+  FreeEntry entry;
+  entry.fbo = fbo;
+  entry.idle_frames = 0;
+  free_[KeyOf(fbo)].append(entry);
+}
+
+void FramebufferPool::Keep(QOpenGLFramebufferObject *fbo)
+{
+  if (in_use_.removeOne(fbo)) {
+    kept_.append(fbo);
+  }
+}
+
+void FramebufferPool::Recycle()
+{
+  // age free framebuffers and destroy any that have gone unused for too long
+  QMap<Key, QVector<FreeEntry> >::iterator i = free_.begin();
+  while (i != free_.end()) {
+    QVector<FreeEntry>& free_list = i.value();
+
+    for (int j=free_list.size()-1;j>=0;j--) {
+      free_list[j].idle_frames++;
+      if (free_list.at(j).idle_frames > kMaxIdleFrames) {
+        delete free_list.at(j).fbo;
+        free_list.removeAt(j);
+      }
+    }
+
+    if (free_list.isEmpty()) {
+      i = free_.erase(i);
+    } else {
+      i++;
+    }
+  }
+
+  // return everything used this frame to the free list
+  for (int j=0;j<in_use_.size();j++) {
+    FreeEntry entry;
+    entry.fbo = in_use_.at(j);
+    entry.idle_frames = 0;
+    free_[KeyOf(entry.fbo)].append(entry);
+  }
+  in_use_.clear();
+}
+
+void FramebufferPool::Clear()
+{
+  QMap<Key, QVector<FreeEntry> >::iterator i;
+  for (i=free_.begin();i!=free_.end();i++) {
+    for (int j=0;j<i.value().size();j++) {
+      delete i.value().at(j).fbo;
+    }
+  }
+  free_.clear();
+
+  qDeleteAll(in_use_);
+  in_use_.clear();
+
+  qDeleteAll(kept_);
+  kept_.clear();
+}
+
+int FramebufferPool::size()
+{
+  int count = in_use_.size() + kept_.size();
+
+  QMap<Key, QVector<FreeEntry> >::const_iterator i;
+  for (i=free_.constBegin();i!=free_.constEnd();i++) {
+    count += i.value().size();
+  }
+
+  return count;
+}
+
+qint64 FramebufferPool::memory_usage()
+{
+  qint64 bytes = 0;
+
+  for (int i=0;i<in_use_.size();i++) {
+    bytes += qint64(in_use_.at(i)->width()) * in_use_.at(i)->height() * 4;
+  }
+
+  for (int i=0;i<kept_.size();i++) {
+    bytes += qint64(kept_.at(i)->width()) * kept_.at(i)->height() * 4;
+  }
+
+  QMap<Key, QVector<FreeEntry> >::const_iterator i;
+  for (i=free_.constBegin();i!=free_.constEnd();i++) {
+    bytes += qint64(i.key().width) * i.key().height * 4 * i.value().size();
+  }
+
+  return bytes;
+}
+
+FramebufferPool::Key FramebufferPool::KeyOf(QOpenGLFramebufferObject *fbo)
+{
+  Key key;
+  key.width = fbo->width();
+  key.height = fbo->height();
+  key.format = fbo->format().internalTextureFormat();
+  return key;
+}
+
+bool FramebufferPool::Key::operator<(const FramebufferPool::Key &rhs) const
+{
+  if (width != rhs.width) {
+    return width < rhs.width;
+  }
+  if (height != rhs.height) {
+    return height < rhs.height;
+  }
+  return format < rhs.format;
+}
+
+NestedSequenceCache::NestedSequenceCache() {}
+
+GLuint NestedSequenceCache::Get(Sequence *seq, long frame, int revision)
+{
+  for (int i=0;i<entries_.size();i++) {
+    Entry& e = entries_[i];
+    if (e.seq == seq && e.frame == frame && e.revision == revision) {
+      e.used = true;
+      return e.fbo->texture();
+    }
+  }
+  return 0;
+}
+
+void NestedSequenceCache::Insert(FramebufferPool* pool,
+                                 Sequence *seq,
+                                 long frame,
+                                 int revision,
+                                 QOpenGLFramebufferObject *fbo)
+{
+  // replace any stale entry for this sequence and frame
+  for (int i=0;i<entries_.size();i++) {
+    if (entries_.at(i).seq == seq && entries_.at(i).frame == frame) {
+      pool->Release(entries_.at(i).fbo);
+      entries_.removeAt(i);
+      break;
+    }
+  }
+
+  Entry e;
+  e.seq = seq;
+  e.frame = frame;
+  e.revision = revision;
+  e.fbo = fbo;
+  e.used = true;
+  entries_.append(e);
+}
+
+void NestedSequenceCache::EndFrame(FramebufferPool* pool)
+{
+  for (int i=entries_.size()-1;i>=0;i--) {
+    if (entries_.at(i).used) {
+      entries_[i].used = false;
+    } else {
+      pool->Release(entries_.at(i).fbo);
+      entries_.removeAt(i);
+    }
+  }
+}
+
+void NestedSequenceCache::Clear()
+{
+  entries_.clear();
+}
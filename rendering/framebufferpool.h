@@ -0,0 +1,171 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEBUFFERPOOL_H
+#define FRAMEBUFFERPOOL_H
+
+#include <QOpenGLFramebufferObject>
+#include <QVector>
+#include <QMap>
+
+class Sequence;
+
+/**
+ * @brief Pool of reusable framebuffers shared between all clips rendered by one context
+ *
+ * Previously every clip allocated its own set of QOpenGLFramebufferObjects at its media resolution and held onto them
+ * for as long as it was open. With many clips (and especially many nested sequences) this added up to a very large
+ * amount of GPU memory for buffers that were only ever used for a fraction of a frame.
+ *
+ * The pool hands out framebuffers keyed by size and internal format. Every framebuffer acquired during a frame is
+ * considered "in use" until Recycle() is called at the end of that frame, at which point it returns to the free list
+ * for the next frame. Free framebuffers that go unused for a number of frames are destroyed so the pool shrinks again
+ * after e.g. a resolution change.
+ *
+ * All functions must be called with the owning OpenGL context current.
+ */
+class FramebufferPool {
+public:
+  FramebufferPool();
+  ~FramebufferPool();
+
+  /**
+   * @brief Get a framebuffer of a given size and format
+   *
+   * Returns a free framebuffer matching the request, or creates a new one if there are none available. The contents
+   * of the framebuffer are undefined and should be cleared before use.
+   *
+   * @return A framebuffer that stays valid (and reserved) until the next call to Recycle() or Release().
+   */
+  QOpenGLFramebufferObject* Acquire(int width, int height, GLenum internal_format = GL_RGBA8);
+
+  /**
+   * @brief Return a framebuffer to the pool before the end of the frame
+   *
+   * Also used to hand back framebuffers that were detached with Keep().
+   */
+  void Release(QOpenGLFramebufferObject* fbo);
+
+  /**
+   * @brief Detach a framebuffer from per-frame recycling
+   *
+   * The framebuffer will not be recycled by Recycle() until it's explicitly handed back with Release(). Used by
+   * NestedSequenceCache to hold onto rendered frames across several frames.
+   */
+  void Keep(QOpenGLFramebufferObject* fbo);
+
+  /**
+   * @brief Signal the end of a frame
+   *
+   * Returns all framebuffers acquired this frame to the free list and destroys any that have been sitting unused for
+   * too long.
+   */
+  void Recycle();
+
+  /**
+   * @brief Destroy every framebuffer owned by the pool, including ones in use or kept
+   */
+  void Clear();
+
+  /**
+   * @brief Number of framebuffers currently allocated by this pool
+   */
+  int size();
+
+  /**
+   * @brief Approximate GPU memory held by all framebuffers owned by this pool, in bytes
+   *
+   * Assumes 4 bytes per pixel (every framebuffer Olive uses is 8-bit RGBA) and doesn't count mipmaps.
+   */
+  qint64 memory_usage();
+
+private:
+  struct Key {
+    int width;
+    int height;
+    GLenum format;
+
+    bool operator<(const Key& rhs) const;
+  };
+
+  struct FreeEntry {
+    QOpenGLFramebufferObject* fbo;
+    int idle_frames;
+  };
+
+  static Key KeyOf(QOpenGLFramebufferObject* fbo);
+
+  QMap<Key, QVector<FreeEntry> > free_;
+  QVector<QOpenGLFramebufferObject*> in_use_;
+  QVector<QOpenGLFramebufferObject*> kept_;
+};
+
+/**
+ * @brief Cache of rendered nested sequence frames
+ *
+ * Keyed by the nested Sequence, the frame of that sequence and the project content revision (see
+ * olive::ContentRevision()). If the same nested sequence is shown several times at the same frame, it only needs to
+ * be composited once. Entries that weren't used during a frame are handed back to the FramebufferPool by EndFrame(),
+ * so the cache never holds more than what the current frame actually needs.
+ */
+class NestedSequenceCache {
+public:
+  NestedSequenceCache();
+
+  /**
+   * @brief Look up a rendered frame
+   *
+   * @return The texture of the cached frame, or 0 if this frame hasn't been rendered at this revision.
+   */
+  GLuint Get(Sequence* seq, long frame, int revision);
+
+  /**
+   * @brief Store a rendered frame
+   *
+   * The framebuffer must have been acquired from `pool` and detached with FramebufferPool::Keep(). Ownership passes
+   * to the cache.
+   */
+  void Insert(FramebufferPool* pool, Sequence* seq, long frame, int revision, QOpenGLFramebufferObject* fbo);
+
+  /**
+   * @brief Drop all entries that weren't used since the last call
+   */
+  void EndFrame(FramebufferPool* pool);
+
+  /**
+   * @brief Forget all entries
+   *
+   * Does not release the framebuffers, should be called alongside FramebufferPool::Clear().
+   */
+  void Clear();
+
+private:
+  struct Entry {
+    Sequence* seq;
+    long frame;
+    int revision;
+    QOpenGLFramebufferObject* fbo;
+    bool used;
+  };
+
+  QVector<Entry> entries_;
+};
+
+#endif // FRAMEBUFFERPOOL_H
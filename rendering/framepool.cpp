@@ -0,0 +1,196 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framepool.h"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
+#include <QAtomicInt>
+#include <QDebug>
+
+// maximum amount of unused frames to hold onto
+const int kMaxFreeFrames = 64;
+
+// alignment of each plane's line size
+const int kLinesizeAlign = 64;
+
+static QAtomicInt frame_allocations;
+static QAtomicInt buffer_allocations;
+static QAtomicInt frame_reuses;
+
+FramePool::FramePool() {}
+
+FramePool::~FramePool()
+{
+  Clear();
+}
+
+AVFrame *FramePool::Get()
+{
+  if (free_frames_.isEmpty()) {
+    frame_allocations.ref();
+    return av_frame_alloc();
+  }
+
+  frame_reuses.ref();
+  return free_frames_.takeLast();
+}
+
+void FramePool::Release(AVFrame **frame)
+{
+  if (*frame == nullptr) {
+    return;
+  }
+
+  if (free_frames_.size() < kMaxFreeFrames) {
+    // returns the frame's buffers to whichever pool they came from
+    av_frame_unref(*frame);
+    free_frames_.append(*frame);
+    *frame = nullptr;
+  } else {
+    av_frame_free(frame);
+  }
+}
+
+void FramePool::SetUpDecoder(AVCodecContext *ctx)
+{
+  ctx->opaque = this;
+  ctx->get_buffer2 = GetBuffer2;
+}
+
+void FramePool::Clear()
+{
+  for (int i=0;i<free_frames_.size();i++) {
+    av_frame_free(&free_frames_[i]);
+  }
+  free_frames_.clear();
+
+  // buffers that are still in use keep their pool alive until they're unreferenced
+  QMap<int, AVBufferPool*>::iterator i;
+  for (i=buffer_pools_.begin();i!=buffer_pools_.end();i++) {
+    av_buffer_pool_uninit(&i.value());
+  }
+  buffer_pools_.clear();
+}
+
+int FramePool::allocated_frames()
+{
+  return frame_allocations.load();
+}
+
+int FramePool::allocated_buffers()
+{
+  return buffer_allocations.load();
+}
+
+int FramePool::reused_frames()
+{
+  return frame_reuses.load();
+}
+
+void FramePool::LogStats()
+{
+  static int last_frame_allocations = 0;
+  static int last_buffer_allocations = 0;
+  static int last_frame_reuses = 0;
+
+  int frames = frame_allocations.load();
+  int buffers = buffer_allocations.load();
+  int reuses = frame_reuses.load();
+
+  qInfo() << "Frame pool:"
+          << frames - last_frame_allocations << "frames allocated,"
+          << buffers - last_buffer_allocations << "buffers allocated,"
+          << reuses - last_frame_reuses << "frames reused";
+
+  last_frame_allocations = frames;
+  last_buffer_allocations = buffers;
+  last_frame_reuses = reuses;
+}
+
+int FramePool::GetBuffer2(AVCodecContext *ctx, AVFrame *frame, int flags)
+{
+  FramePool* pool = static_cast<FramePool*>(ctx->opaque);
+
+  if (pool == nullptr
+      || ctx->codec_type != AVMEDIA_TYPE_VIDEO
+      || !(ctx->codec->capabilities & AV_CODEC_CAP_DR1)) {
+    return avcodec_default_get_buffer2(ctx, frame, flags);
+  }
+
+  AVPixelFormat fmt = static_cast<AVPixelFormat>(frame->format);
+
+  // the decoder may write past the visible frame, so we use its aligned dimensions
+  int w = frame->width;
+  int h = frame->height;
+  int linesize_align[AV_NUM_DATA_POINTERS];
+  avcodec_align_dimensions2(ctx, &w, &h, linesize_align);
+
+  int linesizes[4];
+  if (av_image_fill_linesizes(linesizes, fmt, w) < 0) {
+    return avcodec_default_get_buffer2(ctx, frame, flags);
+  }
+  for (int i=0;i<4;i++) {
+    linesizes[i] = FFALIGN(linesizes[i], kLinesizeAlign);
+  }
+
+  // calculate total size of all planes
+  uint8_t* data[4];
+  int size = av_image_fill_pointers(data, fmt, h, nullptr, linesizes);
+  if (size < 0) {
+    return avcodec_default_get_buffer2(ctx, frame, flags);
+  }
+
+  // some decoders read slightly past the end of the buffer
+  size += kLinesizeAlign + AV_INPUT_BUFFER_PADDING_SIZE;
+
+  AVBufferPool*& buffer_pool = pool->buffer_pools_[size];
+  if (buffer_pool == nullptr) {
+    buffer_pool = av_buffer_pool_init(size, AllocBuffer);
+    if (buffer_pool == nullptr) {
+      return AVERROR(ENOMEM);
+    }
+  }
+
+  frame->buf[0] = av_buffer_pool_get(buffer_pool);
+  if (frame->buf[0] == nullptr) {
+    return AVERROR(ENOMEM);
+  }
+
+  // align start of the first plane
+  uint8_t* start = reinterpret_cast<uint8_t*>(FFALIGN(reinterpret_cast<uintptr_t>(frame->buf[0]->data), kLinesizeAlign));
+
+  av_image_fill_pointers(frame->data, fmt, h, start, linesizes);
+  for (int i=0;i<4;i++) {
+    frame->linesize[i] = linesizes[i];
+  }
+
+  frame->extended_data = frame->data;
+
+  return 0;
+}
+
+AVBufferRef *FramePool::AllocBuffer(BufferSize size)
+{
+  buffer_allocations.ref();
+  return av_buffer_alloc(size);
+}
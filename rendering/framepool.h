@@ -0,0 +1,125 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libavutil/version.h>
+}
+
+#include <QVector>
+#include <QMap>
+
+/**
+ * @brief Recycles AVFrames and decoder buffers for a Cacher
+ *
+ * Decoding allocates a lot of memory very quickly (at 4K60, hundreds of MB per second). Rather than allocating a new
+ * AVFrame for every decoded frame and freeing it once it leaves the ClipQueue, frames are handed back to this pool
+ * and reused. The decoder is also given a get_buffer2() callback (see SetUpDecoder()) that serves its picture buffers
+ * from AVBufferPools keyed by buffer size, so once playback reaches a steady state neither the frames nor their data
+ * cause any further allocations. Converted frames from the AVFilter stack already come from libavfilter's own
+ * per-link buffer pools, which are recycled as soon as the frames are unreferenced here.
+ *
+ * Global counters (see allocated_frames() and allocated_buffers()) can be used to verify this.
+ *
+ * A FramePool is owned by a single Cacher and is only used from that Cacher's thread, so it isn't thread-safe.
+ */
+class FramePool {
+public:
+  FramePool();
+
+  /**
+   * @brief FramePool Destructor
+   *
+   * Frees all unused frames. Buffer pools are released, but any buffers still referenced elsewhere stay valid until
+   * they're unreferenced.
+   */
+  ~FramePool();
+
+  /**
+   * @brief Get an empty frame
+   *
+   * Drop-in replacement for av_frame_alloc().
+   */
+  AVFrame* Get();
+
+  /**
+   * @brief Return a frame to the pool
+   *
+   * Drop-in replacement for av_frame_free(). Unreferences the frame's data and sets `*frame` to `nullptr`.
+   */
+  void Release(AVFrame** frame);
+
+  /**
+   * @brief Set up a decoder to allocate its picture buffers from this pool
+   *
+   * Must be called before avcodec_open2(). Only affects video decoders that support direct rendering, everything
+   * else falls back to FFmpeg's default allocator.
+   */
+  void SetUpDecoder(AVCodecContext* ctx);
+
+  /**
+   * @brief Free all unused frames and release all buffer pools
+   */
+  void Clear();
+
+  /**
+   * @brief Total number of AVFrames allocated by all pools since startup
+   */
+  static int allocated_frames();
+
+  /**
+   * @brief Total number of decoder buffers allocated by all pools since startup
+   */
+  static int allocated_buffers();
+
+  /**
+   * @brief Total number of frames reused by all pools since startup
+   */
+  static int reused_frames();
+
+  /**
+   * @brief Print how many frames and buffers were allocated and reused since the last call
+   *
+   * During steady-state playback, both allocation counts should be zero.
+   */
+  static void LogStats();
+
+private:
+  static int GetBuffer2(AVCodecContext* ctx, AVFrame* frame, int flags);
+
+  // av_buffer_pool_init() takes an allocator with a size_t size since FFmpeg 5
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 0, 0)
+  typedef size_t BufferSize;
+#else
+  typedef int BufferSize;
+#endif
+
+  static AVBufferRef* AllocBuffer(BufferSize size);
+
+  QVector<AVFrame*> free_frames_;
+
+  QMap<int, AVBufferPool*> buffer_pools_;
+};
+
+#endif // FRAMEPOOL_H
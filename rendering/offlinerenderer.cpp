@@ -0,0 +1,326 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "offlinerenderer.h"
+
+#include <QOpenGLFunctions>
+#include <QDebug>
+#include <QtMath>
+
+#include "rendering/renderfunctions.h"
+#include "rendering/shaderprogram.h"
+#include "project/media.h"
+#include "effects/transition.h"
+#include "global/config.h"
+#include "global/trace.h"
+
+// the private mix buffer holds 10 seconds at 48kHz so audio can be mixed in blocks of several seconds
+const int kOfflineAudioBufferSize = audio_ibuffer_size * 10;
+
+OfflineRenderer::OfflineRenderer(Sequence *source) :
+  surface_(nullptr),
+  ctx_(nullptr),
+  blend_mode_program_(nullptr),
+  premultiply_program_(nullptr),
+  audio_buffer_(kOfflineAudioBufferSize)
+{
+  seq_ = CopySequence(source);
+}
+
+OfflineRenderer::~OfflineRenderer()
+{
+  Stop();
+}
+
+Sequence *OfflineRenderer::sequence()
+{
+  return seq_.get();
+}
+
+AudioMixBuffer *OfflineRenderer::audio_buffer()
+{
+  return &audio_buffer_;
+}
+
+bool OfflineRenderer::Start(QOffscreenSurface *surface)
+{
+  surface_ = surface;
+
+  // share with the rest of the application so footage and effect resources behave the same as in the viewers
+  QOpenGLContext* share_ctx = QOpenGLContext::globalShareContext();
+
+  ctx_ = new QOpenGLContext();
+  if (share_ctx != nullptr) {
+    ctx_->setFormat(share_ctx->format());
+    ctx_->setShareContext(share_ctx);
+  }
+
+  if (!ctx_->create()) {
+    qCritical() << "Failed to create OpenGL context for offline rendering";
+    delete ctx_;
+    ctx_ = nullptr;
+    return false;
+  }
+
+  if (!ctx_->makeCurrent(surface_)) {
+    qCritical() << "Failed to make offline rendering context current";
+    delete ctx_;
+    ctx_ = nullptr;
+    return false;
+  }
+
+  main_buffer_.Create(ctx_, seq_->width, seq_->height);
+  back_buffer_1_.Create(ctx_, seq_->width, seq_->height);
+  back_buffer_2_.Create(ctx_, seq_->width, seq_->height);
+
+  blend_mode_program_ = olive::rendering::CreateProgram(":/internalshaders/common.vert",
+                                                         ":/internalshaders/blending.frag");
+
+  premultiply_program_ = olive::rendering::CreateProgram(":/internalshaders/common.vert",
+                                                          ":/internalshaders/premultiply.frag");
+
+  quad_.Create();
+
+  return true;
+}
+
+bool OfflineRenderer::RenderFrame(long frame, GLvoid *pixels, int linesize)
+{
+  seq_->playhead = frame;
+
+  ComposeSequenceParams params;
+  params.viewer = nullptr;
+  params.ctx = ctx_;
+  params.seq = seq_.get();
+  params.video = true;
+  params.gizmos = nullptr;
+  params.texture_failed = false;
+  params.wait_for_mutexes = true;
+  params.high_quality = true;
+  params.playback_speed = 1;
+  params.blend_mode_program = blend_mode_program_;
+  params.premultiply_program = premultiply_program_;
+  params.quad = &quad_;
+  params.backend_buffer1 = back_buffer_1_.buffer();
+  params.backend_buffer2 = back_buffer_2_.buffer();
+  params.backend_attachment1 = back_buffer_1_.texture();
+  params.backend_attachment2 = back_buffer_2_.texture();
+  params.main_buffer = main_buffer_.buffer();
+  params.main_attachment = main_buffer_.texture();
+  params.ocio_shader = nullptr;
+  params.ocio_lut_texture = 0;
+  params.fbo_pool = &fbo_pool_;
+  params.nest_cache = &nest_cache_;
+  params.clip_latency = nullptr;
+  params.audio_buffer = nullptr;
+
+  QOpenGLFunctions* f = ctx_->functions();
+
+  f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, params.main_buffer);
+
+  glClearColor(0.0, 0.0, 0.0, 0.0);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  glEnable(GL_BLEND);
+
+  olive::rendering::compose_sequence(params);
+
+  if (!params.texture_failed && pixels != nullptr) {
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, params.main_buffer);
+
+    f->glPixelStorei(GL_PACK_ROW_LENGTH, linesize);
+    f->glReadPixels(0, 0, seq_->width, seq_->height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    f->glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  }
+
+  // all clip framebuffers are free to be reused next frame
+  fbo_pool_.Recycle();
+  nest_cache_.EndFrame(&fbo_pool_);
+
+  glDisable(GL_BLEND);
+
+  f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+  return !params.texture_failed;
+}
+
+void OfflineRenderer::MixAudio(long start_frame, long end_frame)
+{
+  TraceScope trace("audio", "mix sequence");
+
+  // Clips are opened and closed around the playhead, so step the playhead through the block to open every clip that
+  // plays in it. Clips are opened up to Config::prefetch_window ahead of the playhead (see Clip::IsActiveAt()), so
+  // stepping by that much means no clip can fall between two steps. Each clip's cacher mixes as far ahead as the
+  // buffer allows once it's opened, so the steps after the first mostly just open clips that start later in the block.
+  long step = qMax(1L, long(qFloor(seq_->frame_rate * olive::CurrentConfig.prefetch_window)));
+
+  long frame = start_frame;
+  while (true) {
+    seq_->playhead = frame;
+
+    olive::rendering::compose_audio(nullptr, seq_.get(), 1, true, &audio_buffer_);
+
+    // compose_audio() only signals each clip's cacher to start mixing, wait for all of them to finish before the
+    // next step can close any of them
+    for (int i=0;i<sequences_.size();i++) {
+      Sequence* s = sequences_.at(i).get();
+      for (int j=0;j<s->clips.size();j++) {
+        Clip* c = s->clips.at(j).get();
+        if (c != nullptr && c->track() >= 0 && c->IsOpen()) {
+          c->WaitUntilCached();
+        }
+      }
+    }
+
+    if (frame >= end_frame) {
+      break;
+    }
+
+    frame = qMin(frame + step, end_frame);
+  }
+}
+
+long OfflineRenderer::AudioBlockLength()
+{
+  // cachers only mix up to half the buffer ahead of the read position, leave a second of that spare for the audio
+  // frame the encoder pulls past the end of a block
+  int bytes_per_second = audio_buffer_.SampleRate() * int(sizeof(qint16)) * 2;
+  double block_secs = double(audio_buffer_.size / 2) / bytes_per_second - 1.0;
+
+  return qMax(1L, long(qFloor(block_secs * seq_->frame_rate)));
+}
+
+void OfflineRenderer::SoloAudioTrack(int track)
+{
+  for (int i=0;i<seq_->clips.size();i++) {
+    Clip* c = seq_->clips.at(i).get();
+    if (c != nullptr && c->track() >= 0 && c->track() != track) {
+      c->set_enabled(false);
+    }
+  }
+}
+
+void OfflineRenderer::Stop()
+{
+  if (ctx_ == nullptr) {
+    return;
+  }
+
+  ctx_->makeCurrent(surface_);
+
+  // closes nested sequences' clips too
+  close_active_clips(seq_.get());
+
+  nest_cache_.Clear();
+  fbo_pool_.Clear();
+
+  main_buffer_.Destroy();
+  back_buffer_1_.Destroy();
+  back_buffer_2_.Destroy();
+
+  DeleteShaders();
+  quad_.Destroy();
+
+  ctx_->doneCurrent();
+
+  delete ctx_;
+  ctx_ = nullptr;
+}
+
+SequencePtr OfflineRenderer::CopySequence(Sequence *source)
+{
+  SequencePtr copy = source->copy();
+  copy->playhead = source->playhead;
+  sequences_.append(copy);
+
+  for (int i=0;i<source->clips.size();i++) {
+    Clip* original = source->clips.at(i).get();
+
+    if (original == nullptr) {
+      continue;
+    }
+
+    Clip* c = copy->clips.at(i).get();
+
+    // Sequence::copy() doesn't carry transitions over. A transition shared between two clips is owned by its
+    // parent_clip, so it's only copied once from there and then attached to the secondary clip's copy too.
+    TransitionPtr transitions[] = {original->opening_transition, original->closing_transition};
+    for (int j=0;j<2;j++) {
+      Transition* t = transitions[j].get();
+
+      if (t == nullptr || t->parent_clip != original) {
+        continue;
+      }
+
+      Clip* secondary_copy = nullptr;
+      if (t->secondary_clip != nullptr) {
+        for (int k=0;k<source->clips.size();k++) {
+          if (source->clips.at(k).get() == t->secondary_clip) {
+            secondary_copy = copy->clips.at(k).get();
+            break;
+          }
+        }
+      }
+
+      TransitionPtr t_copy = t->copy(c, secondary_copy);
+
+      if (j == 0) {
+        c->opening_transition = t_copy;
+      } else {
+        c->closing_transition = t_copy;
+      }
+
+      if (secondary_copy != nullptr) {
+        if (t->secondary_clip->opening_transition.get() == t) {
+          secondary_copy->opening_transition = t_copy;
+        } else if (t->secondary_clip->closing_transition.get() == t) {
+          secondary_copy->closing_transition = t_copy;
+        }
+      }
+    }
+
+    // nested sequences get their own copy too, otherwise their clips would share decoders with the live viewers
+    if (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_SEQUENCE) {
+      Sequence* nested = c->media()->to_sequence().get();
+
+      MediaPtr nested_media = nested_media_.value(nested);
+      if (nested_media == nullptr) {
+        nested_media = std::make_shared<Media>();
+        nested_media->set_sequence(CopySequence(nested));
+        nested_media_.insert(nested, nested_media);
+      }
+
+      c->set_media(nested_media.get(), c->media_stream_index());
+    }
+  }
+
+  return copy;
+}
+
+void OfflineRenderer::DeleteShaders()
+{
+  delete blend_mode_program_;
+  blend_mode_program_ = nullptr;
+
+  delete premultiply_program_;
+  premultiply_program_ = nullptr;
+}
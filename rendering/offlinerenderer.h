@@ -0,0 +1,172 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OFFLINERENDERER_H
+#define OFFLINERENDERER_H
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <QVector>
+#include <QMap>
+
+#include "timeline/sequence.h"
+#include "rendering/audio.h"
+#include "rendering/framebufferobject.h"
+#include "rendering/framebufferpool.h"
+#include "rendering/quadrenderer.h"
+
+/**
+ * @brief Renders a Sequence independently of the live viewers
+ *
+ * Previously exporting borrowed the Sequence Viewer's RenderThread, mixed audio through the live playback buffer and
+ * moved the sequence's playhead along as it went, so nothing else could play or be edited while an export ran.
+ *
+ * OfflineRenderer instead works on a private copy of the sequence (including any sequences nested in it), so every
+ * clip has its own Cacher and decoder instances, and renders it with its own OpenGL context and framebuffers. Audio is
+ * mixed into a private AudioMixBuffer. Frames are rendered at an explicit frame number, the original sequence's
+ * playhead is never touched.
+ *
+ * The renderer doesn't run its own thread, all rendering happens in the thread that calls Start(). The sequence copy is
+ * made in the constructor, which must run in the main thread.
+ */
+class OfflineRenderer {
+public:
+  /**
+   * @brief OfflineRenderer Constructor
+   *
+   * Copies `source` as it is right now. Later changes to `source` won't affect the render. Must be called from the
+   * main thread.
+   */
+  OfflineRenderer(Sequence* source);
+
+  ~OfflineRenderer();
+
+  /**
+   * @brief The private copy of the sequence being rendered
+   */
+  Sequence* sequence();
+
+  /**
+   * @brief The buffer this renderer's audio is mixed into
+   *
+   * Set its sample rate and starting frame (AudioMixBuffer::SetSampleRate() and AudioMixBuffer::Reset()) before the
+   * first call to MixAudio().
+   */
+  AudioMixBuffer* audio_buffer();
+
+  /**
+   * @brief Create the OpenGL context and make it current in the calling thread
+   *
+   * @param surface
+   *
+   * Surface to render with. QOffscreenSurface must be created in the main thread, so it's passed in by the owner.
+   *
+   * @return **TRUE** if the context could be created.
+   */
+  bool Start(QOffscreenSurface* surface);
+
+  /**
+   * @brief Render one frame of the sequence
+   *
+   * @param frame
+   *
+   * Sequence frame to render.
+   *
+   * @param pixels
+   *
+   * Buffer to read the RGBA result back into, must be at least `linesize * height * 4` bytes.
+   *
+   * @param linesize
+   *
+   * Row length of `pixels` in pixels, or 0 if the rows are tightly packed.
+   *
+   * @return **FALSE** if some media wasn't ready and the frame should be rendered again, **TRUE** otherwise.
+   */
+  bool RenderFrame(long frame, GLvoid* pixels, int linesize = 0);
+
+  /**
+   * @brief Mix a block of the sequence's audio into audio_buffer()
+   *
+   * Opens every audio clip that plays between `start_frame` and `end_frame` (inclusive) and blocks until they've all
+   * mixed as much as fits into the buffer. The clips decode in parallel on their own cacher threads, so mixing large
+   * blocks at once runs as fast as the media can be decoded rather than one frame's worth of samples at a time.
+   *
+   * The block must be no longer than AudioBlockLength().
+   */
+  void MixAudio(long start_frame, long end_frame);
+
+  /**
+   * @brief The longest block of frames MixAudio() can mix in one call at the buffer's current sample rate
+   */
+  long AudioBlockLength();
+
+  /**
+   * @brief Only mix the audio of one track
+   *
+   * Disables every audio clip in the private sequence copy that isn't on `track`. Used for exporting stems.
+   */
+  void SoloAudioTrack(int track);
+
+  /**
+   * @brief Close all clips and destroy the OpenGL context
+   *
+   * Must be called from the same thread as Start().
+   */
+  void Stop();
+
+private:
+  /**
+   * @brief Deep copy a sequence for this renderer, including transitions and nested sequences
+   */
+  SequencePtr CopySequence(Sequence* source);
+
+  void DeleteShaders();
+
+  SequencePtr seq_;
+
+  /**
+   * @brief Every sequence copied by this renderer, used for waiting on their clips
+   */
+  QVector<SequencePtr> sequences_;
+
+  /**
+   * @brief Private Media wrappers for nested sequence copies, keyed by the original nested sequence
+   */
+  QMap<Sequence*, MediaPtr> nested_media_;
+
+  QOffscreenSurface* surface_;
+  QOpenGLContext* ctx_;
+
+  QOpenGLShaderProgram* blend_mode_program_;
+  QOpenGLShaderProgram* premultiply_program_;
+  QuadRenderer quad_;
+
+  FramebufferObject main_buffer_;
+  FramebufferObject back_buffer_1_;
+  FramebufferObject back_buffer_2_;
+
+  FramebufferPool fbo_pool_;
+  NestedSequenceCache nest_cache_;
+
+  AudioMixBuffer audio_buffer_;
+};
+
+#endif // OFFLINERENDERER_H
@@ -0,0 +1,252 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "quadrenderer.h"
+
+#include <QOpenGLContext>
+#include <QDebug>
+
+#include "effects/effect.h"
+#include "rendering/shaderprogram.h"
+
+// floats per vertex: position xy followed by texture coordinate st
+const int kVertexStride = 4;
+
+QuadRenderer::QuadRenderer() :
+  vbo_(QOpenGLBuffer::VertexBuffer),
+  texture_program_(nullptr),
+  solid_program_(nullptr)
+{}
+
+void QuadRenderer::Create()
+{
+  if (IsCreated()) {
+    return;
+  }
+
+  // core profile requires a vertex array object, older compatibility contexts may not support them at all in which
+  // case the attribute state is simply set up globally on every draw
+  vao_.create();
+
+  vbo_.create();
+  vbo_.setUsagePattern(QOpenGLBuffer::StreamDraw);
+
+  texture_program_ = new QOpenGLShaderProgram();
+  olive::rendering::AddShader(texture_program_,
+                              QOpenGLShader::Fragment,
+                              "#version 110\n"
+                              "\n"
+                              "uniform sampler2D tex;\n"
+                              "uniform float opacity;\n"
+                              "varying vec2 vTexCoord;\n"
+                              "\n"
+                              "void main() {\n"
+                              "  gl_FragColor = texture2D(tex, vTexCoord) * opacity;\n"
+                              "}\n");
+  olive::rendering::LinkProgram(texture_program_);
+
+  solid_program_ = new QOpenGLShaderProgram();
+  olive::rendering::AddShader(solid_program_,
+                              QOpenGLShader::Fragment,
+                              "#version 110\n"
+                              "\n"
+                              "uniform vec4 color;\n"
+                              "\n"
+                              "void main() {\n"
+                              "  gl_FragColor = color;\n"
+                              "}\n");
+  olive::rendering::LinkProgram(solid_program_);
+}
+
+bool QuadRenderer::IsCreated()
+{
+  return vbo_.isCreated();
+}
+
+void QuadRenderer::Destroy()
+{
+  delete texture_program_;
+  texture_program_ = nullptr;
+
+  delete solid_program_;
+  solid_program_ = nullptr;
+
+  vbo_.destroy();
+  vao_.destroy();
+}
+
+void QuadRenderer::Draw(QOpenGLShaderProgram *program,
+                        const QMatrix4x4 &mvp,
+                        const QVector2D *positions,
+                        const QVector2D *texcoords,
+                        float opacity)
+{
+  bool use_texture_program = (program == nullptr);
+
+  if (use_texture_program) {
+    program = texture_program_;
+  }
+
+  program->bind();
+  program->setUniformValue("olive_mvp", mvp);
+
+  if (use_texture_program) {
+    program->setUniformValue("tex", 0);
+    program->setUniformValue("opacity", opacity);
+  }
+
+  GLfloat data[4 * kVertexStride];
+  for (int i=0;i<4;i++) {
+    data[i*kVertexStride] = positions[i].x();
+    data[i*kVertexStride+1] = positions[i].y();
+    data[i*kVertexStride+2] = texcoords[i].x();
+    data[i*kVertexStride+3] = texcoords[i].y();
+  }
+
+  DrawArrays(GL_TRIANGLE_FAN, data, 4);
+
+  if (use_texture_program) {
+    program->release();
+  }
+}
+
+void QuadRenderer::DrawCoords(QOpenGLShaderProgram *program,
+                              const QMatrix4x4 &mvp,
+                              const GLTextureCoords &coords,
+                              float opacity)
+{
+  QVector2D positions[4] = {
+    QVector2D(coords.vertexTopLeftX, coords.vertexTopLeftY),
+    QVector2D(coords.vertexTopRightX, coords.vertexTopRightY),
+    QVector2D(coords.vertexBottomRightX, coords.vertexBottomRightY),
+    QVector2D(coords.vertexBottomLeftX, coords.vertexBottomLeftY)
+  };
+
+  QVector2D texcoords[4] = {
+    QVector2D(coords.textureTopLeftX, coords.textureTopLeftY),
+    QVector2D(coords.textureTopRightX, coords.textureTopRightY),
+    QVector2D(coords.textureBottomRightX, coords.textureBottomRightY),
+    QVector2D(coords.textureBottomLeftX, coords.textureBottomLeftY)
+  };
+
+  Draw(program, mvp, positions, texcoords, opacity);
+}
+
+void QuadRenderer::Blit(QOpenGLShaderProgram *program, float opacity)
+{
+  QMatrix4x4 mvp;
+  mvp.ortho(0, 1, 0, 1, -1, 1);
+
+  QVector2D corners[4] = {
+    QVector2D(0, 0),
+    QVector2D(1, 0),
+    QVector2D(1, 1),
+    QVector2D(0, 1)
+  };
+
+  Draw(program, mvp, corners, corners, opacity);
+}
+
+void QuadRenderer::DrawSolid(GLenum mode, const QVector<QVector2D> &points, const QColor &color, const QMatrix4x4 &mvp)
+{
+  if (points.isEmpty()) {
+    return;
+  }
+
+  solid_program_->bind();
+  solid_program_->setUniformValue("olive_mvp", mvp);
+  solid_program_->setUniformValue("color", color);
+
+  QVector<GLfloat> data(points.size() * kVertexStride, 0.0f);
+  for (int i=0;i<points.size();i++) {
+    data[i*kVertexStride] = points.at(i).x();
+    data[i*kVertexStride+1] = points.at(i).y();
+  }
+
+  DrawArrays(mode, data.constData(), points.size());
+
+  solid_program_->release();
+}
+
+void QuadRenderer::DrawArrays(GLenum mode, const GLfloat *data, int vertex_count)
+{
+  QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+
+  QOpenGLVertexArrayObject::Binder vao_binder(&vao_);
+
+  vbo_.bind();
+
+  // re-allocating orphans the previous contents so the driver doesn't have to wait for draws still reading them
+  vbo_.allocate(data, vertex_count * kVertexStride * int(sizeof(GLfloat)));
+
+  f->glEnableVertexAttribArray(olive::rendering::kPositionAttribute);
+  f->glEnableVertexAttribArray(olive::rendering::kTexCoordAttribute);
+  f->glVertexAttribPointer(olive::rendering::kPositionAttribute,
+                           2,
+                           GL_FLOAT,
+                           GL_FALSE,
+                           kVertexStride * sizeof(GLfloat),
+                           nullptr);
+  f->glVertexAttribPointer(olive::rendering::kTexCoordAttribute,
+                           2,
+                           GL_FLOAT,
+                           GL_FALSE,
+                           kVertexStride * sizeof(GLfloat),
+                           reinterpret_cast<const void*>(2 * sizeof(GLfloat)));
+
+  f->glDrawArrays(mode, 0, vertex_count);
+
+  // without a vertex array object the attribute state is global, don't leave it enabled for e.g. QPainter
+  if (!vao_.isCreated()) {
+    f->glDisableVertexAttribArray(olive::rendering::kPositionAttribute);
+    f->glDisableVertexAttribArray(olive::rendering::kTexCoordAttribute);
+  }
+
+  vbo_.release();
+}
+
+void olive::rendering::PrepareToDraw(QOpenGLFunctions *f, bool minified) {
+  if (minified) {
+    f->glGenerateMipmap(GL_TEXTURE_2D);
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  } else {
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  }
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+}
+
+bool olive::rendering::IsMinified(const QVector2D *positions,
+                                  const QVector2D *texcoords,
+                                  int texture_width,
+                                  int texture_height)
+{
+  // shortest drawn length of the horizontal and vertical edges, so rotated and corner pinned quads count too
+  float drawn_width = qMin(positions[0].distanceToPoint(positions[1]), positions[3].distanceToPoint(positions[2]));
+  float drawn_height = qMin(positions[0].distanceToPoint(positions[3]), positions[1].distanceToPoint(positions[2]));
+
+  // size of the region of the texture being drawn
+  float source_width = qAbs(texcoords[1].x() - texcoords[0].x()) * texture_width;
+  float source_height = qAbs(texcoords[3].y() - texcoords[0].y()) * texture_height;
+
+  // allow half a pixel of rounding error so 1:1 draws don't count
+  return drawn_width < source_width - 0.5f || drawn_height < source_height - 0.5f;
+}
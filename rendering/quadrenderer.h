@@ -0,0 +1,154 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef QUADRENDERER_H
+#define QUADRENDERER_H
+
+#include <QOpenGLFunctions>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QVector2D>
+#include <QVector>
+#include <QColor>
+
+struct GLTextureCoords;
+
+/**
+ * @brief Draws textured quads and lines from a vertex buffer
+ *
+ * Replaces the immediate mode drawing (glBegin()/glEnd(), glOrtho() and the fixed-function matrix stack) that Olive
+ * used to draw with, none of which are available in core profile contexts. All geometry is streamed through a single
+ * vertex buffer in the layout every program linked with olive::rendering::LinkProgram() expects, and transforms are
+ * passed to shaders as a QMatrix4x4 in the `olive_mvp` uniform.
+ *
+ * Vertex array objects aren't shared between contexts, so every context that draws needs its own QuadRenderer. All
+ * functions must be called with that context current.
+ */
+class QuadRenderer {
+public:
+  QuadRenderer();
+
+  /**
+   * @brief Create the vertex buffer and built-in programs
+   */
+  void Create();
+
+  /**
+   * @brief Returns whether Create() has been called (and Destroy() hasn't since)
+   */
+  bool IsCreated();
+
+  /**
+   * @brief Destroy all OpenGL objects
+   *
+   * Must be called before the context is destroyed, the destructor doesn't free anything.
+   */
+  void Destroy();
+
+  /**
+   * @brief Draw a quad
+   *
+   * @param program
+   *
+   * Program to draw with. It's bound and its `olive_mvp` uniform is set, any other uniforms should be set by the
+   * caller. The program is left bound. If nullptr, a built-in program is used that draws the texture bound to unit 0
+   * multiplied by `opacity`.
+   *
+   * @param positions
+   *
+   * Four corners in the order top left, top right, bottom right, bottom left (the order shaders using gl_VertexID
+   * expect).
+   *
+   * @param texcoords
+   *
+   * Texture coordinates of the four corners in the same order.
+   */
+  void Draw(QOpenGLShaderProgram* program,
+            const QMatrix4x4& mvp,
+            const QVector2D* positions,
+            const QVector2D* texcoords,
+            float opacity = 1.0f);
+
+  /**
+   * @brief Draw a quad described by an effect stack's GLTextureCoords
+   *
+   * Same as Draw(), but takes the corners and texture coordinates from `coords`.
+   */
+  void DrawCoords(QOpenGLShaderProgram* program,
+                  const QMatrix4x4& mvp,
+                  const GLTextureCoords& coords,
+                  float opacity = 1.0f);
+
+  /**
+   * @brief Draw the texture bound to unit 0 over the whole viewport
+   *
+   * Same as Draw() with a quad covering the viewport and texture coordinates from 0.0 to 1.0.
+   */
+  void Blit(QOpenGLShaderProgram* program = nullptr, float opacity = 1.0f);
+
+  /**
+   * @brief Draw untextured primitives in a solid color
+   *
+   * @param mode
+   *
+   * Primitive type, e.g. GL_LINES or GL_TRIANGLE_FAN.
+   */
+  void DrawSolid(GLenum mode, const QVector<QVector2D>& points, const QColor& color, const QMatrix4x4& mvp);
+
+private:
+  void DrawArrays(GLenum mode, const GLfloat* data, int vertex_count);
+
+  QOpenGLVertexArrayObject vao_;
+  QOpenGLBuffer vbo_;
+  QOpenGLShaderProgram* texture_program_;
+  QOpenGLShaderProgram* solid_program_;
+};
+
+namespace olive {
+namespace rendering {
+
+/**
+ * @brief Set up the filtering of the currently bound texture before drawing it
+ *
+ * Mipmaps are only worth generating when the texture is drawn smaller than it is. Effect passes and most clips are
+ * drawn at 1:1 where generating them would be wasted work every frame, so they're only generated if `minified` is
+ * **TRUE** (see IsMinified()). Otherwise the texture is sampled bilinearly from its base level.
+ */
+void PrepareToDraw(QOpenGLFunctions* f, bool minified);
+
+/**
+ * @brief Returns whether a texture is drawn smaller than its size on screen
+ *
+ * @param positions
+ *
+ * The four corners (top left, top right, bottom right, bottom left) the texture is drawn to, in target pixels.
+ *
+ * @param texcoords
+ *
+ * The texture coordinates of the four corners.
+ */
+bool IsMinified(const QVector2D* positions, const QVector2D* texcoords, int texture_width, int texture_height);
+
+}
+}
+
+#endif // QUADRENDERER_H
@@ -25,6 +25,7 @@ extern "C" {
 }
 
 #include <QOpenGLFramebufferObject>
+#include <QElapsedTimer>
 #include <QApplication>
 #include <QDesktopWidget>
 #include <QDebug>
@@ -44,122 +45,164 @@ namespace OCIO = OCIO_NAMESPACE;
 #include "ui/collapsiblewidget.h"
 
 #include "rendering/audio.h"
+#include "rendering/cacher.h"
+#include "rendering/quadrenderer.h"
 
 #include "global/math.h"
 #include "global/config.h"
 
+#include "undo/undostack.h"
+
 #include "panels/timeline.h"
 #include "panels/viewer.h"
 
-void PrepareToDraw(QOpenGLFunctions* f) {
-  f->glGenerateMipmap(GL_TEXTURE_2D);
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+// returns whether a clip's texture is drawn smaller than it is, coords are in sequence pixels
+bool ClipIsMinified(const GLTextureCoords& coords, int texture_width, int texture_height) {
+  QVector2D positions[4] = {
+    QVector2D(coords.matrix * QPointF(coords.vertexTopLeftX, coords.vertexTopLeftY)),
+    QVector2D(coords.matrix * QPointF(coords.vertexTopRightX, coords.vertexTopRightY)),
+    QVector2D(coords.matrix * QPointF(coords.vertexBottomRightX, coords.vertexBottomRightY)),
+    QVector2D(coords.matrix * QPointF(coords.vertexBottomLeftX, coords.vertexBottomLeftY))
+  };
+
+  QVector2D texcoords[4] = {
+    QVector2D(coords.textureTopLeftX, coords.textureTopLeftY),
+    QVector2D(coords.textureTopRightX, coords.textureTopRightY),
+    QVector2D(coords.textureBottomRightX, coords.textureBottomRightY),
+    QVector2D(coords.textureBottomLeftX, coords.textureBottomLeftY)
+  };
+
+  return olive::rendering::IsMinified(positions, texcoords, texture_width, texture_height);
 }
 
-void full_blit() {
-  PrepareToDraw(QOpenGLContext::currentContext()->functions());
-
-  glPushMatrix();
-  glLoadIdentity();
-  glOrtho(0, 1, 0, 1, -1, 1);
-
-  glBegin(GL_QUADS);
-  glTexCoord2f(0, 0); // top left
-  glVertex2f(0, 0); // top left
-  glTexCoord2f(1, 0); // top right
-  glVertex2f(1, 0); // top right
-  glTexCoord2f(1, 1); // bottom right
-  glVertex2f(1, 1); // bottom right
-  glTexCoord2f(0, 1); // bottom left
-  glVertex2f(0, 1); // bottom left
-  glEnd();
-
-  glPopMatrix();
+// returns whether a clip is on screen (or audible) at a given time, as opposed to just being open ahead of time
+static bool clip_is_shown_at(Clip* c, long playhead) {
+  return playhead >= c->timeline_in(true) && playhead < c->timeline_out(true);
 }
 
-void draw_clip(QOpenGLContext* ctx, GLuint fbo, GLuint texture, bool clear) {
-  ctx->functions()->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+// returns how many frames of playback in the current direction are left until a clip is shown, <= 0 if it's
+// already been passed
+static long frames_until_shown(Clip* c, long playhead, int playback_speed) {
+  if (playback_speed < 0) {
+    return playhead - c->timeline_out(true) + 1;
+  }
+  return c->timeline_in(true) - playhead;
+}
+
+// adds a clip to the list of clips being composited, video clips are sorted by track
+static void add_current_clip(QVector<Clip*>& current_clips, Clip* c, bool video) {
+  // track sorting is only necessary for video clips
+  // audio clips are mixed equally, so we skip sorting for those
+  if (video) {
+
+    // insertion sort by track
+    for (int j=0;j<current_clips.size();j++) {
+      if (current_clips.at(j)->track() < c->track()) {
+        current_clips.insert(j, c);
+        return;
+      }
+    }
 
-  if (clear) {
-    glClear(GL_COLOR_BUFFER_BIT);
   }
 
-  glBindTexture(GL_TEXTURE_2D, texture);
+  current_clips.append(c);
+}
 
-  full_blit();
+// opens video clips that are about to be shown, nearest first, for as long as Config::max_open_decoders allows
+static void open_prefetch_clips(QVector<Clip*>& prefetch_clips,
+                                QVector<Clip*>& prefetched_clips,
+                                long playhead,
+                                int playback_speed) {
+  // insertion sort by distance to the playhead
+  QVector<Clip*> sorted_clips;
+  for (int i=0;i<prefetch_clips.size();i++) {
+    Clip* c = prefetch_clips.at(i);
+    long distance = frames_until_shown(c, playhead, playback_speed);
+
+    int j = 0;
+    while (j < sorted_clips.size() && frames_until_shown(sorted_clips.at(j), playhead, playback_speed) <= distance) {
+      j++;
+    }
+    sorted_clips.insert(j, c);
+  }
 
-  glBindTexture(GL_TEXTURE_2D, 0);
+  for (int i=0;i<sorted_clips.size();i++) {
+    if (olive::CurrentConfig.max_open_decoders > 0
+        && Cacher::open_count() >= olive::CurrentConfig.max_open_decoders) {
+      break;
+    }
 
-  ctx->functions()->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-}
+    Clip* c = sorted_clips.at(i);
 
-GLuint draw_clip(QOpenGLFramebufferObject* fbo, GLuint texture, bool clear) {
-  fbo->bind();
+    c->Open();
 
-  if (clear) {
-    glClear(GL_COLOR_BUFFER_BIT);
+    // Open() fails if the clip is still busy closing, we'll try again next frame
+    if (c->IsOpen()) {
+      prefetched_clips.append(c);
+    }
   }
+}
 
-  glBindTexture(GL_TEXTURE_2D, texture);
+// requests the frame of every open footage clip shown inside a nested sequence (and any sequences nested in that), so
+// they decode in parallel with the clips around the nested sequence instead of one nested sequence at a time
+static void precache_nested_clips(olive::rendering::ComposeSequenceParams& params, Clip* nest, long playhead) {
+  Sequence* s = nest->media()->to_sequence().get();
+  long nested_playhead = rescale_frame_number(playhead + nest->clip_in(true) - nest->timeline_in(true),
+                                              nest->sequence->frame_rate,
+                                              s->frame_rate);
+
+  // nothing inside will be composited if the nested sequence's frame is already cached (see compose_sequence())
+  if (params.nest_cache != nullptr
+      && (params.gizmos == nullptr || params.gizmos->parent_clip->sequence == params.seq)
+      && params.nest_cache->Get(s, nested_playhead, olive::ContentRevision()) != 0) {
+    return;
+  }
 
-  full_blit();
+  params.nests.append(nest);
 
-  glBindTexture(GL_TEXTURE_2D, 0);
+  for (int i=0;i<s->clips.size();i++) {
+    Clip* c = s->clips.at(i).get();
 
-  fbo->release();
+    if (c == nullptr
+        || c->track() >= 0
+        || !c->enabled()
+        || c->media() == nullptr
+        || !c->IsOpen()
+        || !clip_is_shown_at(c, nested_playhead)) {
+      continue;
+    }
 
-  return fbo->texture();
-}
+    if (c->media()->get_type() == MEDIA_TYPE_SEQUENCE) {
+      precache_nested_clips(params, c, nested_playhead);
+      continue;
+    }
 
-void process_effect(Clip* c,
-                    Effect* e,
-                    double timecode,
-                    GLTextureCoords& coords,
-                    GLuint& composite_texture,
-                    bool& fbo_switcher,
-                    bool& texture_failed,
-                    int data) {
-  if (e->IsEnabled()) {
-    if (e->Flags() & Effect::CoordsFlag) {
-      e->process_coords(timecode, coords, data);
+    if (c->media()->get_type() != MEDIA_TYPE_FOOTAGE
+        || c->media()->to_footage()->invalid
+        || !c->media()->to_footage()->ready
+        || c->media_stream() == nullptr) {
+      continue;
     }
-    bool can_process_shaders = ((e->Flags() & Effect::ShaderFlag) && olive::CurrentRuntimeConfig.shaders_are_enabled);
-    if (can_process_shaders || (e->Flags() & Effect::SuperimposeFlag)) {
-      e->startEffect();
-      if (can_process_shaders && e->is_glsl_linked()) {
-        for (int i=0;i<e->getIterations();i++) {
-          e->process_shader(timecode, coords, i);
-          composite_texture = draw_clip(c->fbo[fbo_switcher], composite_texture, true);
-          fbo_switcher = !fbo_switcher;
-        }
+
+    // a nested sequence shown several times shares its clips, only the first one can be requested ahead of time
+    bool already_requested = false;
+    for (int j=0;j<params.precached_clips.size();j++) {
+      if (params.precached_clips.at(j).first == c) {
+        already_requested = true;
+        break;
       }
-      if (e->Flags() & Effect::SuperimposeFlag) {
-        GLuint superimpose_texture = e->process_superimpose(timecode);
-
-        if (superimpose_texture == 0) {
-          qWarning() << "Superimpose texture was nullptr, retrying...";
-          texture_failed = true;
-        } else if (composite_texture == 0) {
-          // if there is no previous texture, just return the superimposes texture
-          // UNLESS this is a shader-extended superimpose effect in which case,
-          // we'll need to draw it below
-          composite_texture = superimpose_texture;
-        } else {
-          // if the source texture is not already a framebuffer texture,
-          // we'll need to make it one before drawing a superimpose effect on it
-          if (composite_texture != c->fbo[0]->texture() && composite_texture != c->fbo[1]->texture()) {
-            draw_clip(c->fbo[!fbo_switcher], composite_texture, true);
-          }
+    }
 
-          composite_texture = draw_clip(c->fbo[!fbo_switcher], superimpose_texture, false);
-        }
+    if (!already_requested && c->state_change_lock.tryLock()) {
+      if (c->IsOpen()) {
+        c->Cache(nested_playhead, false, params.nests, params.playback_speed);
+        params.precached_clips.append(QPair<Clip*, long>(c, nested_playhead));
       }
-      e->endEffect();
+      c->state_change_lock.unlock();
     }
   }
+
+  params.nests.removeLast();
 }
 
 GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
@@ -170,15 +213,18 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
   Sequence* s = params.seq;
   long playhead = s->playhead;
 
-  if (!params.nests.isEmpty()) {
+  if (params.nests.isEmpty()) {
+    params.precached_clips.clear();
+  } else {
     for (int i=0;i<params.nests.size();i++) {
       s = params.nests.at(i)->media()->to_sequence().get();
       playhead += params.nests.at(i)->clip_in(true) - params.nests.at(i)->timeline_in(true);
       playhead = rescale_frame_number(playhead, params.nests.at(i)->sequence->frame_rate, s->frame_rate);
     }
 
-    if (params.video && params.nests.last()->fbo != nullptr) {
+    if (params.video && params.nests.last()->fbo[0] != nullptr) {
       params.nests.last()->fbo[0]->bind();
+      glClearColor(0.0, 0.0, 0.0, 0.0);
       glClear(GL_COLOR_BUFFER_BIT);
       final_fbo = params.nests.last()->fbo[0]->handle();
     }
@@ -188,6 +234,12 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
 
   QVector<Clip*> current_clips;
 
+  // video clips that are coming up but aren't open yet, see open_prefetch_clips()
+  QVector<Clip*> prefetch_clips;
+
+  // video clips that are open but not shown yet, they're only pre-rolled and never drawn
+  QVector<Clip*> prefetched_clips;
+
   // loop through clips, find currently active, and sort by track
   for (int i=0;i<s->clips.size();i++) {
 
@@ -205,24 +257,43 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
           Footage* m = c->media()->to_footage();
 
           // does the clip have a valid media source?
-          if (!m->invalid && !(c->track() >= 0 && !is_audio_device_set())) {
+          // audio for live playback is pointless without an output device, offline mixes don't need one
+          if (!m->invalid && !(c->track() >= 0 && params.audio_buffer == &playback_audio && !is_audio_device_set())) {
 
             // is the media process and ready?
             if (m->ready) {
               const FootageStream* ms = c->media_stream();
 
               // does the media have a valid media stream source and is it active?
-              if (ms != nullptr && c->IsActiveAt(playhead)) {
+              if (ms != nullptr && c->IsActiveAt(playhead, params.playback_speed)) {
+
+                if (c->IsOpen()) {
+
+                  if (c->track() >= 0 || clip_is_shown_at(c, playhead)) {
+                    clip_is_active = true;
+                  } else if (frames_until_shown(c, playhead, params.playback_speed) > 0) {
+                    prefetched_clips.append(c);
+                  }
+
+                } else if (c->track() >= 0 || clip_is_shown_at(c, playhead)) {
 
-                // open if not open
-                if (!c->IsOpen()) {
+                  // clips on screen and audio clips (which have to be mixed ahead of the playhead) are always opened
+                  if (c->track() >= 0) {
+                    c->SetAudioBuffer(params.audio_buffer);
+                  }
                   c->Open();
-                }
 
-                clip_is_active = true;
+                  clip_is_active = true;
+
+                } else if (frames_until_shown(c, playhead, params.playback_speed) > 0) {
+
+                  // the clip is coming up, open it after this loop if there are decoders to spare
+                  prefetch_clips.append(c);
+
+                }
 
                 // increment audio track count
-                if (c->track() >= 0) audio_track_count++;
+                if (clip_is_active && c->track() >= 0) audio_track_count++;
 
               } else if (c->IsOpen()) {
 
@@ -240,8 +311,11 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
         } else {
           // if the clip is a nested sequence or null clip, just open it
 
-          if (c->IsActiveAt(playhead)) {
+          if (c->IsActiveAt(playhead, params.playback_speed)) {
             if (!c->IsOpen()) {
+              if (c->track() >= 0) {
+                c->SetAudioBuffer(params.audio_buffer);
+              }
               c->Open();
             }
             clip_is_active = true;
@@ -252,66 +326,105 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
 
         // if the clip is active, added it to "current_clips", sorted by track
         if (clip_is_active) {
-          bool added = false;
-
-          // track sorting is only necessary for video clips
-          // audio clips are mixed equally, so we skip sorting for those
-          if (params.video) {
-
-            // insertion sort by track
-            for (int j=0;j<current_clips.size();j++) {
-              if (current_clips.at(j)->track() < c->track()) {
-                current_clips.insert(j, c);
-                added = true;
-                break;
-              }
-            }
-
-          }
-
-          if (!added) {
-            current_clips.append(c);
-          }
+          add_current_clip(current_clips, c, params.video);
         }
       }
     }
   }
 
-  if (params.video) {
+  open_prefetch_clips(prefetch_clips, prefetched_clips, playhead, params.playback_speed);
 
-    // set default coordinates based on the sequence, with 0 in the direct center
-    glPushMatrix();
-    glLoadIdentity();
+  // set default coordinates based on the sequence, with 0 in the direct center
+  QMatrix4x4 projection;
+
+  if (params.video) {
 
     glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
     int half_width = s->width/2;
     int half_height = s->height/2;
-    glOrtho(-half_width, half_width, -half_height, half_height, -1, 10);
+    projection.ortho(-half_width, half_width, -half_height, half_height, -1, 10);
 
   }
 
-  // loop through current clips
+  // lock every current clip and request its frame up front, so all of the clips' cachers decode in parallel and the
+  // retrieval below only has to wait for the slowest one rather than the sum of all of them. Clips inside nested
+  // sequences are requested along with them (see precache_nested_clips()).
+
+  QVector<bool> got_mutexes(current_clips.size());
+  QVector<ClipLatency> latencies(current_clips.size());
 
   for (int i=0;i<current_clips.size();i++) {
     Clip* c = current_clips.at(i);
 
-    bool got_mutex = true;
-
     if (params.wait_for_mutexes) {
       // wait for clip to finish opening
       c->state_change_lock.lock();
+      got_mutexes[i] = true;
     } else {
-      got_mutex = c->state_change_lock.tryLock();
+      got_mutexes[i] = c->state_change_lock.tryLock();
     }
 
+    if (params.video
+        && got_mutexes.at(i)
+        && c->IsOpen()
+        && c->media() != nullptr
+        && c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
+      QElapsedTimer timer;
+      timer.start();
+
+      // skip clips whose frame was already requested along with the sequence this one is nested in
+      int precached_index = params.precached_clips.indexOf(QPair<Clip*, long>(c, playhead));
+      if (precached_index >= 0) {
+        params.precached_clips.removeAt(precached_index);
+      } else {
+        c->Cache(playhead, false, params.nests, params.playback_speed);
+      }
+
+      latencies[i].clip = c;
+      latencies[i].name = c->name();
+      latencies[i].cache = timer.nsecsElapsed() / 1000;
+    }
+  }
+
+  // clips that aren't shown yet are pre-rolled to the frame they'll start on (their last frame when playing in
+  // reverse) in the background. They're never retrieved, so they can't hold up this frame.
+  for (int i=0;i<prefetched_clips.size();i++) {
+    Clip* c = prefetched_clips.at(i);
+
+    if (c->state_change_lock.tryLock()) {
+      if (c->IsOpen()) {
+        c->Prefetch(qBound(c->timeline_in(), playhead, c->timeline_out() - 1), params.nests, params.playback_speed);
+      }
+      c->state_change_lock.unlock();
+    }
+  }
+
+  if (params.video) {
+    for (int i=0;i<current_clips.size();i++) {
+      Clip* c = current_clips.at(i);
+
+      if (got_mutexes.at(i)
+          && c->IsOpen()
+          && c->media() != nullptr
+          && c->media()->get_type() == MEDIA_TYPE_SEQUENCE
+          && clip_is_shown_at(c, playhead)) {
+        precache_nested_clips(params, c, playhead);
+      }
+    }
+  }
+
+  // loop through current clips
+
+  for (int i=0;i<current_clips.size();i++) {
+    Clip* c = current_clips.at(i);
+
+    bool got_mutex = got_mutexes.at(i);
+
     if (got_mutex && c->IsOpen()) {
       // if clip is a video clip
       if (c->track() < 0) {
 
-        // reset OpenGL to full color
-        glColor4f(1.0, 1.0, 1.0, 1.0);
-
         // textureID variable contains texture to be drawn on screen at the end
         GLuint textureID = 0;
 
@@ -322,68 +435,82 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
         // if media is footage
         if (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
 
-          // retrieve video frame from cache and store it in c->texture
-          c->Cache(qMax(playhead, c->timeline_in()), false, params.nests, params.playback_speed);
-          if (!c->Retrieve()) {
+          // retrieve video frame requested above and store it in c->texture
+          if (!c->Retrieve(&latencies[i])) {
             params.texture_failed = true;
           } else {
             // retrieve ID from c->texture
             textureID = c->texture->textureId();
           }
 
+          if (params.clip_latency != nullptr) {
+            params.clip_latency->append(latencies.at(i));
+          }
+
           if (textureID == 0) {
             qWarning() << "Failed to create texture";
           }
         }
 
-        // prepare framebuffers for backend drawing operations
-        if (c->fbo == nullptr) {
-          // create 3 fbos for nested sequences, 2 for most clips
-          int fbo_count = (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_SEQUENCE) ? 3 : 2;
-
-          c->fbo = new QOpenGLFramebufferObject* [size_t(fbo_count)];
-
-          for (int j=0;j<fbo_count;j++) {
-            c->fbo[j] = new QOpenGLFramebufferObject(video_width, video_height);
-          }
-        }
+        // nested sequences are composited into a framebuffer of their own, the back buffers for blending modes
+        // inside them are only acquired if a clip uses one
+        bool is_nested = (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_SEQUENCE);
+        c->fbo[0] = is_nested ? params.fbo_pool->Acquire(video_width, video_height) : nullptr;
+        c->fbo[1] = c->fbo[2] = nullptr;
 
         // if clip should actually be shown on screen in this frame
         if (playhead >= c->timeline_in(true)
             && playhead < c->timeline_out(true)) {
-          glPushMatrix();
 
-          // simple bool for switching between the two framebuffers
-          bool fbo_switcher = false;
-
-          glViewport(0, 0, video_width, video_height);
+          // program that has to run on the frame before the clip's effects see it
+          QOpenGLShaderProgram* input_program = nullptr;
 
           if (c->media() != nullptr) {
             if (c->media()->get_type() == MEDIA_TYPE_SEQUENCE) {
               // for a nested sequence, run this function again on that sequence and retrieve the texture
 
-              // add nested sequence to nest list
-              params.nests.append(c);
+              Sequence* nested_seq = c->media()->to_sequence().get();
+              long nested_frame = rescale_frame_number(playhead + c->clip_in(true) - c->timeline_in(true),
+                                                       s->frame_rate,
+                                                       nested_seq->frame_rate);
+              int revision = olive::ContentRevision();
 
-              // compose sequence
-              textureID = compose_sequence(params);
+              // gizmos inside a nested sequence are only updated while it's being composited, so skip the cache
+              bool use_nest_cache = (params.nest_cache != nullptr
+                                     && (params.gizmos == nullptr || params.gizmos->parent_clip->sequence == params.seq));
 
-              // remove sequence from nest list
-              params.nests.removeLast();
+              if (use_nest_cache) {
+                textureID = params.nest_cache->Get(nested_seq, nested_frame, revision);
+              }
 
-              // compose_sequence() would have written to this clip's fbo[0], so we switch to fbo[1]
-              fbo_switcher = true;
-            } else if (c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
+              if (textureID == 0) {
+                bool texture_failed_before = params.texture_failed;
+                params.texture_failed = false;
 
-              if (!c->media()->to_footage()->alpha_is_premultiplied) {
-                // alpha is not premultiplied, we'll need to multiply it for the rest of the pipeline
-                params.premultiply_program->bind();
+                // add nested sequence to nest list
+                params.nests.append(c);
 
-                textureID = draw_clip(c->fbo[0], textureID, true);
+                // compose sequence
+                textureID = compose_sequence(params);
 
-                params.premultiply_program->release();
+                // remove sequence from nest list
+                params.nests.removeLast();
+
+                // only cache complete frames, effects never draw into the nested frame so the cache can take it over
+                if (use_nest_cache && !params.texture_failed) {
+                  params.fbo_pool->Keep(c->fbo[0]);
+                  params.nest_cache->Insert(params.fbo_pool, nested_seq, nested_frame, revision, c->fbo[0]);
+                  c->fbo[0] = nullptr;
+                }
 
-                fbo_switcher = true;
+                params.texture_failed |= texture_failed_before;
+              }
+            } else if (c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
+
+              if (!c->media()->to_footage()->alpha_is_premultiplied && c->FrameHasAlpha()) {
+                // alpha is not premultiplied, we'll need to multiply it for the rest of the pipeline (opaque frames
+                // are the same either way, so they skip the pass entirely)
+                input_program = params.premultiply_program;
               }
 
 #ifdef OLIVE_OCIO
@@ -417,158 +544,140 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
           // get current sequence time in seconds (used for effects)
           double timecode = get_timecode(c, playhead);
 
-          // run through all of the clip's effects
-          for (int j=0;j<c->effects.size();j++) {
-
-            Effect* e = c->effects.at(j).get();
-            process_effect(c, e, timecode, coords, textureID, fbo_switcher, params.texture_failed, kTransitionNone);
-
-          }
-
-          // if the clip has an opening transition, process that now
-          if (c->opening_transition != nullptr) {
-            int transition_progress = playhead - c->timeline_in(true);
-            if (transition_progress < c->opening_transition->get_length()) {
-              process_effect(c, c->opening_transition.get(), double(transition_progress)/double(c->opening_transition->get_length()), coords, textureID, fbo_switcher, params.texture_failed, kTransitionOpening);
-            }
-          }
-
-          // if the clip has a closing transition, process that now
-          if (c->closing_transition != nullptr) {
-            int transition_progress = playhead - (c->timeline_out(true) - c->closing_transition->get_length());
-            if (transition_progress >= 0 && transition_progress < c->closing_transition->get_length()) {
-              process_effect(c, c->closing_transition.get(), double(transition_progress)/double(c->closing_transition->get_length()), coords, textureID, fbo_switcher, params.texture_failed, kTransitionClosing);
-            }
-          }
+          // run the clip's effects and transitions
+          c->render_graph.Update(c);
+          textureID = c->render_graph.Process(params.quad,
+                                              params.fbo_pool,
+                                              c,
+                                              playhead,
+                                              textureID,
+                                              input_program,
+                                              coords,
+                                              params.texture_failed,
+                                              params.high_quality);
 
           // == EFFECT CODE END ==
 
 
-          // Check whether the parent clip is auto-scaledc
+          // Check whether the parent clip is auto-scaled
           if (c->autoscaled()
               && (video_width != s->width
                   && video_height != s->height)) {
             float width_multiplier = float(s->width) / float(video_width);
             float height_multiplier = float(s->height) / float(video_height);
             float scale_multiplier = qMin(width_multiplier, height_multiplier);
-            glScalef(scale_multiplier, scale_multiplier, 1);
+            coords.matrix.scale(scale_multiplier, scale_multiplier);
           }
 
+          QMatrix4x4 mvp = projection * coords.matrix;
+
           // Configure effect gizmos if they exist
           if (params.gizmos != nullptr) {
             params.gizmos->gizmo_draw(timecode, coords); // set correct gizmo coords
-            params.gizmos->gizmo_world_to_screen(); // convert gizmo coords to screen coords
+            params.gizmos->gizmo_world_to_screen(mvp); // convert gizmo coords to screen coords
           }
 
 
 
           if (textureID > 0) {
-            // set viewport to sequence size
-            params.ctx->functions()->glViewport(0, 0, s->width, s->height);
-
+            QOpenGLFunctions* f = params.ctx->functions();
 
+            bool minified = ClipIsMinified(coords, video_width, video_height);
 
-            // == START RENDER CLIP IN CONTEXT OF SEQUENCE ==
+            // let the clip know whether its texture needs mipmaps for the next frame, which is only the case if it's
+            // drawn directly rather than through an effect pass
+            c->SetTextureMinified(minified && c->texture != nullptr && textureID == c->texture->textureId());
 
+            // blending modes other than normal alpha blending need the shader, which composites the clip itself
+            bool use_blend_shader = (!olive::CurrentRuntimeConfig.disable_blending
+                                     && coords.blendmode >= 0
+                                     && coords.blendmode != kBlendModeNormal);
 
+            // the last effect pass can be drawn straight into the sequence if nothing else needs to be applied to
+            // its result (the blending shader applies opacity itself), otherwise it gets a framebuffer now
+            bool draw_deferred = (c->render_graph.HasDeferredPass()
+                                  && (use_blend_shader || coords.opacity >= 1.0f));
 
-            // use clip textures for nested sequences, otherwise use main frame buffers
-            GLuint back_buffer_1;
-            GLuint backend_tex_1;
-            GLuint backend_tex_2;
-            if (params.nests.size() > 0) {
-              back_buffer_1 = params.nests.last()->fbo[1]->handle();
-              backend_tex_1 = params.nests.last()->fbo[1]->texture();
-              backend_tex_2 = params.nests.last()->fbo[2]->texture();
-            } else {
-              back_buffer_1 = params.backend_buffer1;
-              backend_tex_1 = params.backend_attachment1;
-              backend_tex_2 = params.backend_attachment2;
+            if (c->render_graph.HasDeferredPass() && !draw_deferred) {
+              textureID = c->render_graph.ResolveDeferredPass();
             }
 
-            // render a backbuffer
-            params.ctx->functions()->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, back_buffer_1);
-
-            glClearColor(0.0, 0.0, 0.0, 0.0);
-            glClear(GL_COLOR_BUFFER_BIT);
-
-            // bind final clip texture
-            glBindTexture(GL_TEXTURE_2D, textureID);
-
-            // set texture filter to bilinear
-            PrepareToDraw(params.ctx->functions());
-
-            // draw clip on screen according to gl coordinates
-            glBegin(GL_QUADS);
-
-            glTexCoord2f(coords.textureTopLeftX, coords.textureTopLeftY); // top left
-            glVertex2f(coords.vertexTopLeftX, coords.vertexTopLeftY); // top left
-            glTexCoord2f(coords.textureTopRightX, coords.textureTopRightY); // top right
-            glVertex2f(coords.vertexTopRightX, coords.vertexTopRightY); // top right
-            glTexCoord2f(coords.textureBottomRightX, coords.textureBottomRightY); // bottom right
-            glVertex2f(coords.vertexBottomRightX, coords.vertexBottomRightY); // bottom right
-            glTexCoord2f(coords.textureBottomLeftX, coords.textureBottomLeftY); // bottom left
-            glVertex2f(coords.vertexBottomLeftX, coords.vertexBottomLeftY); // bottom left
-
-            glEnd();
-
-            // release final clip texture
-            glBindTexture(GL_TEXTURE_2D, 0);
-
-            params.ctx->functions()->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            // set viewport to sequence size
+            f->glViewport(0, 0, s->width, s->height);
 
 
 
-            // == END RENDER CLIP IN CONTEXT OF SEQUENCE ==
+            // == START RENDER CLIP IN CONTEXT OF SEQUENCE ==
 
 
 
-            //
-            //
-            // PROCESS POST-SHADERS
-            //
-            //
+            if (use_blend_shader) {
 
+              // use clip textures for nested sequences, otherwise use main frame buffers
+              GLuint back_buffer_1;
+              GLuint back_buffer_2;
+              GLuint backend_tex_1;
+              GLuint backend_tex_2;
+              GLuint main_tex;
+              if (params.nests.size() > 0) {
+                Clip* nest = params.nests.last();
 
+                if (nest->fbo[1] == nullptr) {
+                  nest->fbo[1] = params.fbo_pool->Acquire(s->width, s->height);
+                  nest->fbo[2] = params.fbo_pool->Acquire(s->width, s->height);
+                }
 
-            // copy front buffer to back buffer (only if we're using blending modes - which we usually will be)
-            if (!olive::CurrentRuntimeConfig.disable_blending) {
-              if (params.nests.size() > 0) {
-                draw_clip(params.ctx, params.nests.last()->fbo[2]->handle(), params.nests.last()->fbo[0]->texture(), true);
+                back_buffer_1 = nest->fbo[1]->handle();
+                back_buffer_2 = nest->fbo[2]->handle();
+                backend_tex_1 = nest->fbo[1]->texture();
+                backend_tex_2 = nest->fbo[2]->texture();
+                main_tex = nest->fbo[0]->texture();
               } else {
-                draw_clip(params.ctx, params.backend_buffer2, params.main_attachment, true);
+                back_buffer_1 = params.backend_buffer1;
+                back_buffer_2 = params.backend_buffer2;
+                backend_tex_1 = params.backend_attachment1;
+                backend_tex_2 = params.backend_attachment2;
+                main_tex = params.main_attachment;
               }
-            }
-
-
-
-            // == START FINAL DRAW ON SEQUENCE BUFFER ==
-
 
+              // render the clip on its own into a backbuffer
+              f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, back_buffer_1);
 
+              glClearColor(0.0, 0.0, 0.0, 0.0);
+              glClear(GL_COLOR_BUFFER_BIT);
 
-            // bind front buffer as draw buffer
-            params.ctx->functions()->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, final_fbo);
+              if (draw_deferred) {
+                c->render_graph.DrawDeferredPass(mvp, coords, minified);
+              } else {
+                f->glBindTexture(GL_TEXTURE_2D, textureID);
+                olive::rendering::PrepareToDraw(f, minified);
+                params.quad->DrawCoords(nullptr, mvp, coords);
+                f->glBindTexture(GL_TEXTURE_2D, 0);
+              }
 
-//            if (olive::CurrentRuntimeConfig.disable_blending) {
-              // some GPUs don't like the blending shader, so we provide a pure GL fallback here
+              // copy what's been composited so far to the other backbuffer, the blending shader can't read from the
+              // framebuffer it's drawing to
+              f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, back_buffer_2);
 
-              params.ctx->functions()->glBindTexture(GL_TEXTURE_2D, backend_tex_1);
+              glClear(GL_COLOR_BUFFER_BIT);
 
-              glColor4f(coords.opacity, coords.opacity, coords.opacity, coords.opacity);
+              f->glBindTexture(GL_TEXTURE_2D, main_tex);
+              olive::rendering::PrepareToDraw(f, false);
+              params.quad->Blit();
+              f->glBindTexture(GL_TEXTURE_2D, 0);
 
-              full_blit();
+              // draw the blended result over the sequence
+              f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, final_fbo);
 
-              params.ctx->functions()->glBindTexture(GL_TEXTURE_2D, 0);
-              /*
-            } else {
               // load background texture into texture unit 0
-              params.ctx->functions()->glActiveTexture(GL_TEXTURE0 + 0); // Texture unit 0
-              params.ctx->functions()->glBindTexture(GL_TEXTURE_2D, backend_tex_2);
+              f->glActiveTexture(GL_TEXTURE0 + 0);
+              f->glBindTexture(GL_TEXTURE_2D, backend_tex_2);
+              olive::rendering::PrepareToDraw(f, false);
 
               // load foreground texture into texture unit 1
-              params.ctx->functions()->glActiveTexture(GL_TEXTURE0 + 1); // Texture unit 1
-              params.ctx->functions()->glBindTexture(GL_TEXTURE_2D, backend_tex_1);
+              f->glActiveTexture(GL_TEXTURE0 + 1);
+              f->glBindTexture(GL_TEXTURE_2D, backend_tex_1);
+              olive::rendering::PrepareToDraw(f, false);
 
               // bind and configure blending mode shader
               params.blend_mode_program->bind();
@@ -577,32 +686,49 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
               params.blend_mode_program->setUniformValue("background", 0);
               params.blend_mode_program->setUniformValue("foreground", 1);
 
-              glClear(GL_COLOR_BUFFER_BIT);
+              // the shader outputs the composited pixel, so it replaces what's there rather than blending over it
+              glDisable(GL_BLEND);
 
-              full_blit();
+              params.quad->Blit(params.blend_mode_program);
+
+              glEnable(GL_BLEND);
 
               // release blend mode shader
               params.blend_mode_program->release();
 
               // unbind texture from texture unit 1
-              params.ctx->functions()->glBindTexture(GL_TEXTURE_2D, 0);
+              f->glBindTexture(GL_TEXTURE_2D, 0);
 
               // unbind texture from texture unit 0
-              params.ctx->functions()->glActiveTexture(GL_TEXTURE0 + 0); // Texture unit 0
-              params.ctx->functions()->glBindTexture(GL_TEXTURE_2D, 0);
+              f->glActiveTexture(GL_TEXTURE0 + 0);
+              f->glBindTexture(GL_TEXTURE_2D, 0);
+
+            } else {
+
+              // normal alpha blending, draw the clip straight into the sequence
+              f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, final_fbo);
+
+              if (draw_deferred) {
+                c->render_graph.DrawDeferredPass(mvp, coords, minified);
+              } else {
+                f->glBindTexture(GL_TEXTURE_2D, textureID);
+                olive::rendering::PrepareToDraw(f, minified);
+                params.quad->DrawCoords(nullptr, mvp, coords, coords.opacity);
+                f->glBindTexture(GL_TEXTURE_2D, 0);
+              }
+
             }
-            */
 
             // unbind framebuffer
-            params.ctx->functions()->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
 
 
-
-            // == END FINAL DRAW ON SEQUENCE BUFFER ==
+            // == END RENDER CLIP IN CONTEXT OF SEQUENCE ==
           }
 
-          glPopMatrix();
+          // the clip's framebuffers can be reused by the next clip
+          c->render_graph.Finish();
         }
       } else {
         if (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_SEQUENCE) {
@@ -633,7 +759,8 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
           }
         }
       }
-    } else {
+    } else if (!params.video || clip_is_shown_at(c, playhead)) {
+      // a video clip that's only been opened ahead of time doesn't hold up the frame while it finishes opening
       params.texture_failed = true;
     }
 
@@ -642,17 +769,13 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
     }
   }
 
-  if (audio_track_count == 0) {
-    WakeAudioWakeObject();
-  }
-
-  if (params.video) {
-    glPopMatrix();
+  if (!params.video && audio_track_count == 0) {
+    params.audio_buffer->Wake();
   }
 
 //  qDebug() << "compose sequence took" << QDateTime::currentMSecsSinceEpoch() - time;
 
-  if (!params.nests.isEmpty() && params.nests.last()->fbo != nullptr) {
+  if (!params.nests.isEmpty() && params.nests.last()->fbo[0] != nullptr) {
     // returns nested clip's texture
     return params.nests.last()->fbo[0]->texture();
   }
@@ -660,7 +783,11 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
   return 0;
 }
 
-void olive::rendering::compose_audio(Viewer* viewer, Sequence* seq, int playback_speed, bool wait_for_mutexes) {
+void olive::rendering::compose_audio(Viewer* viewer,
+                                     Sequence* seq,
+                                     int playback_speed,
+                                     bool wait_for_mutexes,
+                                     AudioMixBuffer* buffer) {
   ComposeSequenceParams params;
   params.viewer = viewer;
   params.ctx = nullptr;
@@ -668,8 +795,14 @@ void olive::rendering::compose_audio(Viewer* viewer, Sequence* seq, int playback
   params.video = false;
   params.gizmos = nullptr;
   params.wait_for_mutexes = wait_for_mutexes;
+  params.high_quality = false;
   params.playback_speed = playback_speed;
   params.blend_mode_program = nullptr;
+  params.quad = nullptr;
+  params.fbo_pool = nullptr;
+  params.nest_cache = nullptr;
+  params.clip_latency = nullptr;
+  params.audio_buffer = (buffer == nullptr) ? &playback_audio : buffer;
   compose_sequence(params);
 }
 
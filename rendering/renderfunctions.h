@@ -23,11 +23,16 @@
 
 #include <QOpenGLContext>
 #include <QVector>
+#include <QPair>
 #include <QOpenGLShaderProgram>
 
 #include "timeline/sequence.h"
 #include "effects/effect.h"
 #include "panels/viewer.h"
+#include "rendering/framebufferpool.h"
+
+class AudioMixBuffer;
+class QuadRenderer;
 
 /**
  * @brief The ComposeSequenceParams struct
@@ -129,6 +134,13 @@ struct ComposeSequenceParams {
      */
     int playback_speed;
 
+    /**
+     * @brief Render at the best quality effects can offer rather than the fastest
+     *
+     * Used only for video rendering. **TRUE** when exporting, **FALSE** for the viewer. See Effect::SetHighQuality().
+     */
+    bool high_quality;
+
     /**
      * @brief Blending mode shader
      *
@@ -175,32 +187,31 @@ struct ComposeSequenceParams {
     /**
      * @brief Backend OpenGL framebuffer 1 used for further processing before rendering to main_buffer
      *
-     * In some situations, compose_sequence() will do some processing through shaders that requires "ping-ponging"
-     * between framebuffers. backend_buffer1 and backend_buffer2 are used for this purpose.
+     * Clips using a blending mode other than normal are drawn into backend_buffer1 on their own while the sequence
+     * composited so far is copied into backend_buffer2, and the blending mode shader combines the two into main_buffer.
      */
     GLuint backend_buffer1;
 
     /**
      * @brief Backend OpenGL framebuffer 1's texture attachment
      *
-     * The texture that ComposeSequenceParams::backend_buffer1 renders to. Bound and drawn to
-     * ComposeSequenceParams::backend_buffer2 to "ping-pong" between them and various shaders.
+     * The texture that ComposeSequenceParams::backend_buffer1 renders to. Bound as the blending mode shader's
+     * foreground.
      */
     GLuint backend_attachment1;
 
     /**
      * @brief Backend OpenGL framebuffer 2 used for further processing before rendering to main_buffer
      *
-     * In some situations, compose_sequence() will do some processing through shaders that requires "ping-ponging"
-     * between framebuffers. backend_buffer1 and backend_buffer2 are used for this purpose.
+     * See ComposeSequenceParams::backend_buffer1.
      */
     GLuint backend_buffer2;
 
     /**
      * @brief Backend OpenGL framebuffer 2's texture attachment
      *
-     * The texture that ComposeSequenceParams::backend_buffer2 renders to. Bound and drawn to
-     * ComposeSequenceParams::backend_buffer1 to "ping-pong" between them and various shaders.
+     * The texture that ComposeSequenceParams::backend_buffer2 renders to. Bound as the blending mode shader's
+     * background.
      */
     GLuint backend_attachment2;
 
@@ -213,6 +224,63 @@ struct ComposeSequenceParams {
      * @brief OpenGL texture containing LUT obtained form OpenColorIO
      */
     GLuint ocio_lut_texture;
+
+    /**
+     * @brief Renderer for all of the quads drawn while compositing
+     *
+     * Used only for video rendering. Never accessed with audio rendering.
+     *
+     * Must have been created (see QuadRenderer::Create()) in ComposeSequenceParams::ctx.
+     */
+    QuadRenderer* quad;
+
+    /**
+     * @brief Pool that clip framebuffers are acquired from
+     *
+     * Used only for video rendering. Never accessed with audio rendering.
+     *
+     * Every clip's RenderGraph acquires its transient framebuffers from this pool, and nested sequences borrow their
+     * Clip::fbo framebuffers from it for the duration of the frame. The owner (see RenderThread) must call FramebufferPool::Recycle() once compose_sequence() has returned and the result has been
+     * read, after which the framebuffers are handed out again on the next frame.
+     */
+    FramebufferPool* fbo_pool;
+
+    /**
+     * @brief Cache of rendered nested sequence frames
+     *
+     * Used only for video rendering. Never accessed with audio rendering. May be nullptr to disable caching.
+     *
+     * When a nested sequence is encountered, compose_sequence() first checks this cache for the same sequence, frame
+     * and content revision and reuses the texture rather than compositing the nested sequence again. The owner must call
+     * NestedSequenceCache::EndFrame() after FramebufferPool::Recycle().
+     */
+    NestedSequenceCache* nest_cache;
+
+    /**
+     * @brief Clips inside nested sequences whose frame was already requested, and the frame that was requested
+     *
+     * Should be left empty. compose_sequence() requests the frames of clips inside nested sequences at the same time
+     * as the frames of the clips around them so they all decode in parallel, and uses this to skip requesting them a
+     * second time when it recurses into the nested sequence.
+     */
+    QVector<QPair<Clip*, long> > precached_clips;
+
+    /**
+     * @brief Optional per-clip latency breakdown
+     *
+     * Used only for video rendering. If not nullptr, compose_sequence() appends a ClipLatency entry for every footage
+     * clip it retrieves a frame from (including clips inside nested sequences) so the caller can see which decoder a
+     * slow frame was waiting on.
+     */
+    QVector<ClipLatency>* clip_latency;
+
+    /**
+     * @brief Buffer to mix audio into
+     *
+     * Used only for audio rendering. Audio clips are bound to this buffer when they're opened (see
+     * Cacher::SetAudioBuffer()). The live viewers use playback_audio, offline rendering uses its own buffer.
+     */
+    AudioMixBuffer* audio_buffer;
 };
 
 namespace olive {
@@ -237,7 +305,8 @@ namespace rendering {
  *
  * @return A reference to the OpenGL texture resulting from the render. Will usually be equal to
  * ComposeSequenceParams::main_attachment unless it's rendering a nested sequence, in which case it'll be a reference
- * to one of the textures referenced by Clip::fbo. Can be used directly to draw the rendered frame.
+ * to the texture of the nested clip's Clip::fbo[0]. Can be used directly to draw the rendered frame, but only until
+ * the framebuffer pool is next recycled.
  */
 GLuint compose_sequence(ComposeSequenceParams &params);
 
@@ -263,8 +332,16 @@ GLuint compose_sequence(ComposeSequenceParams &params);
  * @param
  *
  * Whether to wait for media to open or simply fail if the media is not yet open. This should usually be **FALSE**.
+ *
+ * @param buffer
+ *
+ * The buffer to mix audio into, or nullptr to mix into the live playback buffer (playback_audio).
  */
-void compose_audio(Viewer* viewer, Sequence *seq, int playback_speed, bool wait_for_mutexes);
+void compose_audio(Viewer* viewer,
+                   Sequence *seq,
+                   int playback_speed,
+                   bool wait_for_mutexes,
+                   AudioMixBuffer* buffer = nullptr);
 }
 }
 
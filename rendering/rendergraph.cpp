@@ -0,0 +1,303 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "rendergraph.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QDebug>
+
+#include "timeline/clip.h"
+#include "effects/effect.h"
+#include "effects/transition.h"
+#include "rendering/quadrenderer.h"
+#include "rendering/framebufferpool.h"
+#include "rendering/renderfunctions.h"
+#include "global/config.h"
+#include "global/trace.h"
+
+RenderGraph::RenderGraph() :
+  built_shaders_enabled_(false),
+  quad_(nullptr),
+  pool_(nullptr),
+  width_(0),
+  height_(0),
+  texture_(0),
+  current_fbo_(nullptr),
+  deferred_program_(nullptr)
+{}
+
+void RenderGraph::Update(Clip *c)
+{
+  // the effect stack in processing order, with the transitions last (nullptr if the clip doesn't have one)
+  QVector<Effect*> effects;
+  QVector<bool> enabled;
+
+  for (int i=0;i<c->effects.size();i++) {
+    effects.append(c->effects.at(i).get());
+    enabled.append(c->effects.at(i)->IsEnabled());
+  }
+
+  effects.append(c->opening_transition.get());
+  enabled.append(c->opening_transition != nullptr && c->opening_transition->IsEnabled());
+
+  effects.append(c->closing_transition.get());
+  enabled.append(c->closing_transition != nullptr && c->closing_transition->IsEnabled());
+
+  bool shaders_enabled = olive::CurrentRuntimeConfig.shaders_are_enabled;
+
+  if (effects == built_effects_ && enabled == built_enabled_ && shaders_enabled == built_shaders_enabled_) {
+    return;
+  }
+
+  nodes_.clear();
+
+  for (int i=0;i<effects.size();i++) {
+    Effect* e = effects.at(i);
+
+    if (e == nullptr || !enabled.at(i)) {
+      continue;
+    }
+
+    Node n;
+    n.effect = e;
+
+    if (i < c->effects.size()) {
+      n.transition = kTransitionNone;
+    } else if (i == c->effects.size()) {
+      n.transition = kTransitionOpening;
+    } else {
+      n.transition = kTransitionClosing;
+    }
+
+    n.coords = (e->Flags() & Effect::CoordsFlag);
+    n.shader = ((e->Flags() & Effect::ShaderFlag) && shaders_enabled);
+    n.superimpose = (e->Flags() & Effect::SuperimposeFlag);
+    n.mipmaps = (e->Flags() & Effect::MipmapFlag);
+
+    if (n.coords || n.shader || n.superimpose) {
+      nodes_.append(n);
+    }
+  }
+
+  built_effects_ = effects;
+  built_enabled_ = enabled;
+  built_shaders_enabled_ = shaders_enabled;
+}
+
+GLuint RenderGraph::Process(QuadRenderer *quad,
+                            FramebufferPool *pool,
+                            Clip *c,
+                            long playhead,
+                            GLuint texture,
+                            QOpenGLShaderProgram *input_program,
+                            GLTextureCoords &coords,
+                            bool &texture_failed,
+                            bool high_quality)
+{
+  quad_ = quad;
+  pool_ = pool;
+  width_ = c->media_width();
+  height_ = c->media_height();
+  texture_ = texture;
+  current_fbo_ = nullptr;
+
+  // the input program is deferred like any other pass, so a clip with no effect passes is premultiplied while it's
+  // drawn into the sequence
+  deferred_program_ = input_program;
+
+  double timecode = get_timecode(c, playhead);
+
+  for (int i=0;i<nodes_.size();i++) {
+    const Node& n = nodes_.at(i);
+    Effect* e = n.effect;
+
+    // transitions run on their progress rather than the clip's time, and only while they're active
+    double node_time = timecode;
+
+    if (n.transition == kTransitionOpening) {
+      long length = c->opening_transition->get_length();
+      long progress = playhead - c->timeline_in(true);
+      if (progress >= length) {
+        continue;
+      }
+      node_time = double(progress)/double(length);
+    } else if (n.transition == kTransitionClosing) {
+      long length = c->closing_transition->get_length();
+      long progress = playhead - (c->timeline_out(true) - length);
+      if (progress < 0 || progress >= length) {
+        continue;
+      }
+      node_time = double(progress)/double(length);
+    }
+
+    if (n.coords) {
+      e->process_coords(node_time, coords, n.transition);
+    }
+
+    if (!n.shader && !n.superimpose) {
+      continue;
+    }
+
+    // measures how long it took to submit the effect's passes, the GPU may still be working on them afterwards
+    TraceScope trace("effect", e->name, c->name());
+
+    // this node reads the current image, so a pass that was deferred has to be drawn after all
+    ResolveDeferredPass();
+
+    // mipmaps can only be generated for a framebuffer's texture, clip textures only have one level (this has to
+    // happen before the effect binds its program)
+    if (n.shader && n.mipmaps && texture_ != 0) {
+      TakeOwnership();
+    }
+
+    e->SetHighQuality(high_quality);
+    e->startEffect();
+
+    if (n.shader && e->is_glsl_linked()) {
+      int iterations = e->getIterations();
+
+      for (int j=0;j<iterations;j++) {
+        e->process_shader(node_time, coords, j);
+
+        if (j == iterations - 1 && !n.superimpose && e->IsMergeable()) {
+          // uniforms stay set on the program, so the pass can be drawn later
+          deferred_program_ = e->glsl_program();
+        } else {
+          RenderPass(e->glsl_program(), n.mipmaps);
+        }
+      }
+    }
+
+    if (n.superimpose) {
+      GLuint superimpose_texture = e->process_superimpose(node_time);
+
+      if (superimpose_texture == 0) {
+        qWarning() << "Superimpose texture was nullptr, retrying...";
+        texture_failed = true;
+      } else if (texture_ == 0) {
+        // if there is no previous image, just use the superimposed one
+        texture_ = superimpose_texture;
+      } else {
+        TakeOwnership();
+
+        QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+
+        current_fbo_->bind();
+
+        f->glViewport(0, 0, width_, height_);
+        f->glBindTexture(GL_TEXTURE_2D, superimpose_texture);
+        olive::rendering::PrepareToDraw(f, false);
+
+        quad_->Blit();
+
+        f->glBindTexture(GL_TEXTURE_2D, 0);
+
+        current_fbo_->release();
+      }
+    }
+
+    e->endEffect();
+  }
+
+  return texture_;
+}
+
+bool RenderGraph::HasDeferredPass()
+{
+  return deferred_program_ != nullptr;
+}
+
+GLuint RenderGraph::ResolveDeferredPass()
+{
+  if (deferred_program_ != nullptr) {
+    QOpenGLShaderProgram* program = deferred_program_;
+    deferred_program_ = nullptr;
+
+    RenderPass(program);
+
+    program->release();
+  }
+
+  return texture_;
+}
+
+void RenderGraph::DrawDeferredPass(const QMatrix4x4 &mvp, const GLTextureCoords &coords, bool minified)
+{
+  QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+
+  f->glBindTexture(GL_TEXTURE_2D, texture_);
+  olive::rendering::PrepareToDraw(f, minified);
+
+  quad_->DrawCoords(deferred_program_, mvp, coords);
+
+  deferred_program_->release();
+  deferred_program_ = nullptr;
+
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void RenderGraph::Finish()
+{
+  if (pool_ != nullptr) {
+    pool_->Release(current_fbo_);
+  }
+
+  current_fbo_ = nullptr;
+  deferred_program_ = nullptr;
+}
+
+void RenderGraph::RenderPass(QOpenGLShaderProgram *program, bool mipmaps)
+{
+  QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+
+  QOpenGLFramebufferObject* target = pool_->Acquire(width_, height_);
+
+  target->bind();
+
+  f->glViewport(0, 0, width_, height_);
+  f->glClearColor(0.0, 0.0, 0.0, 0.0);
+  f->glClear(GL_COLOR_BUFFER_BIT);
+
+  f->glBindTexture(GL_TEXTURE_2D, texture_);
+
+  // passes are drawn at the image's own size, so there's nothing to minify unless the program samples lower levels
+  // on purpose
+  olive::rendering::PrepareToDraw(f, mipmaps);
+
+  quad_->Blit(program);
+
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+
+  target->release();
+
+  // the previous image has been read, let the next pass (or clip) reuse its framebuffer
+  pool_->Release(current_fbo_);
+
+  current_fbo_ = target;
+  texture_ = target->texture();
+}
+
+void RenderGraph::TakeOwnership()
+{
+  if (current_fbo_ == nullptr || texture_ != current_fbo_->texture()) {
+    RenderPass(nullptr);
+  }
+}
@@ -0,0 +1,166 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QVector>
+
+class Clip;
+class Effect;
+class QuadRenderer;
+class FramebufferPool;
+struct GLTextureCoords;
+
+/**
+ * @brief Retained list of the GPU passes that render a clip's effect stack
+ *
+ * compose_sequence() used to walk a clip's effects every frame, ping-ponging the image between two framebuffers the
+ * clip held for the whole frame and drawing every pass (including a premultiply pass and a copy into a back buffer)
+ * regardless of whether it changed anything. The graph is built once from the clip's effects and transitions and only
+ * rebuilt when they change (see Update()). Running it (see Process()):
+ *
+ * * Skips disabled effects, and effects that only transform the clip's coordinates never touch a framebuffer.
+ * * Acquires a transient framebuffer from the FramebufferPool for each pass and hands the previous one straight back,
+ *   so a clip only holds one framebuffer at a time and the next clip can reuse the rest.
+ * * Defers the last pass. If nothing after it needs its output in a framebuffer, compose_sequence() can run it
+ *   directly while drawing the clip into the sequence (see DrawDeferredPass()), merging it with the final composite.
+ *   This applies to the premultiply pass and to effect shaders that don't depend on the pixel grid they're rendered
+ *   at (see Effect::IsMergeable()).
+ * * Generates mipmaps of a pass's input only for effects that sample them (see Effect::MipmapFlag). Blurs use these
+ *   as a downsample pyramid so their cost doesn't grow with their radius.
+ *
+ * All functions must be called with the rendering context current.
+ */
+class RenderGraph {
+public:
+  RenderGraph();
+
+  /**
+   * @brief Rebuild the graph if the clip's effects or transitions have changed since it was last built
+   */
+  void Update(Clip* c);
+
+  /**
+   * @brief Run the clip's effect stack on a frame
+   *
+   * @param texture
+   *
+   * The clip's frame (or 0 if it has none, e.g. a solid or title clip).
+   *
+   * @param input_program
+   *
+   * A program that must be applied to `texture` before anything else reads it (the premultiply shader), or nullptr.
+   *
+   * @param coords
+   *
+   * The clip's default coordinates, modified by any effects that transform the clip.
+   *
+   * @param texture_failed
+   *
+   * Set to **TRUE** if an effect couldn't produce its image in time.
+   *
+   * @param high_quality
+   *
+   * Passed on to effects that can trade quality for speed (see Effect::SetHighQuality()).
+   *
+   * @return The texture to draw the clip with. If HasDeferredPass() is **TRUE**, this is the input to that pass and
+   * the result must be drawn with DrawDeferredPass() or resolved with ResolveDeferredPass().
+   */
+  GLuint Process(QuadRenderer* quad,
+                 FramebufferPool* pool,
+                 Clip* c,
+                 long playhead,
+                 GLuint texture,
+                 QOpenGLShaderProgram* input_program,
+                 GLTextureCoords& coords,
+                 bool& texture_failed,
+                 bool high_quality);
+
+  /**
+   * @brief Returns whether the last pass of the last Process() call hasn't been drawn yet
+   */
+  bool HasDeferredPass();
+
+  /**
+   * @brief Draw the deferred pass into a framebuffer and return its texture
+   */
+  GLuint ResolveDeferredPass();
+
+  /**
+   * @brief Draw the deferred pass straight into the currently bound framebuffer
+   *
+   * The pass's program can't apply the clip's opacity, so this should only be used for fully opaque clips.
+   */
+  void DrawDeferredPass(const QMatrix4x4& mvp, const GLTextureCoords& coords, bool minified);
+
+  /**
+   * @brief Hand the framebuffer holding the result of the last Process() call back to the pool
+   *
+   * Must be called once the result has been drawn.
+   */
+  void Finish();
+
+private:
+  struct Node {
+    Effect* effect;
+
+    // kTransitionNone, or the kind of transition this effect is
+    int transition;
+
+    bool coords;
+    bool shader;
+    bool superimpose;
+    bool mipmaps;
+  };
+
+  /**
+   * @brief Draw `texture_` through `program` into a new framebuffer and make it the current image
+   *
+   * If `mipmaps` is **TRUE**, mipmaps of `texture_` are generated first so the program can sample them.
+   */
+  void RenderPass(QOpenGLShaderProgram* program, bool mipmaps = false);
+
+  /**
+   * @brief Make sure the current image is in a framebuffer owned by this graph so it can be drawn over
+   */
+  void TakeOwnership();
+
+  QVector<Node> nodes_;
+
+  // the effect stack the nodes were built from
+  QVector<Effect*> built_effects_;
+  QVector<bool> built_enabled_;
+  bool built_shaders_enabled_;
+
+  // state of the current Process() call
+  QuadRenderer* quad_;
+  FramebufferPool* pool_;
+  int width_;
+  int height_;
+  GLuint texture_;
+  QOpenGLFramebufferObject* current_fbo_;
+  QOpenGLShaderProgram* deferred_program_;
+};
+
+#endif // RENDERGRAPH_H
@@ -31,7 +31,20 @@ namespace OCIO = OCIO_NAMESPACE;
 #endif
 
 #include "rendering/renderfunctions.h"
+#include "rendering/framepool.h"
+#include "rendering/shaderprogram.h"
 #include "timeline/sequence.h"
+#include "timeline/clip.h"
+#include "global/config.h"
+#include "global/trace.h"
+
+RenderStats::RenderStats() :
+  render_time(0),
+  dropped_frames(0),
+  gpu_memory(0),
+  frame_memory(0)
+{
+}
 
 RenderThread::RenderThread() :
   gizmos(nullptr),
@@ -39,6 +52,8 @@ RenderThread::RenderThread() :
   ctx(nullptr),
   blend_mode_program(nullptr),
   premultiply_program(nullptr),
+  last_playhead_(0),
+  last_playback_speed_(0),
   seq(nullptr),
   tex_width(-1),
   tex_height(-1),
@@ -97,15 +112,13 @@ void RenderThread::run() {
           // create shader program to make blending modes work
           delete_shaders();
 
-          blend_mode_program = new QOpenGLShaderProgram();
-          blend_mode_program->addShaderFromSourceFile(QOpenGLShader::Vertex, ":/internalshaders/common.vert");
-          blend_mode_program->addShaderFromSourceFile(QOpenGLShader::Fragment, ":/internalshaders/blending.frag");
-          blend_mode_program->link();
+          blend_mode_program = olive::rendering::CreateProgram(":/internalshaders/common.vert",
+                                                               ":/internalshaders/blending.frag");
+
+          premultiply_program = olive::rendering::CreateProgram(":/internalshaders/common.vert",
+                                                                ":/internalshaders/premultiply.frag");
 
-          premultiply_program = new QOpenGLShaderProgram();
-          premultiply_program->addShaderFromSourceFile(QOpenGLShader::Vertex, ":/internalshaders/common.vert");
-          premultiply_program->addShaderFromSourceFile(QOpenGLShader::Fragment, ":/internalshaders/premultiply.frag");
-          premultiply_program->link();
+          quad_.Create();
         }
 
         // draw frame
@@ -140,6 +153,11 @@ void RenderThread::set_up_ocio()
 }
 
 void RenderThread::paint() {
+  TraceScope trace("render", "paint");
+
+  QElapsedTimer render_timer;
+  render_timer.start();
+
   // set up compose_sequence() parameters
   ComposeSequenceParams params;
   params.viewer = nullptr;
@@ -148,15 +166,23 @@ void RenderThread::paint() {
   params.video = true;
   params.texture_failed = false;
   params.wait_for_mutexes = true;
+  params.high_quality = false;
   params.playback_speed = playback_speed_;
   params.blend_mode_program = blend_mode_program;
   params.premultiply_program = premultiply_program;
+  params.quad = &quad_;
   params.backend_buffer1 = back_buffer_1.buffer();
   params.backend_buffer2 = back_buffer_2.buffer();
   params.backend_attachment1 = back_buffer_1.texture();
   params.backend_attachment2 = back_buffer_2.texture();
   params.main_buffer = front_buffer_switcher ? front_buffer_1.buffer() : front_buffer_2.buffer();
   params.main_attachment = front_buffer_switcher ? front_buffer_1.texture() : front_buffer_2.texture();
+  params.fbo_pool = &fbo_pool_;
+  params.nest_cache = &nest_cache_;
+  params.audio_buffer = nullptr;
+
+  clip_latency_.clear();
+  params.clip_latency = &clip_latency_;
 
   // get currently selected gizmos
   gizmos = seq->GetSelectedGizmo();
@@ -168,14 +194,9 @@ void RenderThread::paint() {
   // bind framebuffer for drawing
   ctx->functions()->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, params.main_buffer);
 
-  glLoadIdentity();
-
   glClearColor(0.0, 0.0, 0.0, 0.0);
   glClear(GL_COLOR_BUFFER_BIT);
 
-  glMatrixMode(GL_MODELVIEW);
-
-  glEnable(GL_TEXTURE_2D);
   glEnable(GL_BLEND);
 
   olive::rendering::compose_sequence(params);
@@ -187,6 +208,19 @@ void RenderThread::paint() {
 
   active_mutex.unlock();
 
+  if (olive::CurrentRuntimeConfig.log_frame_pool
+      && (!frame_pool_stats_timer_.isValid() || frame_pool_stats_timer_.elapsed() >= 1000)) {
+    FramePool::LogStats();
+    frame_pool_stats_timer_.start();
+  }
+
+  if (olive::CurrentRuntimeConfig.log_clip_latency) {
+    for (int i=0;i<clip_latency_.size();i++) {
+      const ClipLatency& l = clip_latency_.at(i);
+      qInfo() << "Clip" << l.clip->name() << "cache:" << l.cache << "us, wait:" << l.wait << "us, upload:" << l.upload << "us";
+    }
+  }
+
   if (!save_fn.isEmpty()) {
     if (texture_failed) {
       // texture failed, try again
@@ -221,11 +255,66 @@ void RenderThread::paint() {
     pixel_buffer = nullptr;
   }
 
+  // all clip framebuffers are free to be reused next frame
+  fbo_pool_.Recycle();
+  nest_cache_.EndFrame(&fbo_pool_);
+
   glDisable(GL_BLEND);
-  glDisable(GL_TEXTURE_2D);
 
   // release
   ctx->functions()->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+  update_stats(render_timer.nsecsElapsed() / 1000);
+}
+
+void RenderThread::update_stats(qint64 render_time)
+{
+  stats_lock_.lock();
+
+  stats_.render_time = render_time;
+
+  // the playhead follows the wall clock during playback, so any frames it moved past beyond the playback speed are
+  // frames that were never shown (jumps against the playback direction are loops or seeks and aren't counted)
+  long playhead = seq->playhead;
+  if (playback_speed_ != 0) {
+    if (last_playback_speed_ == 0) {
+      stats_.dropped_frames = 0;
+    } else {
+      long step = (playback_speed_ > 0) ? playhead - last_playhead_ : last_playhead_ - playhead;
+      long expected = qAbs(playback_speed_);
+      if (step > expected) {
+        stats_.dropped_frames += int(step - expected);
+      }
+    }
+  }
+  last_playhead_ = playhead;
+  last_playback_speed_ = playback_speed_;
+
+  // front and back buffers
+  stats_.gpu_memory = qint64(tex_width) * tex_height * 4 * 4;
+  stats_.gpu_memory += fbo_pool_.memory_usage();
+  stats_.frame_memory = 0;
+
+  stats_.clips.clear();
+  for (int i=0;i<clip_latency_.size();i++) {
+    const ClipLatency& l = clip_latency_.at(i);
+
+    stats_.gpu_memory += l.texture_memory;
+    stats_.frame_memory += l.queue_memory;
+
+    stats_.clips.append(l);
+    stats_.clips.last().clip = nullptr;
+  }
+
+  stats_lock_.unlock();
+}
+
+RenderStats RenderThread::get_stats()
+{
+  stats_lock_.lock();
+  RenderStats stats = stats_;
+  stats_lock_.unlock();
+  return stats;
 }
 
 void RenderThread::start_render(QOpenGLContext *share,
@@ -297,6 +386,8 @@ void RenderThread::delete_buffers() {
 }
 
 void RenderThread::delete_shaders() {
+  quad_.Destroy();
+
   delete blend_mode_program;
   blend_mode_program = nullptr;
 
@@ -308,6 +399,9 @@ void RenderThread::delete_ctx() {
   if (ctx != nullptr) {
     delete_shaders();
     delete_buffers();
+
+    nest_cache_.Clear();
+    fbo_pool_.Clear();
   }
 
   delete ctx;
@@ -28,10 +28,13 @@
 #include <QOpenGLContext>
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLShaderProgram>
+#include <QElapsedTimer>
 
 #include "timeline/sequence.h"
 #include "effects/effect.h"
 #include "rendering/framebufferobject.h"
+#include "rendering/framebufferpool.h"
+#include "rendering/quadrenderer.h"
 
 // copied from source code to OCIODisplay
 const int LUT3D_EDGE_SIZE = 32;
@@ -39,6 +42,40 @@ const int LUT3D_EDGE_SIZE = 32;
 // copied from source code to OCIODisplay, expanded from 3*LUT3D_EDGE_SIZE*LUT3D_EDGE_SIZE*LUT3D_EDGE_SIZE
 const int NUM_3D_ENTRIES = 98304;
 
+/**
+ * @brief How the last frame rendered by a RenderThread went
+ *
+ * Shown by the viewer's performance overlay (see Config::show_performance_overlay).
+ */
+struct RenderStats {
+  RenderStats();
+
+  /**
+   * @brief Time the last frame took to render, in microseconds
+   */
+  qint64 render_time;
+
+  /**
+   * @brief Number of frames the playhead skipped because rendering couldn't keep up since playback last started
+   */
+  int dropped_frames;
+
+  /**
+   * @brief Approximate GPU memory held by the renderer's framebuffers and the clips' textures, in bytes
+   */
+  qint64 gpu_memory;
+
+  /**
+   * @brief Memory held by decoded frames waiting in the clips' queues, in bytes
+   */
+  qint64 frame_memory;
+
+  /**
+   * @brief Per-clip breakdown of the last frame
+   */
+  QVector<ClipLatency> clips;
+};
+
 class RenderThread : public QThread {
   Q_OBJECT
 public:
@@ -59,6 +96,13 @@ public:
                     int pixel_linesize = 0,
                     int idivider = 0);
   bool did_texture_fail();
+
+  /**
+   * @brief Get statistics about the last rendered frame
+   *
+   * Thread-safe.
+   */
+  RenderStats get_stats();
   void cancel();
   void wait_until_paused();
 
@@ -73,6 +117,11 @@ private:
   void delete_shaders();
 
   void set_up_ocio();
+
+  /**
+   * @brief Update the statistics returned by get_stats() after a frame has been rendered
+   */
+  void update_stats(qint64 render_time);
   void destroy_ocio();
 
   FramebufferObject front_buffer_1;
@@ -94,10 +143,23 @@ private:
   QOpenGLContext* ctx;
   QOpenGLShaderProgram* blend_mode_program;
   QOpenGLShaderProgram* premultiply_program;
+  QuadRenderer quad_;
 
   FramebufferObject back_buffer_1;
   FramebufferObject back_buffer_2;
 
+  FramebufferPool fbo_pool_;
+  NestedSequenceCache nest_cache_;
+
+  QVector<ClipLatency> clip_latency_;
+
+  RenderStats stats_;
+  QMutex stats_lock_;
+  long last_playhead_;
+  int last_playback_speed_;
+
+  QElapsedTimer frame_pool_stats_timer_;
+
   float ocio_lut_data[NUM_3D_ENTRIES];
   GLuint ocio_lut_texture;
   QOpenGLShaderProgram* ocio_shader;
@@ -0,0 +1,413 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "shaderprogram.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QRegularExpression>
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QMutex>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+
+namespace {
+
+struct CachedProgram {
+  QOpenGLShaderProgram* program;
+  QOpenGLContext* ctx;
+  QByteArray key;
+  QByteArray source;
+  int references;
+};
+
+// programs shared by AcquireProgram(), effects are opened from both the render thread and the main thread
+QMutex program_cache_lock;
+QVector<CachedProgram> program_cache;
+
+bool ReadShaderFile(const QString& filename, QByteArray& source) {
+  if (filename.isEmpty()) {
+    source.clear();
+    return true;
+  }
+
+  QFile file(filename);
+  if (!file.open(QFile::ReadOnly)) {
+    qWarning() << "Failed to open shader file" << filename;
+    return false;
+  }
+
+  source = file.readAll();
+  return true;
+}
+
+QByteArray ProgramKey(const QByteArray& vert, const QByteArray& frag) {
+  // translation depends on the profile, so it's part of the key
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(vert);
+  hash.addData("\n// olive fragment shader\n");
+  hash.addData(frag);
+  hash.addData(olive::rendering::IsCoreProfile() ? "core" : "compat");
+  return hash.result();
+}
+
+bool SupportsProgramBinaries(QOpenGLContext* ctx) {
+  bool supported;
+
+  if (ctx->isOpenGLES()) {
+    supported = (ctx->format().majorVersion() >= 3);
+  } else {
+    supported = (ctx->format().version() >= qMakePair(4, 1) || ctx->hasExtension("GL_ARB_get_program_binary"));
+  }
+
+  if (supported) {
+    // some drivers expose the functions without supporting any binary formats
+    GLint format_count = 0;
+    ctx->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    supported = (format_count > 0);
+  }
+
+  return supported;
+}
+
+QString ProgramBinaryPath(QOpenGLContext* ctx, const QByteArray& key) {
+  // binaries are only valid for the driver that produced them
+  QOpenGLFunctions* f = ctx->functions();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(key);
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_VENDOR)));
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_RENDERER)));
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_VERSION)));
+
+  QDir cache_dir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+  return cache_dir.filePath(QString("shaders/%1.bin").arg(QString(hash.result().toHex())));
+}
+
+QOpenGLShaderProgram* LoadProgramBinary(QOpenGLContext* ctx, const QString& path) {
+  QFile file(path);
+  if (!file.open(QFile::ReadOnly)) {
+    return nullptr;
+  }
+
+  QByteArray data = file.readAll();
+  file.close();
+
+  if (data.size() <= int(sizeof(GLenum))) {
+    return nullptr;
+  }
+
+  GLenum format;
+  memcpy(&format, data.constData(), sizeof(GLenum));
+
+  QOpenGLShaderProgram* program = new QOpenGLShaderProgram();
+  program->create();
+
+  ctx->extraFunctions()->glProgramBinary(program->programId(),
+                                         format,
+                                         data.constData() + sizeof(GLenum),
+                                         data.size() - int(sizeof(GLenum)));
+
+  // with no shaders attached, link() just checks whether the binary left the program linked
+  if (!program->link()) {
+    // most likely a driver update, the binary will be replaced once the program has been compiled again
+    delete program;
+    QFile::remove(path);
+    return nullptr;
+  }
+
+  return program;
+}
+
+void SaveProgramBinary(QOpenGLContext* ctx, QOpenGLShaderProgram* program, const QString& path) {
+  QOpenGLExtraFunctions* f = ctx->extraFunctions();
+
+  GLint length = 0;
+  f->glGetProgramiv(program->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  QByteArray data(int(sizeof(GLenum)) + length, 0);
+  GLenum format = 0;
+  GLsizei written = 0;
+
+  f->glGetProgramBinary(program->programId(), length, &written, &format, data.data() + sizeof(GLenum));
+  if (written <= 0) {
+    return;
+  }
+
+  memcpy(data.data(), &format, sizeof(GLenum));
+  data.resize(int(sizeof(GLenum)) + written);
+
+  QDir().mkpath(QFileInfo(path).absolutePath());
+
+  QFile file(path);
+  if (file.open(QFile::WriteOnly)) {
+    file.write(data);
+    file.close();
+  } else {
+    qWarning() << "Failed to write shader binary" << path;
+  }
+}
+
+QOpenGLShaderProgram* BuildProgram(const QByteArray& vert, const QByteArray& frag, const QByteArray& key) {
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  bool use_binary = SupportsProgramBinaries(ctx);
+  QString binary_path;
+
+  if (use_binary) {
+    binary_path = ProgramBinaryPath(ctx, key);
+
+    QOpenGLShaderProgram* program = LoadProgramBinary(ctx, binary_path);
+    if (program != nullptr) {
+      return program;
+    }
+  }
+
+  QOpenGLShaderProgram* program = new QOpenGLShaderProgram();
+
+  if (use_binary) {
+    program->create();
+    ctx->extraFunctions()->glProgramParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+
+  bool compiled = true;
+
+  if (!vert.isEmpty()) {
+    compiled = olive::rendering::AddShader(program, QOpenGLShader::Vertex, vert);
+  }
+
+  if (compiled && !frag.isEmpty()) {
+    compiled = olive::rendering::AddShader(program, QOpenGLShader::Fragment, frag);
+  }
+
+  if (compiled && olive::rendering::LinkProgram(program) && use_binary) {
+    SaveProgramBinary(ctx, program, binary_path);
+  }
+
+  return program;
+}
+
+}
+
+bool olive::rendering::IsCoreProfile()
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+  return ctx != nullptr && ctx->format().profile() == QSurfaceFormat::CoreProfile;
+}
+
+QByteArray olive::rendering::TranslateShader(const QByteArray &source,
+                                              QOpenGLShader::ShaderType type,
+                                              bool core_profile)
+{
+  QString code = QString::fromUtf8(source);
+
+  // the version directive has to stay first, so pull it out and re-add it above the declarations we insert
+  int version = 110;
+  QRegularExpression version_regex("^[ \\t]*#version[ \\t]+(\\d+)[^\\n]*$", QRegularExpression::MultilineOption);
+  QRegularExpressionMatch version_match = version_regex.match(code);
+  if (version_match.hasMatch()) {
+    version = version_match.captured(1).toInt();
+    code.remove(version_match.capturedStart(), version_match.capturedLength());
+  }
+
+  code.replace(QRegularExpression("\\bgl_Vertex\\b"), "olive_position");
+  code.replace(QRegularExpression("\\bgl_MultiTexCoord0\\b"), "olive_texcoord");
+  code.replace(QRegularExpression("\\bgl_ModelViewProjectionMatrix\\b"), "olive_mvp");
+
+  QString header;
+
+  if (core_profile) {
+    header = QString("#version %1 core\n").arg(qMax(version, 150));
+
+    if (type == QOpenGLShader::Vertex) {
+      code.replace(QRegularExpression("\\battribute\\b"), "in");
+      code.replace(QRegularExpression("\\bvarying\\b"), "out");
+    } else {
+      code.replace(QRegularExpression("\\bvarying\\b"), "in");
+
+      QRegularExpression frag_color_regex("\\bgl_FragColor\\b");
+      if (code.contains(frag_color_regex)) {
+        code.replace(frag_color_regex, "olive_FragColor");
+        header.append("out vec4 olive_FragColor;\n");
+      }
+    }
+
+    code.replace(QRegularExpression("\\btexture2D\\b"), "texture");
+    code.replace(QRegularExpression("\\btexture2DProj\\b"), "textureProj");
+  } else {
+    header = QString("#version %1\n").arg(version);
+  }
+
+  if (type == QOpenGLShader::Vertex) {
+    QString input_qualifier = (core_profile || version >= 130) ? "in" : "attribute";
+    header.append(QString("%1 vec4 olive_position;\n"
+                          "%1 vec4 olive_texcoord;\n"
+                          "uniform mat4 olive_mvp;\n").arg(input_qualifier));
+  }
+
+  return (header + code).toUtf8();
+}
+
+bool olive::rendering::AddShader(QOpenGLShaderProgram *program,
+                                 QOpenGLShader::ShaderType type,
+                                 const QByteArray &source)
+{
+  if (!program->addShaderFromSourceCode(type, TranslateShader(source, type, IsCoreProfile()))) {
+    qWarning() << "Failed to compile shader:" << program->log();
+    return false;
+  }
+
+  return true;
+}
+
+bool olive::rendering::AddShaderFromFile(QOpenGLShaderProgram *program,
+                                         QOpenGLShader::ShaderType type,
+                                         const QString &filename)
+{
+  QFile file(filename);
+  if (!file.open(QFile::ReadOnly)) {
+    qWarning() << "Failed to open shader file" << filename;
+    return false;
+  }
+
+  return AddShader(program, type, file.readAll());
+}
+
+bool olive::rendering::LinkProgram(QOpenGLShaderProgram *program)
+{
+  bool has_vertex_shader = false;
+  QList<QOpenGLShader*> shaders = program->shaders();
+  for (int i=0;i<shaders.size();i++) {
+    if (shaders.at(i)->shaderType() & QOpenGLShader::Vertex) {
+      has_vertex_shader = true;
+      break;
+    }
+  }
+
+  if (!has_vertex_shader && !AddShader(program, QOpenGLShader::Vertex, DefaultVertexShader())) {
+    return false;
+  }
+
+  program->bindAttributeLocation("olive_position", kPositionAttribute);
+  program->bindAttributeLocation("olive_texcoord", kTexCoordAttribute);
+
+  if (!program->link()) {
+    qWarning() << "Shader program failed to link:" << program->log();
+    return false;
+  }
+
+  return true;
+}
+
+QOpenGLShaderProgram *olive::rendering::CreateProgram(const QString &vert, const QString &frag)
+{
+  QByteArray vert_source;
+  QByteArray frag_source;
+
+  if (!ReadShaderFile(vert, vert_source) || !ReadShaderFile(frag, frag_source)) {
+    return new QOpenGLShaderProgram();
+  }
+
+  return BuildProgram(vert_source, frag_source, ProgramKey(vert_source, frag_source));
+}
+
+QOpenGLShaderProgram *olive::rendering::AcquireProgram(const QString &vert, const QString &frag)
+{
+  QByteArray vert_source;
+  QByteArray frag_source;
+
+  // programs that couldn't be read are cached under an empty key so they're still released properly
+  bool read = (ReadShaderFile(vert, vert_source) && ReadShaderFile(frag, frag_source));
+  QByteArray key = read ? ProgramKey(vert_source, frag_source) : QByteArray();
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  QMutexLocker locker(&program_cache_lock);
+
+  for (int i=0;i<program_cache.size();i++) {
+    CachedProgram& cached = program_cache[i];
+
+    // a program whose context group has gone away has an ID of 0 and can't be reused
+    if (cached.ctx == ctx && cached.key == key && (key.isEmpty() || cached.program->programId() != 0)) {
+      cached.references++;
+      return cached.program;
+    }
+  }
+
+  CachedProgram cached;
+  cached.program = read ? BuildProgram(vert_source, frag_source, key) : new QOpenGLShaderProgram();
+  cached.ctx = ctx;
+  cached.key = key;
+  cached.source = vert_source + frag_source;
+  cached.references = 1;
+  program_cache.append(cached);
+
+  return cached.program;
+}
+
+void olive::rendering::ReleaseProgram(QOpenGLShaderProgram *program)
+{
+  QMutexLocker locker(&program_cache_lock);
+
+  for (int i=0;i<program_cache.size();i++) {
+    if (program_cache.at(i).program == program) {
+      program_cache[i].references--;
+
+      if (program_cache.at(i).references == 0) {
+        delete program;
+        program_cache.removeAt(i);
+      }
+
+      return;
+    }
+  }
+
+  qWarning() << "Tried to release a shader program that isn't in the cache";
+}
+
+QByteArray olive::rendering::ProgramSource(QOpenGLShaderProgram *program)
+{
+  QMutexLocker locker(&program_cache_lock);
+
+  for (int i=0;i<program_cache.size();i++) {
+    if (program_cache.at(i).program == program) {
+      return program_cache.at(i).source;
+    }
+  }
+
+  return QByteArray();
+}
+
+QByteArray olive::rendering::DefaultVertexShader()
+{
+  return "#version 110\n"
+         "\n"
+         "varying vec2 vTexCoord;\n"
+         "\n"
+         "void main() {\n"
+         "  vTexCoord = gl_MultiTexCoord0.xy;\n"
+         "  gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+         "}\n";
+}
@@ -0,0 +1,126 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SHADERPROGRAM_H
+#define SHADERPROGRAM_H
+
+#include <QOpenGLShaderProgram>
+#include <QByteArray>
+#include <QString>
+
+namespace olive {
+namespace rendering {
+
+/**
+ * @brief Attribute location every program reads its vertex positions from
+ *
+ * Bound by LinkProgram() so QuadRenderer can use the same vertex layout for every shader.
+ */
+const int kPositionAttribute = 0;
+
+/**
+ * @brief Attribute location every program reads its texture coordinates from
+ */
+const int kTexCoordAttribute = 1;
+
+/**
+ * @brief Returns whether the current OpenGL context is a core profile context
+ */
+bool IsCoreProfile();
+
+/**
+ * @brief Convert a legacy GLSL shader to run without the fixed-function pipeline
+ *
+ * Olive's shaders (and the effect shaders users write) are written against GLSL 1.10 and read their inputs from
+ * fixed-function built-ins. These are replaced with generic attributes and a uniform that QuadRenderer supplies:
+ *
+ * * `gl_Vertex` becomes the `olive_position` attribute
+ * * `gl_MultiTexCoord0` becomes the `olive_texcoord` attribute
+ * * `gl_ModelViewProjectionMatrix` becomes the `olive_mvp` uniform
+ *
+ * If `core_profile` is **TRUE**, the shader is also raised to GLSL 1.50 core (varying/attribute become in/out,
+ * texture2D() becomes texture() and gl_FragColor becomes an output variable) so it compiles on core profile contexts
+ * and drivers like llvmpipe that don't provide a compatibility profile.
+ */
+QByteArray TranslateShader(const QByteArray& source, QOpenGLShader::ShaderType type, bool core_profile);
+
+/**
+ * @brief Translate and compile a shader from source and add it to a program
+ */
+bool AddShader(QOpenGLShaderProgram* program, QOpenGLShader::ShaderType type, const QByteArray& source);
+
+/**
+ * @brief Translate and compile a shader from a file (or Qt resource) and add it to a program
+ */
+bool AddShaderFromFile(QOpenGLShaderProgram* program, QOpenGLShader::ShaderType type, const QString& filename);
+
+/**
+ * @brief Bind Olive's attribute locations and link a program
+ *
+ * Adds the default vertex shader (see DefaultVertexShader()) first if the program doesn't have one.
+ */
+bool LinkProgram(QOpenGLShaderProgram* program);
+
+/**
+ * @brief Create and link a program from a vertex and fragment shader file
+ *
+ * `vert` may be empty to use the default vertex shader. Always returns a program, check
+ * QOpenGLShaderProgram::isLinked() to see whether it's usable.
+ *
+ * Where the driver supports program binaries, the linked binary is stored on disk keyed by the shader sources and
+ * the OpenGL vendor, renderer and version, so later runs skip compiling and linking entirely.
+ */
+QOpenGLShaderProgram* CreateProgram(const QString& vert, const QString& frag);
+
+/**
+ * @brief Get a shared program for a vertex and fragment shader file
+ *
+ * Same as CreateProgram(), but programs are cached for the current context by the hash of their sources, so every
+ * effect using the same shaders shares one program instead of compiling its own. Uniforms stay set on a program
+ * between draws, so users must set every uniform they rely on each time they bind it.
+ *
+ * Every call must be matched by a call to ReleaseProgram(), the returned program must not be deleted directly.
+ */
+QOpenGLShaderProgram* AcquireProgram(const QString& vert, const QString& frag);
+
+/**
+ * @brief Hand back a program from AcquireProgram()
+ *
+ * The program is destroyed once nothing is using it anymore.
+ */
+void ReleaseProgram(QOpenGLShaderProgram* program);
+
+/**
+ * @brief Get the (untranslated) source code a program from AcquireProgram() was built from
+ *
+ * Programs loaded from a binary have no QOpenGLShader objects attached, so their source can't be retrieved from
+ * QOpenGLShaderProgram::shaders().
+ */
+QByteArray ProgramSource(QOpenGLShaderProgram* program);
+
+/**
+ * @brief Pass-through vertex shader that outputs `vTexCoord` for a fragment shader to sample with
+ */
+QByteArray DefaultVertexShader();
+
+}
+}
+
+#endif // SHADERPROGRAM_H
@@ -21,6 +21,7 @@
 #include "clip.h"
 
 #include <QtMath>
+#include <QElapsedTimer>
 
 #include "effects/effect.h"
 #include "effects/transition.h"
@@ -35,6 +36,7 @@
 #include "project/clipboard.h"
 #include "undo/undo.h"
 #include "global/debug.h"
+#include "global/trace.h"
 
 const int kRGBAComponentCount = 4;
 
@@ -53,10 +55,11 @@ Clip::Clip(Sequence* s) :
   closing_transition(nullptr),
   undeletable(false),
   replaced(false),
-  fbo(nullptr),
   open_(false),
-  texture(nullptr)
+  texture(nullptr),
+  texture_minified_(false)
 {
+  fbo[0] = fbo[1] = fbo[2] = nullptr;
 }
 
 ClipPtr Clip::copy(Sequence* s) {
@@ -85,13 +88,20 @@ ClipPtr Clip::copy(Sequence* s) {
   return copy;
 }
 
-bool Clip::IsActiveAt(long timecode)
+bool Clip::IsActiveAt(long timecode, int playback_speed)
 {
   // these buffers allow clips to be opened and prepared well before they're displayed
   // as well as closed a little after they're not needed anymore
-  int open_buffer = qCeil(this->sequence->frame_rate*2);
-  int close_buffer = qCeil(this->sequence->frame_rate);
-
+  // at least one frame either way, otherwise a clip wouldn't count as active on its own first frame
+  int open_buffer = qMax(1, qCeil(this->sequence->frame_rate
+                                  * olive::CurrentConfig.prefetch_window
+                                  * qMax(1, qAbs(playback_speed))));
+  int close_buffer = qMax(1, qCeil(this->sequence->frame_rate * olive::CurrentConfig.prefetch_window * 0.5));
+
+  // when playing in reverse, the clips coming up are the ones before the playhead
+  if (playback_speed < 0) {
+    qSwap(open_buffer, close_buffer);
+  }
 
   return enabled()
       && timeline_in(true) < timecode + open_buffer
@@ -507,19 +517,8 @@ void Clip::Close(bool wait) {
       }
     }
 
-    // delete framebuffers
-    if (fbo != nullptr) {
-      // delete 3 fbos for nested sequences, 2 for most clips
-      int fbo_count = (media() != nullptr && media()->get_type() == MEDIA_TYPE_SEQUENCE) ? 3 : 2;
-
-      for (int j=0;j<fbo_count;j++) {
-        delete fbo[j];
-      }
-
-      delete [] fbo;
-
-      fbo = nullptr;
-    }
+    // framebuffers belong to the renderer's FramebufferPool, just forget about them
+    fbo[0] = fbo[1] = fbo[2] = nullptr;
 
     if (UsesCacher()) {
       cacher.Close(wait);
@@ -539,29 +538,52 @@ void Clip::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int playb
   cacher_frame = playhead;
 }
 
-bool Clip::Retrieve()
+void Clip::Prefetch(long playhead, QVector<Clip*>& nests, int playback_speed) {
+  cacher.Prefetch(playhead, nests, playback_speed);
+}
+
+void Clip::SetAudioBuffer(AudioMixBuffer *buffer) {
+  cacher.SetAudioBuffer(buffer);
+}
+
+void Clip::WaitUntilCached() {
+  if (UsesCacher()) {
+    cacher.WaitUntilIdle();
+  }
+}
+
+bool Clip::Retrieve(ClipLatency* latency)
 {
   bool ret = false;
 
   if (UsesCacher()) {
 
+    QElapsedTimer timer;
+    timer.start();
+
     // Retrieve the frame from the cacher that we requested in Cache().
     AVFrame* frame = cacher.Retrieve();
 
-    // Wait for exclusive control of the queue to avoid any threading collisions
-    cacher.queue()->lock();
+    if (latency != nullptr) {
+      latency->wait = timer.nsecsElapsed() / 1000;
+      timer.restart();
+    }
 
-    // Check if we retrieved a frame (nullptr) and if the queue stil contains this frame.
+    // Check if we retrieved a frame (nullptr).
     //
     // `nullptr` is returned if the cacher failed to get any sort of frame and is uncommon, but we do need
     // to handle it.
     //
-    // We check the queue because in some situations (e.g. intensive scrubbing), in the time it took to gain
-    // exclusive control of the queue, the cacher may have deleted the frame.
-    // Therefore we check to ensure the queue still contains the frame now that we have exclusive control,
-    // to avoid any attempt to utilize now-freed memory.
+    // Cache() started a read section on the queue, so even if the cacher removes this frame from the queue in the
+    // meantime (e.g. during intensive scrubbing), it won't be freed until we end the read section below.
+
+    if (frame != nullptr) {
 
-    if (frame != nullptr && cacher.queue()->contains(frame)) {
+      // only keep a mipmap chain around while the clip is actually being drawn minified
+      if (texture != nullptr && (texture->mipLevels() > 1) != texture_minified_) {
+        delete texture;
+        texture = nullptr;
+      }
 
       // check if the opengl texture exists yet, create it if not
       if (texture == nullptr) {
@@ -573,8 +595,12 @@ bool Clip::Retrieve()
         texture->setSize(cacher.media_width(), cacher.media_height());
 
         texture->setFormat(QOpenGLTexture::RGBA8_UNorm);
-        texture->setMipLevels(texture->maximumMipLevels());
-        texture->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear, QOpenGLTexture::Linear);
+        texture->setMipLevels(texture_minified_ ? texture->maximumMipLevels() : 1);
+        texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+
+        // mipmaps are generated by olive::rendering::PrepareToDraw() when needed, not on every upload
+        texture->setAutoMipMapGenerationEnabled(false);
+
         texture->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
       }
 
@@ -591,10 +617,16 @@ bool Clip::Retrieve()
         Effect* e = effects.at(i).get();
         if ((e->Flags() & Effect::ImageFlag) && e->IsEnabled()) {
           if (data_buffer_1 == frame->data[0]) {
-            data_buffer_1 = new uint8_t[frame_size];
-            data_buffer_2 = new uint8_t[frame_size];
+            // scratch buffers are kept between frames so they don't have to be reallocated every time
+            if (image_buffer_1_.size() < frame_size) {
+              image_buffer_1_.resize(frame_size);
+              image_buffer_2_.resize(frame_size);
+            }
+
+            data_buffer_1 = reinterpret_cast<uint8_t*>(image_buffer_1_.data());
+            data_buffer_2 = reinterpret_cast<uint8_t*>(image_buffer_2_.data());
 
-            memcpy(data_buffer_1, frame->data[0], frame_size);
+            memcpy(data_buffer_1, frame->data[0], size_t(frame_size));
           }
 
           e->process_image(get_timecode(this, cacher_frame),
@@ -607,33 +639,95 @@ bool Clip::Retrieve()
         }
       }
 
-      texture->setData(QOpenGLTexture::RGBA,
-                          QOpenGLTexture::UInt8,
-                          const_cast<const uint8_t*>(using_db_1 ? data_buffer_1 : data_buffer_2));
-
-      if (data_buffer_1 != frame->data[0]) {
-        delete [] data_buffer_1;
-        delete [] data_buffer_2;
+      {
+        TraceScope trace("clip", "upload", name());
+        texture->setData(QOpenGLTexture::RGBA,
+                            QOpenGLTexture::UInt8,
+                            const_cast<const uint8_t*>(using_db_1 ? data_buffer_1 : data_buffer_2));
       }
 
       glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
       ret = true;
+
+      if (latency != nullptr) {
+        // still inside the read section, so every frame in the queue is safe to look at
+        ClipQueue* queue = cacher.queue();
+        for (int i=0;i<queue->size();i++) {
+          AVFrame* queued_frame = queue->at(i);
+          if (queued_frame != nullptr) {
+            latency->queue_memory += queued_frame->linesize[0]*queued_frame->height;
+            if (queued_frame->pts > frame->pts) {
+              latency->queue_ahead++;
+            }
+          }
+        }
+
+        if (olive::CurrentConfig.upcoming_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES) {
+          latency->queue_target = qCeil(olive::CurrentConfig.upcoming_queue_size);
+        } else {
+          latency->queue_target = qCeil(olive::CurrentConfig.upcoming_queue_size * media_frame_rate());
+        }
+
+        latency->texture_memory = qint64(texture->width()) * texture->height() * kRGBAComponentCount;
+        if (texture->mipLevels() > 1) {
+          // a full mipmap chain adds another third
+          latency->texture_memory += latency->texture_memory / 3;
+        }
+      }
     } else {
       qCritical() << "Failed to retrieve frame for clip" << name();
     }
 
-    cacher.queue()->unlock();
+    // we're done with the frame, the cacher is free to reclaim it now
+    cacher.queue()->EndRead();
+
+    if (latency != nullptr) {
+      latency->upload = timer.nsecsElapsed() / 1000;
+    }
   }
 
   return ret;
 }
 
+bool Clip::FrameHasAlpha()
+{
+  if (!UsesCacher() || cacher.media_has_alpha()) {
+    return true;
+  }
+
+  // image effects write raw RGBA, so they could have made pixels transparent
+  for (int i=0;i<effects.size();i++) {
+    if ((effects.at(i)->Flags() & Effect::ImageFlag) && effects.at(i)->IsEnabled()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void Clip::SetTextureMinified(bool minified)
+{
+  texture_minified_ = minified;
+}
+
 bool Clip::UsesCacher()
 {
   return track() >= 0 || (media() != nullptr && media()->get_type() == MEDIA_TYPE_FOOTAGE);
 }
 
+ClipLatency::ClipLatency() :
+  clip(nullptr),
+  cache(0),
+  wait(0),
+  upload(0),
+  queue_ahead(0),
+  queue_target(0),
+  queue_memory(0),
+  texture_memory(0)
+{
+}
+
 ClipSpeed::ClipSpeed() :
   value(1.0),
   maintain_audio_pitch(false)
@@ -29,6 +29,7 @@
 #include <QOpenGLTexture>
 
 #include "rendering/cacher.h"
+#include "rendering/rendergraph.h"
 
 #include "effects/effect.h"
 #include "effects/transition.h"
@@ -53,13 +54,76 @@ using ClipPtr = std::shared_ptr<Clip>;
 
 class Sequence;
 
+/**
+ * @brief Timing and buffering breakdown of one clip's Cache()/Retrieve() cycle for a single frame
+ *
+ * Filled in by compose_sequence() if ComposeSequenceParams::clip_latency is set. All times are in microseconds.
+ */
+struct ClipLatency {
+  ClipLatency();
+
+  /**
+   * @brief The clip these timings belong to
+   *
+   * Only valid while the frame is being rendered, use `name` afterwards.
+   */
+  Clip* clip;
+
+  /**
+   * @brief Name of the clip
+   */
+  QString name;
+
+  /**
+   * @brief Time spent issuing the Cache() request to the clip's decoder
+   */
+  qint64 cache;
+
+  /**
+   * @brief Time Retrieve() spent blocked waiting for the decoder to deliver the frame
+   */
+  qint64 wait;
+
+  /**
+   * @brief Time spent running image effects on the frame and uploading it to the GPU
+   */
+  qint64 upload;
+
+  /**
+   * @brief Number of decoded frames waiting in the clip's queue after the one that was retrieved
+   */
+  int queue_ahead;
+
+  /**
+   * @brief Number of upcoming frames the clip's decoder tries to keep queued (see Config::upcoming_queue_size)
+   */
+  int queue_target;
+
+  /**
+   * @brief Memory held by the decoded frames in the clip's queue, in bytes
+   */
+  qint64 queue_memory;
+
+  /**
+   * @brief GPU memory held by the clip's texture, in bytes
+   */
+  qint64 texture_memory;
+};
+
 class Clip {
 public:
   Clip(Sequence *s);
   ~Clip();
   ClipPtr copy(Sequence *s);
 
-  bool IsActiveAt(long timecode);
+  /**
+   * @brief Returns whether the clip should be open at a given time
+   *
+   * Clips are opened ahead of time so they're ready by the time they're displayed, and closed a little after they've
+   * been passed. The window ahead of the playhead is Config::prefetch_window long and grows with the playback speed,
+   * the window behind it is half that. A negative playback_speed swaps the two.
+   */
+  bool IsActiveAt(long timecode, int playback_speed = 0);
   bool IsSelected(bool containing = true);
 
   const QColor& color();
@@ -136,7 +200,26 @@ public:
   // playback functions
   void Open();
   void Cache(long playhead, bool scrubbing, QVector<Clip*> &nests, int playback_speed);
-  bool Retrieve();
+  void Prefetch(long playhead, QVector<Clip*> &nests, int playback_speed);
+  void SetAudioBuffer(AudioMixBuffer* buffer);
+  void WaitUntilCached();
+  bool Retrieve(ClipLatency* latency = nullptr);
+
+  /**
+   * @brief Returns whether the uploaded frame may have pixels that aren't opaque
+   *
+   * **FALSE** if the media has no alpha channel and no image effect could have introduced one, in which case
+   * premultiplying the frame would do nothing.
+   */
+  bool FrameHasAlpha();
+
+  /**
+   * @brief Set whether the compositor is drawing this clip's texture smaller than its resolution
+   *
+   * Mipmaps are only allocated and generated for textures that are minified. Changing this recreates the texture on
+   * the next Retrieve().
+   */
+  void SetTextureMinified(bool minified);
   void Close(bool wait);
   bool IsOpen();
 
@@ -152,7 +235,12 @@ public:
   QMutex cache_lock;
 
   // video playback variables
-  QOpenGLFramebufferObject** fbo;
+  // framebuffers borrowed from the renderer's FramebufferPool for the duration of a frame, only used by nested
+  // sequences (the nested sequence's target and two back buffers for blending modes), nullptr otherwise
+  QOpenGLFramebufferObject* fbo[3];
+
+  // passes to render this clip's effect stack with
+  RenderGraph render_graph;
   QOpenGLTexture* texture;
   long texture_frame;
 
@@ -174,6 +262,13 @@ private:
   Cacher cacher;
   long cacher_frame;
 
+  // scratch buffers for effects that process raw image data (see Effect::ImageFlag), reused between frames
+  QByteArray image_buffer_1_;
+  QByteArray image_buffer_2_;
+
+  // whether `texture` was last drawn minified and should have mipmaps (see SetTextureMinified())
+  bool texture_minified_;
+
   QVector<Marker> markers;
   QColor color_;
   bool open_;
@@ -43,7 +43,9 @@
 #include "global/config.h"
 #include "global/path.h"
 #include "global/debug.h"
+#include "global/trace.h"
 #include "project/proxygenerator.h"
+#include "project/filmstrip.h"
 #include "project/projectfilter.h"
 #include "ui/sourcetable.h"
 #include "ui/viewerwidget.h"
@@ -55,6 +57,7 @@
 #include "panels/panels.h"
 #include "dialogs/debugdialog.h"
 #include "rendering/audio.h"
+#include "rendering/audiopagecache.h"
 #include "rendering/renderfunctions.h"
 #include "undo/undostack.h"
 
@@ -288,6 +291,12 @@ MainWindow::MainWindow(QWidget *parent) :
   // start omnipotent proxy generator process
   olive::proxy_generator.start();
 
+  // start filmstrip thumbnail generator for the Timeline
+  olive::filmstrip_generator.start(QThread::LowPriority);
+
+  // start audio decoder for scrubbing and shuttle playback
+  olive::audio_page_cache.start(QThread::LowPriority);
+
   // load preferred language from file
   olive::Global->load_translation_from_config();
 
@@ -638,6 +647,10 @@ void MainWindow::setup_menus() {
   title_safe_custom->setData(-1.0);
   title_safe_group->addAction(title_safe_custom);
 
+  performance_overlay_ = MenuHelper::create_menu_action(view_menu, "performanceoverlay", &olive::MenuHelper, SLOT(toggle_bool_action()));
+  performance_overlay_->setCheckable(true);
+  performance_overlay_->setData(reinterpret_cast<quintptr>(&olive::CurrentConfig.show_performance_overlay));
+
   view_menu->addSeparator();
 
   full_screen = MenuHelper::create_menu_action(view_menu, "fullscreen", this, SLOT(toggle_full_screen()), QKeySequence("F11"));
@@ -811,6 +824,10 @@ void MainWindow::setup_menus() {
 
   debug_log_ = MenuHelper::create_menu_action(help_menu, "debuglog", olive::Global.get(), SLOT(open_debug_log()));
 
+  frame_trace_ = MenuHelper::create_menu_action(help_menu, "frametrace", olive::Global.get(), SLOT(toggle_frame_trace(bool)));
+  frame_trace_->setCheckable(true);
+  frame_trace_->setChecked(olive::trace::IsEnabled());
+
   help_menu->addSeparator();
 
   about_action_ = MenuHelper::create_menu_action(help_menu, "about", olive::Global.get(), SLOT(open_about_dialog()));
@@ -864,6 +881,8 @@ void MainWindow::Retranslate()
   title_safe_169->setText(tr("16:9"));
   title_safe_custom->setText(tr("Custom"));
 
+  performance_overlay_->setText(tr("Performance Overlay"));
+
   full_screen->setText(tr("Full Screen"));
   full_screen_viewer_->setText(tr("Full Screen Viewer"));
 
@@ -925,6 +944,7 @@ void MainWindow::Retranslate()
 
   action_search_->setText(tr("A&ction Search"));
   debug_log_->setText(tr("Debug Log"));
+  frame_trace_->setText(tr("Record Frame Trace"));
   about_action_->setText(tr("&About..."));
 
   panel_sequence_viewer->set_panel_name(QCoreApplication::translate("Viewer", "Sequence Viewer"));
@@ -952,6 +972,12 @@ void MainWindow::closeEvent(QCloseEvent *e) {
     // stop proxy generator thread
     olive::proxy_generator.cancel();
 
+    // stop filmstrip generator thread
+    olive::filmstrip_generator.cancel();
+
+    // stop scrubbing audio decoder thread
+    olive::audio_page_cache.cancel();
+
     panel_graph_editor->set_row(nullptr);
     panel_effect_controls->Clear(true);
 
@@ -1122,6 +1148,8 @@ void MainWindow::viewMenu_About_To_Be_Shown() {
 
   olive::MenuHelper.set_bool_action_checked(rectified_waveforms);
 
+  olive::MenuHelper.set_bool_action_checked(performance_overlay_);
+
   olive::MenuHelper.set_int_action_checked(frames_action, olive::CurrentConfig.timecode_view);
   olive::MenuHelper.set_int_action_checked(drop_frame_action, olive::CurrentConfig.timecode_view);
   olive::MenuHelper.set_int_action_checked(nondrop_frame_action, olive::CurrentConfig.timecode_view);
@@ -279,6 +279,8 @@ private:
   QAction* title_safe_169;
   QAction* title_safe_custom;
 
+  QAction* performance_overlay_;
+
   QAction* full_screen;
   QAction* full_screen_viewer_;
   QAction* show_all;
@@ -337,6 +339,7 @@ private:
   QMenu* help_menu;
   QAction* action_search_;
   QAction* debug_log_;
+  QAction* frame_trace_;
   QAction* about_action_;
 
   // used to store the panel state when one panel is maximized
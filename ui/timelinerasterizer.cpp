@@ -0,0 +1,206 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "timelinerasterizer.h"
+
+#include <QRunnable>
+#include <QPainter>
+#include <QThread>
+#include <QtMath>
+
+#include "ui/timelinewidget.h"
+#include "global/config.h"
+
+// maximum number of finished images kept
+const int kMaxImages = 1024;
+
+class WaveformJob : public QRunnable {
+public:
+  QObject* receiver;
+  QString key;
+
+  QVector<char> preview;
+  int channels;
+  long clip_in;
+  bool reversed;
+  long media_length;
+  int height;
+  int waveform_start;
+  int waveform_limit;
+  double zoom;
+  qreal dpr;
+  bool rectified;
+
+  virtual void run() override {
+    QImage image(qCeil((waveform_limit - waveform_start)*dpr), qCeil(height*dpr), QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(dpr);
+    image.fill(Qt::transparent);
+
+    QPainter p(&image);
+    p.setPen(QColor(80, 80, 80));
+
+    // shift the clip so waveform_start lands on the image's first column
+    draw_waveform(preview,
+                  channels,
+                  clip_in,
+                  reversed,
+                  media_length,
+                  &p,
+                  QRect(-waveform_start, 0, waveform_limit, height),
+                  waveform_start,
+                  waveform_limit,
+                  zoom,
+                  rectified);
+
+    p.end();
+
+    QMetaObject::invokeMethod(receiver, "StoreImage", Qt::QueuedConnection, Q_ARG(QString, key), Q_ARG(QImage, image));
+  }
+};
+
+class ThumbnailJob : public QRunnable {
+public:
+  QObject* receiver;
+  QString key;
+
+  QImage preview;
+  QSize size;
+  qreal dpr;
+
+  virtual void run() override {
+    QImage image = preview.scaled(qCeil(size.width()*dpr), qCeil(size.height()*dpr), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    image.setDevicePixelRatio(dpr);
+
+    QMetaObject::invokeMethod(receiver, "StoreImage", Qt::QueuedConnection, Q_ARG(QString, key), Q_ARG(QImage, image));
+  }
+};
+
+TimelineRasterizer::TimelineRasterizer(QObject *parent) :
+  QObject(parent)
+{
+  // leave the rest of the cores to playback
+  pool_.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+TimelineRasterizer::~TimelineRasterizer()
+{
+  // jobs post their results back to this object, so they must all be finished before it's destroyed
+  pool_.clear();
+  pool_.waitForDone();
+}
+
+QImage TimelineRasterizer::GetWaveform(ClipPtr clip,
+                                       const FootageStream *ms,
+                                       long media_length,
+                                       int height,
+                                       int waveform_start,
+                                       int waveform_limit,
+                                       double zoom,
+                                       qreal dpr)
+{
+  // the waveform only depends on the part of the media being shown, not on the clip itself
+  QString key = QString("w%1:%2:%3:%4:%5:%6:%7:%8:%9").arg(QString::number(quintptr(ms->audio_preview.constData())),
+                                                            QString::number(ms->audio_preview.size()),
+                                                            QString::number(clip->clip_in()),
+                                                            QString::number(clip->reversed()),
+                                                            QString::number(media_length),
+                                                            QString::number(height),
+                                                            QString::number(waveform_start),
+                                                            QString::number(waveform_limit),
+                                                            QString::number(zoom, 'g', 17));
+  key.append(QString(":%1:%2").arg(QString::number(dpr), QString::number(olive::CurrentConfig.rectified_waveforms)));
+
+  bool queue;
+  QImage image = Find(key, &queue);
+
+  if (queue) {
+    WaveformJob* job = new WaveformJob();
+    job->receiver = this;
+    job->key = key;
+    job->preview = ms->audio_preview;
+    job->channels = ms->audio_channels;
+    job->clip_in = clip->clip_in();
+    job->reversed = clip->reversed();
+    job->media_length = media_length;
+    job->height = height;
+    job->waveform_start = waveform_start;
+    job->waveform_limit = waveform_limit;
+    job->zoom = zoom;
+    job->dpr = dpr;
+    job->rectified = olive::CurrentConfig.rectified_waveforms;
+    pool_.start(job);
+  }
+
+  return image;
+}
+
+QImage TimelineRasterizer::GetThumbnail(const QImage &preview, const QSize &size, qreal dpr)
+{
+  QString key = QString("t%1:%2:%3:%4").arg(QString::number(preview.cacheKey()),
+                                            QString::number(size.width()),
+                                            QString::number(size.height()),
+                                            QString::number(dpr));
+
+  bool queue;
+  QImage image = Find(key, &queue);
+
+  if (queue) {
+    ThumbnailJob* job = new ThumbnailJob();
+    job->receiver = this;
+    job->key = key;
+    job->preview = preview;
+    job->size = size;
+    job->dpr = dpr;
+    pool_.start(job);
+  }
+
+  return image;
+}
+
+void TimelineRasterizer::StoreImage(const QString &key, const QImage &image)
+{
+  pending_.remove(key);
+
+  images_.insert(key, image);
+  order_.append(key);
+
+  while (order_.size() > kMaxImages) {
+    images_.remove(order_.takeFirst());
+  }
+
+  emit ImagesReady();
+}
+
+QImage TimelineRasterizer::Find(const QString &key, bool *queue)
+{
+  QHash<QString, QImage>::const_iterator i = images_.constFind(key);
+  if (i != images_.constEnd()) {
+    *queue = false;
+    return i.value();
+  }
+
+  // only queue one job per image
+  *queue = !pending_.contains(key);
+  if (*queue) {
+    pending_.insert(key);
+  }
+
+  return QImage();
+}
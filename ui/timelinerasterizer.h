@@ -0,0 +1,104 @@
+/***
+
+    Olive - Non-Linear Video Editor
+    Copyright (C) 2019  Olive Team
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TIMELINERASTERIZER_H
+#define TIMELINERASTERIZER_H
+
+#include <QObject>
+#include <QImage>
+#include <QThreadPool>
+#include <QHash>
+#include <QSet>
+#include <QList>
+
+#include "timeline/clip.h"
+#include "project/footage.h"
+
+/**
+ * @brief Rasterizes clip waveforms and thumbnails for the timeline on worker threads
+ *
+ * Drawing a waveform means reading through the audio preview for every pixel column, and drawing a thumbnail means
+ * scaling the video preview. Both used to happen on the GUI thread for every visible clip on every repaint.
+ *
+ * TimelineWidget asks the rasterizer for the finished images instead. If an image isn't ready yet, a job is queued on
+ * the rasterizer's own thread pool and a null image is returned. ImagesReady() is emitted once the job is done so the
+ * widget can redraw. Finished images are kept up to a limit and shared by every clip showing the same part of the same
+ * media at the same size.
+ */
+class TimelineRasterizer : public QObject {
+  Q_OBJECT
+public:
+  TimelineRasterizer(QObject* parent = nullptr);
+  virtual ~TimelineRasterizer() override;
+
+  /**
+   * @brief Get part of a clip's waveform
+   *
+   * Takes the same parameters as draw_waveform(). The image covers columns `waveform_start` to `waveform_limit` of the
+   * clip and is `height` pixels tall.
+   *
+   * @return The waveform, or a null image if it's still being rasterized.
+   */
+  QImage GetWaveform(ClipPtr clip,
+                     const FootageStream* ms,
+                     long media_length,
+                     int height,
+                     int waveform_start,
+                     int waveform_limit,
+                     double zoom,
+                     qreal dpr);
+
+  /**
+   * @brief Get a video preview scaled to `size`
+   *
+   * @return The scaled preview, or a null image if it's still being scaled.
+   */
+  QImage GetThumbnail(const QImage& preview, const QSize& size, qreal dpr);
+
+signals:
+  /**
+   * @brief Emitted when an image requested earlier has finished rasterizing
+   */
+  void ImagesReady();
+
+private slots:
+  /**
+   * @brief Receives finished images from the worker threads
+   */
+  void StoreImage(const QString& key, const QImage& image);
+
+private:
+  /**
+   * @brief Returns the finished image for `key`, or a null image if a job for it needs to be queued
+   */
+  QImage Find(const QString& key, bool* queue);
+
+  QThreadPool pool_;
+
+  QHash<QString, QImage> images_;
+  QSet<QString> pending_;
+
+  /**
+   * @brief Keys of images_ in the order they were finished, used to drop the oldest ones
+   */
+  QList<QString> order_;
+};
+
+#endif // TIMELINERASTERIZER_H
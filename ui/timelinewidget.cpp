@@ -57,10 +57,17 @@
 #include "global/debug.h"
 #include "effects/effect.h"
 #include "effects/internal/solideffect.h"
+#include "project/filmstrip.h"
 
 #define MAX_TEXT_WIDTH 20
 #define TRANSITION_BETWEEN_RANGE 40
 
+// width of one cached tile of clips (in pixels)
+const int kTileWidth = 256;
+
+// maximum number of tiles kept across all tracks and zoom levels
+const int kMaxTiles = 512;
+
 TimelineWidget::TimelineWidget(QWidget *parent) : QWidget(parent) {
   selection_command = nullptr;
   self_created_sequence = nullptr;
@@ -77,6 +84,10 @@ TimelineWidget::TimelineWidget(QWidget *parent) : QWidget(parent) {
 
   tooltip_timer.setInterval(500);
   connect(&tooltip_timer, SIGNAL(timeout()), this, SLOT(tooltip_timer_timeout()));
+
+  tile_clock_ = 0;
+  connect(&rasterizer_, SIGNAL(ImagesReady()), this, SLOT(rasterizer_images_ready()));
+  connect(&olive::filmstrip_generator, SIGNAL(FilmstripReady()), this, SLOT(rasterizer_images_ready()));
 }
 
 void TimelineWidget::show_context_menu(const QPoint& pos) {
@@ -2812,43 +2823,73 @@ void TimelineWidget::leaveEvent(QEvent*) {
 }
 
 void draw_waveform(ClipPtr clip, const FootageStream* ms, long media_length, QPainter *p, const QRect& clip_rect, int waveform_start, int waveform_limit, double zoom) {
+  draw_waveform(ms->audio_preview,
+                ms->audio_channels,
+                clip->clip_in(),
+                clip->reversed(),
+                media_length,
+                p,
+                clip_rect,
+                waveform_start,
+                waveform_limit,
+                zoom,
+                olive::CurrentConfig.rectified_waveforms);
+}
+
+void draw_waveform(const QVector<char>& preview,
+                   int channels,
+                   long clip_in,
+                   bool reversed,
+                   long media_length,
+                   QPainter* p,
+                   const QRect& clip_rect,
+                   int waveform_start,
+                   int waveform_limit,
+                   double zoom,
+                   bool rectified) {
   // audio channels multiplied by the number of bytes in a 16-bit audio sample
-  int divider = ms->audio_channels*2;
+  int divider = channels*2;
 
-  int channel_height = clip_rect.height()/ms->audio_channels;
+  int channel_height = clip_rect.height()/channels;
 
   int last_waveform_index = -1;
 
-  for (int i=waveform_start;i<waveform_limit;i++) {
-    int waveform_index = qFloor((((clip->clip_in() + (double(i)/zoom))/media_length) * ms->audio_preview.size())/divider)*divider;
+  // start a column early so the first column covers the same range it would if the waveform was drawn from the start
+  for (int i=qMax(0, waveform_start-1);i<waveform_limit;i++) {
+    int waveform_index = qFloor((((clip_in + (double(i)/zoom))/media_length) * preview.size())/divider)*divider;
 
-    if (clip->reversed()) {
-      waveform_index = ms->audio_preview.size() - waveform_index - (ms->audio_channels * 2);
+    if (reversed) {
+      waveform_index = preview.size() - waveform_index - (channels * 2);
     }
 
     if (last_waveform_index < 0) last_waveform_index = waveform_index;
 
-    for (int j=0;j<ms->audio_channels;j++) {
-      int mid = (olive::CurrentConfig.rectified_waveforms) ? clip_rect.top()+channel_height*(j+1) : clip_rect.top()+channel_height*j+(channel_height/2);
+    if (i < waveform_start) {
+      last_waveform_index = waveform_index;
+      continue;
+    }
+
+    for (int j=0;j<channels;j++) {
+      int mid = (rectified) ? clip_rect.top()+channel_height*(j+1) : clip_rect.top()+channel_height*j+(channel_height/2);
 
       int offset_range_start = last_waveform_index+(j*2);
       int offset_range_end = waveform_index+(j*2);
       int offset_range_min = qMin(offset_range_start, offset_range_end);
       int offset_range_max = qMax(offset_range_start, offset_range_end);
 
-      qint8 min = qint8(qRound(double(ms->audio_preview.at(offset_range_min)) / 128.0 * (channel_height/2)));
-      qint8 max = qint8(qRound(double(ms->audio_preview.at(offset_range_min+1)) / 128.0 * (channel_height/2)));
+      qint8 min = qint8(qRound(double(preview.at(offset_range_min)) / 128.0 * (channel_height/2)));
+      qint8 max = qint8(qRound(double(preview.at(offset_range_min+1)) / 128.0 * (channel_height/2)));
 
-      if ((offset_range_max + 1) < ms->audio_preview.size()) {
+      if ((offset_range_max + 1) < preview.size()) {
 
         // for waveform drawings, we get the maximum below 0 and maximum above 0 for this waveform range
         for (int k=offset_range_min+2;k<=offset_range_max;k+=2) {
-          min = qMin(min, qint8(qRound(double(ms->audio_preview.at(k)) / 128.0 * (channel_height/2))));
-          max = qMax(max, qint8(qRound(double(ms->audio_preview.at(k+1)) / 128.0 * (channel_height/2))));
+          min = qMin(min, qint8(qRound(double(preview.at(k)) / 128.0 * (channel_height/2))));
+          max = qMax(max, qint8(qRound(double(preview.at(k+1)) / 128.0 * (channel_height/2))));
         }
 
         // draw waveforms
-        if (olive::CurrentConfig.rectified_waveforms)  {
+        if (rectified)  {
 
           // rectified waveforms start from the bottom and draw upwards
           p->drawLine(clip_rect.left()+i, mid, clip_rect.left()+i, mid - (max - min));
@@ -2914,7 +2955,520 @@ void draw_transition(QPainter& p, ClipPtr c, const QRect& clip_rect, QRect& text
 
 }
 
-void TimelineWidget::paintEvent(QPaintEvent*) {
+void hash_combine(uint& seed, uint value) {
+  seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+uint clip_paint_hash(ClipPtr clip) {
+  // everything draw_clip() reads from the clip
+  uint hash = qHash(clip.get());
+  hash_combine(hash, qHash(qint64(clip->timeline_in())));
+  hash_combine(hash, qHash(qint64(clip->timeline_out())));
+  hash_combine(hash, qHash(qint64(clip->clip_in())));
+  hash_combine(hash, qHash(qint64(clip->media_length())));
+  hash_combine(hash, qHash(clip->enabled()));
+  hash_combine(hash, qHash(clip->color().rgba()));
+  hash_combine(hash, qHash(clip->name()));
+  hash_combine(hash, qHash(clip->speed().value));
+  hash_combine(hash, qHash(clip->reversed()));
+  hash_combine(hash, qHash(clip->linked.size()));
+  hash_combine(hash, qHash(clip->media()));
+
+  FootageStream* ms = clip->media_stream();
+  hash_combine(hash, qHash(ms));
+  if (ms != nullptr) {
+    hash_combine(hash, qHash(ms->preview_done));
+    hash_combine(hash, qHash(ms->infinite_length));
+    hash_combine(hash, qHash(ms->video_preview.cacheKey()));
+    hash_combine(hash, qHash(quintptr(ms->audio_preview.constData())));
+  }
+
+  TransitionPtr transitions[2] = {clip->opening_transition, clip->closing_transition};
+  for (int i=0;i<2;i++) {
+    hash_combine(hash, qHash(transitions[i].get()));
+    if (transitions[i] != nullptr) {
+      hash_combine(hash, qHash(qint64(transitions[i]->get_true_length())));
+      hash_combine(hash, qHash(transitions[i]->secondary_clip != nullptr));
+    }
+  }
+
+  for (int i=0;i<clip->get_markers().size();i++) {
+    hash_combine(hash, qHash(qint64(clip->get_markers().at(i).frame)));
+  }
+
+  hash_combine(hash, qHash(olive::CurrentConfig.rectified_waveforms));
+
+  return hash;
+}
+
+QRect TimelineWidget::get_clip_rect(ClipPtr clip) {
+  return QRect(panel_timeline->getTimelineScreenPointFromFrame(clip->timeline_in()),
+               getScreenPointFromTrack(clip->track()),
+               getScreenPointFromFrame(panel_timeline->zoom, clip->length()),
+               panel_timeline->GetTrackHeight(clip->track()));
+}
+
+QRect TimelineWidget::get_playhead_rect() {
+  // covers the playhead line and the single frame highlight next to it
+  int playhead_x = panel_timeline->getTimelineScreenPointFromFrame(olive::ActiveSequence->playhead);
+  int playhead_frame_width = panel_timeline->getTimelineScreenPointFromFrame(olive::ActiveSequence->playhead+1) - playhead_x;
+  return QRect(playhead_x - 1, 0, qMax(playhead_frame_width, 1) + 2, height());
+}
+
+bool TimelineWidget::draw_clip(QPainter &p, ClipPtr clip, const QRect& clip_rect, const QRect& bounds) {
+  // clips may be drawn across several tiles, so anything that affects layout (e.g. the text position) must only depend
+  // on clip_rect and never on bounds, which is only used to skip drawing what's out of view
+  int bound_left = bounds.x();
+  int bound_right = bounds.x() + bounds.width();
+  int bound_top = bounds.y();
+  int bound_bottom = bounds.y() + bounds.height();
+
+  if (clip_rect.left() >= bound_right || clip_rect.right() < bound_left || clip_rect.top() >= bound_bottom || clip_rect.bottom() < bound_top) {
+    return true;
+  }
+
+  bool complete = true;
+
+  // offset between timeline coordinates and the coordinates being drawn in
+  int x_origin = getScreenPointFromFrame(panel_timeline->zoom, clip->timeline_in()) - clip_rect.x();
+
+  QRect text_rect(clip_rect.left() + olive::timeline::kClipTextPadding, clip_rect.top() + olive::timeline::kClipTextPadding, clip_rect.width() - olive::timeline::kClipTextPadding - 1, clip_rect.height() - olive::timeline::kClipTextPadding - 1);
+
+  p.fillRect(clip_rect.intersected(bounds), (clip->enabled()) ? clip->color() : QColor(96, 96, 96));
+
+  int thumb_x = clip_rect.x() + 1;
+
+  if (clip->media() != nullptr && clip->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
+    bool draw_checkerboard = false;
+    QRect checkerboard_rect(clip_rect);
+    FootageStream* ms = clip->media_stream();
+    if (ms == nullptr) {
+      draw_checkerboard = true;
+    } else if (ms->preview_done) {
+      // draw top and tail triangles
+      int triangle_size = olive::timeline::kTrackMinHeight >> 2;
+      if (!ms->infinite_length && clip_rect.width() > triangle_size) {
+        p.setPen(Qt::NoPen);
+        p.setBrush(QColor(80, 80, 80));
+        if (clip->clip_in() == 0) {
+          const QPoint points[3] = {
+            QPoint(clip_rect.x(), clip_rect.y()),
+            QPoint(clip_rect.x() + triangle_size, clip_rect.y()),
+            QPoint(clip_rect.x(), clip_rect.y() + triangle_size)
+          };
+          p.drawPolygon(points, 3);
+          text_rect.setLeft(text_rect.left() + (triangle_size >> 2));
+        }
+        if (clip->timeline_out() - clip->timeline_in() + clip->clip_in() == clip->media_length()) {
+          const QPoint points[3] = {
+            QPoint(clip_rect.right(), clip_rect.y()),
+            QPoint(clip_rect.right() - triangle_size, clip_rect.y()),
+            QPoint(clip_rect.right(), clip_rect.y() + triangle_size)
+          };
+          p.drawPolygon(points, 3);
+          text_rect.setRight(text_rect.right() - (triangle_size >> 2));
+        }
+      }
+
+      p.setBrush(Qt::NoBrush);
+
+      // draw thumbnail/waveform
+      long media_length = clip->media_length();
+
+      if (clip->track() < 0) {
+        // draw thumbnail
+        int thumb_y = p.fontMetrics().height()+olive::timeline::kClipTextPadding+olive::timeline::kClipTextPadding;
+        if (thumb_x < bound_right && thumb_y < clip_rect.height()) {
+          int space_for_thumb = clip_rect.width()-1;
+          if (clip->opening_transition != nullptr) {
+            int ot_width = getScreenPointFromFrame(panel_timeline->zoom, clip->opening_transition->get_true_length());
+            thumb_x += ot_width;
+            space_for_thumb -= ot_width;
+          }
+          if (clip->closing_transition != nullptr) {
+            space_for_thumb -= getScreenPointFromFrame(panel_timeline->zoom, clip->closing_transition->get_true_length());
+          }
+          int thumb_height = clip_rect.height()-thumb_y;
+          int thumb_width = qRound(thumb_height*(double(ms->video_preview.width())/double(ms->video_preview.height())));
+          if (thumb_x + thumb_width >= bound_left
+              && thumb_height > thumb_y
+              && thumb_y + thumb_height >= 0
+              && space_for_thumb > MAX_TEXT_WIDTH) {
+            if (!ms->infinite_length && space_for_thumb >= thumb_width * 2) {
+              // there's room for several thumbnails, show a filmstrip of the clip instead of repeating the poster frame
+              if (!draw_filmstrip(p,
+                                  clip,
+                                  ms,
+                                  clip_rect.x(),
+                                  QRect(thumb_x, clip_rect.y()+thumb_y, space_for_thumb, thumb_height),
+                                  thumb_width,
+                                  bounds)) {
+                complete = false;
+              }
+            } else {
+              int thumb_clip_width = qMin(thumb_width, space_for_thumb);
+
+              // scaling the thumbnail happens on the rasterizer's threads, until it's done the clip is drawn without it
+              QImage thumb = rasterizer_.GetThumbnail(ms->video_preview, QSize(thumb_width, thumb_height), devicePixelRatioF());
+              if (thumb.isNull()) {
+                complete = false;
+              } else {
+                p.drawImage(QRect(thumb_x,
+                                  clip_rect.y()+thumb_y,
+                                  thumb_clip_width,
+                                  thumb_height),
+                            thumb,
+                            QRect(0,
+                                  0,
+                                  qRound(thumb_clip_width*thumb.devicePixelRatio()),
+                                  thumb.height()
+                                  )
+                            );
+              }
+            }
+            }
+          }
+        }
+        if (clip->timeline_out() - clip->timeline_in() + clip->clip_in() > clip->media_length()) {
+          draw_checkerboard = true;
+          checkerboard_rect.setLeft(getScreenPointFromFrame(panel_timeline->zoom, clip->media_length() + clip->timeline_in() - clip->clip_in()) - x_origin);
+        }
+      } else if (clip_rect.height() > olive::timeline::kTrackMinHeight) {
+        // draw waveform
+        int media_limit = qMin(clip_rect.width(), getScreenPointFromFrame(panel_timeline->zoom, media_length - clip->clip_in()));
+
+        if (media_limit < clip_rect.width()) {
+          draw_checkerboard = true;
+          if (media_limit > 0) checkerboard_rect.setLeft(checkerboard_rect.left() + media_limit);
+        }
+
+        // only the part of the waveform inside bounds is rasterized
+        int waveform_start = qMax(0, bound_left - clip_rect.x());
+        int waveform_limit = qMin(media_limit, bound_right - clip_rect.x());
+
+        if (waveform_start < waveform_limit) {
+          QImage waveform = rasterizer_.GetWaveform(clip,
+                                                    ms,
+                                                    media_length,
+                                                    clip_rect.height(),
+                                                    waveform_start,
+                                                    waveform_limit,
+                                                    panel_timeline->zoom,
+                                                    devicePixelRatioF());
+          if (waveform.isNull()) {
+            complete = false;
+          } else {
+            p.drawImage(clip_rect.x() + waveform_start, clip_rect.y(), waveform);
+          }
+        }
+      }
+    }
+    if (draw_checkerboard && checkerboard_rect.left() < bound_right && checkerboard_rect.right() >= bound_left) {
+      // draw "error lines" if media stream is missing
+      p.setPen(QPen(QColor(64, 64, 64), 2));
+      int limit = qMin(checkerboard_rect.width(), bound_right + 1 - checkerboard_rect.left());
+      int clip_height = checkerboard_rect.height();
+
+      // skip lines that are entirely before bounds, but keep the same spacing as if they were drawn
+      int first_line = -clip_height;
+      int first_visible_line = bound_left - checkerboard_rect.left() - clip_height;
+      if (first_visible_line > first_line) {
+        first_line += ((first_visible_line - first_line) / 15) * 15;
+      }
+
+      for (int j=first_line;j<limit;j+=15) {
+        int lines_start_x = checkerboard_rect.left()+j;
+        int lines_start_y = checkerboard_rect.bottom();
+        int lines_end_x = lines_start_x + clip_height;
+        int lines_end_y = checkerboard_rect.top();
+        if (lines_start_x < checkerboard_rect.left()) {
+          lines_start_y -= (checkerboard_rect.left() - lines_start_x);
+          lines_start_x = checkerboard_rect.left();
+        }
+        if (lines_end_x > checkerboard_rect.right()) {
+          lines_end_y -= (checkerboard_rect.right() - lines_end_x);
+          lines_end_x = checkerboard_rect.right();
+        }
+        p.drawLine(lines_start_x, lines_start_y, lines_end_x, lines_end_y);
+      }
+    }
+  }
+
+  // draw clip markers
+  for (int j=0;j<clip->get_markers().size();j++) {
+    const Marker& m = clip->get_markers().at(j);
+
+    // convert marker time (in clip time) to sequence time
+    long marker_time = m.frame + clip->timeline_in() - clip->clip_in();
+    int marker_x = getScreenPointFromFrame(panel_timeline->zoom, marker_time) - x_origin;
+    if (marker_x > clip_rect.x() && marker_x < clip_rect.right()) {
+      draw_marker(p, marker_x, clip_rect.bottom()-p.fontMetrics().height(), clip_rect.bottom(), false);
+    }
+  }
+  p.setBrush(Qt::NoBrush);
+
+  // draw clip transitions
+  draw_transition(p, clip, clip_rect, text_rect, kTransitionOpening);
+  draw_transition(p, clip, clip_rect, text_rect, kTransitionClosing);
+
+  // top left bevel
+  p.setPen(Qt::white);
+  if (clip_rect.x() >= bound_left && clip_rect.x() < bound_right) p.drawLine(clip_rect.bottomLeft(), clip_rect.topLeft());
+  if (clip_rect.y() >= bound_top && clip_rect.y() < bound_bottom) p.drawLine(QPoint(qMax(bound_left, clip_rect.left()), clip_rect.top()), QPoint(qMin(bound_right, clip_rect.right()), clip_rect.top()));
+
+  // draw text
+  if (text_rect.width() > MAX_TEXT_WIDTH && text_rect.right() > bound_left && text_rect.left() < bound_right) {
+    if (!clip->enabled()) {
+      p.setPen(Qt::gray);
+    } else if (clip->color().lightness() > 160) {
+      // set to black if color is bright
+      p.setPen(Qt::black);
+    }
+    if (clip->linked.size() > 0) {
+      int underline_y = olive::timeline::kClipTextPadding + p.fontMetrics().height() + clip_rect.top();
+        int underline_width = qMin(text_rect.width() - 1, p.fontMetrics().width(clip->name()));
+      p.drawLine(text_rect.x(), underline_y, text_rect.x() + underline_width, underline_y);
+    }
+    QString name = clip->name();
+    if (clip->speed().value != 1.0 || clip->reversed()) {
+      name += " (";
+      if (clip->reversed()) name += "-";
+      name += QString::number(clip->speed().value*100) + "%)";
+    }
+    p.drawText(text_rect, 0, name, &text_rect);
+  }
+
+  // bottom right gray
+  p.setPen(QColor(0, 0, 0, 128));
+  if (clip_rect.right() >= bound_left && clip_rect.right() < bound_right) p.drawLine(clip_rect.bottomRight(), clip_rect.topRight());
+  if (clip_rect.bottom() >= bound_top && clip_rect.bottom() < bound_bottom) p.drawLine(QPoint(qMax(bound_left, clip_rect.left()), clip_rect.bottom()), QPoint(qMin(bound_right, clip_rect.right()), clip_rect.bottom()));
+
+  return complete;
+}
+
+bool TimelineWidget::draw_filmstrip(QPainter &p, ClipPtr clip, FootageStream* ms, int clip_x, const QRect &strip_rect, int thumb_width, const QRect &bounds) {
+  double zoom = panel_timeline->zoom;
+
+  // clip frames are in the sequence's frame rate adjusted for the clip's speed
+  double media_frame_rate = clip->sequence->frame_rate / clip->speed().value;
+
+  int level = FilmstripGenerator::LevelForScale(zoom * media_frame_rate, thumb_width);
+  double interval = FilmstripGenerator::LevelInterval(level);
+
+  const QString& url = clip->media()->to_footage()->url;
+  long media_length = clip->media_length();
+
+  bool complete = true;
+
+  int strip_right = strip_rect.x() + strip_rect.width();
+  int bound_right = bounds.x() + bounds.width();
+
+  // thumbnails are always laid out from the left of strip_rect, but the ones left of bounds are skipped
+  int first = qMax(0, (bounds.x() - strip_rect.x()) / thumb_width);
+
+  for (int x=strip_rect.x()+first*thumb_width;x<strip_right && x<bound_right;x+=thumb_width) {
+    long media_frame = clip->clip_in() + qFloor(double(x - clip_x) / zoom);
+    if (clip->reversed()) {
+      media_frame = media_length - media_frame - 1;
+    }
+    if (media_frame < 0 || media_frame >= media_length) {
+      continue;
+    }
+
+    int index = qFloor(double(media_frame) / media_frame_rate / interval);
+
+    bool pending;
+    QImage thumb = olive::filmstrip_generator.GetThumbnail(url, ms->file_index, level, index, &pending);
+
+    if (thumb.isNull() && !pending) {
+      // no filmstrip can be made for this footage, repeat the poster frame instead
+      thumb = rasterizer_.GetThumbnail(ms->video_preview, QSize(thumb_width, strip_rect.height()), devicePixelRatioF());
+      pending = thumb.isNull();
+    }
+
+    if (thumb.isNull()) {
+      if (pending) {
+        complete = false;
+      }
+      continue;
+    }
+
+    int width = qMin(thumb_width, strip_right - x);
+
+    p.drawImage(QRect(x, strip_rect.y(), width, strip_rect.height()),
+                thumb,
+                QRect(0, 0, qRound(width * double(thumb.width()) / double(thumb_width)), thumb.height()));
+  }
+
+  return complete;
+}
+
+void TimelineWidget::draw_clip_tiles(QPainter &p, const QRect &dirty_rect) {
+  double zoom = panel_timeline->zoom;
+
+  // tiles are laid out in unscrolled timeline coordinates, so scrolling only changes where they're drawn
+  int scroll_x = -panel_timeline->getTimelineScreenPointFromFrame(0);
+
+  int first_tile = qFloor(double(scroll_x + dirty_rect.left()) / kTileWidth);
+  int last_tile = qFloor(double(scroll_x + dirty_rect.right()) / kTileWidth);
+  int tile_count = last_tile - first_tile + 1;
+
+  // collect the clips in view per track and combine everything that affects how they're drawn into a signature per
+  // tile, so a tile is only redrawn when a clip inside it changes
+  QMap<int, QVector<ClipPtr> > track_clips;
+  QMap<int, QVector<TileSignature> > signatures;
+
+  for (int i=0;i<olive::ActiveSequence->clips.size();i++) {
+    ClipPtr clip = olive::ActiveSequence->clips.at(i);
+    if (clip == nullptr || !is_track_visible(clip->track())) {
+      continue;
+    }
+
+    int clip_left = getScreenPointFromFrame(zoom, clip->timeline_in());
+    int clip_right = clip_left + getScreenPointFromFrame(zoom, clip->length());
+    int clip_first_tile = qMax(first_tile, qFloor(double(clip_left) / kTileWidth));
+    int clip_last_tile = qMin(last_tile, qFloor(double(clip_right) / kTileWidth));
+
+    if (clip_first_tile > clip_last_tile) {
+      continue;
+    }
+
+    track_clips[clip->track()].append(clip);
+
+    QVector<TileSignature>& track_signatures = signatures[clip->track()];
+    if (track_signatures.isEmpty()) {
+      track_signatures.resize(tile_count);
+    }
+
+    uint hash = clip_paint_hash(clip);
+    for (int j=clip_first_tile;j<=clip_last_tile;j++) {
+      TileSignature& sig = track_signatures[j - first_tile];
+      hash_combine(sig.hash, hash);
+      sig.clips++;
+    }
+  }
+
+  qreal dpr = devicePixelRatioF();
+
+  QMap<int, QVector<ClipPtr> >::const_iterator i;
+  for (i=track_clips.constBegin();i!=track_clips.constEnd();i++) {
+    int track = i.key();
+    int track_y = getScreenPointFromTrack(track);
+    int track_height = panel_timeline->GetTrackHeight(track);
+
+    if (track_y > dirty_rect.bottom() || track_y + track_height <= dirty_rect.top()) {
+      continue;
+    }
+
+    const QVector<TileSignature>& track_signatures = signatures[track];
+
+    for (int j=first_tile;j<=last_tile;j++) {
+      const TileSignature& sig = track_signatures.at(j - first_tile);
+      if (sig.clips == 0) {
+        continue;
+      }
+
+      TileKey key;
+      key.sequence = olive::ActiveSequence.get();
+      key.track = track;
+      key.zoom = zoom;
+      key.index = j;
+      key.height = track_height;
+
+      Tile& tile = tiles_[key];
+
+      if (tile.pixmap.isNull()
+          || tile.signature != sig.hash
+          || tile.pixmap.devicePixelRatio() != dpr) {
+        int tile_x = j*kTileWidth;
+
+        tile.signature = sig.hash;
+        tile.complete = true;
+
+        tile.pixmap = QPixmap(qCeil(kTileWidth*dpr), qCeil(track_height*dpr));
+        tile.pixmap.setDevicePixelRatio(dpr);
+        tile.pixmap.fill(Qt::transparent);
+
+        QPainter tile_painter(&tile.pixmap);
+        tile_painter.setFont(font());
+        tile_painter.setPen(p.pen());
+        tile_painter.translate(-tile_x, 0);
+
+        QRect bounds(tile_x, 0, kTileWidth, track_height);
+
+        const QVector<ClipPtr>& clips = i.value();
+        for (int k=0;k<clips.size();k++) {
+          QRect clip_rect(getScreenPointFromFrame(zoom, clips.at(k)->timeline_in()),
+                          0,
+                          getScreenPointFromFrame(zoom, clips.at(k)->length()),
+                          track_height);
+
+          if (!draw_clip(tile_painter, clips.at(k), clip_rect, bounds)) {
+            tile.complete = false;
+          }
+        }
+      }
+
+      tile.last_used = ++tile_clock_;
+
+      p.drawPixmap(j*kTileWidth - scroll_x, track_y, tile.pixmap);
+    }
+  }
+
+  // drop the tiles that have gone the longest without being drawn, e.g. ones from older zoom levels
+  if (tiles_.size() > kMaxTiles) {
+    QMap<TileKey, Tile>::iterator t = tiles_.begin();
+    while (t != tiles_.end()) {
+      if (t.value().last_used + kMaxTiles <= tile_clock_) {
+        t = tiles_.erase(t);
+      } else {
+        t++;
+      }
+    }
+  }
+}
+
+void TimelineWidget::rasterizer_images_ready() {
+  // redraw every tile that was drawn while some of its images were still being rasterized
+  QMap<TileKey, Tile>::iterator i;
+  for (i=tiles_.begin();i!=tiles_.end();i++) {
+    if (!i.value().complete) {
+      i.value().pixmap = QPixmap();
+    }
+  }
+
+  update();
+}
+
+bool TimelineWidget::TileKey::operator<(const TimelineWidget::TileKey &rhs) const {
+  if (sequence != rhs.sequence) {
+    return sequence < rhs.sequence;
+  }
+  if (track != rhs.track) {
+    return track < rhs.track;
+  }
+  if (zoom != rhs.zoom) {
+    return zoom < rhs.zoom;
+  }
+  if (height != rhs.height) {
+    return height < rhs.height;
+  }
+  return index < rhs.index;
+}
+
+void TimelineWidget::update_playhead() {
+  if (olive::ActiveSequence == nullptr) {
+    return;
+  }
+
+  // repaint only the strip between where the playhead was last drawn and where it is now
+  QRect new_playhead_rect = get_playhead_rect();
+  if (new_playhead_rect != playhead_rect_) {
+    update(playhead_rect_.united(new_playhead_rect));
+  }
+}
+
+void TimelineWidget::paintEvent(QPaintEvent* e) {
   // Draw clips
   if (olive::ActiveSequence != nullptr) {
     QPainter p(this);
@@ -2949,239 +3503,52 @@ void TimelineWidget::paintEvent(QPaintEvent*) {
       scrollBar->setMaximum(qMax(0, panel_height - height()));
     }
 
-    for (int i=0;i<olive::ActiveSequence->clips.size();i++) {
-      ClipPtr clip = olive::ActiveSequence->clips.at(i);
-      if (clip != nullptr && is_track_visible(clip->track())) {
-        QRect clip_rect(panel_timeline->getTimelineScreenPointFromFrame(clip->timeline_in()), getScreenPointFromTrack(clip->track()), getScreenPointFromFrame(panel_timeline->zoom, clip->length()), panel_timeline->GetTrackHeight(clip->track()));
-        QRect text_rect(clip_rect.left() + olive::timeline::kClipTextPadding, clip_rect.top() + olive::timeline::kClipTextPadding, clip_rect.width() - olive::timeline::kClipTextPadding - 1, clip_rect.height() - olive::timeline::kClipTextPadding - 1);
-        if (clip_rect.left() < width() && clip_rect.right() >= 0 && clip_rect.top() < height() && clip_rect.bottom() >= 0) {
-          QRect actual_clip_rect = clip_rect;
-          if (actual_clip_rect.x() < 0) actual_clip_rect.setX(0);
-          if (actual_clip_rect.right() > width()) actual_clip_rect.setRight(width());
-          if (actual_clip_rect.y() < 0) actual_clip_rect.setY(0);
-          if (actual_clip_rect.bottom() > height()) actual_clip_rect.setBottom(height());
-          p.fillRect(actual_clip_rect, (clip->enabled()) ? clip->color() : QColor(96, 96, 96));
-
-          int thumb_x = clip_rect.x() + 1;
-
-          if (clip->media() != nullptr && clip->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
-            bool draw_checkerboard = false;
-            QRect checkerboard_rect(clip_rect);
-            FootageStream* ms = clip->media_stream();
-            if (ms == nullptr) {
-              draw_checkerboard = true;
-            } else if (ms->preview_done) {
-              // draw top and tail triangles
-              int triangle_size = olive::timeline::kTrackMinHeight >> 2;
-              if (!ms->infinite_length && clip_rect.width() > triangle_size) {
-                p.setPen(Qt::NoPen);
-                p.setBrush(QColor(80, 80, 80));
-                if (clip->clip_in() == 0
-                    && clip_rect.x() + triangle_size > 0
-                    && clip_rect.y() + triangle_size > 0
-                    && clip_rect.x() < width()
-                    && clip_rect.y() < height()) {
-                  const QPoint points[3] = {
-                    QPoint(clip_rect.x(), clip_rect.y()),
-                    QPoint(clip_rect.x() + triangle_size, clip_rect.y()),
-                    QPoint(clip_rect.x(), clip_rect.y() + triangle_size)
-                  };
-                  p.drawPolygon(points, 3);
-                  text_rect.setLeft(text_rect.left() + (triangle_size >> 2));
-                }
-                if (clip->timeline_out() - clip->timeline_in() + clip->clip_in() == clip->media_length()
-                    && clip_rect.right() - triangle_size < width()
-                    && clip_rect.y() + triangle_size > 0
-                    && clip_rect.right() > 0
-                    && clip_rect.y() < height()) {
-                  const QPoint points[3] = {
-                    QPoint(clip_rect.right(), clip_rect.y()),
-                    QPoint(clip_rect.right() - triangle_size, clip_rect.y()),
-                    QPoint(clip_rect.right(), clip_rect.y() + triangle_size)
-                  };
-                  p.drawPolygon(points, 3);
-                  text_rect.setRight(text_rect.right() - (triangle_size >> 2));
-                }
-              }
+    // Draw clips
+    draw_clip_tiles(p, e->rect());
 
-              p.setBrush(Qt::NoBrush);
+    // Draw transition tool
+    if (panel_timeline->tool == TIMELINE_TOOL_TRANSITION) {
 
-              // draw thumbnail/waveform
-              long media_length = clip->media_length();
+      bool shared_transition = (panel_timeline->transition_tool_open_clip > -1
+                                && panel_timeline->transition_tool_close_clip > -1);
 
-              if (clip->track() < 0) {
-                // draw thumbnail
-                int thumb_y = p.fontMetrics().height()+olive::timeline::kClipTextPadding+olive::timeline::kClipTextPadding;
-                if (thumb_x < width() && thumb_y < height()) {
-                  int space_for_thumb = clip_rect.width()-1;
-                  if (clip->opening_transition != nullptr) {
-                    int ot_width = getScreenPointFromFrame(panel_timeline->zoom, clip->opening_transition->get_true_length());
-                    thumb_x += ot_width;
-                    space_for_thumb -= ot_width;
-                  }
-                  if (clip->closing_transition != nullptr) {
-                    space_for_thumb -= getScreenPointFromFrame(panel_timeline->zoom, clip->closing_transition->get_true_length());
-                  }
-                  int thumb_height = clip_rect.height()-thumb_y;
-                  int thumb_width = qRound(thumb_height*(double(ms->video_preview.width())/double(ms->video_preview.height())));
-                  if (thumb_x + thumb_width >= 0
-                      && thumb_height > thumb_y
-                      && thumb_y + thumb_height >= 0
-                      && space_for_thumb > MAX_TEXT_WIDTH) {
-                    int thumb_clip_width = qMin(thumb_width, space_for_thumb);
-                    p.drawImage(QRect(thumb_x,
-                                      clip_rect.y()+thumb_y,
-                                      thumb_clip_width,
-                                      thumb_height),
-                                ms->video_preview,
-                                QRect(0,
-                                      0,
-                                      qRound(thumb_clip_width*(double(ms->video_preview.width())/double(thumb_width))),
-                                      ms->video_preview.height()
-                                      )
-                                );
-                  }
-                }
-                if (clip->timeline_out() - clip->timeline_in() + clip->clip_in() > clip->media_length()) {
-                  draw_checkerboard = true;
-                  checkerboard_rect.setLeft(panel_timeline->getTimelineScreenPointFromFrame(clip->media_length() + clip->timeline_in() - clip->clip_in()));
-                }
-              } else if (clip_rect.height() > olive::timeline::kTrackMinHeight) {
-                // draw waveform
-                p.setPen(QColor(80, 80, 80));
-
-                int waveform_start = -qMin(clip_rect.x(), 0);
-                int waveform_limit = qMin(clip_rect.width(), getScreenPointFromFrame(panel_timeline->zoom, media_length - clip->clip_in()));
-
-                if ((clip_rect.x() + waveform_limit) > width()) {
-                  waveform_limit -= (clip_rect.x() + waveform_limit - width());
-                } else if (waveform_limit < clip_rect.width()) {
-                  draw_checkerboard = true;
-                  if (waveform_limit > 0) checkerboard_rect.setLeft(checkerboard_rect.left() + waveform_limit);
-                }
-
-                draw_waveform(clip, ms, media_length, &p, clip_rect, waveform_start, waveform_limit, panel_timeline->zoom);
-              }
-            }
-            if (draw_checkerboard) {
-              checkerboard_rect.setLeft(qMax(checkerboard_rect.left(), 0));
-              checkerboard_rect.setRight(qMin(checkerboard_rect.right(), width()));
-              checkerboard_rect.setTop(qMax(checkerboard_rect.top(), 0));
-              checkerboard_rect.setBottom(qMin(checkerboard_rect.bottom(), height()));
-
-              if (checkerboard_rect.left() < width()
-                  && checkerboard_rect.right() >= 0
-                  && checkerboard_rect.top() < height()
-                  && checkerboard_rect.bottom() >= 0) {
-                // draw "error lines" if media stream is missing
-                p.setPen(QPen(QColor(64, 64, 64), 2));
-                int limit = checkerboard_rect.width();
-                int clip_height = checkerboard_rect.height();
-                for (int j=-clip_height;j<limit;j+=15) {
-                  int lines_start_x = checkerboard_rect.left()+j;
-                  int lines_start_y = checkerboard_rect.bottom();
-                  int lines_end_x = lines_start_x + clip_height;
-                  int lines_end_y = checkerboard_rect.top();
-                  if (lines_start_x < checkerboard_rect.left()) {
-                    lines_start_y -= (checkerboard_rect.left() - lines_start_x);
-                    lines_start_x = checkerboard_rect.left();
-                  }
-                  if (lines_end_x > checkerboard_rect.right()) {
-                    lines_end_y -= (checkerboard_rect.right() - lines_end_x);
-                    lines_end_x = checkerboard_rect.right();
-                  }
-                  p.drawLine(lines_start_x, lines_start_y, lines_end_x, lines_end_y);
-                }
-              }
-            }
-          }
+      for (int i=0;i<olive::ActiveSequence->clips.size();i++) {
+        ClipPtr clip = olive::ActiveSequence->clips.at(i);
+        if (clip == nullptr || !is_track_visible(clip->track())) {
+          continue;
+        }
 
-          // draw clip markers
-          for (int j=0;j<clip->get_markers().size();j++) {
-            const Marker& m = clip->get_markers().at(j);
+        QRect transition_tool_rect = get_clip_rect(clip);
+        bool draw_transition_tool_rect = false;
 
-            // convert marker time (in clip time) to sequence time
-            long marker_time = m.frame + clip->timeline_in() - clip->clip_in();
-            int marker_x = panel_timeline->getTimelineScreenPointFromFrame(marker_time);
-            if (marker_x > clip_rect.x() && marker_x < clip_rect.right()) {
-              draw_marker(p, marker_x, clip_rect.bottom()-p.fontMetrics().height(), clip_rect.bottom(), false);
-            }
+        if (panel_timeline->transition_tool_open_clip == i) {
+          if (shared_transition) {
+            transition_tool_rect.setWidth(TRANSITION_BETWEEN_RANGE);
+          } else {
+            transition_tool_rect.setWidth(transition_tool_rect.width()>>2);
           }
-          p.setBrush(Qt::NoBrush);
-
-          // draw clip transitions
-          draw_transition(p, clip, clip_rect, text_rect, kTransitionOpening);
-          draw_transition(p, clip, clip_rect, text_rect, kTransitionClosing);
-
-          // top left bevel
-          p.setPen(Qt::white);
-          if (clip_rect.x() >= 0 && clip_rect.x() < width()) p.drawLine(clip_rect.bottomLeft(), clip_rect.topLeft());
-          if (clip_rect.y() >= 0 && clip_rect.y() < height()) p.drawLine(QPoint(qMax(0, clip_rect.left()), clip_rect.top()), QPoint(qMin(width(), clip_rect.right()), clip_rect.top()));
-
-          // draw text
-          if (text_rect.width() > MAX_TEXT_WIDTH && text_rect.right() > 0 && text_rect.left() < width()) {
-            if (!clip->enabled()) {
-              p.setPen(Qt::gray);
-            } else if (clip->color().lightness() > 160) {
-              // set to black if color is bright
-              p.setPen(Qt::black);
-            }
-            if (clip->linked.size() > 0) {
-              int underline_y = olive::timeline::kClipTextPadding + p.fontMetrics().height() + clip_rect.top();
-                int underline_width = qMin(text_rect.width() - 1, p.fontMetrics().width(clip->name()));
-              p.drawLine(text_rect.x(), underline_y, text_rect.x() + underline_width, underline_y);
-            }
-            QString name = clip->name();
-            if (clip->speed().value != 1.0 || clip->reversed()) {
-              name += " (";
-              if (clip->reversed()) name += "-";
-              name += QString::number(clip->speed().value*100) + "%)";
-            }
-            p.drawText(text_rect, 0, name, &text_rect);
+          draw_transition_tool_rect = true;
+        } else if (panel_timeline->transition_tool_close_clip == i) {
+          if (shared_transition) {
+            transition_tool_rect.setLeft(transition_tool_rect.right() - TRANSITION_BETWEEN_RANGE);
+          } else {
+            transition_tool_rect.setLeft(transition_tool_rect.left() + (3*(transition_tool_rect.width()>>2)));
           }
+          draw_transition_tool_rect = true;
+        }
 
-          // bottom right gray
-          p.setPen(QColor(0, 0, 0, 128));
-          if (clip_rect.right() >= 0 && clip_rect.right() < width()) p.drawLine(clip_rect.bottomRight(), clip_rect.topRight());
-          if (clip_rect.bottom() >= 0 && clip_rect.bottom() < height()) p.drawLine(QPoint(qMax(0, clip_rect.left()), clip_rect.bottom()), QPoint(qMin(width(), clip_rect.right()), clip_rect.bottom()));
-
-          // draw transition tool
-          if (panel_timeline->tool == TIMELINE_TOOL_TRANSITION) {
-
-            bool shared_transition = (panel_timeline->transition_tool_open_clip > -1
-                                      && panel_timeline->transition_tool_close_clip > -1);
-
-            QRect transition_tool_rect = clip_rect;
-            bool draw_transition_tool_rect = false;
-
-            if (panel_timeline->transition_tool_open_clip == i) {
-              if (shared_transition) {
-                transition_tool_rect.setWidth(TRANSITION_BETWEEN_RANGE);
-              } else {
-                transition_tool_rect.setWidth(transition_tool_rect.width()>>2);
-              }
-              draw_transition_tool_rect = true;
-            } else if (panel_timeline->transition_tool_close_clip == i) {
-              if (shared_transition) {
-                transition_tool_rect.setLeft(transition_tool_rect.right() - TRANSITION_BETWEEN_RANGE);
-              } else {
-                transition_tool_rect.setLeft(transition_tool_rect.left() + (3*(transition_tool_rect.width()>>2)));
-              }
-              draw_transition_tool_rect = true;
-            }
-
-            if (draw_transition_tool_rect
-                && transition_tool_rect.left() < width()
-                && transition_tool_rect.right() > 0) {
-              if (transition_tool_rect.left() < 0) {
-                transition_tool_rect.setLeft(0);
-              }
-              if (transition_tool_rect.right() > width()) {
-                transition_tool_rect.setRight(width());
-              }
-              p.fillRect(transition_tool_rect, QColor(0, 0, 0, 128));
-            }
+        if (draw_transition_tool_rect
+            && transition_tool_rect.left() < width()
+            && transition_tool_rect.right() > 0
+            && transition_tool_rect.top() < height()
+            && transition_tool_rect.bottom() >= 0) {
+          if (transition_tool_rect.left() < 0) {
+            transition_tool_rect.setLeft(0);
+          }
+          if (transition_tool_rect.right() > width()) {
+            transition_tool_rect.setRight(width());
           }
+          p.fillRect(transition_tool_rect, QColor(0, 0, 0, 128));
         }
       }
     }
@@ -3329,6 +3696,7 @@ void TimelineWidget::paintEvent(QPaintEvent*) {
     p.setPen(Qt::red);
     int playhead_x = panel_timeline->getTimelineScreenPointFromFrame(olive::ActiveSequence->playhead);
     p.drawLine(playhead_x, rect().top(), playhead_x, rect().bottom());
+    playhead_rect_ = get_playhead_rect();
 
     // Draw single frame highlight
     int playhead_frame_width = panel_timeline->getTimelineScreenPointFromFrame(olive::ActiveSequence->playhead+1) - playhead_x;
@@ -27,6 +27,8 @@
 #include <QPainter>
 #include <QApplication>
 #include <QDesktopWidget>
+#include <QPixmap>
+#include <QMap>
 
 #include "timeline/sequence.h"
 #include "timeline/clip.h"
@@ -34,6 +36,7 @@
 #include "project/media.h"
 #include "undo/undo.h"
 #include "timelinetools.h"
+#include "timelinerasterizer.h"
 
 class Timeline;
 
@@ -44,6 +47,7 @@ struct TimelineTrackHeight {
 
 bool same_sign(int a, int b);
 void draw_waveform(ClipPtr clip, const FootageStream *ms, long media_length, QPainter* p, const QRect& clip_rect, int waveform_start, int waveform_limit, double zoom);
+void draw_waveform(const QVector<char>& preview, int channels, long clip_in, bool reversed, long media_length, QPainter* p, const QRect& clip_rect, int waveform_start, int waveform_limit, double zoom, bool rectified);
 
 class TimelineWidget : public QWidget {
   Q_OBJECT
@@ -52,10 +56,17 @@ public:
   QScrollBar* scrollBar;
   bool bottom_align;
 
+  /**
+   * @brief Repaint only the area around the playhead
+   *
+   * Used instead of update() during playback, when the playhead is the only thing that moves.
+   */
+  void update_playhead();
+
 public slots:
 
 protected:
-  void paintEvent(QPaintEvent*);
+  void paintEvent(QPaintEvent* e);
 
   void resizeEvent(QResizeEvent *event);
 
@@ -81,6 +92,77 @@ private:
 
   void VerifyTransitionHelper();
 
+  QRect get_clip_rect(ClipPtr clip);
+  QRect get_playhead_rect();
+
+  /**
+   * @brief Draw a clip clipped to `bounds`
+   *
+   * @return **FALSE** if the clip's waveform or thumbnail is still being rasterized and was left out.
+   */
+  bool draw_clip(QPainter& p, ClipPtr clip, const QRect& clip_rect, const QRect& bounds);
+
+  /**
+   * @brief Draw a row of filmstrip thumbnails of a video clip into `strip_rect`, clipped to `bounds`
+   *
+   * Thumbnails are laid out from the left of `strip_rect` every `thumb_width` pixels and show the media at their left
+   * edge. `clip_x` is the x coordinate of the clip's in point in the same coordinates as `strip_rect`.
+   *
+   * @return **FALSE** if some thumbnails are still being generated and were left out.
+   */
+  bool draw_filmstrip(QPainter& p, ClipPtr clip, FootageStream* ms, int clip_x, const QRect& strip_rect, int thumb_width, const QRect& bounds);
+
+  /**
+   * @brief Draw the clips inside `dirty_rect` from tiles_, redrawing any tiles that are out of date first
+   */
+  void draw_clip_tiles(QPainter& p, const QRect& dirty_rect);
+
+  /**
+   * @brief Identifies a tile, a kTileWidth wide strip of one track at one zoom level
+   */
+  struct TileKey {
+    Sequence* sequence;
+    int track;
+    double zoom;
+    int index;
+    int height;
+
+    bool operator<(const TileKey& rhs) const;
+  };
+
+  struct Tile {
+    QPixmap pixmap;
+
+    // combined paint state of the clips drawn into the tile, see clip_paint_hash()
+    uint signature;
+
+    // false if some clip's images weren't rasterized yet when the tile was drawn
+    bool complete;
+
+    quint64 last_used;
+  };
+
+  struct TileSignature {
+    uint hash = 0;
+    int clips = 0;
+  };
+
+  /**
+   * @brief Cached clip drawings
+   *
+   * Tiles are kept across scrolling and zoom levels, so scrolling and zooming back to a previous level just draws the
+   * existing pixmaps. A tile is only redrawn when one of the clips inside it changes.
+   */
+  QMap<TileKey, Tile> tiles_;
+  quint64 tile_clock_;
+
+  TimelineRasterizer rasterizer_;
+
+  /**
+   * @brief Area the playhead was last drawn in
+   */
+  QRect playhead_rect_;
+
   bool track_resizing;
   int track_target;
 
@@ -103,6 +185,7 @@ public slots:
   void setScroll(int);
 
 private slots:
+  void rasterizer_images_ready();
   void reveal_media();
   void show_context_menu(const QPoint& pos);
   void toggle_autoscale();
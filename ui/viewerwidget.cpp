@@ -215,6 +215,8 @@ void ViewerWidget::retry() {
 void ViewerWidget::initializeGL() {
   initializeOpenGLFunctions();
 
+  quad_.Create();
+
   connect(context(), SIGNAL(aboutToBeDestroyed()), this, SLOT(context_destroy()), Qt::DirectConnection);
 }
 
@@ -253,6 +255,7 @@ void ViewerWidget::context_destroy() {
     close_active_clips(viewer->seq.get());
   }
   renderer->delete_ctx();
+  quad_.Destroy();
   doneCurrent();
 }
 
@@ -413,127 +416,183 @@ void ViewerWidget::draw_title_safe_area() {
     }
   }
 
-  glLoadIdentity();
-  glOrtho(-halfWidth, halfWidth, halfHeight, -halfHeight, 0, 1);
+  QColor color = QColor::fromRgbF(0.66, 0.66, 0.66);
+
+  QMatrix4x4 projection;
+  projection.ortho(-halfWidth, halfWidth, halfHeight, -halfHeight, 0, 1);
 
-  glColor4f(0.66f, 0.66f, 0.66f, 1.0f);
-  glBegin(GL_LINES);
+  QVector<QVector2D> lines;
 
   // action safe rectangle
-  glVertex2d(-0.45, -0.45);
-  glVertex2d(0.45, -0.45);
-  glVertex2d(0.45, -0.45);
-  glVertex2d(0.45, 0.45);
-  glVertex2d(0.45, 0.45);
-  glVertex2d(-0.45, 0.45);
-  glVertex2d(-0.45, 0.45);
-  glVertex2d(-0.45, -0.45);
+  lines.append(QVector2D(-0.45f, -0.45f));
+  lines.append(QVector2D(0.45f, -0.45f));
+  lines.append(QVector2D(0.45f, -0.45f));
+  lines.append(QVector2D(0.45f, 0.45f));
+  lines.append(QVector2D(0.45f, 0.45f));
+  lines.append(QVector2D(-0.45f, 0.45f));
+  lines.append(QVector2D(-0.45f, 0.45f));
+  lines.append(QVector2D(-0.45f, -0.45f));
 
   // title safe rectangle
-  glVertex2d(-0.4, -0.4);
-  glVertex2d(0.4, -0.4);
-  glVertex2d(0.4, -0.4);
-  glVertex2d(0.4, 0.4);
-  glVertex2d(0.4, 0.4);
-  glVertex2d(-0.4, 0.4);
-  glVertex2d(-0.4, 0.4);
-  glVertex2d(-0.4, -0.4);
+  lines.append(QVector2D(-0.4f, -0.4f));
+  lines.append(QVector2D(0.4f, -0.4f));
+  lines.append(QVector2D(0.4f, -0.4f));
+  lines.append(QVector2D(0.4f, 0.4f));
+  lines.append(QVector2D(0.4f, 0.4f));
+  lines.append(QVector2D(-0.4f, 0.4f));
+  lines.append(QVector2D(-0.4f, 0.4f));
+  lines.append(QVector2D(-0.4f, -0.4f));
 
   // horizontal centers
-  glVertex2d(-0.45, 0);
-  glVertex2d(-0.375, 0);
-  glVertex2d(0.45, 0);
-  glVertex2d(0.375, 0);
+  lines.append(QVector2D(-0.45f, 0));
+  lines.append(QVector2D(-0.375f, 0));
+  lines.append(QVector2D(0.45f, 0));
+  lines.append(QVector2D(0.375f, 0));
 
   // vertical centers
-  glVertex2d(0, -0.45);
-  glVertex2d(0, -0.375);
-  glVertex2d(0, 0.45);
-  glVertex2d(0, 0.375);
+  lines.append(QVector2D(0, -0.45f));
+  lines.append(QVector2D(0, -0.375f));
+  lines.append(QVector2D(0, 0.45f));
+  lines.append(QVector2D(0, 0.375f));
 
-  glEnd();
+  quad_.DrawSolid(GL_LINES, lines, color, projection);
 
   // center cross
-  glLoadIdentity();
-  glOrtho(-halfAr, halfAr, 0.5, -0.5, -1, 1);
+  QMatrix4x4 cross_projection;
+  cross_projection.ortho(-halfAr, halfAr, 0.5, -0.5, -1, 1);
 
-  glBegin(GL_LINES);
+  QVector<QVector2D> cross;
 
-  glVertex2d(-0.05, 0);
-  glVertex2d(0.05, 0);
-  glVertex2d(0, -0.05);
-  glVertex2d(0, 0.05);
+  cross.append(QVector2D(-0.05f, 0));
+  cross.append(QVector2D(0.05f, 0));
+  cross.append(QVector2D(0, -0.05f));
+  cross.append(QVector2D(0, 0.05f));
 
-  glEnd();
+  quad_.DrawSolid(GL_LINES, cross, color, cross_projection);
 }
 
 void ViewerWidget::draw_gizmos() {
-  float color[4];
-  glGetFloatv(GL_CURRENT_COLOR, color);
-
-  double dot_size = GIZMO_DOT_SIZE / double(width()) * viewer->seq->width;
-  double target_size = GIZMO_TARGET_SIZE / double(width()) * viewer->seq->width;
+  float dot_size = GIZMO_DOT_SIZE / float(width()) * viewer->seq->width;
+  float target_size = GIZMO_TARGET_SIZE / float(width()) * viewer->seq->width;
 
   double zoom_factor = container->zoom/(double(width())/double(viewer->seq->width));
 
-  glPushMatrix();
-  glLoadIdentity();
+  QMatrix4x4 mvp;
+  mvp.ortho(0, viewer->seq->width, 0, viewer->seq->height, -1, 10);
+  mvp.scale(zoom_factor, zoom_factor);
+  mvp.translate(-(viewer->seq->width-(width()/container->zoom))*x_scroll,
+                -((viewer->seq->height-(height()/container->zoom))*(1.0-y_scroll)));
 
-  glOrtho(0, viewer->seq->width, 0, viewer->seq->height, -1, 10);
-  glScaled(zoom_factor, zoom_factor, 0.0);
-  glTranslated(-(viewer->seq->width-(width()/container->zoom))*x_scroll,
-               -((viewer->seq->height-(height()/container->zoom))*(1.0-y_scroll)),
-               0);
-
-  float gizmo_z = 0.0f;
   for (int j=0;j<gizmos->gizmo_count();j++) {
     EffectGizmo* g = gizmos->gizmo(j);
-    glColor4d(g->color.redF(), g->color.greenF(), g->color.blueF(), 1.0);
+
+    QColor color = g->color;
+    color.setAlphaF(1.0);
+
+    QVector<QVector2D> points;
+
     switch (g->get_type()) {
     case GIZMO_TYPE_DOT: // draw dot
-      glBegin(GL_QUADS);
-      glVertex3f(g->screen_pos[0].x()-dot_size, g->screen_pos[0].y()-dot_size, gizmo_z);
-      glVertex3f(g->screen_pos[0].x()+dot_size, g->screen_pos[0].y()-dot_size, gizmo_z);
-      glVertex3f(g->screen_pos[0].x()+dot_size, g->screen_pos[0].y()+dot_size, gizmo_z);
-      glVertex3f(g->screen_pos[0].x()-dot_size, g->screen_pos[0].y()+dot_size, gizmo_z);
-      glEnd();
+    {
+      QVector2D center(g->screen_pos[0]);
+      points.append(center + QVector2D(-dot_size, -dot_size));
+      points.append(center + QVector2D(dot_size, -dot_size));
+      points.append(center + QVector2D(dot_size, dot_size));
+      points.append(center + QVector2D(-dot_size, dot_size));
+      quad_.DrawSolid(GL_TRIANGLE_FAN, points, color, mvp);
+    }
       break;
     case GIZMO_TYPE_POLY: // draw lines
-      glBegin(GL_LINES);
       for (int k=1;k<g->get_point_count();k++) {
-        glVertex3f(g->screen_pos[k-1].x(), g->screen_pos[k-1].y(), gizmo_z);
-        glVertex3f(g->screen_pos[k].x(), g->screen_pos[k].y(), gizmo_z);
+        points.append(QVector2D(g->screen_pos[k-1]));
+        points.append(QVector2D(g->screen_pos[k]));
       }
-      glVertex3f(g->screen_pos[g->get_point_count()-1].x(), g->screen_pos[g->get_point_count()-1].y(), gizmo_z);
-      glVertex3f(g->screen_pos[0].x(), g->screen_pos[0].y(), gizmo_z);
-      glEnd();
+      points.append(QVector2D(g->screen_pos[g->get_point_count()-1]));
+      points.append(QVector2D(g->screen_pos[0]));
+      quad_.DrawSolid(GL_LINES, points, color, mvp);
       break;
     case GIZMO_TYPE_TARGET: // draw target
-      glBegin(GL_LINES);
-      glVertex3f(g->screen_pos[0].x()-target_size, g->screen_pos[0].y()-target_size, gizmo_z);
-      glVertex3f(g->screen_pos[0].x()+target_size, g->screen_pos[0].y()-target_size, gizmo_z);
+    {
+      QVector2D center(g->screen_pos[0]);
+      points.append(center + QVector2D(-target_size, -target_size));
+      points.append(center + QVector2D(target_size, -target_size));
 
-      glVertex3f(g->screen_pos[0].x()+target_size, g->screen_pos[0].y()-target_size, gizmo_z);
-      glVertex3f(g->screen_pos[0].x()+target_size, g->screen_pos[0].y()+target_size, gizmo_z);
+      points.append(center + QVector2D(target_size, -target_size));
+      points.append(center + QVector2D(target_size, target_size));
 
-      glVertex3f(g->screen_pos[0].x()+target_size, g->screen_pos[0].y()+target_size, gizmo_z);
-      glVertex3f(g->screen_pos[0].x()-target_size, g->screen_pos[0].y()+target_size, gizmo_z);
+      points.append(center + QVector2D(target_size, target_size));
+      points.append(center + QVector2D(-target_size, target_size));
 
-      glVertex3f(g->screen_pos[0].x()-target_size, g->screen_pos[0].y()+target_size, gizmo_z);
-      glVertex3f(g->screen_pos[0].x()-target_size, g->screen_pos[0].y()-target_size, gizmo_z);
+      points.append(center + QVector2D(-target_size, target_size));
+      points.append(center + QVector2D(-target_size, -target_size));
 
-      glVertex3f(g->screen_pos[0].x()-target_size, g->screen_pos[0].y(), gizmo_z);
-      glVertex3f(g->screen_pos[0].x()+target_size, g->screen_pos[0].y(), gizmo_z);
+      points.append(center + QVector2D(-target_size, 0));
+      points.append(center + QVector2D(target_size, 0));
 
-      glVertex3f(g->screen_pos[0].x(), g->screen_pos[0].y()-target_size, gizmo_z);
-      glVertex3f(g->screen_pos[0].x(), g->screen_pos[0].y()+target_size, gizmo_z);
-      glEnd();
+      points.append(center + QVector2D(0, -target_size));
+      points.append(center + QVector2D(0, target_size));
+      quad_.DrawSolid(GL_LINES, points, color, mvp);
+    }
       break;
     }
   }
-  glPopMatrix();
+}
+
+void ViewerWidget::draw_performance_overlay() {
+  RenderStats stats = renderer->get_stats();
+
+  // anything that takes longer than a frame's duration on its own is enough to make playback stutter
+  qint64 frame_budget = qRound64(1000000.0 / viewer->seq->frame_rate);
+
+  QStringList lines;
+  QVector<bool> over_budget;
+
+  lines.append(tr("Render: %1 ms").arg(QString::number(stats.render_time * 0.001, 'f', 1)));
+  over_budget.append(stats.render_time > frame_budget);
+
+  lines.append(tr("Dropped Frames: %1").arg(stats.dropped_frames));
+  over_budget.append(stats.dropped_frames > 0 && viewer->playing);
+
+  if (is_audio_device_set()) {
+    int audio_buffered = playback_audio.BufferedMilliseconds();
+    lines.append(tr("Audio Buffered: %1 ms").arg(audio_buffered));
+    over_budget.append(viewer->playing && audio_buffered * 1000 < frame_budget);
+  }
+
+  lines.append(tr("GPU Memory: %1 MB").arg(QString::number(double(stats.gpu_memory) / 1048576.0, 'f', 1)));
+  over_budget.append(false);
+
+  lines.append(tr("Frame Memory: %1 MB").arg(QString::number(double(stats.frame_memory) / 1048576.0, 'f', 1)));
+  over_budget.append(false);
+
+  for (int i=0;i<stats.clips.size();i++) {
+    const ClipLatency& l = stats.clips.at(i);
+
+    lines.append(tr("%1: decode %2 ms, upload %3 ms, queue %4/%5").arg(l.name,
+                                                                         QString::number(l.wait * 0.001, 'f', 1),
+                                                                         QString::number(l.upload * 0.001, 'f', 1),
+                                                                         QString::number(l.queue_ahead),
+                                                                         QString::number(l.queue_target)));
+    over_budget.append(l.wait + l.upload > frame_budget || (viewer->playing && l.queue_ahead == 0));
+  }
 
-  glColor4f(color[0], color[1], color[2], color[3]);
+  QPainter p(this);
+
+  QFontMetrics fm = p.fontMetrics();
+  int line_height = fm.height();
+  int margin = line_height / 2;
+
+  int text_width = 0;
+  for (int i=0;i<lines.size();i++) {
+    text_width = qMax(text_width, fm.width(lines.at(i)));
+  }
+
+  p.fillRect(0, 0, text_width + margin * 2, line_height * lines.size() + margin * 2, QColor(0, 0, 0, 160));
+
+  for (int i=0;i<lines.size();i++) {
+    p.setPen(over_budget.at(i) ? QColor(255, 96, 96) : Qt::white);
+    p.drawText(margin, margin + line_height * i + fm.ascent(), lines.at(i));
+  }
 }
 
 void ViewerWidget::paintGL() {
@@ -551,22 +610,9 @@ void ViewerWidget::paintGL() {
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    // set color multipler to straight white
-    glColor4f(1.0, 1.0, 1.0, 1.0);
-
-    glEnable(GL_TEXTURE_2D);
-
     // set screen coords to widget size
-    glLoadIdentity();
-    glOrtho(-1, 1, -1, 1, -1, 1);
-
-    // draw texture from render thread
-
-    glBindTexture(GL_TEXTURE_2D, tex);
-
-    context()->functions()->glGenerateMipmap(GL_TEXTURE_2D);
-
-    glBegin(GL_QUADS);
+    QMatrix4x4 projection;
+    projection.ortho(-1, 1, -1, 1, -1, 1);
 
     double zoom_factor = container->zoom/(double(width())/double(viewer->seq->width));
     double zoom_size = (zoom_factor*2.0) - 2.0;
@@ -575,19 +621,38 @@ void ViewerWidget::paintGL() {
     double zoom_bottom = -zoom_size*(1.0-y_scroll) - 1.0;
     double zoom_top = zoom_size*(y_scroll) + 1.0;
 
-    //zoom_left *= ar_diff;
-    //zoom_right *= ar_diff;
+    QVector2D positions[4] = {
+      QVector2D(zoom_left, zoom_top),
+      QVector2D(zoom_right, zoom_top),
+      QVector2D(zoom_right, zoom_bottom),
+      QVector2D(zoom_left, zoom_bottom)
+    };
+
+    QVector2D texcoords[4] = {
+      QVector2D(0, 0),
+      QVector2D(1, 0),
+      QVector2D(1, 1),
+      QVector2D(0, 1)
+    };
+
+    // the frame only needs mipmaps if it's zoomed out below 100% on this screen
+    QVector2D pixel_scale(width()*devicePixelRatioF()*0.5, height()*devicePixelRatioF()*0.5);
+    QVector2D pixel_positions[4];
+    for (int i=0;i<4;i++) {
+      pixel_positions[i] = positions[i] * pixel_scale;
+    }
+    bool minified = olive::rendering::IsMinified(pixel_positions,
+                                                 texcoords,
+                                                 viewer->seq->width,
+                                                 viewer->seq->height);
 
-    glVertex2d(zoom_left, zoom_bottom);
-    glTexCoord2d(0, 0);
-    glVertex2d(zoom_left, zoom_top);
-    glTexCoord2d(1, 0);
-    glVertex2d(zoom_right, zoom_top);
-    glTexCoord2d(1, 1);
-    glVertex2d(zoom_right, zoom_bottom);
-    glTexCoord2d(0, 1);
+    // draw texture from render thread
 
-    glEnd();
+    glBindTexture(GL_TEXTURE_2D, tex);
+
+    olive::rendering::PrepareToDraw(context()->functions(), minified);
+
+    quad_.Draw(nullptr, projection, positions, texcoords);
 
     glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -601,11 +666,14 @@ void ViewerWidget::paintGL() {
       draw_gizmos();
     }
 
-    glDisable(GL_TEXTURE_2D);
+    if (olive::CurrentConfig.show_performance_overlay) {
+      draw_performance_overlay();
+    }
+
     glFinish();
 
     if (window->isVisible()) {
-      window->set_texture(tex, double(viewer->seq->width)/double(viewer->seq->height), tex_lock);
+      window->set_texture(tex, viewer->seq->width, viewer->seq->height, tex_lock);
     }
 
     tex_lock->unlock();
@@ -36,6 +36,7 @@
 #include "ui/viewerwindow.h"
 #include "ui/viewercontainer.h"
 #include "rendering/renderthread.h"
+#include "rendering/quadrenderer.h"
 
 class Viewer;
 class QOpenGLFramebufferObject;
@@ -77,6 +78,7 @@ private:
   void draw_waveform_func();
   void draw_title_safe_area();
   void draw_gizmos();
+  void draw_performance_overlay();
   EffectGizmo* get_gizmo_from_mouse(int x, int y);
   void move_gizmos(QMouseEvent *event, bool done);
   bool dragging;
@@ -91,6 +93,7 @@ private:
   ViewerWindow* window;
   double x_scroll;
   double y_scroll;
+  QuadRenderer quad_;
 private slots:
   void context_destroy();
   void retry();
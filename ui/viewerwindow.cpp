@@ -36,6 +36,9 @@
 ViewerWindow::ViewerWindow(QWidget *parent) :
   QOpenGLWidget(parent, Qt::Window),
   texture(0),
+  texture_width(0),
+  texture_height(0),
+  ar(1.0),
   mutex(nullptr),
   show_fullscreen_msg(false)
 {
@@ -45,9 +48,11 @@ ViewerWindow::ViewerWindow(QWidget *parent) :
   connect(&fullscreen_msg_timer, SIGNAL(timeout()), this, SLOT(fullscreen_msg_timeout()));
 }
 
-void ViewerWindow::set_texture(GLuint t, double iar, QMutex* imutex) {
+void ViewerWindow::set_texture(GLuint t, int width, int height, QMutex* imutex) {
   texture = t;
-  ar = iar;
+  texture_width = width;
+  texture_height = height;
+  ar = double(width)/double(height);
   mutex = imutex;
   update();
 }
@@ -107,6 +112,12 @@ void ViewerWindow::mouseMoveEvent(QMouseEvent *) {
   }
 }
 
+void ViewerWindow::initializeGL() {
+  quad_.Create();
+
+  connect(context(), SIGNAL(aboutToBeDestroyed()), this, SLOT(context_destroy()), Qt::DirectConnection);
+}
+
 void ViewerWindow::paintGL() {
   if (texture > 0) {
     if (mutex != nullptr) mutex->lock();
@@ -114,15 +125,6 @@ void ViewerWindow::paintGL() {
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glEnable(GL_TEXTURE_2D);
-
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glLoadIdentity();
-    glOrtho(0, 1, 0, 1, -1, 1);
-
-    glBegin(GL_QUADS);
-
     double top = 0;
     double left = 0;
     double right = 1;
@@ -140,20 +142,35 @@ void ViewerWindow::paintGL() {
       bottom = top + height;
     }
 
-    glVertex2d(left, top);
-    glTexCoord2d(0, 0);
-    glVertex2d(left, bottom);
-    glTexCoord2d(1, 0);
-    glVertex2d(right, bottom);
-    glTexCoord2d(1, 1);
-    glVertex2d(right, top);
-    glTexCoord2d(0, 1);
+    QMatrix4x4 projection;
+    projection.ortho(0, 1, 0, 1, -1, 1);
 
-    glEnd();
+    QVector2D positions[4] = {
+      QVector2D(left, top),
+      QVector2D(right, top),
+      QVector2D(right, bottom),
+      QVector2D(left, bottom)
+    };
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    QVector2D texcoords[4] = {
+      QVector2D(0, 1),
+      QVector2D(1, 1),
+      QVector2D(1, 0),
+      QVector2D(0, 0)
+    };
 
-    glDisable(GL_TEXTURE_2D);
+    // only generate mipmaps if the frame is shown smaller than its resolution
+    double pixel_width = (right - left) * width() * devicePixelRatioF();
+    double pixel_height = (bottom - top) * height() * devicePixelRatioF();
+    bool minified = (pixel_width < texture_width - 0.5 || pixel_height < texture_height - 0.5);
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    olive::rendering::PrepareToDraw(context()->functions(), minified);
+
+    quad_.Draw(nullptr, projection, positions, texcoords);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
 
     if (mutex != nullptr) mutex->unlock();
   }
@@ -189,6 +206,12 @@ void ViewerWindow::paintGL() {
   }
 }
 
+void ViewerWindow::context_destroy() {
+  makeCurrent();
+  quad_.Destroy();
+  doneCurrent();
+}
+
 void ViewerWindow::fullscreen_msg_timeout() {
   fullscreen_msg_timer.stop();
   if (show_fullscreen_msg) {
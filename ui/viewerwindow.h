@@ -24,6 +24,8 @@
 #include <QOpenGLWidget>
 #include <QTimer>
 
+#include "rendering/quadrenderer.h"
+
 class QMutex;
 class QMenu;
 class QShortcut;
@@ -32,17 +34,21 @@ class ViewerWindow : public QOpenGLWidget {
   Q_OBJECT
 public:
   ViewerWindow(QWidget *parent);
-  void set_texture(GLuint t, double iar, QMutex *imutex);
+  void set_texture(GLuint t, int width, int height, QMutex *imutex);
 protected:
   virtual void showEvent(QShowEvent*) override;
   virtual void keyPressEvent(QKeyEvent*) override;
   virtual void mousePressEvent(QMouseEvent*) override;
   virtual void mouseMoveEvent(QMouseEvent*) override;
 
+  virtual void initializeGL() override;
   virtual void paintGL() override;
 private:
   GLuint texture;
+  int texture_width;
+  int texture_height;
   double ar;
+  QuadRenderer quad_;
   QMutex* mutex;
 
   // shortcuts
@@ -55,6 +61,7 @@ private:
   QRect fullscreen_msg_rect;
 private slots:
   void fullscreen_msg_timeout();
+  void context_destroy();
 };
 
 #endif // VIEWERWINDOW_H
@@ -41,6 +41,7 @@
 #include "project/clipboard.h"
 #include "project/previewgenerator.h"
 #include "ui/mainwindow.h"
+#include "undo/undostack.h"
 
 MoveClipAction::MoveClipAction(Clip *c, long iin, long iout, long iclip_in, int itrack, bool irelative) {
   clip = c;
@@ -1141,6 +1142,8 @@ OliveAction::~OliveAction() {}
 void OliveAction::undo() {
   doUndo();
 
+  olive::BumpContentRevision();
+
   if (set_window_modified) {
     olive::Global->set_modified(old_window_modified);
   }
@@ -1149,6 +1152,8 @@ void OliveAction::undo() {
 void OliveAction::redo() {
   doRedo();
 
+  olive::BumpContentRevision();
+
   if (set_window_modified) {
 
     // store current modified state
@@ -1,3 +1,15 @@
 #include "undostack.h"
 
+#include <QAtomicInt>
+
 QUndoStack olive::UndoStack;
+
+static QAtomicInt content_revision;
+
+int olive::ContentRevision() {
+  return content_revision.load();
+}
+
+void olive::BumpContentRevision() {
+  content_revision.ref();
+}
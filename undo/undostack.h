@@ -8,6 +8,20 @@ namespace olive {
  * @brief Global undo stack object
  */
 extern QUndoStack UndoStack;
+
+/**
+ * @brief Get the current project content revision
+ *
+ * A counter that increases every time something that could change a rendered frame is modified (undo/redo actions,
+ * effect field changes). Render caches use it as part of their key so they can tell a stale frame from a valid one
+ * without having to track every individual change. Thread-safe.
+ */
+int ContentRevision();
+
+/**
+ * @brief Increment the project content revision, invalidating anything cached against the previous one
+ */
+void BumpContentRevision();
 }
 
 #endif // UNDOSTACK_H